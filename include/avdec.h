@@ -323,6 +323,18 @@ void bgav_options_set_rtp_port_base(bgav_options_t * opt, int p);
 BGAV_PUBLIC
 void bgav_options_set_rtp_try_tcp(bgav_options_t * opt, int enable);
 
+/** \ingroup options
+ *  \brief Set the number of UDP datagrams read at once
+ *  \param opt Option container
+ *  \param num Maximum number of datagrams per system call (default 32)
+ *
+ *  Where supported (recvmmsg), RTP over UDP receives up to this many
+ *  datagrams with one system call. Use 1 to disable batching.
+ */
+
+BGAV_PUBLIC
+void bgav_options_set_udp_batch_size(bgav_options_t * opt, int num);
+
 /** \ingroup options
  *  \brief Set network bandwidth
  *  \param opt Option container
@@ -432,6 +444,30 @@ void bgav_options_set_http_proxy_pass(bgav_options_t* opt, const char * pass);
 BGAV_PUBLIC
 void bgav_options_set_http_shoutcast_metadata(bgav_options_t* opt, int enable);
 
+/** \ingroup options
+ *  \brief Set the size of the http block cache
+ *  \param opt Option container
+ *  \param num Number of 256 kB blocks
+ *
+ *  After the first seek, seekable http resources are loaded with range
+ *  requests and kept in an in-memory cache of this many blocks. Default is 64.
+ */
+
+BGAV_PUBLIC
+void bgav_options_set_http_cache_blocks(bgav_options_t* opt, int num);
+
+/** \ingroup options
+ *  \brief Set the number of prefetched HLS segments
+ *  \param opt Option container
+ *  \param num Number of segments
+ *
+ *  HTTP live streams are downloaded in the background up to this many
+ *  segments ahead of the reader. Default is 3.
+ */
+
+BGAV_PUBLIC
+void bgav_options_set_hls_prefetch_segments(bgav_options_t* opt, int num);
+
 /* Set FTP options */
 
 /** \ingroup options
@@ -526,6 +562,58 @@ void bgav_options_set_cache_time(bgav_options_t*opt, int t);
 BGAV_PUBLIC
 void bgav_options_set_cache_size(bgav_options_t*opt, int s);
 
+/** \ingroup options
+ *  \brief Follow growing files
+ *  \param opt Option container
+ *  \param interval Minimum time (in milliseconds) between two index updates, 0 disables following
+ *
+ *  For files, which are still being written (e.g. recordings), the
+ *  file index is extended when a stream reaches the end of the index
+ *  in sample accurate mode. After that, durations and the end of
+ *  the streams are updated. The index can also be updated
+ *  explicitly with \ref bgav_update_file_index.
+ *
+ *  Only formats, which are indexed by parsing the whole file
+ *  (e.g. MPEG program- and transport streams) can be followed.
+ */
+
+BGAV_PUBLIC
+void bgav_options_set_follow(bgav_options_t*opt, int interval);
+
+/** \ingroup options
+ *  \brief Enable the media info cache
+ *  \param opt Option container
+ *  \param enable 1 to enable the cache, 0 to disable it
+ *
+ *  If enabled, the track table (formats, durations, metadata and
+ *  compression infos known so far) of local files is stored in
+ *  the same directory as the indices. The cache entry is keyed by
+ *  the filename, size and modification time. If a valid entry exists,
+ *  \ref bgav_open doesn't read the file at all. The demuxer is opened
+ *  when \ref bgav_select_track is called or a compression info
+ *  must be obtained from the file. All data returned by the
+ *  info functions before (e.g. by \ref bgav_get_media_info) becomes
+ *  invalid then.
+ */
+
+BGAV_PUBLIC
+void bgav_options_set_info_cache(bgav_options_t*opt, int enable);
+
+/** \ingroup options
+ *  \brief Enable the info only mode
+ *  \param opt Option container
+ *  \param enable 1 to stop after the headers, 0 to open files completely
+ *
+ *  In info only mode, demuxers, which support it, read only the file headers
+ *  in \ref bgav_open. Expensive things like building the packet index are
+ *  done when \ref bgav_select_track is called or a compression info is
+ *  requested. Some infos are estimated until then,
+ *  see \ref bgav_get_info_flags.
+ */
+
+BGAV_PUBLIC
+void bgav_options_set_info_only(bgav_options_t*opt, int enable);
+
 /** \ingroup options
  *  \brief Enable external subtitle files
  *  \param opt Option container
@@ -581,6 +669,60 @@ void bgav_options_set_postprocessing_level(bgav_options_t* opt,
 BGAV_PUBLIC
 void bgav_options_set_threads(bgav_options_t * opt, int threads);
 
+/** \ingroup options
+ *  \brief Enable pipeline mode
+ *  \param opt Option container
+ *  \param pipeline 1 to enable pipeline mode, 0 to disable it
+ *
+ *  In pipeline mode, the demuxer runs in its own thread and each decoded
+ *  audio and video stream is decoded by its own thread. Up to 4 frames
+ *  per stream are decoded ahead. Frames returned by the sources
+ *  (see \ref bgav_get_audio_source and \ref bgav_get_video_source)
+ *  stay valid until the next read call as usual. Seeking stops all
+ *  threads, the next read call restarts them.
+ *
+ *  Pipeline mode is only available if the demuxer reads the file
+ *  sequentially. Callbacks (e.g. metadata changes) can be called from
+ *  the demuxer thread then.
+ */
+
+BGAV_PUBLIC
+void bgav_options_set_pipeline(bgav_options_t * opt, int pipeline);
+
+/** \ingroup options
+ *  \brief Enable stream copy mode
+ *  \param opt Option container
+ *  \param enable 1 to pass compressed video packets without parsing, 0 else
+ *
+ *  This is for applications, which read compressed packets
+ *  (see \ref bgav_read_video_packet) for remultiplexing. If the
+ *  container has a complete packet index (e.g. Quicktime/mp4 or AVI)
+ *  with timestamps, durations and keyframe flags, the video packets
+ *  are passed from the demuxer to the packet source directly.
+ *  They don't go through the parser, the packet timer and the frame type
+ *  detector then. Consequently, the coding types (I, P, B) of the packets
+ *  and timecodes from the elementary stream are not available, and the
+ *  formats and compression infos are taken from the container
+ *  headers only.
+ *
+ *  Streams of other formats are handled as usual.
+ */
+
+BGAV_PUBLIC
+void bgav_options_set_stream_copy(bgav_options_t * opt, int enable);
+
+/** \ingroup options
+ *  \brief Enable seamless playback
+ *  \param opt Option container
+ *  \param seamless 1 to enable seamless playback, 0 to disable it
+ *
+ *  With seamless playback, further tracks can be queued with
+ *  \ref bgav_queue_track. See \ref seamless.
+ */
+
+BGAV_PUBLIC
+void bgav_options_set_seamless(bgav_options_t * opt, int seamless);
+
   
 /** \ingroup options
  *  \brief Set DVB channels file
@@ -622,6 +764,23 @@ BGAV_PUBLIC
 void bgav_options_set_dv_datetime(bgav_options_t* opt,
                                   int datetime);
 
+/** \ingroup options
+ *  \brief Demultiplex all programs of MPEG transport streams at once
+ *  \param opt Option container
+ *  \param multiplex 1 to add a track with all programs, 0 else
+ *
+ *  If a transport stream has more than one program, an additional
+ *  last track is added, which contains the streams of all programs.
+ *  Selecting it lets one pass over the input deliver packets for
+ *  several programs (e.g. for recording a whole multiplex).
+ *  Timestamps of each stream are relative to the first PCR of its
+ *  program.
+ */
+
+BGAV_PUBLIC
+void bgav_options_set_mpegts_multiplex(bgav_options_t* opt,
+                                       int multiplex);
+
 /** \ingroup options
  *  \brief Shrink factor
  *  \param opt Option container
@@ -700,6 +859,20 @@ BGAV_PUBLIC
 void bgav_options_set_dump_packets(bgav_options_t* opt,
                                    int enable);
 
+/** \ingroup options
+ *  \brief Enable timing in the performance counters
+ *  \param opt Option container
+ *  \param enable 1 to measure the time spent in each stage, 0 else
+ *
+ *  Call counts and byte counts are always maintained. Measuring the
+ *  time needs a clock call before and after each read, packet or frame,
+ *  so it's disabled by default. See \ref bgav_get_perf.
+ */
+
+BGAV_PUBLIC
+void bgav_options_set_perf_counters(bgav_options_t* opt,
+                                    int enable);
+
 
 /** \ingroup options
  *  \brief Enumeration for log levels
@@ -1203,6 +1376,24 @@ const char * bgav_get_description(bgav_t * bgav);
 BGAV_PUBLIC
 gavl_time_t bgav_get_duration(bgav_t * bgav, int track);
 
+#define BGAV_INFO_DURATION_ESTIMATED (1<<0) //!< Durations are taken from the container header
+#define BGAV_INFO_STATS_MISSING      (1<<1) //!< Packet statistics (bitrates, packet sizes) are not available
+
+/** \ingroup track
+ *  \brief Check, which infos of a track are estimated
+ *  \param bgav A decoder instance
+ *  \param track Track index (starting with 0)
+ *  \returns A combination of BGAV_INFO_* flags
+ *
+ *  This returns nonzero only in info only mode
+ *  (see \ref bgav_options_set_info_only) until the track is selected.
+ *  Selecting the track builds the index, which also removes streams
+ *  without packets.
+ */
+
+BGAV_PUBLIC
+int bgav_get_info_flags(bgav_t * bgav, int track);
+
 /* Query stream numbers */
 
 /** \ingroup track
@@ -1694,6 +1885,23 @@ int bgav_set_audio_stream(bgav_t * bgav, int stream, bgav_stream_action_t action
 BGAV_PUBLIC
 int bgav_set_video_stream(bgav_t * bgav, int stream, bgav_stream_action_t action);
 
+/** \ingroup streams
+ * \brief Decode only keyframes of a video stream
+ * \param bgav A decoder instance
+ * \param stream Stream index (starting with 0)
+ * \param keyframes_only 1 to decode only keyframes
+ * \returns 1 on success, 0 if the stream doesn't exist
+ *
+ * Call this before \ref bgav_start. Useful for thumbnails and scrubbing.
+ * If the demuxer has an index with keyframe flags, other packets are
+ * not even read from the file. The decoder drops non-reference frames.
+ * Output frames have the timestamps of the keyframes, so the framerate
+ * mode of the stream becomes \ref GAVL_FRAMERATE_VARIABLE.
+ */
+
+BGAV_PUBLIC
+int bgav_set_video_keyframes_only(bgav_t * bgav, int stream, int keyframes_only);
+
 /** \ingroup streams
  * \brief Select mode for a subtitle stream
  * \param bgav A decoder instance
@@ -1763,6 +1971,56 @@ int bgav_set_overlay_stream(bgav_t * bgav, int stream,
 BGAV_PUBLIC
 int bgav_start(bgav_t * bgav);
 
+/** \defgroup seamless Seamless playback
+ *  \ingroup decoding
+ *
+ *  If seamless playback is enabled (see \ref bgav_options_set_seamless),
+ *  the application can queue tracks, which are played after the current
+ *  one. The next queued track is opened in the background while the
+ *  current one is played.
+ *
+ *  If the active streams of the next track have the same formats as
+ *  the current ones (same codec, codec header, samplerate, channels,
+ *  image size), the packets are appended to the current streams. The
+ *  decoders are kept open and the timestamps continue without a gap.
+ *  The metadata change callback (see
+ *  \ref bgav_options_set_metadata_change_callback) is called with
+ *  the metadata of the new track.
+ *
+ *  If the formats differ, the read functions return EOF at the end of
+ *  the current track. The already opened next track can then be
+ *  obtained with \ref bgav_get_next.
+ *
+ *  Seeking always goes to the track, which was selected with
+ *  \ref bgav_select_track. Tracks, which were appended already, are
+ *  queued again.
+ */
+
+/** \ingroup seamless
+ *  \brief Queue a track
+ *  \param bgav A decoder instance
+ *  \param location Location to open or NULL for the location of bgav
+ *  \param track Track to play (starting with 0)
+ *  \returns 1 if the track was queued, 0 if seamless playback is disabled
+ */
+
+BGAV_PUBLIC
+int bgav_queue_track(bgav_t * bgav, const char * location, int track);
+
+/** \ingroup seamless
+ *  \brief Get the next queued track as a new decoder instance
+ *  \param bgav A decoder instance
+ *  \returns A new decoder instance or NULL
+ *
+ *  Call this after EOF if the next track could not be appended. The
+ *  returned instance is opened and the track is selected. The remaining
+ *  queued tracks are moved to the new instance. Close it with
+ *  \ref bgav_close.
+ */
+
+BGAV_PUBLIC
+bgav_t * bgav_get_next(bgav_t * bgav);
+
 /** \defgroup stream_info Information about the streams
     \ingroup decoding
  */
@@ -2494,6 +2752,21 @@ void bgav_seek_text(bgav_t * bgav, int stream, int64_t time);
 BGAV_PUBLIC
 void bgav_seek_overlay(bgav_t * bgav, int stream, int64_t time);
 
+/** \ingroup sampleseek
+ *  \brief Extend the file index of a growing file
+ *  \param bgav A decoder handle
+ *  \returns 1 if the index was extended, 0 else
+ *
+ *  If the file grew since the index was created, the appended
+ *  part is indexed and the durations are updated. Only the
+ *  part after the last complete packet (or keyframe for video)
+ *  is parsed. Use this only after \ref bgav_can_seek_sample returned 1.
+ *  See also \ref bgav_options_set_follow.
+ */
+
+BGAV_PUBLIC
+int bgav_update_file_index(bgav_t * bgav);
+
   
 /** \defgroup codec Standalone stream decoders
  *
@@ -2671,6 +2944,83 @@ gavl_codec_id_t * bgav_supported_video_compressions();
 BGAV_PUBLIC
 void bgav_dump(bgav_t * bgav);
 
+/** \ingroup debugging
+ *  \brief Performance counter of one processing stage
+ *
+ *  Times are in microseconds and only measured, if enabled with
+ *  \ref bgav_options_set_perf_counters. They don't include the time
+ *  spent in the stages called from this one, i.e. the demuxer time
+ *  doesn't include reading from the input and the decoder time doesn't
+ *  include the parser. In pipeline mode (see \ref bgav_options_set_pipeline)
+ *  the parser time includes waiting for the demuxer thread.
+ */
+
+typedef struct
+  {
+  int64_t time;    //!< Time spent in this stage
+  int64_t calls;   //!< Number of reads, seeks, packets or frames
+  int64_t bytes;   //!< Number of bytes read or passed
+  int64_t dropped; //!< Number of skipped packets or frames
+  } bgav_perf_counter_t;
+
+/** \ingroup debugging
+ *  \brief Performance counters of the input and demuxer
+ */
+
+typedef struct
+  {
+  bgav_perf_counter_t read;  //!< Reads from the input module
+  bgav_perf_counter_t seek;  //!< Seeks of the input module
+  bgav_perf_counter_t demux; //!< Packets produced by the demuxer
+
+  int64_t requests;          //!< Requests sent by network inputs (e.g. http range requests)
+  int64_t requests_reused;   //!< Requests sent over a kept alive connection
+  int64_t cache_hits;        //!< Reads served from the block cache of the input
+  int64_t cache_misses;      //!< Reads, which had to load a block
+  } bgav_perf_t;
+
+/** \ingroup debugging
+ *  \brief Performance counters of an A/V stream
+ */
+
+typedef struct
+  {
+  bgav_perf_counter_t parse;  //!< Packets read by the decoder (parser, packet timer)
+  bgav_perf_counter_t decode; //!< Frames decoded
+  int64_t pool_misses;        //!< Packets, which had to be allocated
+  } bgav_stream_perf_t;
+
+/** \ingroup debugging
+ *  \brief Get the performance counters of the input and demuxer
+ *  \param bgav A decoder handle
+ *  \param ret Returns the counters
+ *
+ *  The counters are accumulated since the file was opened.
+ */
+
+BGAV_PUBLIC
+void bgav_get_perf(bgav_t * bgav, bgav_perf_t * ret);
+
+/** \ingroup debugging
+ *  \brief Get the performance counters of an audio stream
+ *  \param bgav A decoder handle
+ *  \param stream Stream index (starting with 0)
+ *  \param ret Returns the counters
+ */
+
+BGAV_PUBLIC
+void bgav_get_audio_perf(bgav_t * bgav, int stream, bgav_stream_perf_t * ret);
+
+/** \ingroup debugging
+ *  \brief Get the performance counters of a video stream
+ *  \param bgav A decoder handle
+ *  \param stream Stream index (starting with 0)
+ *  \param ret Returns the counters
+ */
+
+BGAV_PUBLIC
+void bgav_get_video_perf(bgav_t * bgav, int stream, bgav_stream_perf_t * ret);
+
 /* Dump infos about the installed codecs */
 
 /** \ingroup debugging
@@ -80,6 +80,11 @@ typedef struct bgav_packet_pool_s bgav_packet_pool_t;
 
 typedef struct bgav_video_format_tracker_s bgav_video_format_tracker_t;
 
+typedef struct bgav_pipeline_s bgav_pipeline_t;
+typedef struct bgav_frame_threads_s bgav_frame_threads_t;
+typedef struct bgav_seamless_s bgav_seamless_t;
+typedef struct bgav_pipeline_stream_s bgav_pipeline_stream_t;
+
 #include <id3.h>
 #include <yml.h>
 #include <packettimer.h>
@@ -116,6 +121,11 @@ struct bgav_audio_decoder_s
   bgav_audio_decoder_t * next;
   };
 
+/* Decoder reads exactly one packet per frame and keeps no state
+   between frames. Multiple instances can decode intra-only streams in
+   parallel */
+#define VIDEO_DECODER_FRAME_THREADS (1<<0)
+
 struct bgav_video_decoder_s
   {
   const uint32_t * fourccs;
@@ -323,6 +333,7 @@ void bgav_packet_buffer_append(bgav_packet_buffer_t * b,
 void bgav_packet_buffer_clear(bgav_packet_buffer_t*);
 
 int bgav_packet_buffer_is_empty(bgav_packet_buffer_t * b);
+int bgav_packet_buffer_get_num_packets(bgav_packet_buffer_t * b);
 
 /* packetpool.c */
 
@@ -334,6 +345,9 @@ void bgav_packet_pool_put(bgav_packet_pool_t * pp,
 
 void bgav_packet_pool_destroy(bgav_packet_pool_t*);
 
+/* Number of packets, which had to be allocated because the pool was empty */
+int64_t bgav_packet_pool_get_misses(bgav_packet_pool_t * pp);
+
 
 
 /* Stream types
@@ -381,6 +395,9 @@ typedef enum
 #define STREAM_DISCONT            (1<<16) // Stream is discontinuous
 #define STREAM_SUBREADER          (1<<17) // External subtitle file
 #define STREAM_STANDALONE         (1<<18) // Standalone decoder
+#define STREAM_KEYFRAMES_ONLY     (1<<19) // Decode only keyframes
+#define STREAM_DURATION_ESTIMATE  (1<<20) // Stats are estimated from the headers
+#define STREAM_SPLICE_SOURCE      (1<<21) // Packets are appended to another stream, no decoder
 
 
 /* Stream could not get exact compression info from the
@@ -427,6 +444,12 @@ typedef struct
       
   gavl_video_source_t * vsrc;
 
+  /* Packet source before the keyframe filter */
+  bgav_packet_source_t kf_src;
+
+  /* Frame parallel decoding */
+  bgav_frame_threads_t * fth;
+  
   } bgav_stream_video_t;
   
 struct bgav_stream_s
@@ -517,6 +540,9 @@ struct bgav_stream_s
   int src_flags;
   
   gavf_stream_stats_t stats;
+
+  /* Original stats if the duration is estimated */
+  gavf_stream_stats_t stats_orig;
   
   /*
    *  Timestamp of the first frame in *output* timescale
@@ -545,6 +571,11 @@ struct bgav_stream_s
   bgav_packet_pool_t * pp;  /* Where to put consumed
                                packets for later use */
 
+  /* Performance counters. perf_parse_total is the parse time
+     including the demuxer and input */
+  bgav_stream_perf_t perf;
+  int64_t perf_parse_total;
+
   bgav_packet_t * out_packet_b;
   gavl_packet_t out_packet_g;
   
@@ -563,6 +594,9 @@ struct bgav_stream_s
   /* If this is set, we will pass this to the
      source */
   gavl_video_frame_t * vframe;
+
+  /* Decoder thread in pipeline mode */
+  bgav_pipeline_stream_t * pipe;
   
   union
     {
@@ -642,6 +676,9 @@ int64_t bgav_stream_get_duration(bgav_stream_t * s);
 gavl_source_status_t
 bgav_stream_read_packet_func(void * sp, gavl_packet_t ** p);
 
+/* Check if the demuxer packets can be passed without parsing */
+int bgav_stream_copy_packets(const bgav_stream_t * s);
+
 /* Top level packet functions */
 bgav_packet_t * bgav_stream_get_packet_write(bgav_stream_t * s);
 void bgav_stream_done_packet_write(bgav_stream_t * s, bgav_packet_t * p);
@@ -686,6 +723,7 @@ int bgav_stream_skipto(bgav_stream_t * s, int64_t * time, int scale);
 #define TRACK_SAMPLE_ACCURATE (1<<0)
 #define TRACK_HAS_FILE_INDEX  (1<<1)
 #define TRACK_HAS_COMPRESSION (1<<2)
+#define TRACK_INFO_ESTIMATE   (1<<3)
 
 struct bgav_track_s
   {
@@ -835,6 +873,15 @@ struct bgav_options_s
   int sample_accurate;
   int cache_time;
   int cache_size;
+
+  /* Extend the file index of growing files (interval in ms) */
+  int follow;
+
+  /* Cache the media info of local files */
+  int info_cache;
+
+  /* Stop after the headers until the track is selected */
+  int info_only;
   
   /* Generic network options */
   int connect_timeout;
@@ -848,6 +895,7 @@ struct bgav_options_s
   
   int rtp_port_base;
   int rtp_try_tcp; /* try TCP before falling back to UDP */
+  int udp_batch_size; /* Datagrams per recvmmsg() */
   
   /* http options */
 
@@ -860,6 +908,8 @@ struct bgav_options_s
   char * http_proxy_pass;
   
   int http_shoutcast_metadata;
+  int http_cache_blocks;
+  int hls_prefetch_segments;
 
   /* ftp options */
     
@@ -883,6 +933,9 @@ struct bgav_options_s
   int prefer_ffmpeg_demuxers;
 
   int dv_datetime;
+
+  /* Add a track with the streams of all MPEG-TS programs */
+  int mpegts_multiplex;
   
   int shrink;
 
@@ -891,11 +944,18 @@ struct bgav_options_s
 
   int threads;
 
+  /* Demux and decode in separate threads */
+  int pipeline;
+
+  /* Pass complete packets of indexed formats without parsing */
+  int stream_copy;
+
   int log_level;
 
   int dump_headers;
   int dump_indices;
   int dump_packets; 
+  int perf_counters;
   /* Callbacks */
 
   bgav_log_callback log_callback;
@@ -1030,6 +1090,17 @@ struct bgav_input_context_s
   char * index_file;
 
   bgav_yml_node_t * yml;
+
+  /* Performance counters */
+  bgav_perf_counter_t perf_read;
+  bgav_perf_counter_t perf_seek;
+  int64_t perf_total;
+
+  /* Set by network inputs */
+  int64_t perf_requests;
+  int64_t perf_requests_reused;
+  int64_t perf_cache_hits;
+  int64_t perf_cache_misses;
   };
 
 /* input.c */
@@ -1127,6 +1198,9 @@ void bgav_input_seek(bgav_input_context_t * ctx,
 void bgav_input_seek_sector(bgav_input_context_t * ctx,
                             int64_t sector);
 
+void bgav_input_seek_time(bgav_input_context_t * ctx,
+                          int64_t time, int scale);
+
 
 void bgav_input_buffer(bgav_input_context_t * ctx);
 
@@ -1311,13 +1385,20 @@ bgav_file_index_append_packet(bgav_file_index_t * idx,
                               int64_t time,
                               int keyframe, gavl_timecode_t tc);
 
+/* Returns 1 if the index is valid, 2 if the file grew and the
+   index can be continued at the resume position */
+
 int bgav_file_index_read_header(const char * filename,
                                 bgav_input_context_t * input,
-                                int * num_tracks);
+                                int * num_tracks,
+                                int64_t * indexed_size,
+                                int64_t * resume_position);
 
 void bgav_file_index_write_header(const char * filename,
                                   FILE * output,
-                                  int num_tracks);
+                                  int num_tracks,
+                                  int64_t indexed_size,
+                                  int64_t resume_position);
 
 int bgav_read_file_index(bgav_t*);
 
@@ -1355,6 +1436,10 @@ struct bgav_demuxer_s
      after seeking with the fileindex */
   
   void (*resync)(bgav_demuxer_context_t*, bgav_stream_t * s);
+
+  /* Info only mode: Do the things (e.g. building the superindex),
+     which were skipped by open() */
+  int (*finish_open)(bgav_demuxer_context_t*);
   };
 
 /* Demuxer flags */
@@ -1374,6 +1459,10 @@ struct bgav_demuxer_s
                                                   * True if we have just one active subtitle stream with attached subreader
                                                   */
 
+#define BGAV_DEMUXER_INFO_ONLY            (1<<10) /* Open() can stop after the headers */
+#define BGAV_DEMUXER_INCOMPLETE           (1<<11) /* Open() stopped after the headers,
+                                                     finish_open() must be called */
+
 
 #define INDEX_MODE_NONE   0 /* Default: No sample accuracy */
 /* Packets have precise timestamps and durations and are adjacent in the file */
@@ -1447,6 +1536,16 @@ struct bgav_demuxer_context_s
      packets, inside which no frame starts */
   
   int64_t next_packet_pos;
+
+  /* Set while the demuxer runs in its own thread */
+  bgav_pipeline_t * pipeline;
+
+  /* Follow mode: Extend the file index when the end is reached */
+  bgav_t * follow;
+
+  /* Performance counters. perf_total includes the input */
+  bgav_perf_counter_t perf;
+  int64_t perf_total;
   };
 
 /* demuxer.c */
@@ -1481,6 +1580,12 @@ bgav_demuxer_seek(bgav_demuxer_context_t * demuxer,
 int
 bgav_demuxer_next_packet(bgav_demuxer_context_t * demuxer);
 
+/* Used by the demuxer thread: Doesn't touch the EOF flags of
+   the streams */
+
+int
+bgav_demuxer_next_packet_pipeline(bgav_demuxer_context_t * demuxer);
+
 /*
  *  Start a demuxer. Some demuxers (most notably quicktime)
  *  can contain nothing but urls for the real streams.
@@ -1491,6 +1596,14 @@ bgav_demuxer_next_packet(bgav_demuxer_context_t * demuxer);
 int bgav_demuxer_start(bgav_demuxer_context_t * ctx);
 void bgav_demuxer_stop(bgav_demuxer_context_t * ctx);
 
+/* Complete a demuxer opened in info only mode */
+int bgav_demuxer_finish_open(bgav_demuxer_context_t * ctx);
+
+/* Set the stats of a stream from the container header in info
+   only mode. They are restored by bgav_demuxer_finish_open() */
+void bgav_stream_set_duration_estimate(bgav_stream_t * s,
+                                       int64_t pts_start, int64_t pts_end);
+
 
 // bgav_packet_t *
 // bgav_demuxer_get_packet_write(bgav_demuxer_context_t * demuxer, int stream);
@@ -1533,12 +1646,56 @@ struct bgav_s
   /* Set by the seek function */
 
   int eof;
+
+  bgav_pipeline_t * pipeline;
+
+  /* Media info was read from the cache, the demuxer is opened
+     on demand */
+  int info_cached;
+  int info_cache_flags;
+  int info_cache_dirty;   /* Info changed since the cache was read */
+  int info_cache_written; /* Cache is written at most once per handle */
+
+  /* Queued tracks for seamless playback */
+  bgav_seamless_t * seamless;
+
+  /* File size covered by the file index */
+  int64_t file_index_size;
+  /* Time of the last index update in follow mode */
+  int64_t follow_time;
+  /* Second instance continuing the index in follow mode */
+  bgav_t * follower;
   };
 
 /* bgav.c */
 
 void bgav_stop(bgav_t * b);
 int bgav_init(bgav_t * b);
+int bgav_ensure_demuxer(bgav_t * b);
+
+/* seamless.c */
+
+/* Append the queued tracks to the active streams */
+void bgav_seamless_start(bgav_t * b);
+
+/* Go back to the current track (before seeking) */
+void bgav_seamless_reset(bgav_t * b);
+
+void bgav_seamless_stop(bgav_t * b);
+void bgav_seamless_destroy(bgav_t * b);
+
+/* infocache.c */
+
+#define BGAV_INFO_CACHE_CAN_SEEK (1<<0)
+
+int bgav_info_cache_read(bgav_t * b);
+void bgav_info_cache_write(bgav_t * b);
+
+/* Write the cache if there is something new and it wasn't written before */
+void bgav_info_cache_flush(bgav_t * b);
+
+/* Move the streams of the demuxer (b->tt) into the cached track table */
+int bgav_info_cache_merge(bgav_t * b, bgav_track_table_t * ctt);
 
 
 /* Bytestream utilities */
@@ -1651,6 +1808,12 @@ struct addrinfo * bgav_hostbyname(const bgav_options_t * opt,
 /* udp.c */
 int bgav_udp_open(const bgav_options_t * opt, int port);
 int bgav_udp_read(int fd, uint8_t * data, int len);
+int bgav_udp_join(const bgav_options_t * opt, int fd, const char * group);
+
+#define BGAV_UDP_MAX_BATCH 64
+
+int bgav_udp_read_batch(int fd, uint8_t ** data, int * len,
+                        int max_len, int num, uint32_t * drops);
 
 int bgav_udp_write(const bgav_options_t * opt,
                    int fd, uint8_t * data, int len,
@@ -1728,6 +1891,9 @@ void bgav_video_resync(bgav_stream_t * s);
 
 int bgav_video_skipto(bgav_stream_t * stream, int64_t * t, int scale);
 
+/* Whether non-keyframes can be skipped already in the demuxer */
+int bgav_video_skip_nonkey(bgav_stream_t * s);
+
 void bgav_video_set_still(bgav_stream_t * stream);
 
 
@@ -1944,6 +2110,73 @@ int bgav_keyframe_table_seek(bgav_keyframe_table_t *,
                              int64_t  seek_pts,
                              int64_t * kf_pts);
 
+/* pipeline.c */
+
+bgav_pipeline_t * bgav_pipeline_create(bgav_t * b);
+void bgav_pipeline_destroy(bgav_pipeline_t * pl);
+
+/* Stop all threads and flush the frame queues. The threads are
+   restarted by the next read operation */
+void bgav_pipeline_stop(bgav_pipeline_t * pl);
+
+gavl_source_status_t
+bgav_pipeline_get_packet(bgav_pipeline_t * pl, bgav_stream_t * s,
+                         bgav_packet_t ** ret, int peek, int force);
+
+gavl_video_source_t * bgav_pipeline_get_video_source(bgav_stream_t * s);
+gavl_audio_source_t * bgav_pipeline_get_audio_source(bgav_stream_t * s);
+
+int bgav_pipeline_skip_video(bgav_stream_t * s, int64_t * time, int scale);
+
+/* Returns 1 if the packet should be dropped because the stream isn't read */
+int bgav_pipeline_drop_packet(bgav_pipeline_t * pl, bgav_stream_t * s,
+                              bgav_packet_t * p);
+
+/* framethreads.c */
+
+/* Returns NULL if the stream cannot be decoded frame parallel. In this
+   case, the decoder must be initialized the normal way */
+bgav_frame_threads_t * bgav_frame_threads_create(bgav_stream_t * s,
+                                                 bgav_video_decoder_t * dec);
+void bgav_frame_threads_destroy(bgav_frame_threads_t * ft);
+
+/* Drop all frames decoded in advance */
+void bgav_frame_threads_reset(bgav_frame_threads_t * ft);
+
+gavl_source_status_t
+bgav_frame_threads_read(bgav_frame_threads_t * ft, gavl_video_frame_t ** frame);
+
+/* Skip frames decoded in advance. Returns 1 if a frame at or after
+   time was found */
+int bgav_frame_threads_skipto(bgav_frame_threads_t * ft, int64_t time,
+                              int64_t * out_time);
+
+/* perf.c */
+
+/*
+ *  Timer for the performance counters. The time spent in the stage
+ *  below (given by its total time) is subtracted from the own time.
+ *  If timing is disabled, only the call counts are maintained.
+ */
+
+typedef struct
+  {
+  int64_t start; /* 0 if timing is disabled */
+  const int64_t * below;
+  int64_t below_start;
+  } bgav_perf_timer_t;
+
+/* Monotonic time in microseconds */
+int64_t bgav_perf_time(void);
+
+void bgav_perf_start(bgav_perf_timer_t * t, const bgav_options_t * opt,
+                     const int64_t * below);
+
+/* Count one call in c and add the own time to c and the elapsed
+   time to total (if non-NULL) */
+void bgav_perf_stop(bgav_perf_timer_t * t, bgav_perf_counter_t * c,
+                    int64_t * total);
+
 /* parse_dca.c */
 #ifdef HAVE_DCA
 void bgav_dca_flags_2_channel_setup(int flags, gavl_audio_format_t * format);
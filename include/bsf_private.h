@@ -26,6 +26,10 @@ struct bgav_bsf_s
   
   void (*cleanup)(bgav_bsf_t*);
   void (*filter)(bgav_bsf_t*, bgav_packet_t * in, bgav_packet_t * out);
+
+  /* Optional: Filter the packet in place. Return 0 if the packet
+     must go through filter() instead */
+  int (*filter_inplace)(bgav_bsf_t*, bgav_packet_t * p);
   bgav_stream_t * s;
   void * priv;
 
@@ -41,6 +45,7 @@ struct bgav_bsf_s
 void bgav_bsf_run(bgav_bsf_t * bsf, bgav_packet_t * in, bgav_packet_t * out);
 
 int bgav_bsf_init_avcC(bgav_bsf_t*);
+int bgav_bsf_init_hvcC(bgav_bsf_t*);
 
 
 int
@@ -27,5 +27,10 @@ bgav_hls_t * bgav_hls_create(bgav_input_context_t * ctx);
 
 int bgav_hls_read(bgav_hls_t *, uint8_t * data, int len, int block);
 
+/* GAVL_TIME_UNDEFINED for live streams */
+gavl_time_t bgav_hls_get_duration(bgav_hls_t *);
+
+void bgav_hls_seek_time(bgav_hls_t *, int64_t time, int scale);
+
 void bgav_hls_close(bgav_hls_t *);
 
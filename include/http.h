@@ -86,6 +86,9 @@ bgav_http_header_t* bgav_http_get_header(bgav_http_t *);
 
 int bgav_http_is_keep_alive(bgav_http_t *);
 
+/* Returns 1 if the last request didn't need a new connection */
+int bgav_http_is_reused(bgav_http_t *);
+
 int bgav_http_read(bgav_http_t * h, uint8_t * data, int len, int block);
 
 int64_t bgav_http_total_bytes(bgav_http_t * h);
@@ -31,6 +31,7 @@ typedef struct
   int id;
   int64_t size;
   int64_t end;
+  int unknown_size; /* Size field had all bits set (live streams) */
   } bgav_mkv_element_t;
 
 
@@ -553,6 +554,18 @@ int bgav_mkv_block_read(bgav_input_context_t * ctx,
                         bgav_mkv_block_t * ret,
                         bgav_mkv_element_t * parent);
 
+/* Read only the header, the input is left at the start of the
+   data_size payload bytes */
+
+int bgav_mkv_block_read_header(bgav_input_context_t * ctx,
+                               bgav_mkv_block_t * ret,
+                               bgav_mkv_element_t * parent);
+
+/* Called with the input at the start of the payload, must
+   consume all payload bytes */
+
+typedef int (*bgav_mkv_block_func)(void * priv, bgav_mkv_block_t * b);
+
 void bgav_mkv_block_dump(int indent, bgav_mkv_block_t * b);
 void bgav_mkv_block_free(bgav_mkv_block_t * b);
 
@@ -570,9 +583,13 @@ typedef struct
   int num_reference_blocks;
   } bgav_mkv_block_group_t;
 
+/* If block_func is NULL, the payload is read into block.data */
+
 int bgav_mkv_block_group_read(bgav_input_context_t * ctx,
                               bgav_mkv_block_group_t * ret,
-                              bgav_mkv_element_t * parent);
+                              bgav_mkv_element_t * parent,
+                              bgav_mkv_block_func block_func,
+                              void * block_priv);
 
 void bgav_mkv_block_group_dump(bgav_mkv_block_group_t * g);
 void bgav_mkv_block_group_free(bgav_mkv_block_group_t * g);
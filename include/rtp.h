@@ -53,6 +53,11 @@ typedef struct
   int initialized;
   gavl_timer_t * timer;
   gavl_time_t time_offset;
+
+  /* Receive statistics (UDP only) */
+  int64_t datagrams;       /* datagrams received */
+  int64_t syscalls;        /* receive calls */
+  uint32_t kernel_drops;   /* datagrams dropped by the kernel */
   } rtp_stats_t;
 
 typedef struct
@@ -77,7 +82,6 @@ typedef struct rtp_packet_s
   uint8_t * buf;
   int len;
   int broken; /* 1 if sequence number gap */
-  struct rtp_packet_s * next;
   } rtp_packet_t;
 
 typedef struct bgav_rtp_packet_buffer_s bgav_rtp_packet_buffer_t;
@@ -92,16 +96,19 @@ bgav_rtp_packet_buffer_lock_write(bgav_rtp_packet_buffer_t *);
 
 void bgav_rtp_packet_buffer_unlock_write(bgav_rtp_packet_buffer_t *);
 
+/* Batched writing: Get *num packets to receive into, then
+   commit the ones, which were filled */
+
+rtp_packet_t **
+bgav_rtp_packet_buffer_lock_write_batch(bgav_rtp_packet_buffer_t *, int * num);
+
+void bgav_rtp_packet_buffer_commit(bgav_rtp_packet_buffer_t *, int index);
+
 void bgav_rtp_packet_buffer_set_eof(bgav_rtp_packet_buffer_t *);
 int bgav_rtp_packet_buffer_get_eof(bgav_rtp_packet_buffer_t *);
 
 rtp_stats_t * bgav_rtp_packet_buffer_get_stats(bgav_rtp_packet_buffer_t *);
 
-#if 0
-rtp_packet_t *
-bgav_rtp_packet_buffer_lock_read(bgav_rtp_packet_buffer_t *);
-#endif
-
 rtp_packet_t *
 bgav_rtp_packet_buffer_try_lock_read(bgav_rtp_packet_buffer_t *);
 
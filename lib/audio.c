@@ -55,12 +55,20 @@ int bgav_set_audio_stream(bgav_t * b, int stream, bgav_stream_action_t action)
 static gavl_source_status_t get_frame(void * sp, gavl_audio_frame_t ** frame)
   {
   bgav_stream_t * s = sp;
+  bgav_perf_timer_t t;
+  int result;
   
-  if(!(s->flags & STREAM_HAVE_FRAME) &&
-     !s->data.audio.decoder->decode_frame(s))
+  if(!(s->flags & STREAM_HAVE_FRAME))
     {
-    s->flags |= STREAM_EOF_C;
-    return GAVL_SOURCE_EOF;
+    bgav_perf_start(&t, s->opt, &s->perf_parse_total);
+    result = s->data.audio.decoder->decode_frame(s);
+    bgav_perf_stop(&t, &s->perf.decode, NULL);
+
+    if(!result)
+      {
+      s->flags |= STREAM_EOF_C;
+      return GAVL_SOURCE_EOF;
+      }
     }
   s->flags &= ~STREAM_HAVE_FRAME; 
   s->data.audio.frame->timestamp = s->out_time;
@@ -136,6 +144,10 @@ int bgav_audio_start(bgav_stream_t * s)
   if(!s->timescale && s->data.audio.format->samplerate)
     s->timescale = s->data.audio.format->samplerate;
   
+  /* Packets go to the decoder of another handle */
+  if(s->flags & STREAM_SPLICE_SOURCE)
+    return 1;
+  
   if(s->action == BGAV_STREAM_DECODE)
     {
     dec = bgav_find_audio_decoder(s->fourcc);
@@ -272,7 +284,7 @@ int bgav_read_audio(bgav_t * b, gavl_audio_frame_t * frame,
                     int stream, int num_samples)
   {
   bgav_stream_t * s = &b->tt->cur->audio_streams[stream];
-  return gavl_audio_source_read_samples(s->data.audio.source,
+  return gavl_audio_source_read_samples(bgav_pipeline_get_audio_source(s),
                                         frame, num_samples);
   }
 
@@ -456,6 +468,11 @@ int bgav_get_audio_compression_info(bgav_t * bgav, int stream,
   else if(s->flags & STREAM_GOT_NO_CI)
     return 0;
 
+  /* Not in the info cache or demuxer opened in info only mode */
+  if(!bgav_ensure_demuxer(bgav))
+    return 0;
+  s = &bgav->tt->cur->audio_streams[stream];
+  
   bgav_track_get_compression(bgav->tt->cur);
   
   if(bgav_check_fourcc(s->fourcc, alaw_fourccs))
@@ -550,6 +567,9 @@ int bgav_get_audio_compression_info(bgav_t * bgav, int stream,
     gavl_compression_info_copy(ret, &s->ci);
   
   s->flags |= STREAM_GOT_CI;
+
+  if(bgav->opt.info_cache)
+    bgav->info_cache_dirty = 1;
   return 1;
   }
 
@@ -562,7 +582,7 @@ int bgav_read_audio_packet(bgav_t * bgav, int stream, gavl_packet_t * p)
 gavl_audio_source_t * bgav_get_audio_source(bgav_t * bgav, int stream)
   {
   bgav_stream_t * s = &bgav->tt->cur->audio_streams[stream];
-  return s->data.audio.source;
+  return bgav_pipeline_get_audio_source(s);
   }
 
 gavl_packet_source_t * bgav_get_audio_packet_source(bgav_t * bgav, int stream)
@@ -28,6 +28,12 @@
 
 #include <bswap.h>
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && \
+  defined(HAVE_IMMINTRIN_H)
+#define HAVE_X86_SIMD
+#include <immintrin.h>
+#endif
+
 #define FRAME_SAMPLES 1024
 #define LOG_DOMAIN "pcm"
 
@@ -37,6 +43,8 @@ typedef struct
   {
   void (*decode_func)(bgav_stream_t * s);
   gavl_audio_frame_t * frame;
+  gavl_audio_frame_t * ref_frame; /* Points into the packet */
+  gavl_audio_frame_t * out;       /* frame or ref_frame */
 
   bgav_packet_t * p;
   int             bytes_in_packet;
@@ -45,742 +53,820 @@ typedef struct
   int block_align;
   } pcm_t;
 
-/* Decode functions */
+/* U-Law */
 
-static void decode_8(bgav_stream_t * s)
-  {
-  pcm_t * priv;
-  int num_samples, num_bytes;
-  priv = s->decoder_priv;
+static const short ulaw_decode [256] =
+{	-32124,	-31100,	-30076,	-29052,	-28028,	-27004,	-25980,	-24956,
+	-23932,	-22908,	-21884,	-20860,	-19836,	-18812,	-17788,	-16764,
+	-15996,	-15484,	-14972,	-14460,	-13948,	-13436,	-12924,	-12412,
+	-11900,	-11388,	-10876,	-10364,	-9852,	-9340,	-8828,	-8316,
+	-7932,	-7676,	-7420,	-7164,	-6908,	-6652,	-6396,	-6140,
+	-5884,	-5628,	-5372,	-5116,	-4860,	-4604,	-4348,	-4092,
+	-3900,	-3772,	-3644,	-3516,	-3388,	-3260,	-3132,	-3004,
+	-2876,	-2748,	-2620,	-2492,	-2364,	-2236,	-2108,	-1980,
+	-1884,	-1820,	-1756,	-1692,	-1628,	-1564,	-1500,	-1436,
+	-1372,	-1308,	-1244,	-1180,	-1116,	-1052,	-988,	-924,
+	-876,	-844,	-812,	-780,	-748,	-716,	-684,	-652,
+	-620,	-588,	-556,	-524,	-492,	-460,	-428,	-396,
+	-372,	-356,	-340,	-324,	-308,	-292,	-276,	-260,
+	-244,	-228,	-212,	-196,	-180,	-164,	-148,	-132,
+	-120,	-112,	-104,	-96,	-88,	-80,	-72,	-64,
+	-56,	-48,	-40,	-32,	-24,	-16,	-8,		0,
 
-  num_samples = priv->bytes_in_packet / (s->data.audio.format->num_channels);
-  
-  if(num_samples > FRAME_SAMPLES)
-    num_samples = FRAME_SAMPLES;
+	32124,	31100,	30076,	29052,	28028,	27004,	25980,	24956,
+	23932,	22908,	21884,	20860,	19836,	18812,	17788,	16764,
+	15996,	15484,	14972,	14460,	13948,	13436,	12924,	12412,
+	11900,	11388,	10876,	10364,	9852,	9340,	8828,	8316,
+	7932,	7676,	7420,	7164,	6908,	6652,	6396,	6140,
+	5884,	5628,	5372,	5116,	4860,	4604,	4348,	4092,
+	3900,	3772,	3644,	3516,	3388,	3260,	3132,	3004,
+	2876,	2748,	2620,	2492,	2364,	2236,	2108,	1980,
+	1884,	1820,	1756,	1692,	1628,	1564,	1500,	1436,
+	1372,	1308,	1244,	1180,	1116,	1052,	988,	924,
+	876,	844,	812,	780,	748,	716,	684,	652,
+	620,	588,	556,	524,	492,	460,	428,	396,
+	372,	356,	340,	324,	308,	292,	276,	260,
+	244,	228,	212,	196,	180,	164,	148,	132,
+	120,	112,	104,	96,		88,		80,		72,		64,
+	56,		48,		40,		32,		24,		16,		8,		0
+} ;
 
-  num_bytes   = num_samples * s->data.audio.format->num_channels;
+/* A-Law */
 
-  memcpy(priv->frame->samples.u_8, priv->packet_ptr, num_bytes);
+static
+const short alaw_decode [256] =
+{	-5504,	-5248,	-6016,	-5760,	-4480,	-4224,	-4992,	-4736,
+	-7552,	-7296,	-8064,	-7808,	-6528,	-6272,	-7040,	-6784,
+	-2752,	-2624,	-3008,	-2880,	-2240,	-2112,	-2496,	-2368,
+	-3776,	-3648,	-4032,	-3904,	-3264,	-3136,	-3520,	-3392,
+	-22016,	-20992,	-24064,	-23040,	-17920,	-16896,	-19968,	-18944,
+	-30208,	-29184,	-32256,	-31232,	-26112,	-25088,	-28160,	-27136,
+	-11008,	-10496,	-12032,	-11520,	-8960,	-8448,	-9984,	-9472,
+	-15104,	-14592,	-16128,	-15616,	-13056,	-12544,	-14080,	-13568,
+	-344,	-328,	-376,	-360,	-280,	-264,	-312,	-296,
+	-472,	-456,	-504,	-488,	-408,	-392,	-440,	-424,
+	-88,	-72,	-120,	-104,	-24,	-8,		-56,	-40,
+	-216,	-200,	-248,	-232,	-152,	-136,	-184,	-168,
+	-1376,	-1312,	-1504,	-1440,	-1120,	-1056,	-1248,	-1184,
+	-1888,	-1824,	-2016,	-1952,	-1632,	-1568,	-1760,	-1696,
+	-688,	-656,	-752,	-720,	-560,	-528,	-624,	-592,
+	-944,	-912,	-1008,	-976,	-816,	-784,	-880,	-848,
+	5504,	5248,	6016,	5760,	4480,	4224,	4992,	4736,
+	7552,	7296,	8064,	7808,	6528,	6272,	7040,	6784,
+	2752,	2624,	3008,	2880,	2240,	2112,	2496,	2368,
+	3776,	3648,	4032,	3904,	3264,	3136,	3520,	3392,
+	22016,	20992,	24064,	23040,	17920,	16896,	19968,	18944,
+	30208,	29184,	32256,	31232,	26112,	25088,	28160,	27136,
+	11008,	10496,	12032,	11520,	8960,	8448,	9984,	9472,
+	15104,	14592,	16128,	15616,	13056,	12544,	14080,	13568,
+	344,	328,	376,	360,	280,	264,	312,	296,
+	472,	456,	504,	488,	408,	392,	440,	424,
+	88,		72,		120,	104,	24,		8,		56,		40,
+	216,	200,	248,	232,	152,	136,	184,	168,
+	1376,	1312,	1504,	1440,	1120,	1056,	1248,	1184,
+	1888,	1824,	2016,	1952,	1632,	1568,	1760,	1696,
+	688,	656,	752,	720,	560,	528,	624,	592,
+	944,	912,	1008,	976,	816,	784,	880,	848
+} ; /* alaw_decode */
 
-  priv->packet_ptr += num_bytes;
-  priv->bytes_in_packet -= num_bytes;
-  priv->frame->valid_samples = num_samples;
-  }
+/*
+ *  Conversion kernels. They convert num values (samples * channels)
+ *  from src to dst. The SIMD versions leave the remaining values to
+ *  the C versions.
+ */
 
-static void decode_s_16(bgav_stream_t * s)
-  {
-  pcm_t * priv;
-  int num_samples, num_bytes;
-  priv = s->decoder_priv;
+typedef void (*convert_func)(const uint8_t * src, void * dst, int num);
 
-  num_samples = priv->bytes_in_packet / (2 * s->data.audio.format->num_channels);
+static void convert_swap_16_c(const uint8_t * src, void * dst, int num)
+  {
+  const uint16_t * s = (const uint16_t*)src;
+  uint16_t * d = dst;
   
-  if(num_samples > FRAME_SAMPLES)
-    num_samples = FRAME_SAMPLES;
-
-//  fprintf(stderr, "Bytes: %d, Samples: %d\n", priv->bytes_in_packet, num_samples);
-
-  num_bytes   = num_samples * 2 * s->data.audio.format->num_channels;
-
-  memcpy(priv->frame->samples.s_16, priv->packet_ptr, num_bytes);
-
-  priv->packet_ptr += num_bytes;
-  priv->bytes_in_packet -= num_bytes;
-  priv->frame->valid_samples = num_samples;
+  while(num--)
+    {
+    *d = bswap_16(*s);
+    s++;
+    d++;
+    }
   }
 
-static void decode_s_16_swap(bgav_stream_t * s)
+static void convert_swap_32_c(const uint8_t * src, void * dst, int num)
   {
-  pcm_t * priv;
-  int num_samples, num_bytes, i;
-  int16_t * src, *dst;
+  const uint32_t * s = (const uint32_t*)src;
+  uint32_t * d = dst;
   
-  priv = s->decoder_priv;
-
-  num_samples = priv->bytes_in_packet / (2 * s->data.audio.format->num_channels);
+  while(num--)
+    {
+    *d = bswap_32(*s);
+    s++;
+    d++;
+    }
+  }
 
+static void convert_swap_64_c(const uint8_t * src, void * dst, int num)
+  {
+  const uint64_t * s = (const uint64_t*)src;
+  uint64_t * d = dst;
   
-  if(num_samples > FRAME_SAMPLES)
-    num_samples = FRAME_SAMPLES;
-
-  num_bytes   = num_samples * 2 * s->data.audio.format->num_channels;
-
-  src = (int16_t*)priv->packet_ptr;
-  dst = priv->frame->samples.s_16;
-
-  i = num_samples * s->data.audio.format->num_channels;
-
-  while(i--)
+  while(num--)
     {
-    *dst = bswap_16(*src);
-    src++;
-    dst++;
+    *d = bswap_64(*s);
+    s++;
+    d++;
     }
-  
-  priv->packet_ptr += num_bytes;
-  priv->bytes_in_packet -= num_bytes;
-  priv->frame->valid_samples = num_samples;
   }
 
-static void decode_s_24_le(bgav_stream_t * s)
+static void convert_s_24_le_c(const uint8_t * src, void * dst, int num)
   {
-  pcm_t * priv;
-  int num_samples, num_bytes, i;
-  uint8_t * src;
-  uint32_t * dst;
-  priv = s->decoder_priv;
-
-  num_samples = priv->bytes_in_packet / (3 * s->data.audio.format->num_channels);
-
-  if(num_samples > FRAME_SAMPLES)
-    num_samples = FRAME_SAMPLES;
-
-  num_bytes   = num_samples * 3 * s->data.audio.format->num_channels;
-
-  src = priv->packet_ptr;
-  dst = (uint32_t*)(priv->frame->samples.s_32);
-
-  i = num_samples * s->data.audio.format->num_channels;
+  uint32_t * d = dst;
   
-  while(i--)
+  while(num--)
     {
-    *dst =
+    *d =
       ((uint32_t)(src[0]) << 8)  |
       ((uint32_t)(src[1]) << 16)  |
       ((uint32_t)(src[2]) << 24);
     src+=3;
-    dst++;
+    d++;
     }
-  priv->packet_ptr += num_bytes;
-  priv->bytes_in_packet -= num_bytes;
-  priv->frame->valid_samples = num_samples;
-  
   }
 
-static void decode_s_24_be(bgav_stream_t * s)
+static void convert_s_24_be_c(const uint8_t * src, void * dst, int num)
   {
-  pcm_t * priv;
-  int num_samples, num_bytes, i;
-  uint8_t * src;
-  uint32_t * dst;
-  priv = s->decoder_priv;
-
-  num_samples = priv->bytes_in_packet / (3 * s->data.audio.format->num_channels);
-
-  if(num_samples > FRAME_SAMPLES)
-    num_samples = FRAME_SAMPLES;
-
-  num_bytes   = num_samples * 3 * s->data.audio.format->num_channels;
-
-  src = priv->packet_ptr;
-  dst = (uint32_t*)(priv->frame->samples.s_32);
-
-  i = num_samples * s->data.audio.format->num_channels;
+  uint32_t * d = dst;
   
-  while(i--)
+  while(num--)
     {
-    *dst =
+    *d =
       ((uint32_t)(src[2]) << 8)  |
       ((uint32_t)(src[1]) << 16)  |
       ((uint32_t)(src[0]) << 24);
     src+=3;
-    dst++;
+    d++;
     }
-  priv->packet_ptr += num_bytes;
-  priv->bytes_in_packet -= num_bytes;
-  priv->frame->valid_samples = num_samples;
   }
 
-static void decode_s_24_lpcm(bgav_stream_t * s)
-  {
-  pcm_t * priv;
-  int num_samples, num_bytes, i;
-  uint8_t * src;
-  uint32_t * dst;
-  priv = s->decoder_priv;
-
-  num_samples = priv->bytes_in_packet / (3 * s->data.audio.format->num_channels);
+/* LPCM: Groups of 4 samples. num must be a multiple of 4 */
 
-  if(num_samples > FRAME_SAMPLES)
-    num_samples = FRAME_SAMPLES;
-
-  num_bytes   = num_samples * 3 * s->data.audio.format->num_channels;
-
-  src = priv->packet_ptr;
-  dst = (uint32_t *)priv->frame->samples.s_32;
+static void convert_s_24_lpcm_c(const uint8_t * src, void * dst, int num)
+  {
+  uint32_t * d = dst;
 
-  i = (num_samples * s->data.audio.format->num_channels)/4;
+  num /= 4;
   
-  while(i--)
+  while(num--)
     {
-    dst[0] = ((uint32_t)(src[0])<<24)|((uint32_t)(src[1])<<16)|((uint32_t)(src[8])<< 8);
-    dst[1] = ((uint32_t)(src[2])<<24)|((uint32_t)(src[3])<<16)|((uint32_t)(src[9])<< 8);
-    dst[2] = ((uint32_t)(src[4])<<24)|((uint32_t)(src[5])<<16)|((uint32_t)(src[10])<< 8);
-    dst[3] = ((uint32_t)(src[6])<<24)|((uint32_t)(src[7])<<16)|((uint32_t)(src[11])<< 8);
+    d[0] = ((uint32_t)(src[0])<<24)|((uint32_t)(src[1])<<16)|((uint32_t)(src[8])<< 8);
+    d[1] = ((uint32_t)(src[2])<<24)|((uint32_t)(src[3])<<16)|((uint32_t)(src[9])<< 8);
+    d[2] = ((uint32_t)(src[4])<<24)|((uint32_t)(src[5])<<16)|((uint32_t)(src[10])<< 8);
+    d[3] = ((uint32_t)(src[6])<<24)|((uint32_t)(src[7])<<16)|((uint32_t)(src[11])<< 8);
     src+=12;
-    dst+=4;
+    d+=4;
     }
-  priv->packet_ptr += num_bytes;
-  priv->bytes_in_packet -= num_bytes;
-  priv->frame->valid_samples = num_samples;
   }
 
-static void decode_s_24_lpcm_mono(bgav_stream_t * s)
+static void convert_s_20_lpcm_c(const uint8_t * src, void * dst, int num)
   {
-  pcm_t * priv;
-  int num_samples, num_bytes, i;
-  uint8_t * src;
-  uint32_t * dst;
-  priv = s->decoder_priv;
-
-  num_samples = priv->bytes_in_packet / 3;
-
-  if(num_samples > FRAME_SAMPLES)
-    num_samples = FRAME_SAMPLES;
-
-  num_bytes   = num_samples * 3;
+  uint32_t * d = dst;
 
-  src = priv->packet_ptr;
-  dst = (uint32_t *)priv->frame->samples.s_32;
+  num /= 4;
+  
+  while(num--)
+    {
+    d[0] = ((uint32_t)(src[0])<<24)|((uint32_t)(src[1])<<16)|((uint32_t)(src[8] & 0xf0)<< 8);
+    d[1] = ((uint32_t)(src[2])<<24)|((uint32_t)(src[3])<<16)|((uint32_t)(src[8] & 0x0f)<< 12);
+    d[2] = ((uint32_t)(src[4])<<24)|((uint32_t)(src[5])<<16)|((uint32_t)(src[9] & 0xf0)<< 8);
+    d[3] = ((uint32_t)(src[6])<<24)|((uint32_t)(src[7])<<16)|((uint32_t)(src[9] & 0x0f)<< 12);
+    src+=10;
+    d+=4;
+    }
+  }
 
-  i = num_samples/2;
+static void convert_ulaw_c(const uint8_t * src, void * dst, int num)
+  {
+  int16_t * d = dst;
   
-  while(i--)
+  while(num--)
     {
-    dst[0] = ((uint32_t)(src[0])<<24)|((uint32_t)(src[1])<<16)|((uint32_t)(src[4])<< 8);
-    dst[1] = ((uint32_t)(src[2])<<24)|((uint32_t)(src[3])<<16)|((uint32_t)(src[5])<< 8);
-    src+=6;
-    dst+=2;
+    *d = ulaw_decode[*src];
+    src++;
+    d++;
     }
-  priv->packet_ptr += num_bytes;
-  priv->bytes_in_packet -= num_bytes;
-  priv->frame->valid_samples = num_samples;
   }
 
-static void decode_s_20_lpcm(bgav_stream_t * s)
+static void convert_alaw_c(const uint8_t * src, void * dst, int num)
   {
-  pcm_t * priv;
-  int num_samples, num_bytes, i;
-  uint8_t * src;
-  uint32_t * dst;
-  priv = s->decoder_priv;
+  int16_t * d = dst;
+  
+  while(num--)
+    {
+    *d = alaw_decode[*src];
+    src++;
+    d++;
+    }
+  }
 
-  /* 5 bytes -> 2 samples */
-  num_samples = (2*priv->bytes_in_packet) / (5 * s->data.audio.format->num_channels);
+#ifdef HAVE_X86_SIMD
 
-  if(num_samples > FRAME_SAMPLES)
-    num_samples = FRAME_SAMPLES;
+#define TARGET(t) __attribute__((target(t)))
 
-  num_bytes   = (num_samples * 5 * s->data.audio.format->num_channels)/2;
-  
-  src = priv->packet_ptr;
-  dst = (uint32_t*)(priv->frame->samples.s_32);
-
-  i = (num_samples * s->data.audio.format->num_channels)/4;
+static void TARGET("sse2")
+convert_swap_16_sse2(const uint8_t * src, void * dst, int num)
+  {
+  int i;
+  __m128i v;
+  uint8_t * d = dst;
   
-  while(i--)
+  for(i = 0; i + 8 <= num; i += 8)
     {
-    dst[0] = ((uint32_t)(src[0])<<24)|((uint32_t)(src[1])<<16)|((uint32_t)(src[8] & 0xf0)<< 8);
-    dst[1] = ((uint32_t)(src[2])<<24)|((uint32_t)(src[3])<<16)|((uint32_t)(src[8] & 0x0f)<< 12);
-    dst[2] = ((uint32_t)(src[4])<<24)|((uint32_t)(src[5])<<16)|((uint32_t)(src[9] & 0xf0)<< 8);
-    dst[3] = ((uint32_t)(src[6])<<24)|((uint32_t)(src[7])<<16)|((uint32_t)(src[9] & 0x0f)<< 12);
-    src+=10;
-    dst+=4;
+    v = _mm_loadu_si128((const __m128i*)src);
+    _mm_storeu_si128((__m128i*)d,
+                     _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8)));
+    src += 16;
+    d += 16;
     }
-  priv->packet_ptr += num_bytes;
-  priv->bytes_in_packet -= num_bytes;
-  priv->frame->valid_samples = num_samples;
+  convert_swap_16_c(src, d, num - i);
   }
 
-static void decode_s_20_lpcm_mono(bgav_stream_t * s)
+static void TARGET("avx2")
+convert_swap_16_avx2(const uint8_t * src, void * dst, int num)
   {
-  pcm_t * priv;
-  int num_samples, num_bytes, i;
-  uint8_t * src;
-  uint32_t * dst;
-  priv = s->decoder_priv;
-
-  num_samples = (2*priv->bytes_in_packet) / (5 * s->data.audio.format->num_channels);
+  int i;
+  uint8_t * d = dst;
+  const __m256i mask =
+    _mm256_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+                     1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
   
-  if(num_samples > FRAME_SAMPLES)
-    num_samples = FRAME_SAMPLES;
+  for(i = 0; i + 16 <= num; i += 16)
+    {
+    _mm256_storeu_si256((__m256i*)d,
+                        _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)src), mask));
+    src += 32;
+    d += 32;
+    }
+  convert_swap_16_sse2(src, d, num - i);
+  }
 
-  num_bytes   = (num_samples * 5 * s->data.audio.format->num_channels)/2;
+static void TARGET("ssse3")
+convert_swap_32_ssse3(const uint8_t * src, void * dst, int num)
+  {
+  int i;
+  uint8_t * d = dst;
+  const __m128i mask =
+    _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
   
-  src = priv->packet_ptr;
-  dst = (uint32_t*)(priv->frame->samples.s_32);
+  for(i = 0; i + 4 <= num; i += 4)
+    {
+    _mm_storeu_si128((__m128i*)d,
+                     _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)src), mask));
+    src += 16;
+    d += 16;
+    }
+  convert_swap_32_c(src, d, num - i);
+  }
 
-  i = num_samples/2;
+static void TARGET("avx2")
+convert_swap_32_avx2(const uint8_t * src, void * dst, int num)
+  {
+  int i;
+  uint8_t * d = dst;
+  const __m256i mask =
+    _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+                     3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
   
-  while(i--)
+  for(i = 0; i + 8 <= num; i += 8)
     {
-    dst[0] = ((uint32_t)(src[0])<<24)|((uint32_t)(src[1])<<16)|((uint32_t)(src[4] & 0xf0)<< 8);
-    dst[1] = ((uint32_t)(src[2])<<24)|((uint32_t)(src[3])<<16)|((uint32_t)(src[4] & 0x0f)<< 12);
-    src+=5;
-    dst+=2;
+    _mm256_storeu_si256((__m256i*)d,
+                        _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)src), mask));
+    src += 32;
+    d += 32;
     }
-  priv->packet_ptr += num_bytes;
-  priv->bytes_in_packet -= num_bytes;
-  priv->frame->valid_samples = num_samples;
+  convert_swap_32_ssse3(src, d, num - i);
   }
 
-
-static void decode_s_32(bgav_stream_t * s)
+static void TARGET("ssse3")
+convert_swap_64_ssse3(const uint8_t * src, void * dst, int num)
   {
-  pcm_t * priv;
-  int num_samples, num_bytes;
-  priv = s->decoder_priv;
+  int i;
+  uint8_t * d = dst;
+  const __m128i mask =
+    _mm_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+  
+  for(i = 0; i + 2 <= num; i += 2)
+    {
+    _mm_storeu_si128((__m128i*)d,
+                     _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)src), mask));
+    src += 16;
+    d += 16;
+    }
+  convert_swap_64_c(src, d, num - i);
+  }
 
-  num_samples = priv->bytes_in_packet / (4 * s->data.audio.format->num_channels);
+/*
+ *  24 bit: 8 samples (24 bytes) from 2 overlapping 16 byte loads.
+ *  The second load reads 4 bytes beyond the samples, so we stop
+ *  early enough.
+ */
 
-  if(num_samples > FRAME_SAMPLES)
-    num_samples = FRAME_SAMPLES;
+#define X -128
 
-  num_bytes   = num_samples * 4 * s->data.audio.format->num_channels;
-  memcpy(priv->frame->samples.s_32, priv->packet_ptr, num_bytes);
+static void TARGET("ssse3")
+convert_s_24_le_ssse3(const uint8_t * src, void * dst, int num)
+  {
+  int i;
+  uint8_t * d = dst;
+  const __m128i mask =
+    _mm_setr_epi8(X, 0, 1, 2, X, 3, 4, 5, X, 6, 7, 8, X, 9, 10, 11);
   
-  priv->packet_ptr += num_bytes;
-  priv->bytes_in_packet -= num_bytes;
-  priv->frame->valid_samples = num_samples;
+  for(i = 0; i + 10 <= num; i += 8)
+    {
+    _mm_storeu_si128((__m128i*)d,
+                     _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)src), mask));
+    _mm_storeu_si128((__m128i*)(d + 16),
+                     _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(src + 12)), mask));
+    src += 24;
+    d += 32;
+    }
+  convert_s_24_le_c(src, d, num - i);
+  }
+
+static void TARGET("ssse3")
+convert_s_24_be_ssse3(const uint8_t * src, void * dst, int num)
+  {
+  int i;
+  uint8_t * d = dst;
+  const __m128i mask =
+    _mm_setr_epi8(X, 2, 1, 0, X, 5, 4, 3, X, 8, 7, 6, X, 11, 10, 9);
   
+  for(i = 0; i + 10 <= num; i += 8)
+    {
+    _mm_storeu_si128((__m128i*)d,
+                     _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)src), mask));
+    _mm_storeu_si128((__m128i*)(d + 16),
+                     _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(src + 12)), mask));
+    src += 24;
+    d += 32;
+    }
+  convert_s_24_be_c(src, d, num - i);
   }
 
-/* Integer 32 bit */
+/* LPCM: One group of 4 samples (12 or 10 bytes) per 16 byte load */
 
-static void decode_s_32_swap(bgav_stream_t * s)
+static void TARGET("ssse3")
+convert_s_24_lpcm_ssse3(const uint8_t * src, void * dst, int num)
   {
-
-  pcm_t * priv;
-  int num_samples, num_bytes, i;
-  int32_t * src, *dst;
+  int i;
+  uint8_t * d = dst;
+  const __m128i mask =
+    _mm_setr_epi8(X, 8, 1, 0, X, 9, 3, 2, X, 10, 5, 4, X, 11, 7, 6);
   
-  priv = s->decoder_priv;
+  for(i = 0; i + 8 <= num; i += 4)
+    {
+    _mm_storeu_si128((__m128i*)d,
+                     _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)src), mask));
+    src += 12;
+    d += 16;
+    }
+  convert_s_24_lpcm_c(src, d, num - i);
+  }
 
-  num_samples = priv->bytes_in_packet / (4 * s->data.audio.format->num_channels);
+static void TARGET("ssse3")
+convert_s_20_lpcm_ssse3(const uint8_t * src, void * dst, int num)
+  {
+  int i;
+  __m128i v;
+  uint8_t * d = dst;
+  /* The 2 upper bytes */
+  const __m128i mask_hi =
+    _mm_setr_epi8(X, X, 1, 0, X, X, 3, 2, X, X, 5, 4, X, X, 7, 6);
+  /* Byte with the lower 4 bits */
+  const __m128i mask_lo =
+    _mm_setr_epi8(X, 8, X, X, X, 8, X, X, X, 9, X, X, X, 9, X, X);
+  /* Upper nibble for even samples, lower nibble for odd samples */
+  const __m128i nibble_even = _mm_setr_epi32(0xf000, 0, 0xf000, 0);
+  const __m128i nibble_odd  = _mm_setr_epi32(0, 0xf000, 0, 0xf000);
   
-  if(num_samples > FRAME_SAMPLES)
-    num_samples = FRAME_SAMPLES;
-
-  num_bytes   = num_samples * 4 * s->data.audio.format->num_channels;
+  for(i = 0; i + 8 <= num; i += 4)
+    {
+    v = _mm_loadu_si128((const __m128i*)src);
+
+    _mm_storeu_si128((__m128i*)d,
+                     _mm_or_si128(_mm_shuffle_epi8(v, mask_hi),
+                                  _mm_or_si128(_mm_and_si128(_mm_shuffle_epi8(v, mask_lo),
+                                                             nibble_even),
+                                               _mm_and_si128(_mm_slli_epi32(_mm_shuffle_epi8(v, mask_lo), 4),
+                                                             nibble_odd))));
+    src += 10;
+    d += 16;
+    }
+  convert_s_20_lpcm_c(src, d, num - i);
+  }
 
-  src = (int32_t*)priv->packet_ptr;
-  dst = priv->frame->samples.s_32;
+#undef X
 
-  i = num_samples * s->data.audio.format->num_channels;
+/*
+ *  u-law and A-law are computed instead of looked up:
+ *
+ *  u-law: u = ~byte, magnitude = (((u & 0x0f) << 3) + 0x84) << ((u >> 4) & 7) - 0x84,
+ *         negative if bit 7 of u is set
+ *
+ *  A-law: a = byte ^ 0x55, e = (a >> 4) & 7,
+ *         magnitude = ((a & 0x0f) << 4) + 8                  for e == 0
+ *                     (((a & 0x0f) << 4) + 0x108) << (e - 1) for e > 0
+ *         negative if bit 7 of a is cleared
+ *
+ *  The shifts are multiplications with a power of 2 looked up with pshufb.
+ */
 
-  while(i--)
+static void TARGET("ssse3")
+convert_ulaw_ssse3(const uint8_t * src, void * dst, int num)
+  {
+  int i;
+  __m128i u, m, e, neg, lo, hi, zero;
+  int16_t * d = dst;
+  const __m128i pow2 = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, (char)128,
+                                     0, 0, 0, 0, 0, 0, 0, 0);
+  const __m128i mask_0f = _mm_set1_epi8(0x0f);
+  const __m128i mask_07 = _mm_set1_epi8(0x07);
+  const __m128i bias = _mm_set1_epi16(0x84);
+
+  zero = _mm_setzero_si128();
+  
+  for(i = 0; i + 16 <= num; i += 16)
     {
-    *dst = bswap_32(*src);
-    src++;
-    dst++;
+    u = _mm_xor_si128(_mm_loadu_si128((const __m128i*)src), _mm_set1_epi8((char)0xff));
+    
+    m = _mm_and_si128(u, mask_0f);
+    e = _mm_shuffle_epi8(pow2, _mm_and_si128(_mm_srli_epi16(u, 4), mask_07));
+    neg = _mm_cmplt_epi8(u, zero);
+
+    /* Low 8 values */
+    lo = _mm_mullo_epi16(_mm_add_epi16(_mm_slli_epi16(_mm_unpacklo_epi8(m, zero), 3), bias),
+                         _mm_unpacklo_epi8(e, zero));
+    lo = _mm_sub_epi16(lo, bias);
+    hi = _mm_mullo_epi16(_mm_add_epi16(_mm_slli_epi16(_mm_unpackhi_epi8(m, zero), 3), bias),
+                         _mm_unpackhi_epi8(e, zero));
+    hi = _mm_sub_epi16(hi, bias);
+
+    lo = _mm_sub_epi16(_mm_xor_si128(lo, _mm_unpacklo_epi8(neg, neg)),
+                       _mm_unpacklo_epi8(neg, neg));
+    hi = _mm_sub_epi16(_mm_xor_si128(hi, _mm_unpackhi_epi8(neg, neg)),
+                       _mm_unpackhi_epi8(neg, neg));
+    
+    _mm_storeu_si128((__m128i*)d, lo);
+    _mm_storeu_si128((__m128i*)(d + 8), hi);
+    src += 16;
+    d += 16;
     }
+  convert_ulaw_c(src, d, num - i);
+  }
+
+static void TARGET("ssse3")
+convert_alaw_ssse3(const uint8_t * src, void * dst, int num)
+  {
+  int i;
+  __m128i a, m, e, pos, lo, hi, add, zero;
+  int16_t * d = dst;
+  const __m128i pow2 = _mm_setr_epi8(1, 1, 2, 4, 8, 16, 32, 64,
+                                     0, 0, 0, 0, 0, 0, 0, 0);
+  const __m128i mask_0f = _mm_set1_epi8(0x0f);
+  const __m128i mask_07 = _mm_set1_epi8(0x07);
+  const __m128i add_0   = _mm_set1_epi16(0x008);
+
+  zero = _mm_setzero_si128();
   
-  priv->packet_ptr += num_bytes;
-  priv->bytes_in_packet -= num_bytes;
-  priv->frame->valid_samples = num_samples;
-  
+  for(i = 0; i + 16 <= num; i += 16)
+    {
+    a = _mm_xor_si128(_mm_loadu_si128((const __m128i*)src), _mm_set1_epi8(0x55));
+    
+    m = _mm_slli_epi16(_mm_and_si128(a, mask_0f), 4); /* Max 0xf0, no carry */
+    e = _mm_and_si128(_mm_srli_epi16(a, 4), mask_07);
+    /* 0x100 is added for e > 0 */
+    add = _mm_andnot_si128(_mm_cmpeq_epi8(e, zero), _mm_set1_epi8(1));
+    e = _mm_shuffle_epi8(pow2, e);
+    pos = _mm_cmplt_epi8(a, zero);
+
+    lo = _mm_add_epi16(_mm_unpacklo_epi8(m, add), add_0);
+    lo = _mm_mullo_epi16(lo, _mm_unpacklo_epi8(e, zero));
+    hi = _mm_add_epi16(_mm_unpackhi_epi8(m, add), add_0);
+    hi = _mm_mullo_epi16(hi, _mm_unpackhi_epi8(e, zero));
+
+    /* Negate, where the sign bit is cleared */
+    pos = _mm_xor_si128(pos, _mm_set1_epi8((char)0xff));
+    lo = _mm_sub_epi16(_mm_xor_si128(lo, _mm_unpacklo_epi8(pos, pos)),
+                       _mm_unpacklo_epi8(pos, pos));
+    hi = _mm_sub_epi16(_mm_xor_si128(hi, _mm_unpackhi_epi8(pos, pos)),
+                       _mm_unpackhi_epi8(pos, pos));
+    
+    _mm_storeu_si128((__m128i*)d, lo);
+    _mm_storeu_si128((__m128i*)(d + 8), hi);
+    src += 16;
+    d += 16;
+    }
+  convert_alaw_c(src, d, num - i);
   }
 
-#ifndef WORDS_BIGENDIAN
-#define decode_s_16_le decode_s_16
-#define decode_s_16_be decode_s_16_swap
-#define decode_s_32_le decode_s_32
-#define decode_s_32_be decode_s_32_swap
-#else
-#define decode_s_16_le decode_s_16_swap
-#define decode_s_16_be decode_s_16
-#define decode_s_32_le decode_s_32_swap
-#define decode_s_32_be decode_s_32
 #endif
 
-/* Big/Little endian floating point routines taken from libsndfile */
-
-static float
-float32_be_read (unsigned char *cptr)
-  {       int             exponent, mantissa, negative ;
-  float   fvalue ;
-
-  negative = cptr [0] & 0x80 ;
-  exponent = ((cptr [0] & 0x7F) << 1) | ((cptr [1] & 0x80) ? 1 : 0) ;
-  mantissa = ((cptr [1] & 0x7F) << 16) | (cptr [2] << 8) | (cptr [3]) ;
-
-  if (! (exponent || mantissa))
-    return 0.0 ;
-
-  mantissa |= 0x800000 ;
-  exponent = exponent ? exponent - 127 : 0 ;
-
-  fvalue = mantissa ? ((float) mantissa) / ((float) 0x800000) : 0.0 ;
-
-  if (negative)
-    fvalue *= -1 ;
+/* Selected in bgav_init_audio_decoders_pcm() */
 
-  if (exponent > 0)
-    fvalue *= (1 << exponent) ;
-  else if (exponent < 0)
-    fvalue /= (1 << abs (exponent)) ;
-
-  return fvalue ;
-  } /* float32_be_read */
-
-static float
-float32_le_read (unsigned char *cptr)
+static struct
   {
-  int             exponent, mantissa, negative ;
-  float   fvalue ;
-
-  negative = cptr [3] & 0x80 ;
-  exponent = ((cptr [3] & 0x7F) << 1) | ((cptr [2] & 0x80) ? 1 : 0) ;
-  mantissa = ((cptr [2] & 0x7F) << 16) | (cptr [1] << 8) | (cptr [0]) ;
-
-  if (! (exponent || mantissa))
-    return 0.0 ;
-
-  mantissa |= 0x800000 ;
-  exponent = exponent ? exponent - 127 : 0 ;
-
-  fvalue = mantissa ? ((float) mantissa) / ((float) 0x800000) : 0.0 ;
-
-  if (negative)
-    fvalue *= -1 ;
-
-  if (exponent > 0)
-    fvalue *= (1 << exponent) ;
-  else if (exponent < 0)
-    fvalue /= (1 << abs (exponent)) ;
-
-  return fvalue ;
-  } /* float32_le_read */
-
-static double
-double64_be_read (unsigned char *cptr)
+  convert_func swap_16;
+  convert_func swap_32;
+  convert_func swap_64;
+  convert_func s_24_le;
+  convert_func s_24_be;
+  convert_func s_24_lpcm;
+  convert_func s_20_lpcm;
+  convert_func ulaw;
+  convert_func alaw;
+  } kernels =
   {
-  int             exponent, negative ;
-  double  dvalue ;
-
-  negative = (cptr [0] & 0x80) ? 1 : 0 ;
-  exponent = ((cptr [0] & 0x7F) << 4) | ((cptr [1] >> 4) & 0xF) ;
-
-  /* Might not have a 64 bit long, so load the mantissa into a double. */
-  dvalue = (((cptr [1] & 0xF) << 24) | (cptr [2] << 16) | (cptr [3] << 8) | cptr [4]) ;
-  dvalue += ((cptr [5] << 16) | (cptr [6] << 8) | cptr [7]) / ((double) 0x1000000) ;
-
-  if (exponent == 0 && dvalue == 0.0)
-    return 0.0 ;
-
-  dvalue += 0x10000000 ;
-
-  exponent = exponent - 0x3FF ;
-
-  dvalue = dvalue / ((double) 0x10000000) ;
+    .swap_16   = convert_swap_16_c,
+    .swap_32   = convert_swap_32_c,
+    .swap_64   = convert_swap_64_c,
+    .s_24_le   = convert_s_24_le_c,
+    .s_24_be   = convert_s_24_be_c,
+    .s_24_lpcm = convert_s_24_lpcm_c,
+    .s_20_lpcm = convert_s_20_lpcm_c,
+    .ulaw      = convert_ulaw_c,
+    .alaw      = convert_alaw_c,
+  };
 
-  if (negative)
-    dvalue *= -1 ;
+static void init_kernels()
+  {
+#ifdef HAVE_X86_SIMD
+  __builtin_cpu_init();
 
-  if (exponent > 0)
-    dvalue *= (1 << exponent) ;
-  else if (exponent < 0)
-    dvalue /= (1 << abs (exponent)) ;
+  if(__builtin_cpu_supports("sse2"))
+    kernels.swap_16 = convert_swap_16_sse2;
+  
+  if(__builtin_cpu_supports("ssse3"))
+    {
+    kernels.swap_32   = convert_swap_32_ssse3;
+    kernels.swap_64   = convert_swap_64_ssse3;
+    kernels.s_24_le   = convert_s_24_le_ssse3;
+    kernels.s_24_be   = convert_s_24_be_ssse3;
+    kernels.s_24_lpcm = convert_s_24_lpcm_ssse3;
+    kernels.s_20_lpcm = convert_s_20_lpcm_ssse3;
+    kernels.ulaw      = convert_ulaw_ssse3;
+    kernels.alaw      = convert_alaw_ssse3;
+    }
+  
+  if(__builtin_cpu_supports("avx2"))
+    {
+    kernels.swap_16 = convert_swap_16_avx2;
+    kernels.swap_32 = convert_swap_32_avx2;
+    }
+#endif
+  }
 
-  return dvalue ;
-  } /* double64_be_read */
+/* Decode functions */
 
-static double
-double64_le_read (unsigned char *cptr)
+static int get_num_samples(bgav_stream_t * s, int sample_size)
   {
-  int             exponent, negative ;
-  double  dvalue ;
-
-  negative = (cptr [7] & 0x80) ? 1 : 0 ;
-  exponent = ((cptr [7] & 0x7F) << 4) | ((cptr [6] >> 4) & 0xF) ;
-
-  /* Might not have a 64 bit long, so load the mantissa into a double. */
-  dvalue = (((cptr [6] & 0xF) << 24) | (cptr [5] << 16) | (cptr [4] << 8) | cptr [3]) ;
-  dvalue += ((cptr [2] << 16) | (cptr [1] << 8) | cptr [0]) / ((double) 0x1000000) ;
+  int num_samples;
+  pcm_t * priv;
+  priv = s->decoder_priv;
+  
+  num_samples = priv->bytes_in_packet / (sample_size * s->data.audio.format->num_channels);
+  
+  if(num_samples > FRAME_SAMPLES)
+    num_samples = FRAME_SAMPLES;
+  return num_samples;
+  }
 
-  if (exponent == 0 && dvalue == 0.0)
-    return 0.0 ;
+static void advance(pcm_t * priv, int num_bytes, int num_samples)
+  {
+  priv->packet_ptr += num_bytes;
+  priv->bytes_in_packet -= num_bytes;
+  priv->out->valid_samples = num_samples;
+  }
 
-  dvalue += 0x10000000 ;
+/*
+ *  Native formats: The frame points into the packet unless the
+ *  samples are misaligned.
+ */
 
-  exponent = exponent - 0x3FF ;
+static void decode_native(bgav_stream_t * s, int sample_size)
+  {
+  pcm_t * priv;
+  int num_samples, num_bytes;
+  priv = s->decoder_priv;
 
-  dvalue = dvalue / ((double) 0x10000000) ;
+  num_samples = get_num_samples(s, sample_size);
+  num_bytes   = num_samples * sample_size * s->data.audio.format->num_channels;
 
-  if (negative)
-    dvalue *= -1 ;
+  if(((uintptr_t)priv->packet_ptr) % sample_size)
+    {
+    memcpy(priv->frame->samples.u_8, priv->packet_ptr, num_bytes);
+    priv->out = priv->frame;
+    }
+  else
+    {
+    priv->ref_frame->samples.u_8 = priv->packet_ptr;
+    priv->out = priv->ref_frame;
+    }
+  advance(priv, num_bytes, num_samples);
+  }
 
-  if (exponent > 0)
-    dvalue *= (1 << exponent) ;
-  else if (exponent < 0)
-    dvalue /= (1 << abs (exponent)) ;
+static void decode_convert(bgav_stream_t * s, int sample_size, convert_func convert)
+  {
+  pcm_t * priv;
+  int num_samples, num_bytes;
+  priv = s->decoder_priv;
 
-  return dvalue ;
-  } /* double64_le_read */
+  num_samples = get_num_samples(s, sample_size);
+  num_bytes   = num_samples * sample_size * s->data.audio.format->num_channels;
 
-/* Corrsponding decoding functions */
+  convert(priv->packet_ptr, priv->frame->samples.u_8,
+          num_samples * s->data.audio.format->num_channels);
+  
+  priv->out = priv->frame;
+  advance(priv, num_bytes, num_samples);
+  }
 
-static void decode_float_32_be(bgav_stream_t * s)
+static void decode_8(bgav_stream_t * s)
   {
-  pcm_t * priv;
-  int num_samples, num_bytes, i;
-  uint8_t * src;
-  float * dst;
-  priv = s->decoder_priv;
+  decode_native(s, 1);
+  }
 
-  num_samples = priv->bytes_in_packet / (4 * s->data.audio.format->num_channels);
+static void decode_s_16(bgav_stream_t * s)
+  {
+  decode_native(s, 2);
+  }
 
-  if(num_samples > FRAME_SAMPLES)
-    num_samples = FRAME_SAMPLES;
+static void decode_s_16_swap(bgav_stream_t * s)
+  {
+  decode_convert(s, 2, kernels.swap_16);
+  }
 
-  num_bytes   = num_samples * 4 * s->data.audio.format->num_channels;
+static void decode_s_24_le(bgav_stream_t * s)
+  {
+  decode_convert(s, 3, kernels.s_24_le);
+  }
 
-  src = priv->packet_ptr;
-  dst = (float*)(priv->frame->samples.f);
+static void decode_s_24_be(bgav_stream_t * s)
+  {
+  decode_convert(s, 3, kernels.s_24_be);
+  }
 
-  i = num_samples * s->data.audio.format->num_channels;
-  
-  while(i--)
-    {
-    *dst = float32_be_read(src);
-    src+=4;
-    dst++;
-    }
-  priv->packet_ptr += num_bytes;
-  priv->bytes_in_packet -= num_bytes;
-  priv->frame->valid_samples = num_samples;
+static void decode_s_24_lpcm(bgav_stream_t * s)
+  {
+  decode_convert(s, 3, kernels.s_24_lpcm);
   }
 
-static void decode_float_32_le(bgav_stream_t * s)
+static void decode_s_24_lpcm_mono(bgav_stream_t * s)
   {
   pcm_t * priv;
   int num_samples, num_bytes, i;
   uint8_t * src;
-  float * dst;
+  uint32_t * dst;
   priv = s->decoder_priv;
 
-  num_samples = priv->bytes_in_packet / (4 * s->data.audio.format->num_channels);
+  num_samples = priv->bytes_in_packet / 3;
 
   if(num_samples > FRAME_SAMPLES)
     num_samples = FRAME_SAMPLES;
 
-  num_bytes   = num_samples * 4 * s->data.audio.format->num_channels;
+  num_bytes   = num_samples * 3;
 
   src = priv->packet_ptr;
-  dst = (float*)(priv->frame->samples.f);
+  dst = (uint32_t *)priv->frame->samples.s_32;
 
-  i = num_samples * s->data.audio.format->num_channels;
+  i = num_samples/2;
   
   while(i--)
     {
-    *dst = float32_le_read(src);
-    src+=4;
-    dst++;
+    dst[0] = ((uint32_t)(src[0])<<24)|((uint32_t)(src[1])<<16)|((uint32_t)(src[4])<< 8);
+    dst[1] = ((uint32_t)(src[2])<<24)|((uint32_t)(src[3])<<16)|((uint32_t)(src[5])<< 8);
+    src+=6;
+    dst+=2;
     }
-  priv->packet_ptr += num_bytes;
-  priv->bytes_in_packet -= num_bytes;
-  priv->frame->valid_samples = num_samples;
+  priv->out = priv->frame;
+  advance(priv, num_bytes, num_samples);
   }
 
-static void decode_float_64_be(bgav_stream_t * s)
+static void decode_s_20_lpcm(bgav_stream_t * s)
   {
   pcm_t * priv;
-  int num_samples, num_bytes, i;
-  uint8_t * src;
-  double * dst;
+  int num_samples, num_bytes;
   priv = s->decoder_priv;
 
-  num_samples = priv->bytes_in_packet / (8 * s->data.audio.format->num_channels);
+  /* 5 bytes -> 2 samples */
+  num_samples = (2*priv->bytes_in_packet) / (5 * s->data.audio.format->num_channels);
 
   if(num_samples > FRAME_SAMPLES)
     num_samples = FRAME_SAMPLES;
 
-  num_bytes   = num_samples * 8 * s->data.audio.format->num_channels;
-
-  src = priv->packet_ptr;
-  dst = (double*)(priv->frame->samples.f);
+  num_bytes   = (num_samples * 5 * s->data.audio.format->num_channels)/2;
 
-  i = num_samples * s->data.audio.format->num_channels;
+  kernels.s_20_lpcm(priv->packet_ptr, priv->frame->samples.s_32,
+                    num_samples * s->data.audio.format->num_channels);
   
-  while(i--)
-    {
-    *dst = double64_be_read(src);
-    src+=8;
-    dst++;
-    }
-  priv->packet_ptr += num_bytes;
-  priv->bytes_in_packet -= num_bytes;
-  priv->frame->valid_samples = num_samples;
+  priv->out = priv->frame;
+  advance(priv, num_bytes, num_samples);
   }
 
-static void decode_float_64_le(bgav_stream_t * s)
+static void decode_s_20_lpcm_mono(bgav_stream_t * s)
   {
   pcm_t * priv;
   int num_samples, num_bytes, i;
   uint8_t * src;
-  double * dst;
+  uint32_t * dst;
   priv = s->decoder_priv;
 
-  num_samples = priv->bytes_in_packet / (8 * s->data.audio.format->num_channels);
-
+  num_samples = (2*priv->bytes_in_packet) / (5 * s->data.audio.format->num_channels);
+  
   if(num_samples > FRAME_SAMPLES)
     num_samples = FRAME_SAMPLES;
 
-  num_bytes   = num_samples * 8 * s->data.audio.format->num_channels;
-
+  num_bytes   = (num_samples * 5 * s->data.audio.format->num_channels)/2;
+  
   src = priv->packet_ptr;
-  dst = (double*)(priv->frame->samples.f);
+  dst = (uint32_t*)(priv->frame->samples.s_32);
 
-  i = num_samples * s->data.audio.format->num_channels;
+  i = num_samples/2;
   
   while(i--)
     {
-    *dst = double64_le_read(src);
-    src+=8;
-    dst++;
+    dst[0] = ((uint32_t)(src[0])<<24)|((uint32_t)(src[1])<<16)|((uint32_t)(src[4] & 0xf0)<< 8);
+    dst[1] = ((uint32_t)(src[2])<<24)|((uint32_t)(src[3])<<16)|((uint32_t)(src[4] & 0x0f)<< 12);
+    src+=5;
+    dst+=2;
     }
-  priv->packet_ptr += num_bytes;
-  priv->bytes_in_packet -= num_bytes;
-  priv->frame->valid_samples = num_samples;
+  priv->out = priv->frame;
+  advance(priv, num_bytes, num_samples);
   }
 
-/* U-Law */
-
-static const short ulaw_decode [256] =
-{	-32124,	-31100,	-30076,	-29052,	-28028,	-27004,	-25980,	-24956,
-	-23932,	-22908,	-21884,	-20860,	-19836,	-18812,	-17788,	-16764,
-	-15996,	-15484,	-14972,	-14460,	-13948,	-13436,	-12924,	-12412,
-	-11900,	-11388,	-10876,	-10364,	-9852,	-9340,	-8828,	-8316,
-	-7932,	-7676,	-7420,	-7164,	-6908,	-6652,	-6396,	-6140,
-	-5884,	-5628,	-5372,	-5116,	-4860,	-4604,	-4348,	-4092,
-	-3900,	-3772,	-3644,	-3516,	-3388,	-3260,	-3132,	-3004,
-	-2876,	-2748,	-2620,	-2492,	-2364,	-2236,	-2108,	-1980,
-	-1884,	-1820,	-1756,	-1692,	-1628,	-1564,	-1500,	-1436,
-	-1372,	-1308,	-1244,	-1180,	-1116,	-1052,	-988,	-924,
-	-876,	-844,	-812,	-780,	-748,	-716,	-684,	-652,
-	-620,	-588,	-556,	-524,	-492,	-460,	-428,	-396,
-	-372,	-356,	-340,	-324,	-308,	-292,	-276,	-260,
-	-244,	-228,	-212,	-196,	-180,	-164,	-148,	-132,
-	-120,	-112,	-104,	-96,	-88,	-80,	-72,	-64,
-	-56,	-48,	-40,	-32,	-24,	-16,	-8,		0,
+/* Integer 32 bit */
 
-	32124,	31100,	30076,	29052,	28028,	27004,	25980,	24956,
-	23932,	22908,	21884,	20860,	19836,	18812,	17788,	16764,
-	15996,	15484,	14972,	14460,	13948,	13436,	12924,	12412,
-	11900,	11388,	10876,	10364,	9852,	9340,	8828,	8316,
-	7932,	7676,	7420,	7164,	6908,	6652,	6396,	6140,
-	5884,	5628,	5372,	5116,	4860,	4604,	4348,	4092,
-	3900,	3772,	3644,	3516,	3388,	3260,	3132,	3004,
-	2876,	2748,	2620,	2492,	2364,	2236,	2108,	1980,
-	1884,	1820,	1756,	1692,	1628,	1564,	1500,	1436,
-	1372,	1308,	1244,	1180,	1116,	1052,	988,	924,
-	876,	844,	812,	780,	748,	716,	684,	652,
-	620,	588,	556,	524,	492,	460,	428,	396,
-	372,	356,	340,	324,	308,	292,	276,	260,
-	244,	228,	212,	196,	180,	164,	148,	132,
-	120,	112,	104,	96,		88,		80,		72,		64,
-	56,		48,		40,		32,		24,		16,		8,		0
-} ;
+static void decode_s_32(bgav_stream_t * s)
+  {
+  decode_native(s, 4);
+  }
 
-static void decode_ulaw(bgav_stream_t * s)
+static void decode_s_32_swap(bgav_stream_t * s)
   {
-  pcm_t * priv;
-  int num_samples, num_bytes, i;
-  uint8_t * src;
-  int16_t * dst;
-  priv = s->decoder_priv;
+  decode_convert(s, 4, kernels.swap_32);
+  }
 
-  num_samples = priv->bytes_in_packet / (s->data.audio.format->num_channels);
+/*
+ *  Floating point: We assume IEEE floats, so non-native
+ *  endianess is just a byte swap
+ */
 
-  if(num_samples > FRAME_SAMPLES)
-    num_samples = FRAME_SAMPLES;
+static void decode_float_32(bgav_stream_t * s)
+  {
+  decode_native(s, 4);
+  }
 
-  num_bytes   = num_samples * s->data.audio.format->num_channels;
+static void decode_float_32_swap(bgav_stream_t * s)
+  {
+  decode_convert(s, 4, kernels.swap_32);
+  }
 
-  src = priv->packet_ptr;
-  dst = (int16_t*)(priv->frame->samples.s_16);
+static void decode_float_64(bgav_stream_t * s)
+  {
+  decode_native(s, 8);
+  }
 
-  i = num_samples * s->data.audio.format->num_channels;
-  
-  while(i--)
-    {
-    *dst = ulaw_decode[*src];
-    src++;
-    dst++;
-    }
-  priv->packet_ptr += num_bytes;
-  priv->bytes_in_packet -= num_bytes;
-  priv->frame->valid_samples = num_samples;
+static void decode_float_64_swap(bgav_stream_t * s)
+  {
+  decode_convert(s, 8, kernels.swap_64);
   }
 
+#ifndef WORDS_BIGENDIAN
+#define decode_s_16_le decode_s_16
+#define decode_s_16_be decode_s_16_swap
+#define decode_s_32_le decode_s_32
+#define decode_s_32_be decode_s_32_swap
+#define decode_float_32_le decode_float_32
+#define decode_float_32_be decode_float_32_swap
+#define decode_float_64_le decode_float_64
+#define decode_float_64_be decode_float_64_swap
+#else
+#define decode_s_16_le decode_s_16_swap
+#define decode_s_16_be decode_s_16
+#define decode_s_32_le decode_s_32_swap
+#define decode_s_32_be decode_s_32
+#define decode_float_32_le decode_float_32_swap
+#define decode_float_32_be decode_float_32
+#define decode_float_64_le decode_float_64_swap
+#define decode_float_64_be decode_float_64
+#endif
 
-/* A-Law */
+/* u-law and A-law */
 
-static
-const short alaw_decode [256] =
-{	-5504,	-5248,	-6016,	-5760,	-4480,	-4224,	-4992,	-4736,
-	-7552,	-7296,	-8064,	-7808,	-6528,	-6272,	-7040,	-6784,
-	-2752,	-2624,	-3008,	-2880,	-2240,	-2112,	-2496,	-2368,
-	-3776,	-3648,	-4032,	-3904,	-3264,	-3136,	-3520,	-3392,
-	-22016,	-20992,	-24064,	-23040,	-17920,	-16896,	-19968,	-18944,
-	-30208,	-29184,	-32256,	-31232,	-26112,	-25088,	-28160,	-27136,
-	-11008,	-10496,	-12032,	-11520,	-8960,	-8448,	-9984,	-9472,
-	-15104,	-14592,	-16128,	-15616,	-13056,	-12544,	-14080,	-13568,
-	-344,	-328,	-376,	-360,	-280,	-264,	-312,	-296,
-	-472,	-456,	-504,	-488,	-408,	-392,	-440,	-424,
-	-88,	-72,	-120,	-104,	-24,	-8,		-56,	-40,
-	-216,	-200,	-248,	-232,	-152,	-136,	-184,	-168,
-	-1376,	-1312,	-1504,	-1440,	-1120,	-1056,	-1248,	-1184,
-	-1888,	-1824,	-2016,	-1952,	-1632,	-1568,	-1760,	-1696,
-	-688,	-656,	-752,	-720,	-560,	-528,	-624,	-592,
-	-944,	-912,	-1008,	-976,	-816,	-784,	-880,	-848,
-	5504,	5248,	6016,	5760,	4480,	4224,	4992,	4736,
-	7552,	7296,	8064,	7808,	6528,	6272,	7040,	6784,
-	2752,	2624,	3008,	2880,	2240,	2112,	2496,	2368,
-	3776,	3648,	4032,	3904,	3264,	3136,	3520,	3392,
-	22016,	20992,	24064,	23040,	17920,	16896,	19968,	18944,
-	30208,	29184,	32256,	31232,	26112,	25088,	28160,	27136,
-	11008,	10496,	12032,	11520,	8960,	8448,	9984,	9472,
-	15104,	14592,	16128,	15616,	13056,	12544,	14080,	13568,
-	344,	328,	376,	360,	280,	264,	312,	296,
-	472,	456,	504,	488,	408,	392,	440,	424,
-	88,		72,		120,	104,	24,		8,		56,		40,
-	216,	200,	248,	232,	152,	136,	184,	168,
-	1376,	1312,	1504,	1440,	1120,	1056,	1248,	1184,
-	1888,	1824,	2016,	1952,	1632,	1568,	1760,	1696,
-	688,	656,	752,	720,	560,	528,	624,	592,
-	944,	912,	1008,	976,	816,	784,	880,	848
-} ; /* alaw_decode */
+static void decode_ulaw(bgav_stream_t * s)
+  {
+  decode_convert(s, 1, kernels.ulaw);
+  }
 
 static void decode_alaw(bgav_stream_t * s)
   {
-  pcm_t * priv;
-  int num_samples, num_bytes, i;
-  uint8_t * src;
-  int16_t * dst;
-  priv = s->decoder_priv;
-
-  num_samples = priv->bytes_in_packet / (s->data.audio.format->num_channels);
-
-  if(num_samples > FRAME_SAMPLES)
-    num_samples = FRAME_SAMPLES;
-
-  num_bytes   = num_samples * s->data.audio.format->num_channels;
-
-  src = priv->packet_ptr;
-  dst = (int16_t*)(priv->frame->samples.s_16);
-  
-  i = num_samples * s->data.audio.format->num_channels;
-  
-  while(i--)
-    {
-    *dst = alaw_decode[*src];
-    src++;
-    dst++;
-    }
-  priv->packet_ptr += num_bytes;
-  priv->bytes_in_packet -= num_bytes;
-  priv->frame->valid_samples = num_samples;
+  decode_convert(s, 1, kernels.alaw);
   }
 
 static gavl_source_status_t get_packet(bgav_stream_t * s)
@@ -1227,6 +1313,7 @@ static int init_pcm(bgav_stream_t * s)
   gavl_set_channel_setup(s->data.audio.format);
   
   priv->frame = gavl_audio_frame_create(s->data.audio.format);
+  priv->ref_frame = gavl_audio_frame_create(NULL);
   if(!priv->block_align)
     priv->block_align = s->data.audio.format->num_channels *
       ((s->data.audio.bits_per_sample+7)/8);
@@ -1241,6 +1328,15 @@ static gavl_source_status_t decode_frame_pcm(bgav_stream_t * s)
   
   priv = s->decoder_priv;
 
+  /* The last frame might point into the packet, so it is released
+     only now */
+  
+  if(priv->p && !priv->bytes_in_packet)
+    {
+    bgav_stream_done_packet_read(s, priv->p);
+    priv->p = NULL;
+    }
+  
   if(!priv->p && ((st = get_packet(s)) != GAVL_SOURCE_OK))
     return st;
 
@@ -1249,13 +1345,8 @@ static gavl_source_status_t decode_frame_pcm(bgav_stream_t * s)
   priv->decode_func(s);
 
   gavl_audio_frame_copy_ptrs(s->data.audio.format,
-                             s->data.audio.frame, priv->frame);
+                             s->data.audio.frame, priv->out);
   
-  if(!priv->bytes_in_packet)
-    {
-    bgav_stream_done_packet_read(s, priv->p);
-    priv->p = NULL;
-    }
   return GAVL_SOURCE_OK;
   }
 
@@ -1264,8 +1355,20 @@ static void close_pcm(bgav_stream_t * s)
   pcm_t * priv;
   priv = s->decoder_priv;
 
+  /* Packet held for zero copy output */
+  if(priv->p)
+    {
+    bgav_stream_done_packet_read(s, priv->p);
+    priv->p = NULL;
+    }
+  
   if(priv->frame)
     gavl_audio_frame_destroy(priv->frame);
+  if(priv->ref_frame)
+    {
+    gavl_audio_frame_null(priv->ref_frame);
+    gavl_audio_frame_destroy(priv->ref_frame);
+    }
   free(priv);
   }
 
@@ -1280,7 +1383,7 @@ static void resync_pcm(bgav_stream_t * s)
     bgav_stream_done_packet_read(s, priv->p);
     priv->p = NULL;
     }
-
+  priv->bytes_in_packet = 0;
   }
 
 static bgav_audio_decoder_t decoder =
@@ -1315,5 +1418,6 @@ static bgav_audio_decoder_t decoder =
 
 void bgav_init_audio_decoders_pcm()
   {
+  init_kernels();
   bgav_audio_decoder_register(&decoder);
   }
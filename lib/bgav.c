@@ -206,19 +206,10 @@ bgav_t * bgav_create()
   return ret;
   }
 
-int bgav_open(bgav_t * ret, const char * location)
+static int open_demuxer(bgav_t * ret)
   {
-  bgav_codecs_init(&ret->opt);
-  ret->input = create_input(ret);
-
-  /* Create global metadata */
-  
-  if(!bgav_input_open(ret->input, location))
-    goto fail;
   if(!bgav_init(ret))
-    goto fail;
-
-  ret->location = gavl_strdup(location);
+    return 0;
 
   if(ret->demuxer &&
      (ret->demuxer->flags & BGAV_DEMUXER_SEEK_ITERATIVE) &&
@@ -230,11 +221,82 @@ int bgav_open(bgav_t * ret, const char * location)
      ((ret->opt.sample_accurate == 2) &&
       ret->demuxer &&
       !(ret->demuxer->flags & BGAV_DEMUXER_CAN_SEEK)))
+    {
+    if(ret->demuxer && !bgav_demuxer_finish_open(ret->demuxer))
+      return 0;
     bgav_set_sample_accurate(ret);
+    }
   
   bgav_track_table_compute_info(ret->tt);
+  return 1;
+  }
+
+/*
+ *  Open the demuxer if the track table came from the info cache
+ *  and complete it if it was opened in info only mode
+ */
+
+int bgav_ensure_demuxer(bgav_t * b)
+  {
+  bgav_track_table_t * cached;
   
+  if(b->info_cached)
+    {
+    b->info_cached = 0;
+
+    /* The cached table stays, the application can have pointers into it */
+    cached = b->tt;
+    b->tt = NULL;
+
+    if(!open_demuxer(b))
+      {
+      bgav_log(&b->opt, BGAV_LOG_ERROR, LOG_DOMAIN,
+               "Opening %s failed after using the info cache", b->location);
+      if(b->tt)
+        bgav_track_table_unref(b->tt);
+      b->tt = cached;
+      return 0;
+      }
+    
+    if(!bgav_info_cache_merge(b, cached))
+      {
+      bgav_log(&b->opt, BGAV_LOG_WARNING, LOG_DOMAIN,
+               "Cached media info doesn't match %s", b->location);
+      b->info_cache_dirty = 1;
+      }
+    bgav_track_table_unref(cached);
+    }
+
+  if(b->demuxer && !bgav_demuxer_finish_open(b->demuxer))
+    {
+    bgav_log(&b->opt, BGAV_LOG_ERROR, LOG_DOMAIN,
+             "Building the index failed");
+    return 0;
+    }
+  return 1;
+  }
+
+int bgav_open(bgav_t * ret, const char * location)
+  {
+  bgav_codecs_init(&ret->opt);
+  ret->input = create_input(ret);
+
+  /* Create global metadata */
   
+  if(!bgav_input_open(ret->input, location))
+    goto fail;
+
+  if(ret->opt.info_cache && bgav_info_cache_read(ret))
+    ret->info_cached = 1;
+  else
+    {
+    if(!open_demuxer(ret))
+      goto fail;
+    if(ret->opt.info_cache)
+      ret->info_cache_dirty = 1;
+    }
+  
+  ret->location = gavl_strdup(location);
   return 1;
   fail:
 
@@ -250,9 +312,21 @@ int bgav_open(bgav_t * ret, const char * location)
 
 void bgav_close(bgav_t * b)
   {
+  bgav_info_cache_flush(b);
+  bgav_seamless_destroy(b);
+
+  if(b->follower)
+    bgav_close(b->follower);
+  
   if(b->location)
     free(b->location);
   
+  if(b->pipeline)
+    {
+    bgav_pipeline_destroy(b->pipeline);
+    b->pipeline = NULL;
+    }
+  
   if(b->is_running)
     {
     bgav_track_stop(b->tt->cur);
@@ -291,6 +365,13 @@ gavl_time_t bgav_get_duration(bgav_t * bgav, int track)
   return gavl_track_get_duration(bgav->tt->tracks[track].info);
   }
 
+int bgav_get_info_flags(bgav_t * bgav, int track)
+  {
+  if(bgav->tt->tracks[track].flags & TRACK_INFO_ESTIMATE)
+    return BGAV_INFO_DURATION_ESTIMATED | BGAV_INFO_STATS_MISSING;
+  return 0;
+  }
+
 const char * bgav_get_track_name(bgav_t * b, int track)
   {
   return gavl_dictionary_get_string(b->tt->tracks[track].metadata, GAVL_META_LABEL);
@@ -298,6 +379,13 @@ const char * bgav_get_track_name(bgav_t * b, int track)
 
 void bgav_stop(bgav_t * b)
   {
+  bgav_seamless_stop(b);
+  
+  if(b->pipeline)
+    {
+    bgav_pipeline_destroy(b->pipeline);
+    b->pipeline = NULL;
+    }
   bgav_track_stop(b->tt->cur);
   b->is_running = 0;
   }
@@ -347,6 +435,9 @@ int bgav_select_track(bgav_t * b, int track)
   if((track < 0) || (track >= b->tt->num_tracks))
     return 0;
 
+  if(!bgav_ensure_demuxer(b))
+    return 0;
+
   b->eof = 0;
 
   if(bgav_is_redirector(b))
@@ -359,6 +450,14 @@ int bgav_select_track(bgav_t * b, int track)
     }
        
   
+  bgav_seamless_stop(b);
+  
+  if(b->pipeline)
+    {
+    bgav_pipeline_destroy(b->pipeline);
+    b->pipeline = NULL;
+    }
+  
   if(b->is_running)
     {
     bgav_track_stop(b->tt->cur);
@@ -509,6 +608,9 @@ int bgav_select_track(bgav_t * b, int track)
 
 int bgav_start(bgav_t * b)
   {
+  /* Decoders change the formats */
+  bgav_info_cache_flush(b);
+  
   b->is_running = 1;
   /* Create buffers */
   bgav_input_buffer(b->input);
@@ -520,11 +622,21 @@ int bgav_start(bgav_t * b)
     }
   
   bgav_track_compute_info(b->tt->cur);
+
+  /* Must be the last element of the packet chains */
+  if(b->demuxer)
+    bgav_seamless_start(b);
+  
+  if(b->opt.pipeline && b->demuxer)
+    b->pipeline = bgav_pipeline_create(b);
+  
   return 1;
   }
 
 int bgav_can_seek(bgav_t * b)
   {
+  if(b->info_cached)
+    return !!(b->info_cache_flags & BGAV_INFO_CACHE_CAN_SEEK);
   return !!(b->demuxer) && !!(b->demuxer->flags & BGAV_DEMUXER_CAN_SEEK);
   }
 
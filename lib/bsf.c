@@ -39,6 +39,8 @@ typedef struct
 static const filter_t filters[] =
   {
     { BGAV_MK_FOURCC('a', 'v', 'c', '1'), bgav_bsf_init_avcC },
+    { BGAV_MK_FOURCC('h', 'v', 'c', '1'), bgav_bsf_init_hvcC },
+    { BGAV_MK_FOURCC('h', 'e', 'v', '1'), bgav_bsf_init_hvcC },
 #ifdef HAVE_LIBAVCODEC
     { BGAV_MK_FOURCC('A', 'D', 'T', 'S'), bgav_bsf_init_adts },
 #endif
@@ -57,6 +59,22 @@ void bgav_bsf_run(bgav_bsf_t * bsf, bgav_packet_t * in, bgav_packet_t * out)
   bsf->filter(bsf, in, out);
   }
 
+/* Filter a packet and return the output packet. This is the input
+   packet itself if the filter could work in place */
+
+static bgav_packet_t * run_packet(bgav_bsf_t * bsf, bgav_packet_t * in)
+  {
+  bgav_packet_t * out;
+  
+  if(bsf->filter_inplace && bsf->filter_inplace(bsf, in))
+    return in;
+
+  out = bgav_packet_pool_get(bsf->s->pp);
+  bgav_bsf_run(bsf, in, out);
+  bgav_packet_pool_put(bsf->s->pp, in);
+  return out;
+  }
+
 gavl_source_status_t
 bgav_bsf_get_packet(void * bsf_p, bgav_packet_t ** ret)
   {
@@ -75,10 +93,7 @@ bgav_bsf_get_packet(void * bsf_p, bgav_packet_t ** ret)
   if((st = bsf->src.get_func(bsf->src.data, &in_packet)) != GAVL_SOURCE_OK)
     return st;
   
-  *ret = bgav_packet_pool_get(bsf->s->pp);
-  bgav_bsf_run(bsf, in_packet, *ret);
-
-  bgav_packet_pool_put(bsf->s->pp, in_packet);
+  *ret = run_packet(bsf, in_packet);
   return GAVL_SOURCE_OK;
   }
 
@@ -107,9 +122,7 @@ bgav_bsf_peek_packet(void * bsf_p, bgav_packet_t ** ret, int force)
   if(!in_packet)
     return GAVL_SOURCE_EOF; // Impossible but who knows?
   
-  bsf->out_packet = bgav_packet_pool_get(bsf->s->pp);
-  bgav_bsf_run(bsf, in_packet, bsf->out_packet);
-  bgav_packet_pool_put(bsf->s->pp, in_packet);
+  bsf->out_packet = run_packet(bsf, in_packet);
 
   if(ret)
     *ret = bsf->out_packet;
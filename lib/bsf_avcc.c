@@ -93,6 +93,37 @@ filter_avcc(bgav_bsf_t* bsf, bgav_packet_t * in, bgav_packet_t * out)
     }
   }
 
+/*
+ *  With 4 byte NAL sizes, the sizes can be replaced by start codes
+ *  without moving the data. Trailing garbage is cut off like in
+ *  filter_avcc()
+ */
+
+static int
+filter_inplace_avcc(bgav_bsf_t* bsf, bgav_packet_t * p)
+  {
+  uint8_t * ptr, *end;
+  uint32_t len;
+  avcc_t * priv = bsf->priv;
+
+  if(priv->nal_size_length != 4)
+    return 0;
+  
+  ptr = p->data;
+  end = p->data + p->data_size;
+  
+  while(end - ptr > 4)
+    {
+    len = GAVL_PTR_2_32BE(ptr);
+    if(len > end - ptr - 4)
+      break;
+    memcpy(ptr, nal_header, 4);
+    ptr += 4 + len;
+    }
+  p->data_size = ptr - p->data;
+  return 1;
+  }
+
 static void
 cleanup_avcc(bgav_bsf_t * bsf)
   {
@@ -122,6 +153,7 @@ bgav_bsf_init_avcC(bgav_bsf_t * bsf)
   int len;
   
   bsf->filter = filter_avcc;
+  bsf->filter_inplace = filter_inplace_avcc;
   bsf->cleanup = cleanup_avcc;
   priv = calloc(1, sizeof(*priv));
   bsf->priv = priv;
@@ -152,3 +184,57 @@ bgav_bsf_init_avcC(bgav_bsf_t * bsf)
     }
   return 1;
   }
+
+/* HEVC uses the same length prefixed NAL units */
+
+int
+bgav_bsf_init_hvcC(bgav_bsf_t * bsf)
+  {
+  uint8_t * ptr, * end;
+  avcc_t * priv;
+  int num_arrays;
+  int num_units;
+  int i, j;
+  int len;
+  
+  bsf->filter = filter_avcc;
+  bsf->filter_inplace = filter_inplace_avcc;
+  bsf->cleanup = cleanup_avcc;
+  priv = calloc(1, sizeof(*priv));
+  bsf->priv = priv;
+
+  /* Parse extradata */
+  ptr = bsf->s->ext_data;
+  end = ptr + bsf->s->ext_size;
+
+  if(bsf->s->ext_size < 23)
+    {
+    priv->nal_size_length = 4;
+    return 1;
+    }
+  
+  priv->nal_size_length = (ptr[21] & 0x3) + 1;
+  num_arrays = ptr[22];
+  ptr += 23;
+  
+  /* VPS, SPS, PPS, SEI */
+  for(i = 0; i < num_arrays; i++)
+    {
+    if(end - ptr < 3)
+      break;
+    ptr++; // Array completeness, NAL unit type
+    num_units = GAVL_PTR_2_16BE(ptr); ptr += 2;
+    
+    for(j = 0; j < num_units; j++)
+      {
+      if(end - ptr < 2)
+        return 1;
+      len = GAVL_PTR_2_16BE(ptr); ptr += 2;
+      if(end - ptr < len)
+        return 1;
+      append_extradata(bsf, ptr, len);
+      ptr += len;
+      }
+    }
+  return 1;
+  }
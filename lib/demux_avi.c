@@ -1802,6 +1802,172 @@ static void duplicate_si(bgav_superindex_t * idx)
 
 
 
+static void estimate_durations(bgav_demuxer_context_t * ctx)
+  {
+  int i;
+  bgav_stream_t * s;
+  audio_priv_t * avi_as;
+  video_priv_t * avi_vs;
+  
+  for(i = 0; i < ctx->tt->cur->num_audio_streams; i++)
+    {
+    s = &ctx->tt->cur->audio_streams[i];
+    avi_as = s->priv;
+    if(!avi_as->strh.dwRate || !s->data.audio.format->samplerate)
+      continue;
+    bgav_stream_set_duration_estimate(s, 0,
+                                      gavl_time_rescale(avi_as->strh.dwRate,
+                                                        s->data.audio.format->samplerate,
+                                                        (int64_t)avi_as->strh.dwLength *
+                                                        avi_as->strh.dwScale));
+    }
+  for(i = 0; i < ctx->tt->cur->num_video_streams; i++)
+    {
+    s = &ctx->tt->cur->video_streams[i];
+    avi_vs = s->priv;
+    if(!s->data.video.format->frame_duration)
+      continue;
+    bgav_stream_set_duration_estimate(s, 0,
+                                      (int64_t)avi_vs->strh.dwLength *
+                                      s->data.video.format->frame_duration);
+    }
+  }
+
+/* Build the index and determine the index mode */
+
+static int finish_avi(bgav_demuxer_context_t * ctx)
+  {
+  int i;
+  avi_priv_t * p;
+  video_priv_t * avi_vs;
+
+  p = ctx->priv;
+  
+  if(ctx->input->flags & BGAV_INPUT_CAN_SEEK_BYTE)
+    {
+    bgav_input_seek(ctx->input, ctx->data_start + p->movi_size, SEEK_SET);
+
+    if(probe_idx1(ctx->input) && read_idx1(ctx->input, &p->idx1))
+      {
+      p->has_idx1 = 1;
+      if(ctx->opt->dump_indices)
+        dump_idx1(&p->idx1);
+      }
+    bgav_input_seek(ctx->input, ctx->data_start, SEEK_SET);
+    }
+  
+  /* Check, which index to build */
+
+  if(ctx->input->flags & BGAV_INPUT_CAN_SEEK_BYTE)
+    {
+    indx_build_superindex(ctx);
+  
+    if(!ctx->si && p->has_idx1)
+      {
+      idx1_build_superindex(ctx);
+      }
+    if(ctx->si)
+      ctx->flags |= BGAV_DEMUXER_CAN_SEEK;
+    else
+      ctx->flags &= ~BGAV_DEMUXER_CAN_SEEK;
+    }
+
+  /* Obtain index mode */
+
+  if(ctx->opt->sample_accurate && ctx->si && p->has_iavs)
+    {
+    duplicate_si(ctx->si);
+    p->duplicate_si = 1;
+    ctx->flags &= ~BGAV_DEMUXER_SI_PRIVATE_FUNCS;
+    ctx->tt->cur->audio_streams->process_packet = process_packet_iavs_stream;
+    ctx->tt->cur->video_streams->process_packet = process_packet_iavs_stream;
+    ctx->tt->cur->video_streams->first_index_position = 0;
+    ctx->tt->cur->video_streams->last_index_position = ctx->si->num_entries - 2;
+    ctx->tt->cur->audio_streams->first_index_position = 1;
+    ctx->tt->cur->audio_streams->last_index_position = ctx->si->num_entries - 1;
+    }
+
+  if(ctx->si)
+    {
+    ctx->index_mode = INDEX_MODE_SI_SA;
+  
+    for(i = 0; i < ctx->tt->cur->num_audio_streams; i++)
+      {
+      if(check_codec(ctx->tt->cur->audio_streams[i].fourcc, audio_codecs_sa))
+        continue;
+      else if(check_codec(ctx->tt->cur->audio_streams[i].fourcc, audio_codecs_parse_mpeg))
+        {
+        ctx->tt->cur->audio_streams[i].index_mode = INDEX_MODE_SIMPLE;
+        ctx->tt->cur->audio_streams[i].flags |= STREAM_PARSE_FULL;
+        ctx->index_mode = INDEX_MODE_SI_PARSE;
+        continue;
+        }
+      else if(check_codec(ctx->tt->cur->audio_streams[i].fourcc, audio_codecs_parse_simple))
+        {
+        ctx->tt->cur->audio_streams[i].index_mode = INDEX_MODE_SIMPLE;
+        ctx->index_mode = INDEX_MODE_SI_PARSE;
+        continue;
+        }
+      else
+        {
+        ctx->index_mode = 0;
+        break;
+        }
+      }
+    }
+  else /* Index-less */
+    {
+    ctx->index_mode = INDEX_MODE_MIXED;
+
+    for(i = 0; i < ctx->tt->cur->num_video_streams; i++)
+      {
+      avi_vs = ctx->tt->cur->video_streams[i].priv;
+      if(check_codec(ctx->tt->cur->video_streams[i].fourcc,
+                     video_codecs_msmpeg4v1))
+        avi_vs->is_keyframe = is_keyframe_msmpeg4v1;
+      else if(check_codec(ctx->tt->cur->video_streams[i].fourcc,
+                          video_codecs_msmpeg4v3))
+        avi_vs->is_keyframe = is_keyframe_msmpeg4v3;
+      else if(bgav_video_is_divx4(ctx->tt->cur->video_streams[i].fourcc))
+        avi_vs->is_keyframe = is_keyframe_mpeg4;
+      else if(!check_codec(ctx->tt->cur->video_streams[i].fourcc,
+                           video_codecs_intra))
+        ctx->index_mode = 0;
+
+      ctx->tt->cur->video_streams[i].flags |= STREAM_NO_DURATIONS;
+      ctx->tt->cur->video_streams[i].index_mode = INDEX_MODE_SIMPLE;
+      }
+        
+    for(i = 0; i < ctx->tt->cur->num_audio_streams; i++)
+      {
+      if(check_codec(ctx->tt->cur->audio_streams[i].fourcc, audio_codecs_sa))
+        {
+        ctx->tt->cur->audio_streams[i].index_mode = INDEX_MODE_SIMPLE;
+        continue;
+        }
+      else if(check_codec(ctx->tt->cur->audio_streams[i].fourcc, audio_codecs_parse_mpeg))
+        {
+        ctx->tt->cur->audio_streams[i].index_mode = INDEX_MODE_SIMPLE;
+        ctx->tt->cur->audio_streams[i].flags |= STREAM_PARSE_FULL;
+        continue;
+        }
+      else if(check_codec(ctx->tt->cur->audio_streams[i].fourcc, audio_codecs_parse_simple))
+        {
+        ctx->tt->cur->audio_streams[i].index_mode = INDEX_MODE_SIMPLE;
+        ctx->index_mode = INDEX_MODE_SI_PARSE;
+        continue;
+        }
+      else
+        {
+        ctx->index_mode = 0;
+        break;
+        }
+      }
+    }
+  
+  return 1;
+  }
+
 static int open_avi(bgav_demuxer_context_t * ctx)
   {
   int i;
@@ -1811,7 +1977,6 @@ static int open_avi(bgav_demuxer_context_t * ctx)
   strh_t strh;
   uint32_t fourcc;
   int keep_going;
-  video_priv_t * avi_vs;
   
   /* Create track */
   ctx->tt = bgav_track_table_create(1);
@@ -1947,125 +2112,17 @@ static int open_avi(bgav_demuxer_context_t * ctx)
       p->movi_size = ctx->input->total_bytes - ctx->data_start;
     }
 
-  if(ctx->input->flags & BGAV_INPUT_CAN_SEEK_BYTE)
-    {
-    bgav_input_seek(ctx->input, ctx->data_start + p->movi_size, SEEK_SET);
-
-    if(probe_idx1(ctx->input) && read_idx1(ctx->input, &p->idx1))
-      {
-      p->has_idx1 = 1;
-      if(ctx->opt->dump_indices)
-        dump_idx1(&p->idx1);
-      }
-    bgav_input_seek(ctx->input, ctx->data_start, SEEK_SET);
-    }
-  
-  /* Check, which index to build */
-
-  if(ctx->input->flags & BGAV_INPUT_CAN_SEEK_BYTE)
+  /* Info only mode: Take the durations from the stream headers
+     and build the index later */
+  if((ctx->flags & BGAV_DEMUXER_INFO_ONLY) && !p->has_iavs)
     {
-    indx_build_superindex(ctx);
-  
-    if(!ctx->si && p->has_idx1)
-      {
-      idx1_build_superindex(ctx);
-      }
-    if(ctx->si)
+    estimate_durations(ctx);
+    if(ctx->input->flags & BGAV_INPUT_CAN_SEEK_BYTE)
       ctx->flags |= BGAV_DEMUXER_CAN_SEEK;
+    ctx->flags |= BGAV_DEMUXER_INCOMPLETE;
     }
-
-  /* Obtain index mode */
-
-  if(ctx->opt->sample_accurate && ctx->si && p->has_iavs)
-    {
-    duplicate_si(ctx->si);
-    p->duplicate_si = 1;
-    ctx->flags &= ~BGAV_DEMUXER_SI_PRIVATE_FUNCS;
-    ctx->tt->cur->audio_streams->process_packet = process_packet_iavs_stream;
-    ctx->tt->cur->video_streams->process_packet = process_packet_iavs_stream;
-    ctx->tt->cur->video_streams->first_index_position = 0;
-    ctx->tt->cur->video_streams->last_index_position = ctx->si->num_entries - 2;
-    ctx->tt->cur->audio_streams->first_index_position = 1;
-    ctx->tt->cur->audio_streams->last_index_position = ctx->si->num_entries - 1;
-    }
-
-  if(ctx->si)
-    {
-    ctx->index_mode = INDEX_MODE_SI_SA;
-  
-    for(i = 0; i < ctx->tt->cur->num_audio_streams; i++)
-      {
-      if(check_codec(ctx->tt->cur->audio_streams[i].fourcc, audio_codecs_sa))
-        continue;
-      else if(check_codec(ctx->tt->cur->audio_streams[i].fourcc, audio_codecs_parse_mpeg))
-        {
-        ctx->tt->cur->audio_streams[i].index_mode = INDEX_MODE_SIMPLE;
-        ctx->tt->cur->audio_streams[i].flags |= STREAM_PARSE_FULL;
-        ctx->index_mode = INDEX_MODE_SI_PARSE;
-        continue;
-        }
-      else if(check_codec(ctx->tt->cur->audio_streams[i].fourcc, audio_codecs_parse_simple))
-        {
-        ctx->tt->cur->audio_streams[i].index_mode = INDEX_MODE_SIMPLE;
-        ctx->index_mode = INDEX_MODE_SI_PARSE;
-        continue;
-        }
-      else
-        {
-        ctx->index_mode = 0;
-        break;
-        }
-      }
-    }
-  else /* Index-less */
-    {
-    ctx->index_mode = INDEX_MODE_MIXED;
-
-    for(i = 0; i < ctx->tt->cur->num_video_streams; i++)
-      {
-      avi_vs = ctx->tt->cur->video_streams[i].priv;
-      if(check_codec(ctx->tt->cur->video_streams[i].fourcc,
-                     video_codecs_msmpeg4v1))
-        avi_vs->is_keyframe = is_keyframe_msmpeg4v1;
-      else if(check_codec(ctx->tt->cur->video_streams[i].fourcc,
-                          video_codecs_msmpeg4v3))
-        avi_vs->is_keyframe = is_keyframe_msmpeg4v3;
-      else if(bgav_video_is_divx4(ctx->tt->cur->video_streams[i].fourcc))
-        avi_vs->is_keyframe = is_keyframe_mpeg4;
-      else if(!check_codec(ctx->tt->cur->video_streams[i].fourcc,
-                           video_codecs_intra))
-        ctx->index_mode = 0;
-
-      ctx->tt->cur->video_streams[i].flags |= STREAM_NO_DURATIONS;
-      ctx->tt->cur->video_streams[i].index_mode = INDEX_MODE_SIMPLE;
-      }
-        
-    for(i = 0; i < ctx->tt->cur->num_audio_streams; i++)
-      {
-      if(check_codec(ctx->tt->cur->audio_streams[i].fourcc, audio_codecs_sa))
-        {
-        ctx->tt->cur->audio_streams[i].index_mode = INDEX_MODE_SIMPLE;
-        continue;
-        }
-      else if(check_codec(ctx->tt->cur->audio_streams[i].fourcc, audio_codecs_parse_mpeg))
-        {
-        ctx->tt->cur->audio_streams[i].index_mode = INDEX_MODE_SIMPLE;
-        ctx->tt->cur->audio_streams[i].flags |= STREAM_PARSE_FULL;
-        continue;
-        }
-      else if(check_codec(ctx->tt->cur->audio_streams[i].fourcc, audio_codecs_parse_simple))
-        {
-        ctx->tt->cur->audio_streams[i].index_mode = INDEX_MODE_SIMPLE;
-        ctx->index_mode = INDEX_MODE_SI_PARSE;
-        continue;
-        }
-      else
-        {
-        ctx->index_mode = 0;
-        break;
-        }
-      }
-    }
+  else
+    finish_avi(ctx);
   
   /* Build metadata */
 
@@ -2267,6 +2324,6 @@ const const bgav_demuxer_t bgav_demuxer_avi =
     .next_packet = next_packet_avi,
     .seek =        seek_avi,
     .resync  =     resync_avi,
-    .close =       close_avi
-    
+    .close =       close_avi,
+    .finish_open = finish_avi
   };
@@ -30,6 +30,9 @@
 
 #define LOG_DOMAIN "demux_matroska"
 
+/* Not in matroska.h since we never parse attachments */
+#define MKV_ID_Attachments 0x1941a469
+
 
 typedef struct
   {
@@ -57,11 +60,27 @@ typedef struct
   uint64_t * lace_sizes;
   int lace_sizes_alloc;
 
+  /* Packets of the current block */
+  bgav_stream_t * block_stream;
+  bgav_packet_t ** block_packets;
+  int num_block_packets;
+  int block_packets_alloc;
+
   int do_sync;
   
   int64_t cluster_pos; // Start position of last cluster
   
   bgav_mkv_chapters_t chapters;
+
+  /* Cluster index: Built on the first seek for files without cues */
+  struct
+    {
+    int64_t pos; /* Absolute file position */
+    uint64_t Timecode;
+    } * clusters;
+  int num_clusters;
+  int clusters_alloc;
+  int have_cluster_index;
   
   } mkv_t;
  
@@ -848,8 +867,8 @@ static int open_matroska(bgav_demuxer_context_t * ctx)
                             gavl_seconds_to_time(p->segment_info.Duration * 
                                                  p->segment_info.TimecodeScale * 1.0e-9));
     }
-  /* Set seekable flag */
-  if(p->have_cues && (ctx->input->flags & BGAV_INPUT_CAN_SEEK_BYTE))
+  /* Set seekable flag. Without cues we build a cluster index on demand */
+  if(ctx->input->flags & BGAV_INPUT_CAN_SEEK_BYTE)
     ctx->flags |= BGAV_DEMUXER_CAN_SEEK;
 
   if(!strcmp(p->ebml_header.DocType, "matroska"))
@@ -872,51 +891,65 @@ static int open_matroska(bgav_demuxer_context_t * ctx)
   return 1;
   }
   
-static int get_ebml_frame_size_uint(uint8_t * ptr, int size, int64_t * ret)
+/* Lace sizes are read directly from the input */
+
+static int read_lace_size_uint(bgav_input_context_t * input,
+                               int64_t * ret, int * len)
   {
+  uint8_t c;
   uint8_t mask = 0x80;
-  int len = 1;
+  int bytes = 1;
   int i;
-  while(!(mask & (*ptr)) && mask)
+
+  if(!bgav_input_read_8(input, &c))
+    return 0;
+  
+  while(!(mask & c) && mask)
     {
     mask >>= 1;
-    len++;
+    bytes++;
     }
 
   if(!mask)
     return 0;
   
-  *ret = *ptr & (0xff >> len);
+  *ret = c & (0xff >> bytes);
   
-  ptr++;
-
-  for(i = 1; i < len; i++)
+  for(i = 1; i < bytes; i++)
     {
+    if(!bgav_input_read_8(input, &c))
+      return 0;
     *ret <<= 8;
-    *ret |= *ptr;
-    ptr++;
+    *ret |= c;
     }
-  return len;
+  *len += bytes;
+  return bytes;
   }
 
-static int get_ebml_frame_size_int(uint8_t * ptr1, int size, int64_t * ret)
+static int read_lace_size_int(bgav_input_context_t * input,
+                              int64_t * ret, int * len)
   {
-  int64_t offset;
-  int bytes = get_ebml_frame_size_uint(ptr1, size, ret);
+  int bytes = read_lace_size_uint(input, ret, len);
 
-  offset = (1 << (bytes * 7 - 1)) - 1;
+  if(!bytes)
+    return 0;
   
-  *ret -= offset;
+  *ret -= ((int64_t)1 << (bytes * 7 - 1)) - 1;
   return bytes;
   }
 
-static void set_packet_data(bgav_stream_t * s,
+/* Read the payload of one frame into the packet */
+
+static int read_packet_data(bgav_demuxer_context_t * ctx,
+                            bgav_stream_t * s,
                             bgav_packet_t * p,
-                            const uint8_t * data,
+                            bgav_mkv_block_t * b,
                             int len)
   {
   bgav_mkv_track_t * t = s->priv;
 
+  p->data_size = 0;
+  
   if(t->num_encodings == 1)
     {
     if((t->encodings[0].ContentEncodingType == MKV_CONTENT_ENCODING_COMPRESSION) &&
@@ -927,12 +960,21 @@ static void set_packet_data(bgav_stream_t * s,
       /* zlib decompression (probably the dumbest possible routine,
          but it seems that this is used just for subtitles) */
 
+      /* The block buffer holds the compressed data */
+      if(b->data_alloc < len)
+        {
+        b->data_alloc = len + 1024;
+        b->data = realloc(b->data, b->data_alloc);
+        }
+      if(bgav_input_read_data(ctx->input, b->data, len) < len)
+        return 0;
+      
       bgav_packet_alloc(p, len * 5); // Optimistically assume 1:5 ratio
     
       while(1)
         {
         out_len = p->data_alloc;
-        err = uncompress(p->data, &out_len, data, len);
+        err = uncompress(p->data, &out_len, b->data, len);
 
         if(err == Z_OK)
           {
@@ -950,25 +992,36 @@ static void set_packet_data(bgav_stream_t * s,
           break;
           }
         }
+      return 1;
       }
     else if((t->encodings[0].ContentEncodingType == MKV_CONTENT_ENCODING_COMPRESSION) &&
             (t->encodings[0].ContentCompression.ContentCompAlgo == MKV_CONTENT_COMP_ALGO_HEADER_STRIPPING))
       {
-      bgav_packet_alloc(p, len + t->encodings[0].ContentCompression.ContentCompSettingsLen);
+      int hdr_len = t->encodings[0].ContentCompression.ContentCompSettingsLen;
+      
+      bgav_packet_alloc(p, len + hdr_len);
       memcpy(p->data,
              t->encodings[0].ContentCompression.ContentCompSettings,
-             t->encodings[0].ContentCompression.ContentCompSettingsLen);
-      memcpy(p->data + t->encodings[0].ContentCompression.ContentCompSettingsLen, data, len);
-      p->data_size = t->encodings[0].ContentCompression.ContentCompSettingsLen + len;
+             hdr_len);
+      if(bgav_input_read_data(ctx->input, p->data + hdr_len, len) < len)
+        return 0;
+      p->data_size = hdr_len + len;
+      return 1;
       }
     }
   else if(t->num_encodings == 0)
     {
     /* Plain packet */
     bgav_packet_alloc(p, len);
-    memcpy(p->data, data, len);
+    if(bgav_input_read_data(ctx->input, p->data, len) < len)
+      return 0;
     p->data_size = len;
+    return 1;
     }
+
+  /* Unsupported encoding */
+  bgav_input_skip(ctx->input, len);
+  return 1;
   }
 
 static void setup_packet(mkv_t * m, bgav_stream_t * s,
@@ -1015,178 +1068,91 @@ static void setup_packet(mkv_t * m, bgav_stream_t * s,
   //  fprintf(stderr, "setup_packet 1: %"PRId64"\n", p->pts);
   }
 
+/* Return packets of an incomplete block to the pool */
 
-static int process_block(bgav_demuxer_context_t * ctx,
-                         bgav_mkv_block_t * b,
-                         bgav_mkv_block_group_t * bg)
+static void discard_block_packets(mkv_t * m)
   {
-  int keyframe = 0;
+  int i;
+  for(i = 0; i < m->num_block_packets; i++)
+    bgav_stream_done_packet_read(m->block_stream, m->block_packets[i]);
+  m->num_block_packets = 0;
+  m->block_stream = NULL;
+  }
+
+/*
+ *  Read the payload of a block directly into the packets.
+ *  Called with the input at the start of the payload. Payloads of
+ *  unused tracks are skipped.
+ */
+
+static int read_block(void * priv, bgav_mkv_block_t * b)
+  {
+  int i;
+  int len = 0; /* Bytes of lace headers */
+  int64_t size;
+  int64_t size_diff;
+  int num_laces;
   bgav_stream_t * s;
   bgav_packet_t * p;
+  bgav_demuxer_context_t * ctx = priv;
   mkv_t * m = ctx->priv;
-  int64_t pts = b->timecode + m->cluster.Timecode - m->pts_offset;
 
-  
-  
-  //  if(pts > (1<<30))
-  //  fprintf(stderr, "b->timecode: %d, m->cluster.Timecode: %"PRId64", m->pts_offset: %"PRId64"\n",
-  //          b->timecode, m->cluster.Timecode, m->pts_offset);
+  m->num_block_packets = 0;
+  m->block_stream = NULL;
   
   s = bgav_track_find_stream(ctx, b->track);
   if(!s)
-    return 1;
-  
-  if(bg)
     {
-    if(!bg->num_reference_blocks)
-      keyframe = 1;
+    bgav_input_skip(ctx->input, b->data_size);
+    return 1;
     }
-  else if(b->flags & MKV_KEYFRAME)
+
+  num_laces = ((b->flags & MKV_LACING_MASK) == MKV_LACING_NONE) ? 1 : b->num_laces;
+  
+  if(m->lace_sizes_alloc < num_laces)
     {
-    keyframe = 1;
+    m->lace_sizes_alloc = num_laces + 16;
+    m->lace_sizes = realloc(m->lace_sizes,
+                            m->lace_sizes_alloc *
+                            sizeof(*m->lace_sizes));
     }
   
-  //  if(s->type == GAVF_STREAM_AUDIO)
-  //    fprintf(stderr, "Audio stream\n");
-  
   switch(b->flags & MKV_LACING_MASK)
     {
     case MKV_LACING_NONE:
-      p = bgav_stream_get_packet_write(s);
-      p->data_size = 0;
-      set_packet_data(s, p, b->data, b->data_size);
-      setup_packet(m, s, p, pts, keyframe, 0);
-
-      if(s->type == GAVF_STREAM_TEXT)
-        {
-        if(bg && bg->BlockDuration)
-          p->duration = bg->BlockDuration;
-        }
-      
-      bgav_stream_done_packet_write(s, p);
+      m->lace_sizes[0] = b->data_size;
       break;
     case MKV_LACING_EBML:
-      {
-      int i;
-      uint8_t * ptr;
-      int bytes;
-      int64_t frame_size;
-      int64_t frame_size_diff = 0;
-      
-      //      fprintf(stderr, "MKV_LACING_EBML\n");
-      //      gavl_hexdump(ptr, 32, 16);
-
-      if(m->lace_sizes_alloc < b->num_laces)
-        {
-        m->lace_sizes_alloc = b->num_laces + 16;
-        m->lace_sizes = realloc(m->lace_sizes,
-                                m->lace_sizes_alloc *
-                                sizeof(*m->lace_sizes));
-        }
       /* First lace */
-      ptr = b->data;
-      
-      bytes = get_ebml_frame_size_uint(ptr,
-                                       b->data_size - (ptr - b->data),
-                                       &frame_size);
-      if(!bytes)
+      if(!read_lace_size_uint(ctx->input, &size, &len))
         return 0;
-      
-      m->lace_sizes[0] = frame_size;
-      ptr += bytes;
+      m->lace_sizes[0] = size;
       
       /* Intermediate laces */
-      for(i = 1; i < b->num_laces-1; i++)
-        {
-        bytes = get_ebml_frame_size_int(ptr,
-                                        b->data_size - (ptr - b->data),
-                                        &frame_size_diff);
-        ptr += bytes;
-        frame_size += frame_size_diff;
-        m->lace_sizes[i] = frame_size;
-        }
-      /* Last lace */
-      m->lace_sizes[b->num_laces-1] =
-        b->data_size - (ptr - b->data);
-      for(i = 0; i < b->num_laces-1; i++)
-        m->lace_sizes[b->num_laces-1] -= m->lace_sizes[i];
-
-      /* Send all laces as different packets */
-      for(i = 0; i < b->num_laces; i++)
+      for(i = 1; i < num_laces-1; i++)
         {
-        p = bgav_stream_get_packet_write(s);
-        p->data_size = 0;
-        set_packet_data(s, p, ptr, m->lace_sizes[i]);
-        ptr += m->lace_sizes[i];
-        setup_packet(m, s, p, pts, keyframe, i);
-        bgav_stream_done_packet_write(s, p);
+        if(!read_lace_size_int(ctx->input, &size_diff, &len))
+          return 0;
+        size += size_diff;
+        m->lace_sizes[i] = size;
         }
-      
-      }
       break;
     case MKV_LACING_XIPH:
-      {
-      uint8_t * ptr;
-      int i;
-      if(m->lace_sizes_alloc < b->num_laces)
-        {
-        m->lace_sizes_alloc = b->num_laces + 16;
-        m->lace_sizes = realloc(m->lace_sizes,
-                                m->lace_sizes_alloc *
-                                sizeof(*m->lace_sizes));
-        }
-      
-      ptr = b->data;
-      for(i = 0; i < b->num_laces-1; i++)
+      for(i = 0; i < num_laces-1; i++)
         {
+        uint8_t c;
         m->lace_sizes[i] = 0;
-        while(*ptr == 255)
-          {
-          m->lace_sizes[i] += *ptr;
-          ptr++;
-          }
-        m->lace_sizes[i] += *ptr;
-        ptr++;
-        }
-      /* Last lace */
-      m->lace_sizes[b->num_laces-1] =
-        b->data_size - (ptr - b->data);
-      for(i = 0; i < b->num_laces-1; i++)
-        m->lace_sizes[b->num_laces-1] -= m->lace_sizes[i];
-
-      /* Send all laces as different packets */
-      for(i = 0; i < b->num_laces; i++)
-        {
-        p = bgav_stream_get_packet_write(s);
-        p->data_size = 0;
-        set_packet_data(s, p, ptr, m->lace_sizes[i]);
-        ptr += m->lace_sizes[i];
-        setup_packet(m, s, p, pts, keyframe, i);
-        bgav_stream_done_packet_write(s, p);
+        do{
+          if(!bgav_input_read_8(ctx->input, &c))
+            return 0;
+          m->lace_sizes[i] += c;
+          len++;
+          } while(c == 255);
         }
-      
-      // bgav_input_skip_dump(ctx->input, b->data_size);
-      //      return 0;
-      }
       break;
     case MKV_LACING_FIXED:
-      {
-      int i;
-      uint8_t * ptr;
-      int frame_size = b->data_size / b->num_laces;
-
-      ptr = b->data;
-      
-      for(i = 0; i < b->num_laces; i++)
-        {
-        p = bgav_stream_get_packet_write(s);
-        p->data_size = 0;
-        set_packet_data(s, p, ptr, frame_size);
-        ptr += frame_size;
-        setup_packet(m, s, p, pts, keyframe, i);
-        bgav_stream_done_packet_write(s, p);
-        }
-      }
+      for(i = 0; i < num_laces; i++)
+        m->lace_sizes[i] = b->data_size / num_laces;
       break;
     default:
       fprintf(stderr, "Unknown lacing type\n");
@@ -1195,9 +1161,93 @@ static int process_block(bgav_demuxer_context_t * ctx,
       return 0;
       break;
     }
+
+  /* Last lace */
+  if(((b->flags & MKV_LACING_MASK) == MKV_LACING_EBML) ||
+     ((b->flags & MKV_LACING_MASK) == MKV_LACING_XIPH))
+    {
+    size = b->data_size - len;
+    for(i = 0; i < num_laces-1; i++)
+      size -= m->lace_sizes[i];
+    if(size < 0)
+      return 0;
+    m->lace_sizes[num_laces-1] = size;
+    }
+  
+  if(m->block_packets_alloc < num_laces)
+    {
+    m->block_packets_alloc = num_laces + 16;
+    m->block_packets = realloc(m->block_packets,
+                               m->block_packets_alloc *
+                               sizeof(*m->block_packets));
+    }
+
+  m->block_stream = s;
+  
+  /* Each lace goes into it's own packet */
+  for(i = 0; i < num_laces; i++)
+    {
+    p = bgav_stream_get_packet_write(s);
+    m->block_packets[m->num_block_packets++] = p;
+    
+    if(!read_packet_data(ctx, s, p, b, m->lace_sizes[i]))
+      {
+      discard_block_packets(m);
+      return 0;
+      }
+    }
   return 1;
   }
 
+/* Send the packets of a block. For block groups, this is
+   called after the whole group is read because we need the
+   reference blocks and the duration */
+
+static void process_block(bgav_demuxer_context_t * ctx,
+                          bgav_mkv_block_t * b,
+                          bgav_mkv_block_group_t * bg)
+  {
+  int i;
+  int keyframe = 0;
+  bgav_packet_t * p;
+  mkv_t * m = ctx->priv;
+  bgav_stream_t * s = m->block_stream;
+  int64_t pts = b->timecode + m->cluster.Timecode - m->pts_offset;
+
+  //  if(pts > (1<<30))
+  //  fprintf(stderr, "b->timecode: %d, m->cluster.Timecode: %"PRId64", m->pts_offset: %"PRId64"\n",
+  //          b->timecode, m->cluster.Timecode, m->pts_offset);
+
+  if(!s)
+    return;
+  
+  if(bg)
+    {
+    if(!bg->num_reference_blocks)
+      keyframe = 1;
+    }
+  else if(b->flags & MKV_KEYFRAME)
+    {
+    keyframe = 1;
+    }
+  
+  for(i = 0; i < m->num_block_packets; i++)
+    {
+    p = m->block_packets[i];
+    setup_packet(m, s, p, pts, keyframe, i);
+
+    if((s->type == GAVF_STREAM_TEXT) &&
+       ((b->flags & MKV_LACING_MASK) == MKV_LACING_NONE))
+      {
+      if(bg && bg->BlockDuration)
+        p->duration = bg->BlockDuration;
+      }
+    bgav_stream_done_packet_write(s, p);
+    }
+  m->num_block_packets = 0;
+  m->block_stream = NULL;
+  }
+
 /* next packet */
 
 static int next_packet_matroska(bgav_demuxer_context_t * ctx)
@@ -1234,25 +1284,24 @@ static int next_packet_matroska(bgav_demuxer_context_t * ctx)
         priv->cluster_pos = pos;
         break;
       case MKV_ID_BlockGroup:
-        if(!bgav_mkv_block_group_read(ctx->input, &priv->bg, &e))
+        if(!bgav_mkv_block_group_read(ctx->input, &priv->bg, &e,
+                                      read_block, ctx))
           {
           //          fprintf(stderr, "bgav_mkv_block_group_read\n");
+          discard_block_packets(priv);
           return 0;
           }
         
         //        fprintf(stderr, "Got Block group\n");
         //        bgav_mkv_block_group_dump(&priv->bg);
         
-        if(!process_block(ctx, &priv->bg.block, &priv->bg))
-          {
-          //          fprintf(stderr, "process_block failed\n");
-          return 0;
-          }
+        process_block(ctx, &priv->bg.block, &priv->bg);
         num_blocks++;
         break;
       case MKV_ID_Block:
       case MKV_ID_SimpleBlock:
-        if(!bgav_mkv_block_read(ctx->input, &priv->bg.block, &e))
+        if(!bgav_mkv_block_read_header(ctx->input, &priv->bg.block, &e) ||
+           !read_block(ctx, &priv->bg.block))
           {
           //          fprintf(stderr, "bgav_mkv_block_read failed\n");
           return 0;
@@ -1260,11 +1309,7 @@ static int next_packet_matroska(bgav_demuxer_context_t * ctx)
         //        fprintf(stderr, "Got Block\n");
         //        bgav_mkv_block_dump(0, &priv->bg.block);
         
-        if(!process_block(ctx, &priv->bg.block, NULL))
-          {
-          //          fprintf(stderr, "process_block failed\n");
-          return 0;
-          }
+        process_block(ctx, &priv->bg.block, NULL);
         num_blocks++;
         break;
       default:
@@ -1311,38 +1356,221 @@ static void close_matroska(bgav_demuxer_context_t * ctx)
   
   if(priv->lace_sizes)
     free(priv->lace_sizes);
+  if(priv->block_packets)
+    free(priv->block_packets);
+
+  if(priv->clusters)
+    free(priv->clusters);
   
   free(priv);
   }
 
+/* Cluster index */
+
+static int is_toplevel_id(int id)
+  {
+  switch(id)
+    {
+    case MKV_ID_Cluster:
+    case MKV_ID_Cues:
+    case MKV_ID_Tags:
+    case MKV_ID_Chapters:
+    case MKV_ID_SeekHead:
+    case MKV_ID_Info:
+    case MKV_ID_Tracks:
+    case MKV_ID_Attachments:
+      return 1;
+    }
+  return 0;
+  }
+
+/* Skip the children of a cluster with unknown size until the
+   next toplevel element */
+
+static int skip_unknown_size(bgav_input_context_t * input)
+  {
+  bgav_mkv_element_t e;
+  int64_t pos;
+  
+  while(1)
+    {
+    pos = input->position;
+
+    if(!bgav_mkv_element_read(input, &e))
+      return 0;
+
+    if(is_toplevel_id(e.id))
+      {
+      bgav_input_seek(input, pos, SEEK_SET);
+      return 1;
+      }
+    if(e.unknown_size)
+      return 0;
+    
+    bgav_input_seek(input, e.end, SEEK_SET);
+    }
+  return 0;
+  }
+
+/*
+ *  Scan the segment for clusters. We read only the cluster headers
+ *  (up to the first block) and skip the rest using the EBML size.
+ */
+
+static void build_cluster_index(bgav_demuxer_context_t * ctx)
+  {
+  bgav_mkv_element_t e;
+  bgav_mkv_cluster_t cluster;
+  int64_t pos;
+  int64_t old_pos;
+  mkv_t * priv = ctx->priv;
+
+  priv->have_cluster_index = 1;
+  old_pos = ctx->input->position;
+  
+  bgav_input_seek(ctx->input, ctx->data_start, SEEK_SET);
+  
+  while(1)
+    {
+    pos = ctx->input->position;
+
+    if((ctx->input->total_bytes > 0) &&
+       (pos >= ctx->input->total_bytes))
+      break;
+    
+    if(!bgav_mkv_element_read(ctx->input, &e))
+      break;
+    
+    if(e.id == MKV_ID_Cluster)
+      {
+      memset(&cluster, 0, sizeof(cluster));
+      
+      if(!bgav_mkv_cluster_read(ctx->input, &cluster, &e))
+        break;
+      
+      if(priv->num_clusters + 1 > priv->clusters_alloc)
+        {
+        priv->clusters_alloc += 1024;
+        priv->clusters = realloc(priv->clusters,
+                                 priv->clusters_alloc *
+                                 sizeof(*priv->clusters));
+        }
+      priv->clusters[priv->num_clusters].pos      = pos;
+      priv->clusters[priv->num_clusters].Timecode = cluster.Timecode;
+      priv->num_clusters++;
+      bgav_mkv_cluster_free(&cluster);
+      }
+    else if(!is_toplevel_id(e.id))
+      break;
+    
+    if(e.unknown_size)
+      {
+      if((e.id != MKV_ID_Cluster) || !skip_unknown_size(ctx->input))
+        break;
+      }
+    else
+      bgav_input_seek(ctx->input, e.end, SEEK_SET);
+    }
+
+  bgav_log(ctx->opt, BGAV_LOG_DEBUG, LOG_DOMAIN,
+           "Built cluster index with %d entries", priv->num_clusters);
+  
+  bgav_input_seek(ctx->input, old_pos, SEEK_SET);
+  }
+
+/* Binary search for the last cue point at or before time */
+
+static int find_cue_point(const bgav_mkv_cues_t * cues, uint64_t time)
+  {
+  int lo = 0, hi = cues->num_points - 1, mid;
+
+  if(cues->points[0].CueTime > time)
+    return 0;
+  
+  while(lo < hi)
+    {
+    mid = (lo + hi + 1) / 2;
+    if(cues->points[mid].CueTime <= time)
+      lo = mid;
+    else
+      hi = mid - 1;
+    }
+  return lo;
+  }
+
+static int find_cluster(const mkv_t * priv, uint64_t time)
+  {
+  int lo = 0, hi = priv->num_clusters - 1, mid;
+
+  if(priv->clusters[0].Timecode > time)
+    return 0;
+  
+  while(lo < hi)
+    {
+    mid = (lo + hi + 1) / 2;
+    if(priv->clusters[mid].Timecode <= time)
+      lo = mid;
+    else
+      hi = mid - 1;
+    }
+  return lo;
+  }
+
 static void
 seek_matroska(bgav_demuxer_context_t * ctx, int64_t time, int scale)
   {
   int64_t time_scaled;
+  int64_t pos;
   int i;
   mkv_t * priv = ctx->priv;
   
   time_scaled = gavl_time_rescale(scale,
                                   priv->segment_info.TimecodeScale/1000, time);
 
-  for(i = priv->cues.num_points - 1; i >= 0; i--)
+  /* Cue and cluster times are absolute */
+  if(priv->pts_offset != GAVL_TIME_UNDEFINED)
+    time_scaled += priv->pts_offset;
+  if(time_scaled < 0)
+    time_scaled = 0;
+  
+  if(priv->have_cues && priv->cues.num_points)
+    {
+    i = find_cue_point(&priv->cues, time_scaled);
+
+    /* Cue points without track positions are useless */
+    while((i > 0) && !priv->cues.points[i].num_tracks)
+      i--;
+    }
+  else
+    i = -1;
+  
+  if((i >= 0) && priv->cues.points[i].num_tracks)
     {
-    if(priv->cues.points[i].CueTime <= time_scaled)
-      break;
+    pos = priv->cues.points[i].tracks[0].CueClusterPosition +
+      priv->segment_start;
+    }
+  else
+    {
+    if(!priv->have_cluster_index)
+      build_cluster_index(ctx);
+
+    if(priv->num_clusters)
+      pos = priv->clusters[find_cluster(priv, time_scaled)].pos;
+    else
+      pos = ctx->data_start;
     }
-  if(i < 0)
-    i = 0;
   
-  bgav_input_seek(ctx->input,
-                  priv->cues.points[i].tracks[0].CueClusterPosition +
-                  priv->segment_start, SEEK_SET);
+  bgav_input_seek(ctx->input, pos, SEEK_SET);
 
   /* Resync */
 
   priv->do_sync = 1;
   
   while(!bgav_track_has_sync(ctx->tt->cur))
-    next_packet_matroska(ctx);
+    {
+    if(!next_packet_matroska(ctx))
+      break;
+    }
 
   priv->do_sync = 0;
   }
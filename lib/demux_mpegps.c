@@ -1132,10 +1132,10 @@ static int open_mpegps(bgav_demuxer_context_t * ctx)
  
   if(((ctx->input->flags & BGAV_INPUT_CAN_SEEK_BYTE) && priv->have_pts) ||
      (ctx->input->input->seek_sector) ||
-     (ctx->input->input->seek_time))
+     (ctx->input->flags & BGAV_INPUT_CAN_SEEK_TIME))
     ctx->flags |= BGAV_DEMUXER_CAN_SEEK;
   
-  if(!ctx->input->input->seek_time)
+  if(!(ctx->input->flags & BGAV_INPUT_CAN_SEEK_TIME))
     ctx->flags |= BGAV_DEMUXER_SEEK_ITERATIVE;
 
   /* Set the not_aligned flags for all streams */
@@ -1262,9 +1262,9 @@ static void seek_mpegps(bgav_demuxer_context_t * ctx, int64_t time, int scale)
     }
 
   
-  if(ctx->input->input->seek_time)
+  if(ctx->input->flags & BGAV_INPUT_CAN_SEEK_TIME)
     {
-    ctx->input->input->seek_time(ctx->input, time, scale);
+    bgav_input_seek_time(ctx->input, time, scale);
     do_sync(ctx);
     }
   else if(priv->sector_size)
@@ -100,6 +100,7 @@ typedef struct
   int64_t last_pts;
   int64_t pts_offset;
   int64_t pts_offset_2nd;
+  int program; /* Index of the program (multiplex track only) */
   } stream_priv_t;
 
 typedef struct
@@ -121,6 +122,10 @@ typedef struct
   pmt_section_t pmts;
   
   stream_priv_t * streams;
+
+  /* Timestamp offset for the multiplex track */
+  int64_t timestamp_offset;
+  int have_offset;
   } program_priv_t;
 
 static void init_streams_priv(program_priv_t * program,
@@ -219,6 +224,15 @@ typedef struct
   int64_t first_packet_pos;
 
   int current_program;
+
+  /*
+   *  Optional track with the streams of all programs. It lets one pass
+   *  over the input deliver packets of several programs. Each program
+   *  keeps its own timestamp offset.
+   */
+  
+  int multiplex_track; /* -1 if none */
+  stream_priv_t * multiplex_streams;
   
   transport_packet_t packet;
 
@@ -513,6 +527,8 @@ static int get_program_durations(bgav_demuxer_context_t * ctx)
   int program_index = -1;
   int64_t total_packets;
   int64_t position;
+  gavl_time_t duration;
+  gavl_time_t max_duration = 0;
   
   priv = ctx->priv;
   
@@ -628,17 +644,84 @@ static int get_program_durations(bgav_demuxer_context_t * ctx)
     if(priv->programs[i].initialized)
       {
       if(priv->programs[i].end_pcr > priv->programs[i].start_pcr)
-        gavl_track_set_duration(ctx->tt->tracks[i].info,
-                                gavl_time_unscale(90000,
-                                                  priv->programs[i].end_pcr -
-                                                  priv->programs[i].start_pcr));
+        {
+        duration = gavl_time_unscale(90000,
+                                     priv->programs[i].end_pcr -
+                                     priv->programs[i].start_pcr);
+        gavl_track_set_duration(ctx->tt->tracks[i].info, duration);
+
+        if(duration > max_duration)
+          max_duration = duration;
+        }
       else
         return 0;
       }
     }
+
+  if(priv->multiplex_track >= 0)
+    gavl_track_set_duration(ctx->tt->tracks[priv->multiplex_track].info,
+                            max_duration);
   return 1;
   }
 
+static int find_program(mpegts_t * priv, int pid)
+  {
+  int i, j;
+  for(i = 0; i < priv->num_programs; i++)
+    {
+    for(j = 0; j < priv->programs[i].pmts.num_streams; j++)
+      {
+      if(priv->programs[i].pmts.streams[j].pid == pid)
+        return i;
+      }
+    }
+  return 0;
+  }
+
+/* Set up the track with the streams of all programs */
+
+static void init_multiplex(bgav_demuxer_context_t * ctx)
+  {
+  int i, index;
+  bgav_track_t * track;
+  mpegts_t * priv = ctx->priv;
+
+  track = &ctx->tt->tracks[priv->multiplex_track];
+
+  for(i = 0; i < priv->num_programs; i++)
+    {
+    if(priv->programs[i].initialized)
+      bgav_pmt_section_setup_track(&priv->programs[i].pmts,
+                                   track, ctx->opt, -1, -1, -1, NULL, NULL);
+    }
+
+  priv->multiplex_streams =
+    calloc(track->num_audio_streams + track->num_video_streams,
+           sizeof(*priv->multiplex_streams));
+  index = 0;
+
+  for(i = 0; i < track->num_audio_streams; i++)
+    {
+    priv->multiplex_streams[index].last_pts = BGAV_TIMESTAMP_UNDEFINED;
+    priv->multiplex_streams[index].program =
+      find_program(priv, track->audio_streams[i].stream_id);
+    track->audio_streams[i].priv = &priv->multiplex_streams[index];
+    index++;
+    }
+  for(i = 0; i < track->num_video_streams; i++)
+    {
+    priv->multiplex_streams[index].last_pts = BGAV_TIMESTAMP_UNDEFINED;
+    priv->multiplex_streams[index].program =
+      find_program(priv, track->video_streams[i].stream_id);
+    track->video_streams[i].priv = &priv->multiplex_streams[index];
+    index++;
+    }
+  
+  gavl_dictionary_set_string(track->metadata, GAVL_META_LABEL, "All programs");
+  gavl_dictionary_set_string(track->metadata, GAVL_META_FORMAT, "MPEGTS");
+  gavl_dictionary_set_string(track->metadata, GAVL_META_MIMETYPE, "video/MP2T");
+  }
+
 /*
  *  Initialize using a PAT and PMTs
  *  This function expects a PAT table at the beginning
@@ -690,7 +773,14 @@ static int init_psi(bgav_demuxer_context_t * ctx,
   /* Allocate programs and track table */
   
   priv->programs = calloc(priv->num_programs, sizeof(*(priv->programs)));
-  ctx->tt = bgav_track_table_create(priv->num_programs);
+
+  if(ctx->opt->mpegts_multiplex && (priv->num_programs > 1))
+    {
+    priv->multiplex_track = priv->num_programs;
+    ctx->tt = bgav_track_table_create(priv->num_programs + 1);
+    }
+  else
+    ctx->tt = bgav_track_table_create(priv->num_programs);
   
   /* Assign program map pids */
 
@@ -814,6 +904,10 @@ static int init_psi(bgav_demuxer_context_t * ctx,
 #endif
       }
     }
+
+  if(priv->multiplex_track >= 0)
+    init_multiplex(ctx);
+  
   return 1;
   }
 
@@ -1090,6 +1184,7 @@ static int open_mpegts(bgav_demuxer_context_t * ctx)
   
   priv = calloc(1, sizeof(*priv));
   ctx->priv = priv;
+  priv->multiplex_track = -1;
 
   priv->packet_size = guess_packet_size(ctx->input);
 
@@ -1218,6 +1313,12 @@ static int open_mpegts(bgav_demuxer_context_t * ctx)
       }
 
     }
+  else if(ctx->input->flags & BGAV_INPUT_CAN_SEEK_TIME)
+    {
+    /* Input seeks to a position near the target (e.g. HLS segment),
+       we resync from there */
+    ctx->flags |= BGAV_DEMUXER_CAN_SEEK;
+    }
 
   gavl_dictionary_set_string(ctx->tt->cur->metadata, 
                     GAVL_META_FORMAT, "MPEGTS");
@@ -1474,11 +1575,46 @@ static void predict_pcr_wrap(const bgav_options_t * opt, int64_t pcr)
   }
 #endif
 
+/*
+ *  Multiplex track: Get the timestamp offsets of the programs from
+ *  their first PCRs. Return 0 if the packet must be skipped (PAT/PMTs)
+ */
+
+static int check_multiplex_packet(mpegts_t * priv)
+  {
+  int i;
+  
+  if(priv->packet.adaption_field.pcr >= 0)
+    {
+    for(i = 0; i < priv->num_programs; i++)
+      {
+      if(!priv->programs[i].have_offset &&
+         (priv->programs[i].pcr_pid == priv->packet.pid))
+        {
+        priv->programs[i].timestamp_offset =
+          -priv->packet.adaption_field.pcr;
+        priv->programs[i].have_offset = 1;
+        }
+      }
+    }
+
+  if(!priv->packet.pid)
+    return 0;
+  
+  for(i = 0; i < priv->num_programs; i++)
+    {
+    if(priv->packet.pid == priv->programs[i].program_map_pid)
+      return 0;
+    }
+  return 1;
+  }
+
 #define NUM_PACKETS 5 /* Packets to be processed at once */
 
 static int process_packet(bgav_demuxer_context_t * ctx)
   {
   int i;
+  int64_t timestamp_offset;
   bgav_stream_t * s;
   mpegts_t * priv;
   int num_packets;
@@ -1522,41 +1658,54 @@ static int process_packet(bgav_demuxer_context_t * ctx)
       }
     
     
-#if 1
-    //    bgav_transport_packet_dump(&priv->packet);
-        
-    if(!(ctx->flags & BGAV_DEMUXER_HAS_TIMESTAMP_OFFSET) &&
-       (priv->programs[priv->current_program].pcr_pid > 0))
+    if(priv->current_program == priv->multiplex_track)
       {
-      if(priv->packet.adaption_field.pcr < 0)
+      if(!check_multiplex_packet(priv))
         {
         next_packet(priv);
         position += priv->packet_size;
         continue;
         }
-      else if(priv->packet.pid !=
-              priv->programs[priv->current_program].pcr_pid)
+      }
+    else
+      {
+#if 1
+      //    bgav_transport_packet_dump(&priv->packet);
+        
+      if(!(ctx->flags & BGAV_DEMUXER_HAS_TIMESTAMP_OFFSET) &&
+         (priv->programs[priv->current_program].pcr_pid > 0))
+        {
+        if(priv->packet.adaption_field.pcr < 0)
+          {
+          next_packet(priv);
+          position += priv->packet_size;
+          continue;
+          }
+        else if(priv->packet.pid !=
+                priv->programs[priv->current_program].pcr_pid)
+          {
+          next_packet(priv);
+          position += priv->packet_size;
+          continue;
+          }
+        else
+          {
+          ctx->flags |= BGAV_DEMUXER_HAS_TIMESTAMP_OFFSET;
+          ctx->timestamp_offset = -priv->packet.adaption_field.pcr;
+          //        predict_pcr_wrap(priv->packet.adaption_field.pcr);
+          }
+        }
+#endif
+      /* Skip PAT/PMT */
+      if(!priv->packet.pid ||
+         (priv->packet.pid == priv->programs[priv->current_program].program_map_pid))
         {
         next_packet(priv);
         position += priv->packet_size;
         continue;
         }
-      else
-        {
-        ctx->flags |= BGAV_DEMUXER_HAS_TIMESTAMP_OFFSET;
-        ctx->timestamp_offset = -priv->packet.adaption_field.pcr;
-        //        predict_pcr_wrap(priv->packet.adaption_field.pcr);
-        }
-      }
-#endif
-    /* Skip PAT/PMT */
-    if(!priv->packet.pid ||
-       (priv->packet.pid == priv->programs[priv->current_program].program_map_pid))
-      {
-      next_packet(priv);
-      position += priv->packet_size;
-      continue;
       }
+    
 #if 0
     if(priv->packet.pid == priv->programs[priv->current_program].aaux_pid)
       {
@@ -1644,20 +1793,42 @@ static int process_packet(bgav_demuxer_context_t * ctx)
 
       /* Get start pts */
 
-#if 1
-      if(!(ctx->flags & BGAV_DEMUXER_HAS_TIMESTAMP_OFFSET) &&
-         (priv->programs[priv->current_program].pcr_pid <= 0))
+      if(priv->current_program == priv->multiplex_track)
         {
-        if(pes_header.pts < 0)
+        program_priv_t * prog =
+          &priv->programs[((stream_priv_t*)s->priv)->program];
+
+        if(!prog->have_offset)
           {
-          next_packet(priv);
-          position += priv->packet_size;
-          continue;
+          /* Wait for the PCR */
+          if((prog->pcr_pid > 0) || (pes_header.pts < 0))
+            {
+            next_packet(priv);
+            position += priv->packet_size;
+            continue;
+            }
+          prog->timestamp_offset = -pes_header.pts;
+          prog->have_offset = 1;
           }
-        ctx->timestamp_offset = -pes_header.pts;
-        ctx->flags |= BGAV_DEMUXER_HAS_TIMESTAMP_OFFSET;
+        timestamp_offset = prog->timestamp_offset;
         }
-#endif
+      else
+        {
+        if(!(ctx->flags & BGAV_DEMUXER_HAS_TIMESTAMP_OFFSET) &&
+           (priv->programs[priv->current_program].pcr_pid <= 0))
+          {
+          if(pes_header.pts < 0)
+            {
+            next_packet(priv);
+            position += priv->packet_size;
+            continue;
+            }
+          ctx->timestamp_offset = -pes_header.pts;
+          ctx->flags |= BGAV_DEMUXER_HAS_TIMESTAMP_OFFSET;
+          }
+        timestamp_offset = ctx->timestamp_offset;
+        }
+      
       if(!s->packet)
         {
         if(priv->do_sync)
@@ -1675,7 +1846,7 @@ static int process_packet(bgav_demuxer_context_t * ctx)
             }
           else
             {
-            STREAM_SET_SYNC(s, pes_header.pts + ctx->timestamp_offset);
+            STREAM_SET_SYNC(s, pes_header.pts + timestamp_offset);
             s->packet = bgav_stream_get_packet_write(s);
             s->packet->position = position;
             }
@@ -1712,7 +1883,7 @@ static int process_packet(bgav_demuxer_context_t * ctx)
         {
         s->packet->pts = pes_header.pts;
         check_pts_wrap(s, &s->packet->pts);
-        s->packet->pts += ctx->timestamp_offset;
+        s->packet->pts += timestamp_offset;
         }
       }
     else if(s->packet)
@@ -1796,6 +1967,12 @@ static void seek_mpegts(bgav_demuxer_context_t * ctx, int64_t time, int scale)
   duration = gavl_track_get_duration(ctx->tt->cur->info);
   
   reset_streams_priv(ctx->tt->cur);
+
+  if(!(ctx->input->flags & BGAV_INPUT_CAN_SEEK_BYTE))
+    {
+    bgav_input_seek_time(ctx->input, time, scale);
+    goto resync;
+    }
   
   total_packets =
     (ctx->input->total_bytes - priv->first_packet_pos) / priv->packet_size;
@@ -1814,6 +1991,8 @@ static void seek_mpegts(bgav_demuxer_context_t * ctx, int64_t time, int scale)
   
   bgav_input_seek(ctx->input, position, SEEK_SET);
 
+  resync:
+  
   priv->do_sync = 1;
   while(!bgav_track_has_sync(ctx->tt->cur))
     {
@@ -1839,6 +2018,8 @@ static void close_mpegts(bgav_demuxer_context_t * ctx)
     }
   if(priv->buffer)
     free(priv->buffer);
+  if(priv->multiplex_streams)
+    free(priv->multiplex_streams);
   if(priv->programs)
     {
     for(i = 0; i < priv->num_programs; i++)
@@ -1854,12 +2035,29 @@ static void close_mpegts(bgav_demuxer_context_t * ctx)
 static int select_track_mpegts(bgav_demuxer_context_t * ctx,
                                 int track)
   {
+  int i;
   mpegts_t * priv;
   priv = ctx->priv;
   priv->current_program = track;
   priv->error_counter = 0;
   
-  if(ctx->flags & BGAV_DEMUXER_CAN_SEEK)
+  if(track == priv->multiplex_track)
+    {
+    for(i = 0; i < priv->num_programs; i++)
+      {
+      if((ctx->flags & BGAV_DEMUXER_CAN_SEEK) &&
+         (ctx->input->flags & BGAV_INPUT_CAN_SEEK_BYTE))
+        {
+        priv->programs[i].timestamp_offset = -priv->programs[i].start_pcr;
+        priv->programs[i].have_offset = 1;
+        }
+      else
+        priv->programs[i].have_offset = 0;
+      }
+    ctx->flags &= ~BGAV_DEMUXER_HAS_TIMESTAMP_OFFSET;
+    }
+  else if((ctx->flags & BGAV_DEMUXER_CAN_SEEK) &&
+     (ctx->input->flags & BGAV_INPUT_CAN_SEEK_BYTE))
     {
     ctx->flags |= BGAV_DEMUXER_HAS_TIMESTAMP_OFFSET;
     ctx->timestamp_offset = -priv->programs[track].start_pcr;
@@ -1875,6 +2073,11 @@ static int select_track_mpegts(bgav_demuxer_context_t * ctx,
                     SEEK_SET);
     return 1;
     }
+  else if(ctx->input->flags & BGAV_INPUT_CAN_SEEK_TIME)
+    {
+    bgav_input_seek_time(ctx->input, 0, GAVL_TIME_SCALE);
+    return 1;
+    }
   else
     return 0;
     
@@ -2012,6 +2012,77 @@ static void fix_index(bgav_demuxer_context_t * ctx)
   }
 
 
+static void estimate_durations_s(bgav_stream_t * s, int num)
+  {
+  int i;
+  stream_priv_t * sp;
+  
+  for(i = 0; i < num; i++)
+    {
+    sp = s[i].priv;
+    if(!sp || !sp->trak)
+      continue;
+    bgav_stream_set_duration_estimate(&s[i], sp->first_pts,
+                                      sp->first_pts + sp->trak->mdia.mdhd.duration);
+    }
+  }
+
+static void estimate_durations(bgav_track_t * t)
+  {
+  estimate_durations_s(t->audio_streams, t->num_audio_streams);
+  estimate_durations_s(t->video_streams, t->num_video_streams);
+  estimate_durations_s(t->text_streams, t->num_text_streams);
+  estimate_durations_s(t->overlay_streams, t->num_overlay_streams);
+  }
+
+static int finish_quicktime(bgav_demuxer_context_t * ctx)
+  {
+  qt_priv_t * priv = ctx->priv;
+  
+  /* Build index */
+  build_index(ctx);
+  
+  /* No packets are found */
+  if(!ctx->si)
+    return 0;
+
+  /* Quicktime is almost always sample accurate */
+  ctx->index_mode = INDEX_MODE_SI_SA;
+  
+  /* Fix index (probably changing index mode) */
+  fix_index(ctx);
+  
+  priv->current_mdat = 0;
+
+#if 0
+  if((ctx->input->position != priv->mdats[priv->current_mdat].start) &&
+     (ctx->input->flags & BGAV_INPUT_CAN_SEEK_BYTE))
+    bgav_input_seek(ctx->input, priv->mdats[priv->current_mdat].start, SEEK_SET);
+  
+  /* Skip until first chunk */
+  
+  if(priv->mdats && (priv->mdats[priv->current_mdat].start < ctx->si->entries[0].offset))
+    bgav_input_skip(ctx->input,
+                    ctx->si->entries[0].offset -
+                    priv->mdats[priv->current_mdat].start);
+#else
+
+  if(ctx->input->flags & BGAV_INPUT_CAN_SEEK_BYTE)
+    {
+    bgav_input_seek(ctx->input, ctx->si->entries[0].offset, SEEK_SET);
+    }
+  else if(ctx->input->position < ctx->si->entries[0].offset)
+    bgav_input_skip(ctx->input, ctx->si->entries[0].offset - ctx->input->position);
+  
+#endif
+
+  if(priv->fragmented)
+    {
+    /* Read first mdat */
+    }
+  return 1;
+  }
+
 static int open_quicktime(bgav_demuxer_context_t * ctx)
   {
   qt_atom_header_t h;
@@ -2125,52 +2196,20 @@ static int open_quicktime(bgav_demuxer_context_t * ctx)
   ctx->tt = bgav_track_table_create(1);
   quicktime_init(ctx);
 
-  /* Build index */
-  build_index(ctx);
-  
-  /* No packets are found */
-  if(!ctx->si)
+  /* Info only mode: Take the durations from the media headers
+     and build the index later */
+  if((ctx->flags & BGAV_DEMUXER_INFO_ONLY) && !priv->fragmented)
+    {
+    estimate_durations(ctx->tt->cur);
+    ctx->flags |= BGAV_DEMUXER_INCOMPLETE;
+    }
+  else if(!finish_quicktime(ctx))
     return 0;
-
-  /* Quicktime is almost always sample accurate */
-  ctx->index_mode = INDEX_MODE_SI_SA;
-  
-  /* Fix index (probably changing index mode) */
-  fix_index(ctx);
   
   /* Check if we have an EDL */
   if(priv->has_edl)
     build_edl(ctx);
   
-  priv->current_mdat = 0;
-
-#if 0
-  if((ctx->input->position != priv->mdats[priv->current_mdat].start) &&
-     (ctx->input->flags & BGAV_INPUT_CAN_SEEK_BYTE))
-    bgav_input_seek(ctx->input, priv->mdats[priv->current_mdat].start, SEEK_SET);
-  
-  /* Skip until first chunk */
-  
-  if(priv->mdats && (priv->mdats[priv->current_mdat].start < ctx->si->entries[0].offset))
-    bgav_input_skip(ctx->input,
-                    ctx->si->entries[0].offset -
-                    priv->mdats[priv->current_mdat].start);
-#else
-
-  if(ctx->input->flags & BGAV_INPUT_CAN_SEEK_BYTE)
-    {
-    bgav_input_seek(ctx->input, ctx->si->entries[0].offset, SEEK_SET);
-    }
-  else if(ctx->input->position < ctx->si->entries[0].offset)
-    bgav_input_skip(ctx->input, ctx->si->entries[0].offset - ctx->input->position);
-  
-#endif
-
-  if(priv->fragmented)
-    {
-    /* Read first mdat */
-    }
-
 
   /* Set Format description */
   switch(priv->ftyp_fourcc)
@@ -2229,6 +2268,7 @@ const bgav_demuxer_t bgav_demuxer_quicktime =
     .open =        open_quicktime,
     //    .next_packet = next_packet_quicktime,
     //    .seek =        seek_quicktime,
-    .close =       close_quicktime
+    .close =       close_quicktime,
+    .finish_open = finish_quicktime
   };
 
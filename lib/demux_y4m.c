@@ -41,6 +41,11 @@ typedef struct
   char * line;
   
   int buf_size;
+
+  /* For direct addressed seeking */
+  int64_t data_start;
+  int frame_size;   /* FRAME header + image data */
+  int64_t num_frames;
   } y4m_t;
 
 static int probe_y4m(bgav_input_context_t * input)
@@ -84,6 +89,61 @@ static const char * next_tag(const char * old)
   return old;
   }
 
+/* Get the size of the first FRAME header (including the newline).
+   If all frames have the same header, each frame can be addressed directly */
+
+#define MAX_FRAME_HEADER 256
+
+static int get_frame_header_size(bgav_input_context_t * input)
+  {
+  char buf[MAX_FRAME_HEADER];
+  int len, i;
+
+  len = bgav_input_get_data(input, (uint8_t*)buf, MAX_FRAME_HEADER);
+
+  if((len < 5) || strncmp(buf, "FRAME", 5))
+    return 0;
+
+  for(i = 5; i < len; i++)
+    {
+    if(buf[i] == '\n')
+      return i+1;
+    }
+  return 0;
+  }
+
+static void init_seek(bgav_demuxer_context_t * ctx, bgav_stream_t * s)
+  {
+  int header_size;
+  y4m_t * priv = ctx->priv;
+
+  priv->data_start = ctx->input->position;
+  
+  if(!(ctx->input->flags & BGAV_INPUT_CAN_SEEK_BYTE) ||
+     (ctx->input->total_bytes <= 0) ||
+     !priv->buf_size ||
+     (s->data.video.format->interlace_mode == GAVL_INTERLACE_MIXED) ||
+     !(header_size = get_frame_header_size(ctx->input)))
+    return;
+
+  priv->frame_size = header_size + priv->buf_size;
+  priv->num_frames =
+    (ctx->input->total_bytes - priv->data_start) / priv->frame_size;
+
+  /* Export exact frame count without building an index */
+  
+  s->stats.total_packets = priv->num_frames;
+  s->stats.total_bytes   = priv->num_frames * priv->buf_size;
+  s->stats.size_min      = priv->buf_size;
+  s->stats.size_max      = priv->buf_size;
+  s->stats.duration_min  = s->data.video.format->frame_duration;
+  s->stats.duration_max  = s->data.video.format->frame_duration;
+  s->stats.pts_end       =
+    priv->num_frames * s->data.video.format->frame_duration;
+  
+  ctx->flags |= BGAV_DEMUXER_CAN_SEEK;
+  }
+
 static int open_y4m(bgav_demuxer_context_t * ctx)
   {
   y4m_t * priv;
@@ -228,6 +288,8 @@ static int open_y4m(bgav_demuxer_context_t * ctx)
   
   gavl_dictionary_set_string(ctx->tt->cur->metadata, 
                     GAVL_META_FORMAT, "yuv4mpeg");
+
+  init_seek(ctx, s);
   
   ctx->index_mode = INDEX_MODE_SIMPLE;
   return 1;
@@ -317,7 +379,7 @@ static int next_packet_y4m(bgav_demuxer_context_t * ctx)
       default:
         break;
       }
-    pos = next_tag(priv->line);
+    pos = next_tag(pos);
     }
   
   priv->pts += p->duration;
@@ -325,6 +387,62 @@ static int next_packet_y4m(bgav_demuxer_context_t * ctx)
   return 1;
   }
 
+/* Fallback if a frame header has a different size: Walk the frame
+   headers from the start and skip the image data */
+
+static void seek_linear(bgav_demuxer_context_t * ctx, int64_t frame)
+  {
+  int64_t i;
+  y4m_t * priv = ctx->priv;
+  
+  bgav_input_seek(ctx->input, priv->data_start, SEEK_SET);
+
+  for(i = 0; i < frame; i++)
+    {
+    if(!bgav_input_read_line(ctx->input,
+                             &priv->line, &priv->line_alloc,
+                             0, NULL) ||
+       strncmp(priv->line, "FRAME", 5))
+      return;
+    bgav_input_skip(ctx->input, priv->buf_size);
+    }
+  }
+
+static void seek_y4m(bgav_demuxer_context_t * ctx, int64_t time,
+                     int scale)
+  {
+  bgav_stream_t * s;
+  y4m_t * priv;
+  int64_t frame;
+  uint8_t buf[5];
+  
+  priv = ctx->priv;
+  s = ctx->tt->cur->video_streams;
+
+  frame = gavl_time_rescale(scale, s->data.video.format->timescale,
+                            time) / s->data.video.format->frame_duration;
+
+  if(frame >= priv->num_frames)
+    frame = priv->num_frames - 1;
+  if(frame < 0)
+    frame = 0;
+
+  bgav_input_seek(ctx->input,
+                  priv->data_start + frame * priv->frame_size, SEEK_SET);
+  
+  if((bgav_input_get_data(ctx->input, buf, 5) < 5) ||
+     strncmp((char*)buf, "FRAME", 5))
+    {
+    bgav_log(ctx->opt, BGAV_LOG_WARNING, LOG_DOMAIN,
+             "No frame header at expected position, seeking linearly");
+    /* On failure, the next packet will signal EOF */
+    seek_linear(ctx, frame);
+    }
+  
+  priv->pts = frame * s->data.video.format->frame_duration;
+  STREAM_SET_SYNC(s, priv->pts);
+  }
+
 static void resync_y4m(bgav_demuxer_context_t * ctx, bgav_stream_t * s)
   {
   y4m_t * priv;
@@ -349,6 +467,7 @@ const bgav_demuxer_t bgav_demuxer_y4m =
     .open         = open_y4m,
     .select_track = select_track_y4m,
     .next_packet = next_packet_y4m,
+    .seek        = seek_y4m,
     .resync      = resync_y4m,
     .close =       close_y4m
   };
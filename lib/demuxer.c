@@ -300,7 +300,10 @@ bgav_demuxer_create(const bgav_options_t * opt, const bgav_demuxer_t * demuxer,
   ret->opt = opt;
   ret->demuxer = demuxer;
   ret->input = input;
-    
+
+  if(opt->info_only && demuxer->finish_open)
+    ret->flags |= BGAV_DEMUXER_INFO_ONLY;
+  
   return ret;
   }
 
@@ -442,11 +445,8 @@ static void check_interleave(bgav_demuxer_context_t * ctx)
   free(streams);
   }
 
-int bgav_demuxer_start(bgav_demuxer_context_t * ctx)
+static int start_superindex(bgav_demuxer_context_t * ctx)
   {
-  if(!ctx->demuxer->open(ctx))
-    return 0;
-  
   if(ctx->si)
     {
     if(!(ctx->flags & BGAV_DEMUXER_SI_PRIVATE_FUNCS))
@@ -470,6 +470,69 @@ int bgav_demuxer_start(bgav_demuxer_context_t * ctx)
   return 1;
   }
 
+int bgav_demuxer_start(bgav_demuxer_context_t * ctx)
+  {
+  int i;
+  
+  if(!ctx->demuxer->open(ctx))
+    return 0;
+
+  if(ctx->flags & BGAV_DEMUXER_INCOMPLETE)
+    {
+    for(i = 0; i < ctx->tt->num_tracks; i++)
+      ctx->tt->tracks[i].flags |= TRACK_INFO_ESTIMATE;
+    return 1;
+    }
+  
+  return start_superindex(ctx);
+  }
+
+void bgav_stream_set_duration_estimate(bgav_stream_t * s,
+                                       int64_t pts_start, int64_t pts_end)
+  {
+  s->stats_orig = s->stats;
+  s->stats.pts_start = pts_start;
+  s->stats.pts_end = pts_end;
+  s->flags |= STREAM_DURATION_ESTIMATE;
+  }
+
+static int restore_stats(void * priv, bgav_stream_t * s)
+  {
+  if(s->flags & STREAM_DURATION_ESTIMATE)
+    {
+    s->stats = s->stats_orig;
+    s->flags &= ~STREAM_DURATION_ESTIMATE;
+    }
+  return 1;
+  }
+
+int bgav_demuxer_finish_open(bgav_demuxer_context_t * ctx)
+  {
+  int i;
+  
+  if(!(ctx->flags & BGAV_DEMUXER_INCOMPLETE))
+    return 1;
+
+  /* Reopening the demuxer (e.g. after a track reset)
+     will be a complete one */
+  ctx->flags &= ~(BGAV_DEMUXER_INCOMPLETE | BGAV_DEMUXER_INFO_ONLY);
+
+  for(i = 0; i < ctx->tt->num_tracks; i++)
+    bgav_track_foreach(&ctx->tt->tracks[i], restore_stats, NULL);
+  
+  if(!ctx->demuxer->finish_open(ctx) ||
+     !start_superindex(ctx))
+    return 0;
+
+  /* Replace the estimated durations before clearing the flag */
+  for(i = 0; i < ctx->tt->num_tracks; i++)
+    {
+    bgav_track_compute_info(&ctx->tt->tracks[i]);
+    ctx->tt->tracks[i].flags &= ~TRACK_INFO_ESTIMATE;
+    }
+  return 1;
+  }
+
 void bgav_demuxer_stop(bgav_demuxer_context_t * ctx)
   {
   ctx->demuxer->close(ctx);
@@ -520,6 +583,14 @@ int bgav_demuxer_next_packet_interleaved(bgav_demuxer_context_t * ctx)
     ctx->si->current_position++;
     return 1;
     }
+
+  /* Skip non-keyframes without reading them */
+  if(!(ctx->si->entries[ctx->si->current_position].flags & GAVL_PACKET_KEYFRAME) &&
+     (stream->type == GAVF_STREAM_VIDEO) && bgav_video_skip_nonkey(stream))
+    {
+    ctx->si->current_position++;
+    return 1;
+    }
 #if 0
   if(stream->type == GAVF_STREAM_TEXT)
     {
@@ -577,6 +648,18 @@ static int next_packet_noninterleaved(bgav_demuxer_context_t * ctx)
     s->index_position++;
     }
 
+  /* Skip non-keyframes without reading them */
+  if((s->type == GAVF_STREAM_VIDEO) && bgav_video_skip_nonkey(s))
+    {
+    while((s->index_position <= s->last_index_position) &&
+          ((ctx->si->entries[s->index_position].stream_id != s->stream_id) ||
+           !(ctx->si->entries[s->index_position].flags & GAVL_PACKET_KEYFRAME)))
+      s->index_position++;
+
+    if(s->index_position > s->last_index_position)
+      return 0;
+    }
+
   if(ctx->input->flags & BGAV_INPUT_CAN_SEEK_BYTE)
     {
     bgav_input_seek(ctx->input, ctx->si->entries[s->index_position].offset, SEEK_SET);
@@ -610,9 +693,61 @@ static int next_packet_noninterleaved(bgav_demuxer_context_t * ctx)
   
   }
 
-int bgav_demuxer_next_packet(bgav_demuxer_context_t * demuxer)
+/* Some demuxers have packets stored in the streams,
+   we flush them here */
+
+static int flush_stream_packets(bgav_demuxer_context_t * demuxer)
   {
   int ret = 0, i;
+  
+  for(i = 0; i < demuxer->tt->cur->num_audio_streams; i++)
+    {
+    if(demuxer->tt->cur->audio_streams[i].packet)
+      {
+      bgav_stream_done_packet_write(&demuxer->tt->cur->audio_streams[i],
+                                    demuxer->tt->cur->audio_streams[i].packet);
+      demuxer->tt->cur->audio_streams[i].packet = NULL;
+      ret = 1;
+      }
+    }
+  for(i = 0; i < demuxer->tt->cur->num_video_streams; i++)
+    {
+    if(demuxer->tt->cur->video_streams[i].packet)
+      {
+      bgav_stream_done_packet_write(&demuxer->tt->cur->video_streams[i],
+                                    demuxer->tt->cur->video_streams[i].packet);
+      demuxer->tt->cur->video_streams[i].packet = NULL;
+      ret = 1;
+      }
+    }
+  return ret;
+  }
+
+int bgav_demuxer_next_packet_pipeline(bgav_demuxer_context_t * demuxer)
+  {
+  int ret = 0;
+  bgav_perf_timer_t t;
+  
+  bgav_perf_start(&t, demuxer->opt, &demuxer->input->perf_total);
+  
+  switch(demuxer->demux_mode)
+    {
+    case DEMUX_MODE_SI_I:
+      ret = bgav_demuxer_next_packet_interleaved(demuxer);
+      break;
+    case DEMUX_MODE_STREAM:
+      ret = demuxer->demuxer->next_packet(demuxer);
+      if(!ret)
+        flush_stream_packets(demuxer);
+      break;
+    }
+  bgav_perf_stop(&t, &demuxer->perf, &demuxer->perf_total);
+  return ret;
+  }
+
+static int next_packet(bgav_demuxer_context_t * demuxer)
+  {
+  int ret = 0;
   //   fprintf(stderr, "bgav_demuxer_next_packet\n");
   switch(demuxer->demux_mode)
     {
@@ -642,29 +777,7 @@ int bgav_demuxer_next_packet(bgav_demuxer_context_t * demuxer)
       
       if(!ret)
         {
-        /* Some demuxers have packets stored in the streams,
-           we flush them here */
-        
-        for(i = 0; i < demuxer->tt->cur->num_audio_streams; i++)
-          {
-          if(demuxer->tt->cur->audio_streams[i].packet)
-            {
-            bgav_stream_done_packet_write(&demuxer->tt->cur->audio_streams[i],
-                                          demuxer->tt->cur->audio_streams[i].packet);
-            demuxer->tt->cur->audio_streams[i].packet = NULL;
-            ret = 1;
-            }
-          }
-        for(i = 0; i < demuxer->tt->cur->num_video_streams; i++)
-          {
-          if(demuxer->tt->cur->video_streams[i].packet)
-            {
-            bgav_stream_done_packet_write(&demuxer->tt->cur->video_streams[i],
-                                          demuxer->tt->cur->video_streams[i].packet);
-            demuxer->tt->cur->video_streams[i].packet = NULL;
-            ret = 1;
-            }
-          }
+        ret = flush_stream_packets(demuxer);
         bgav_track_set_eof_d(demuxer->tt->cur);
         }
       break;
@@ -673,11 +786,25 @@ int bgav_demuxer_next_packet(bgav_demuxer_context_t * demuxer)
   return ret;
   }
 
+int bgav_demuxer_next_packet(bgav_demuxer_context_t * demuxer)
+  {
+  int ret;
+  bgav_perf_timer_t t;
+  
+  bgav_perf_start(&t, demuxer->opt, &demuxer->input->perf_total);
+  ret = next_packet(demuxer);
+  bgav_perf_stop(&t, &demuxer->perf, &demuxer->perf_total);
+  return ret;
+  }
+
 gavl_source_status_t
 bgav_demuxer_get_packet_read(void * stream1, bgav_packet_t ** ret)
   {
   bgav_stream_t * s = stream1;
   bgav_demuxer_context_t * demuxer = s->demuxer;
+
+  if(demuxer->pipeline)
+    return bgav_pipeline_get_packet(demuxer->pipeline, s, ret, 0, 1);
   
   demuxer->request_stream = s;
   
@@ -710,6 +837,9 @@ bgav_demuxer_peek_packet_read(void * stream1, bgav_packet_t ** ret,
   if(demuxer->flags & BGAV_DEMUXER_PEEK_FORCES_READ)
     force = 1;
 
+  if(demuxer->pipeline)
+    return bgav_pipeline_get_packet(demuxer->pipeline, s, ret, 1, force);
+
   p = bgav_packet_buffer_peek_packet_read(s->packet_buffer);
 
   if(p)
@@ -40,7 +40,7 @@
 
 /* Version must be increased each time the fileformat
    changes */
-#define INDEX_VERSION 10
+#define INDEX_VERSION 11
 
 static void dump_index(bgav_stream_t * s)
   {
@@ -239,6 +239,9 @@ bgav_file_index_append_packet(bgav_file_index_t * idx,
  *    (Version is the INDEX_VERSION defined above)
  * - Filename terminated with \n
  * - File time (st_mtime returned by stat(2)) (64)
+ * - Indexed size: File size covered by the index (64)
+ * - Resume position: File position from where the index
+ *   can be continued if the file grew (64)
  * - Number of tracks (32)
  * - Tracks consising of
  *    - Number of streams (32)
@@ -271,10 +274,15 @@ bgav_file_index_append_packet(bgav_file_index_t * idx,
 
 int bgav_file_index_read_header(const char * filename,
                                 bgav_input_context_t * input,
-                                int * num_tracks)
+                                int * num_tracks,
+                                int64_t * indexed_size,
+                                int64_t * resume_position)
   {
   int ret = 0;
+  int result = 1;
   uint64_t file_time;
+  uint64_t file_size;
+  uint64_t resume_pos;
   char * line = NULL;
   uint32_t line_alloc = 0;
   uint32_t ntracks;
@@ -298,7 +306,9 @@ int bgav_file_index_read_header(const char * filename,
   /* Check filename */
   if(strcmp(line, filename))
     goto fail;
-  if(!bgav_input_read_64_be(input, &file_time))
+  if(!bgav_input_read_64_be(input, &file_time) ||
+     !bgav_input_read_64_be(input, &file_size) ||
+     !bgav_input_read_64_be(input, &resume_pos))
     goto fail;
   
   /* Don't do this check if we have uuid's as names */
@@ -307,14 +317,26 @@ int bgav_file_index_read_header(const char * filename,
     {
     if(stat(filename, &stat_buf))
       goto fail;
-    if(file_time != stat_buf.st_mtime)
+
+    /* File grew since the index was written: The index can be
+       continued from the resume position */
+    if(file_size && resume_pos && (stat_buf.st_size > file_size))
+      result = 2;
+    else if((file_time != stat_buf.st_mtime) ||
+            (file_size && (stat_buf.st_size != file_size)))
       goto fail;
     }
   if(!bgav_input_read_32_be(input, &ntracks))
     goto fail;
   
   *num_tracks = ntracks;
-  ret = 1;
+
+  if(indexed_size)
+    *indexed_size = file_size;
+  if(resume_position)
+    *resume_position = resume_pos;
+  
+  ret = result;
   fail:
   if(line)
     free(line);
@@ -342,7 +364,9 @@ static void write_8(FILE * out, uint8_t i)
 #endif
 void bgav_file_index_write_header(const char * filename,
                                   FILE * output,
-                                  int num_tracks)
+                                  int num_tracks,
+                                  int64_t indexed_size,
+                                  int64_t resume_position)
   {
   uint64_t file_time = 0;
   struct stat stat_buf;
@@ -357,6 +381,8 @@ void bgav_file_index_write_header(const char * filename,
     file_time = stat_buf.st_mtime;
     }
   write_64(output, file_time);
+  write_64(output, indexed_size);
+  write_64(output, resume_position);
   write_32(output, num_tracks);
   }
 
@@ -601,11 +627,101 @@ static void set_has_file_index(bgav_t * b)
   b->demuxer->flags |= BGAV_DEMUXER_CAN_SEEK;
   }
 
+/*
+ *  Incremental indexing of growing files
+ *
+ *  The resume position is the smallest position, from where all streams
+ *  can be continued: The last entry for audio and subtitles and the last
+ *  keyframe for video. When the index is continued, all entries
+ *  starting there are dropped and the file is parsed from this
+ *  position to the end.
+ */
+
+static int get_resume_position(void * priv, bgav_stream_t * s)
+  {
+  int i;
+  int64_t * ret = priv;
+
+  if(!s->file_index || !s->file_index->num_entries)
+    return 1;
+
+  i = s->file_index->num_entries - 1;
+
+  if(s->type == GAVF_STREAM_VIDEO)
+    {
+    while(i && !(s->file_index->entries[i].flags & GAVL_PACKET_KEYFRAME))
+      i--;
+    }
+  if((*ret < 0) || (s->file_index->entries[i].position < *ret))
+    *ret = s->file_index->entries[i].position;
+  return 1;
+  }
+
+static int64_t file_index_resume_position(bgav_t * b)
+  {
+  int i;
+  int64_t ret = -1;
+
+  if((b->demuxer->index_mode != INDEX_MODE_SIMPLE) &&
+     (b->demuxer->index_mode != INDEX_MODE_MIXED))
+    return 0;
+  
+  for(i = 0; i < b->tt->num_tracks; i++)
+    bgav_track_foreach(&b->tt->tracks[i], get_resume_position, &ret);
+
+  return (ret > 0) ? ret : 0;
+  }
+
+/* Timecodes are appended in the same order as the entries, so the
+   table is trimmed together with the removed entries. Comparing
+   against the pts of the last kept entry fails for B-frames */
+
+static void file_index_truncate(bgav_file_index_t * idx, int64_t position)
+  {
+  while(idx->num_entries &&
+        (idx->entries[idx->num_entries-1].position >= position))
+    {
+    idx->num_entries--;
+    if(idx->tt.num_entries &&
+       (idx->tt.entries[idx->tt.num_entries-1].pts ==
+        idx->entries[idx->num_entries].pts))
+      idx->tt.num_entries--;
+    }
+  if(!idx->num_entries)
+    idx->tt.num_entries = 0;
+  }
+
+/* Index of the first entry at or after a file position */
+
+static uint32_t file_index_find_position(bgav_file_index_t * idx,
+                                         int64_t position)
+  {
+  uint32_t i = idx->num_entries;
+  while(i && (idx->entries[i-1].position >= position))
+    i--;
+  return i;
+  }
+
+static int destroy_file_index(void * priv, bgav_stream_t * s)
+  {
+  if(s->file_index)
+    {
+    bgav_file_index_destroy(s->file_index);
+    s->file_index = NULL;
+    }
+  return 1;
+  }
+
+static int build_file_index_parseall(bgav_t * b, int64_t resume_position);
+
 int bgav_read_file_index(bgav_t * b)
   {
   int i, j;
   bgav_input_context_t * input = NULL;
   int num_tracks;
+  int result;
+  int64_t indexed_size;
+  int64_t resume_position;
   uint32_t num_streams;
   uint32_t stream_id;
   uint32_t stream_type;
@@ -631,8 +747,15 @@ int bgav_read_file_index(bgav_t * b)
   if(!bgav_input_open(input, filename))
     goto fail;
 
-  if(!bgav_file_index_read_header(b->input->filename,
-                                  input, &num_tracks))
+  result = bgav_file_index_read_header(b->input->filename,
+                                       input, &num_tracks,
+                                       &indexed_size, &resume_position);
+  if(!result)
+    goto fail;
+
+  if((result == 2) &&
+     (b->demuxer->index_mode != INDEX_MODE_SIMPLE) &&
+     (b->demuxer->index_mode != INDEX_MODE_MIXED))
     goto fail;
 
   if(num_tracks != b->tt->num_tracks)
@@ -692,6 +815,25 @@ int bgav_read_file_index(bgav_t * b)
       }
     }
   bgav_input_destroy(input);
+  input = NULL;
+  
+  b->file_index_size = indexed_size;
+  
+  if(result == 2)
+    {
+    bgav_log(&b->opt, BGAV_LOG_INFO, LOG_DOMAIN,
+             "File grew since the index was created, continuing at %"PRId64,
+             resume_position);
+    
+    if(!build_file_index_parseall(b, resume_position))
+      {
+      for(i = 0; i < b->tt->num_tracks; i++)
+        bgav_track_foreach(&b->tt->tracks[i], destroy_file_index, NULL);
+      goto fail;
+      }
+    bgav_write_file_index(b);
+    }
+  
   set_has_file_index(b);
   free(filename);
   return 1;
@@ -816,10 +958,15 @@ void bgav_write_file_index(bgav_t * b)
   FILE * output;
   char * filename;
   int num_streams;
+  int64_t indexed_size;
   bgav_stream_t * s;
   /* Check if the input provided an index filename */
   if(!b->input->index_file || !b->input->filename)
     return;
+
+  indexed_size = b->file_index_size;
+  if(indexed_size < b->input->total_bytes)
+    indexed_size = b->input->total_bytes;
   
   filename = 
     bgav_search_file_write(&b->opt,
@@ -829,7 +976,9 @@ void bgav_write_file_index(bgav_t * b)
   
   bgav_file_index_write_header(b->input->filename,
                                output,
-                               b->tt->num_tracks);
+                               b->tt->num_tracks,
+                               indexed_size,
+                               file_index_resume_position(b));
   for(i = 0; i < b->tt->num_tracks; i++)
     {
     num_streams = 0;
@@ -978,11 +1127,64 @@ static int build_file_index_simple(bgav_t * b)
     if(!(s->flags & STREAM_SUBREADER))
       flush_stream_simple(s, 1);
     }
+
+  if(b->input->position > b->file_index_size)
+    b->file_index_size = b->input->position;
+  
   bgav_input_seek(b->input, old_position, SEEK_SET);
   return 1;
   }
 
-static int bgav_build_file_index_parseall(bgav_t * b)
+/* Keep the loaded index and stats when continuing an index */
+
+static void init_stream_index(bgav_stream_t * s, int64_t resume_position)
+  {
+  if(s->file_index && resume_position)
+    {
+    file_index_truncate(s->file_index, resume_position);
+    return;
+    }
+  s->file_index = bgav_file_index_create();
+  gavf_stream_stats_init(&s->stats);
+  }
+
+/* Reset the parsing state like after seeking */
+
+static int resume_stream(void * priv, bgav_stream_t * s)
+  {
+  bgav_demuxer_context_t * demuxer = priv;
+
+  if(s->action != BGAV_STREAM_PARSE)
+    return 1;
+  
+  bgav_stream_clear(s);
+
+  switch(s->type)
+    {
+    case GAVF_STREAM_AUDIO:
+      if(s->data.audio.parser)
+        bgav_audio_parser_reset(s->data.audio.parser,
+                                GAVL_TIME_UNDEFINED, GAVL_TIME_UNDEFINED);
+      break;
+    case GAVF_STREAM_VIDEO:
+      if(s->data.video.parser)
+        bgav_video_parser_reset(s->data.video.parser,
+                                GAVL_TIME_UNDEFINED, GAVL_TIME_UNDEFINED);
+      if(s->pt)
+        bgav_packet_timer_reset(s->pt);
+      if(s->fd)
+        bgav_frametype_detector_reset(s->fd);
+      break;
+    default:
+      break;
+    }
+  
+  if(demuxer->demuxer->resync)
+    demuxer->demuxer->resync(demuxer, s);
+  return 1;
+  }
+
+static int build_file_index_parseall(bgav_t * b, int64_t resume_position)
   {
   int i, j;
   int ret = 0;
@@ -993,37 +1195,39 @@ static int bgav_build_file_index_parseall(bgav_t * b)
     b->demuxer->flags |= BGAV_DEMUXER_BUILD_INDEX;
     for(j = 0; j < b->tt->cur->num_audio_streams; j++)
       {
-      b->tt->cur->audio_streams[j].file_index = bgav_file_index_create();
       bgav_set_audio_stream(b, j, BGAV_STREAM_PARSE);
-      gavf_stream_stats_init(&b->tt->cur->audio_streams[j].stats);
+      init_stream_index(&b->tt->cur->audio_streams[j], resume_position);
       }
     for(j = 0; j < b->tt->cur->num_video_streams; j++)
       {
-      b->tt->cur->video_streams[j].file_index = bgav_file_index_create();
       bgav_set_video_stream(b, j, BGAV_STREAM_PARSE);
-      gavf_stream_stats_init(&b->tt->cur->video_streams[j].stats);
+      init_stream_index(&b->tt->cur->video_streams[j], resume_position);
       }
     for(j = 0; j < b->tt->cur->num_text_streams; j++)
       {
       if(!(b->tt->cur->text_streams[j].flags & STREAM_SUBREADER))
         {
-        b->tt->cur->text_streams[j].file_index = bgav_file_index_create();
         bgav_set_text_stream(b, j, BGAV_STREAM_PARSE);
-        gavf_stream_stats_init(&b->tt->cur->text_streams[j].stats);
+        init_stream_index(&b->tt->cur->text_streams[j], resume_position);
         }
       }
     for(j = 0; j < b->tt->cur->num_overlay_streams; j++)
       {
       if(!(b->tt->cur->overlay_streams[j].flags & STREAM_SUBREADER))
         {
-        b->tt->cur->overlay_streams[j].file_index = bgav_file_index_create();
         bgav_set_overlay_stream(b, j, BGAV_STREAM_PARSE);
-        gavf_stream_stats_init(&b->tt->cur->overlay_streams[j].stats);
+        init_stream_index(&b->tt->cur->overlay_streams[j], resume_position);
         }
       }
 
     if(!bgav_start(b))
       return 0;
+
+    if(resume_position)
+      {
+      bgav_input_seek(b->input, resume_position, SEEK_SET);
+      bgav_track_foreach(b->tt->cur, resume_stream, b->demuxer);
+      }
     
     build_file_index_simple(b);
     
@@ -1155,7 +1359,7 @@ int bgav_build_file_index(bgav_t * b, gavl_time_t * time_needed)
     {
     case INDEX_MODE_SIMPLE:
     case INDEX_MODE_MIXED:
-      ret = bgav_build_file_index_parseall(b);
+      ret = build_file_index_parseall(b, 0);
       break;
     case INDEX_MODE_SI_PARSE:
       ret = bgav_build_file_index_si_parse(b);
@@ -1179,14 +1383,242 @@ int bgav_build_file_index(bgav_t * b, gavl_time_t * time_needed)
   return 1;
   }
 
+/*
+ *  Follow mode: Continue the index of a growing file in a second
+ *  decoder instance and take over the extended indices. The second
+ *  instance is kept open and parses only the new part of the file
+ */
+
+static void update_track_duration(bgav_track_t * t)
+  {
+  int i;
+  gavl_time_t d;
+  gavl_time_t duration = gavl_track_get_duration(t->info);
+  bgav_stream_t * s;
+  
+  for(i = 0; i < t->num_audio_streams; i++)
+    {
+    s = &t->audio_streams[i];
+    if(!s->file_index)
+      continue;
+    d = gavl_time_unscale(s->data.audio.format->samplerate,
+                          bgav_stream_get_duration(s));
+    if((duration == GAVL_TIME_UNDEFINED) || (d > duration))
+      duration = d;
+    }
+  for(i = 0; i < t->num_video_streams; i++)
+    {
+    s = &t->video_streams[i];
+    if(!s->file_index)
+      continue;
+    d = gavl_time_unscale(s->data.video.format->timescale,
+                          bgav_stream_get_duration(s));
+    if((duration == GAVL_TIME_UNDEFINED) || (d > duration))
+      duration = d;
+    }
+  if(duration != GAVL_TIME_UNDEFINED)
+    gavl_track_set_duration(t->info, duration);
+  }
+
+typedef struct
+  {
+  bgav_track_t * src;
+  int64_t resume_position;
+  } merge_index_t;
+
+/* Replace the entries from the resume position on with the ones
+   of the other instance. The entries before are the same in both */
+
+static int merge_stream(void * priv, bgav_stream_t * s)
+  {
+  merge_index_t * m = priv;
+  bgav_file_index_t * idx;
+  bgav_file_index_t * src_idx;
+  bgav_stream_t * src;
+  uint32_t src_start;
+  uint32_t num_new;
+  int tt_start;
+  int64_t key;
+  
+  if(!(idx = s->file_index) ||
+     !(src = bgav_track_find_stream_all(m->src, s->stream_id)) ||
+     !(src_idx = src->file_index) ||
+     (src_idx->num_entries < idx->num_entries))
+    return 1;
+
+  if(src_idx->num_entries > idx->num_entries)
+    s->flags &= ~(STREAM_EOF_C|STREAM_EOF_D);
+
+  /* Remember the file position of the next packet. At the end of
+     the index, continue after the last packet */
+  if(s->index_position < idx->num_entries)
+    key = idx->entries[s->index_position].position;
+  else if(idx->num_entries)
+    key = idx->entries[idx->num_entries-1].position + 1;
+  else
+    key = 0;
+  
+  file_index_truncate(idx, m->resume_position);
+  src_start = file_index_find_position(src_idx, m->resume_position);
+  num_new = src_idx->num_entries - src_start;
+  
+  if(idx->num_entries + num_new > idx->entries_alloc)
+    {
+    idx->entries_alloc = idx->num_entries + num_new + 512;
+    idx->entries = realloc(idx->entries,
+                           idx->entries_alloc * sizeof(*idx->entries));
+    }
+  memcpy(idx->entries + idx->num_entries, src_idx->entries + src_start,
+         num_new * sizeof(*idx->entries));
+  idx->num_entries += num_new;
+
+  /* Timecodes of the new entries */
+  for(tt_start = idx->tt.num_entries;
+      tt_start < src_idx->tt.num_entries; tt_start++)
+    bgav_timecode_table_append_entry(&idx->tt,
+                                     src_idx->tt.entries[tt_start].pts,
+                                     src_idx->tt.entries[tt_start].timecode);
+  
+  /* Map the read position by file position, the number of entries
+     before it can differ after parsing again */
+  s->index_position = file_index_find_position(idx, key);
+  
+  s->stats = src->stats;
+
+  if(src->ci.max_packet_size > s->ci.max_packet_size)
+    s->ci.max_packet_size = src->ci.max_packet_size;
+  
+  if((s->type == GAVF_STREAM_VIDEO) && s->data.video.kft)
+    {
+    bgav_keyframe_table_destroy(s->data.video.kft);
+    s->data.video.kft = NULL;
+    }
+  return 1;
+  }
+
+static bgav_t * open_follower(bgav_t * b)
+  {
+  bgav_t * ret = bgav_create();
+  bgav_options_copy(&ret->opt, &b->opt);
+  ret->opt.sample_accurate = 1;
+  ret->opt.follow = 0;
+  ret->opt.info_cache = 0;
+  ret->opt.info_only = 0;
+  ret->opt.cache_time = 0;
+  
+  if(!bgav_open(ret, b->location) ||
+     (ret->tt->num_tracks != b->tt->num_tracks) ||
+     !(ret->tt->tracks[0].flags & TRACK_HAS_FILE_INDEX))
+    {
+    bgav_close(ret);
+    return NULL;
+    }
+  return ret;
+  }
+
+int bgav_update_file_index(bgav_t * b)
+  {
+  int i;
+  struct stat st;
+  bgav_t * f;
+  merge_index_t m;
+  
+  if(!b->tt || !b->tt->num_tracks ||
+     !(b->tt->tracks[0].flags & TRACK_HAS_FILE_INDEX) ||
+     !b->location || !b->input->filename ||
+     (b->input->filename[0] != '/') ||
+     !file_index_resume_position(b))
+    return 0;
+
+  /* Check if the file grew */
+  if(stat(b->input->filename, &st) || (st.st_size <= b->file_index_size))
+    return 0;
+  
+  m.resume_position = file_index_resume_position(b);
+  
+  if(!b->follower)
+    {
+    /* The first instance reads the index from disk and continues it */
+    if(!(b->follower = open_follower(b)))
+      return 0;
+    }
+  else
+    {
+    /* Parse only the part added since the last update */
+    f = b->follower;
+    f->input->total_bytes = st.st_size;
+    if(!build_file_index_parseall(f, m.resume_position))
+      {
+      bgav_close(f);
+      b->follower = NULL;
+      return 0;
+      }
+    }
+  f = b->follower;
+  
+  for(i = 0; i < b->tt->num_tracks; i++)
+    {
+    m.src = &f->tt->tracks[i];
+    bgav_track_foreach(&b->tt->tracks[i], merge_stream, &m);
+    bgav_track_compute_info(&b->tt->tracks[i]);
+    update_track_duration(&b->tt->tracks[i]);
+    }
+  set_has_file_index(b);
+
+  b->file_index_size = f->file_index_size;
+  
+  bgav_log(&b->opt, BGAV_LOG_DEBUG, LOG_DOMAIN,
+           "Updated file index, %"PRId64" bytes indexed",
+           b->file_index_size);
+  return 1;
+  }
+
+/* Called at the end of the index. Returns 1 if the index of the
+   requested stream was extended */
+
+static int follow_file_index(bgav_demuxer_context_t * ctx)
+  {
+  int64_t time;
+  uint32_t num_entries;
+  bgav_t * b = ctx->follow;
+
+  if(!b || ctx->pipeline)
+    return 0;
+
+  time = bgav_perf_time();
+  if(b->follow_time &&
+     (time - b->follow_time < (int64_t)b->opt.follow * 1000))
+    return 0;
+  b->follow_time = time;
+
+  num_entries = ctx->request_stream->file_index->num_entries;
+  
+  return bgav_update_file_index(b) &&
+    (ctx->request_stream->file_index->num_entries > num_entries);
+  }
+
 int bgav_demuxer_next_packet_fileindex(bgav_demuxer_context_t * ctx)
   {
   bgav_stream_t * s = ctx->request_stream;
   int new_pos;
 
+  again:
+  
+  /* Skip non-keyframes without reading them */
+  if((s->type == GAVF_STREAM_VIDEO) && bgav_video_skip_nonkey(s))
+    {
+    while((s->index_position < s->file_index->num_entries) &&
+          !(s->file_index->entries[s->index_position].flags & GAVL_PACKET_KEYFRAME))
+      s->index_position++;
+    }
+  
   /* Check for EOS */
   if(s->index_position >= s->file_index->num_entries)
+    {
+    if(follow_file_index(ctx))
+      goto again;
     return 0;
+    }
   
   /* Seek to right position */
   if(s->file_index->entries[s->index_position].position !=
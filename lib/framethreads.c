@@ -0,0 +1,429 @@
+/*****************************************************************
+ * gmerlin-avdecoder - a general purpose multimedia decoding library
+ *
+ * Copyright (c) 2001 - 2012 Members of the Gmerlin project
+ * gmerlin-general@lists.sourceforge.net
+ * http://gmerlin.sourceforge.net
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * *****************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include <avdec_private.h>
+
+#define LOG_DOMAIN "framethreads"
+
+/*
+ *  Frame parallel decoding for intra-only codecs
+ *
+ *  Each worker has its own instance of the decoder, which is
+ *  initialized on a shadow copy of the stream. The packet source of
+ *  the shadow stream returns exactly one packet, which is handed over
+ *  by the calling thread. The workers form a ring: Packets are
+ *  submitted and frames are returned in the same order, so the
+ *  output order is the packet order.
+ *
+ *  The last frame returned to the application belongs to its worker
+ *  until the next read call.
+ *
+ *  The decode time is counted by each worker and merged into the
+ *  counters of the stream when the frame is picked up. The packets are
+ *  already counted when the calling thread reads them.
+ */
+
+#define WORKER_IDLE 0
+#define WORKER_BUSY 1
+#define WORKER_DONE 2
+
+typedef struct
+  {
+  bgav_stream_t s;
+  gavl_video_format_t format;
+  gavl_video_frame_t * frame;
+
+  bgav_frame_threads_t * ft;
+  pthread_t thread;
+  int have_thread;
+
+  bgav_packet_t * p;
+  int p_read;
+  int64_t pts;
+  int64_t duration;
+
+  int state;
+  gavl_source_status_t st;
+  } worker_t;
+
+struct bgav_frame_threads_s
+  {
+  bgav_stream_t * s;
+  bgav_video_decoder_t * dec;
+
+  worker_t * workers;
+  int num_workers;
+
+  int read_idx;    /* Next worker to return a frame */
+  int num_pending; /* Number of workers after read_idx which have a packet */
+  int held;        /* Frame of read_idx - 1 is owned by the application */
+  int eof;
+
+  pthread_mutex_t mutex;
+  pthread_cond_t start_cond;
+  pthread_cond_t done_cond;
+  int quit;
+  };
+
+/* Packet source of the shadow streams */
+
+static gavl_source_status_t get_packet_worker(void * priv, bgav_packet_t ** ret)
+  {
+  worker_t * w = priv;
+  if(!w->p || w->p_read)
+    return GAVL_SOURCE_AGAIN;
+  w->p_read = 1;
+  *ret = w->p;
+  return GAVL_SOURCE_OK;
+  }
+
+static gavl_source_status_t peek_packet_worker(void * priv, bgav_packet_t ** ret,
+                                               int force)
+  {
+  worker_t * w = priv;
+  if(!w->p || w->p_read)
+    return GAVL_SOURCE_AGAIN;
+  if(ret)
+    *ret = w->p;
+  return GAVL_SOURCE_OK;
+  }
+
+static void * worker_thread(void * data)
+  {
+  worker_t * w = data;
+  bgav_frame_threads_t * ft = w->ft;
+  bgav_perf_timer_t t;
+  
+  while(1)
+    {
+    pthread_mutex_lock(&ft->mutex);
+    while((w->state != WORKER_BUSY) && !ft->quit)
+      pthread_cond_wait(&ft->start_cond, &ft->mutex);
+    if(ft->quit)
+      {
+      pthread_mutex_unlock(&ft->mutex);
+      break;
+      }
+    pthread_mutex_unlock(&ft->mutex);
+
+    w->s.flags &= ~STREAM_HAVE_FRAME;
+    bgav_perf_start(&t, w->s.opt, NULL);
+    w->st = ft->dec->decode(&w->s, w->frame);
+    bgav_perf_stop(&t, &w->s.perf.decode, NULL);
+
+    pthread_mutex_lock(&ft->mutex);
+    w->state = WORKER_DONE;
+    pthread_cond_broadcast(&ft->done_cond);
+    pthread_mutex_unlock(&ft->mutex);
+    }
+  return NULL;
+  }
+
+/* Set up the shadow stream and initialize the decoder. The decoder
+   sees the first packet (peeked from the real stream) during init.
+   Anything it keeps from there is dropped by the resync call. */
+
+static int init_worker(bgav_frame_threads_t * ft, worker_t * w,
+                       bgav_packet_t * first)
+  {
+  memcpy(&w->s, ft->s, sizeof(w->s));
+  gavl_video_format_copy(&w->format, ft->s->data.video.format);
+
+  w->ft = ft;
+  w->s.data.video.format = &w->format;
+  w->s.decoder_priv = NULL;
+  w->s.vframe = NULL;
+  w->s.pp = NULL;
+  w->s.timecode_table = NULL;
+  w->s.flags &= ~STREAM_HAVE_FRAME;
+  memset(&w->s.perf, 0, sizeof(w->s.perf));
+  w->s.perf_parse_total = 0;
+
+  w->s.src.get_func = get_packet_worker;
+  w->s.src.peek_func = peek_packet_worker;
+  w->s.src.data = w;
+
+  w->p = first;
+  w->p_read = 0;
+
+  if(!ft->dec->init(&w->s))
+    {
+    w->p = NULL;
+    return 0;
+    }
+
+  if(ft->dec->resync)
+    ft->dec->resync(&w->s);
+  w->s.flags &= ~STREAM_HAVE_FRAME;
+  w->p = NULL;
+  return 1;
+  }
+
+static void return_packet(bgav_frame_threads_t * ft, worker_t * w)
+  {
+  if(w->p)
+    {
+    bgav_stream_done_packet_read(ft->s, w->p);
+    w->p = NULL;
+    }
+  }
+
+/* Called with the mutex held after the worker is done */
+
+static void merge_perf(bgav_frame_threads_t * ft, worker_t * w)
+  {
+  ft->s->perf.decode.calls += w->s.perf.decode.calls;
+  ft->s->perf.decode.time  += w->s.perf.decode.time;
+  memset(&w->s.perf.decode, 0, sizeof(w->s.perf.decode));
+  }
+
+static void set_idle(bgav_frame_threads_t * ft, worker_t * w)
+  {
+  pthread_mutex_lock(&ft->mutex);
+  w->state = WORKER_IDLE;
+  pthread_mutex_unlock(&ft->mutex);
+  }
+
+/* Wait until the next worker has its frame */
+
+static worker_t * wait_worker(bgav_frame_threads_t * ft)
+  {
+  worker_t * w = &ft->workers[ft->read_idx];
+
+  pthread_mutex_lock(&ft->mutex);
+  while(w->state == WORKER_BUSY)
+    pthread_cond_wait(&ft->done_cond, &ft->mutex);
+  merge_perf(ft, w);
+  pthread_mutex_unlock(&ft->mutex);
+
+  return_packet(ft, w);
+
+  ft->read_idx = (ft->read_idx + 1) % ft->num_workers;
+  ft->num_pending--;
+  return w;
+  }
+
+static void release_held(bgav_frame_threads_t * ft)
+  {
+  if(ft->held)
+    {
+    set_idle(ft,
+             &ft->workers[(ft->read_idx + ft->num_workers - 1) %
+                          ft->num_workers]);
+    ft->held = 0;
+    }
+  }
+
+bgav_frame_threads_t * bgav_frame_threads_create(bgav_stream_t * s,
+                                                 bgav_video_decoder_t * dec)
+  {
+  int i;
+  bgav_packet_t * p = NULL;
+  bgav_frame_threads_t * ret;
+
+  if((s->opt->threads < 2) ||
+     !(dec->flags & VIDEO_DECODER_FRAME_THREADS) ||
+     (s->flags & STREAM_STANDALONE))
+    return NULL;
+
+  if(bgav_stream_peek_packet_read(s, &p, 1) != GAVL_SOURCE_OK)
+    return NULL;
+
+  ret = calloc(1, sizeof(*ret));
+  ret->s = s;
+  ret->dec = dec;
+  ret->workers = calloc(s->opt->threads, sizeof(*ret->workers));
+
+  pthread_mutex_init(&ret->mutex, NULL);
+  pthread_cond_init(&ret->start_cond, NULL);
+  pthread_cond_init(&ret->done_cond, NULL);
+
+  /* The first decoder tells us the format and whether the stream is
+     really intra-only */
+
+  if(!init_worker(ret, &ret->workers[0], p))
+    goto fail;
+  ret->num_workers = 1;
+
+  if(ret->workers[0].s.ci.flags & GAVL_COMPRESSION_HAS_P_FRAMES)
+    goto fail;
+
+  gavl_video_format_copy(s->data.video.format, &ret->workers[0].format);
+  s->ci.flags = ret->workers[0].s.ci.flags;
+
+  for(i = 1; i < s->opt->threads; i++)
+    {
+    if(!init_worker(ret, &ret->workers[i], p))
+      break;
+    ret->num_workers++;
+    }
+
+  for(i = 0; i < ret->num_workers; i++)
+    {
+    ret->workers[i].frame = gavl_video_frame_create(s->data.video.format);
+    if(pthread_create(&ret->workers[i].thread, NULL,
+                      worker_thread, &ret->workers[i]))
+      {
+      bgav_log(s->opt, BGAV_LOG_WARNING, LOG_DOMAIN,
+               "Creating frame thread failed");
+      goto fail;
+      }
+    ret->workers[i].have_thread = 1;
+    }
+
+  if(ret->num_workers < 2)
+    goto fail;
+
+  bgav_log(s->opt, BGAV_LOG_INFO, LOG_DOMAIN,
+           "Decoding with %d frame threads", ret->num_workers);
+  return ret;
+
+  fail:
+  bgav_frame_threads_destroy(ret);
+  return NULL;
+  }
+
+void bgav_frame_threads_destroy(bgav_frame_threads_t * ft)
+  {
+  int i;
+
+  bgav_frame_threads_reset(ft);
+
+  pthread_mutex_lock(&ft->mutex);
+  ft->quit = 1;
+  pthread_cond_broadcast(&ft->start_cond);
+  pthread_mutex_unlock(&ft->mutex);
+
+  for(i = 0; i < ft->num_workers; i++)
+    {
+    if(ft->workers[i].have_thread)
+      pthread_join(ft->workers[i].thread, NULL);
+    if(ft->workers[i].s.decoder_priv)
+      ft->dec->close(&ft->workers[i].s);
+    if(ft->workers[i].frame)
+      gavl_video_frame_destroy(ft->workers[i].frame);
+    }
+  free(ft->workers);
+
+  pthread_mutex_destroy(&ft->mutex);
+  pthread_cond_destroy(&ft->start_cond);
+  pthread_cond_destroy(&ft->done_cond);
+  free(ft);
+  }
+
+void bgav_frame_threads_reset(bgav_frame_threads_t * ft)
+  {
+  int i;
+
+  release_held(ft);
+
+  while(ft->num_pending)
+    set_idle(ft, wait_worker(ft));
+
+  ft->read_idx = 0;
+  ft->eof = 0;
+
+  if(ft->dec->resync)
+    {
+    for(i = 0; i < ft->num_workers; i++)
+      {
+      if(ft->workers[i].s.decoder_priv)
+        ft->dec->resync(&ft->workers[i].s);
+      }
+    }
+  }
+
+gavl_source_status_t
+bgav_frame_threads_read(bgav_frame_threads_t * ft, gavl_video_frame_t ** frame)
+  {
+  worker_t * w;
+  bgav_packet_t * p;
+  gavl_source_status_t st;
+
+  release_held(ft);
+
+  /* Keep all idle workers busy */
+
+  while(!ft->eof && (ft->num_pending < ft->num_workers))
+    {
+    p = NULL;
+
+    if((st = bgav_stream_get_packet_read(ft->s, &p)) != GAVL_SOURCE_OK)
+      {
+      if(st == GAVL_SOURCE_EOF)
+        ft->eof = 1;
+      break;
+      }
+    w = &ft->workers[(ft->read_idx + ft->num_pending) % ft->num_workers];
+
+    w->p = p;
+    w->p_read = 0;
+    w->pts = p->pts;
+    w->duration = p->duration;
+
+    pthread_mutex_lock(&ft->mutex);
+    w->state = WORKER_BUSY;
+    pthread_cond_broadcast(&ft->start_cond);
+    pthread_mutex_unlock(&ft->mutex);
+
+    ft->num_pending++;
+    }
+
+  if(!ft->num_pending)
+    return ft->eof ? GAVL_SOURCE_EOF : GAVL_SOURCE_AGAIN;
+
+  w = wait_worker(ft);
+
+  if(w->st != GAVL_SOURCE_OK)
+    {
+    set_idle(ft, w);
+    return GAVL_SOURCE_EOF;
+    }
+
+  ft->held = 1;
+  if(frame)
+    *frame = w->frame;
+  return GAVL_SOURCE_OK;
+  }
+
+int bgav_frame_threads_skipto(bgav_frame_threads_t * ft, int64_t time,
+                              int64_t * out_time)
+  {
+  worker_t * w;
+
+  release_held(ft);
+
+  while(ft->num_pending)
+    {
+    w = &ft->workers[ft->read_idx];
+    if(w->pts + w->duration > time)
+      {
+      *out_time = w->pts;
+      return 1;
+      }
+    set_idle(ft, wait_worker(ft));
+    }
+  return 0;
+  }
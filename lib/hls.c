@@ -27,9 +27,38 @@
 #include <string.h>
 #include <stdlib.h>
 #include <ctype.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/time.h>
 
 #define LOG_DOMAIN "hls"
 
+/*
+ *  Segments are downloaded by a background thread into a ring of
+ *  buffers. The reader consumes them in order. The ring size is set
+ *  with bgav_options_set_hls_prefetch_segments().
+ */
+
+/* Read size while downloading (the thread checks for stop requests
+   between reads) */
+#define DOWNLOAD_CHUNK (64*1024)
+
+/* Failed downloads in a row, after which a live stream ends */
+#define MAX_FETCH_ERRORS 3
+
+/* Used if the playlist has no #EXT-X-TARGETDURATION */
+#define DEFAULT_TARGET_DURATION 10.0
+
+/*
+ *  Variant selection: Switch to the highest bandwidth variant, which
+ *  needs less than BANDWIDTH_SAFETY of the measured throughput.
+ *  The throughput is averaged over segment downloads with
+ *  BANDWIDTH_WEIGHT for the newest one.
+ */
+
+#define BANDWIDTH_SAFETY 0.8
+#define BANDWIDTH_WEIGHT 0.5
+
 typedef struct
   {
   char * url;
@@ -38,15 +67,25 @@ typedef struct
   int seq;
   } hls_url_t;
 
-#define PROBE_LEN BGAV_ID3V2_DETECT_LEN
+typedef struct
+  {
+  char * url;
+  int bandwidth;
+  } hls_variant_t;
+
+typedef struct
+  {
+  uint8_t * data;
+  int len;
+  int alloc;
+  int seq;
+
+  gavl_dictionary_t m; /* Metadata from the http header */
+  } hls_segment_t;
 
 struct bgav_hls_s
   {
-  uint8_t probe_buffer[PROBE_LEN];
-  int probe_len;
-  int probe_pos;
-  
-  char * url;
+  char * url; // Media playlist
   
   bgav_http_t * stream_socket;
   bgav_http_t * m3u8_socket;
@@ -58,15 +97,46 @@ struct bgav_hls_s
   int urls_alloc;
   int num_urls;
   
-  int seq;
   int end_of_sequence; // End of sequence detected
-  
-  int64_t segment_pos;  // Byte counter
-  int64_t segment_len; // End of segment
+  double target_duration;
+
+  /* Variants from a master playlist, sorted by bandwidth */
+  hls_variant_t * variants;
+  int num_variants;
+  int cur_variant;
+  double bandwidth; // Measured throughput (bits/s), 0 if unknown
 
   bgav_input_context_t * ctx;
   
   int eof;
+
+  /* Prefetch ring. Protected by the mutex except for
+     read_pos and seg_started, which belong to the reader */
+
+  hls_segment_t * segments;
+  int max_segments; // Size of the ring
+  int seg_read;     // Ring index of the segment being read
+  int num_segments; // Complete segments in the ring
+
+  int read_pos;     // Position inside the segment being read
+  int seg_started;  // Metadata of the segment being read were handled
+
+  int fetch_seq;    // Next sequence number to download
+  int fetch_eof;    // No more segments will come
+  int fetch_errors; // Failed downloads in a row
+  int reload_now;   // Reload the live playlist before the next download
+  int64_t fetch_bytes; // Progress of the running download
+  int64_t fetch_total; // Size of the running download (0 if unknown)
+  int seek_gen;     // Incremented on each seek, invalidates running downloads
+
+  gavl_timer_t * timer;
+  gavl_time_t last_reload;
+
+  pthread_t thread;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  int have_thread;
+  int stop;
   };
 
 int bgav_hls_detect(bgav_input_context_t * ctx)
@@ -93,8 +163,9 @@ int bgav_hls_detect(bgav_input_context_t * ctx)
 
   probe_buffer[ctx->total_bytes] = '\0';
   
-  if(strstr(probe_buffer, "\n#EXT-X-STREAM-INF") ||
-     strstr(probe_buffer, "\n#EXT-X-I-FRAME-STREAM-INF"))
+  /* Master playlists are handled as well */
+  if(!strstr(probe_buffer, "#EXTINF") &&
+     !strstr(probe_buffer, "\n#EXT-X-STREAM-INF"))
     goto end;
   
   result = 1;
@@ -125,6 +196,126 @@ static void free_urls(bgav_hls_t * h)
   h->num_urls = 0;
   }
 
+/* Resolve relative URLs against the media playlist */
+
+static char * make_url(bgav_hls_t * h, const char * url)
+  {
+  char * base;
+  char * ret;
+  const char * pos;
+  
+  if(strstr(url, "://") || (*url == '/') || !h->url ||
+     !(pos = strrchr(h->url, '/')))
+    return bgav_input_absolute_url(h->ctx, url);
+
+  base = gavl_strndup(h->url, pos);
+  ret = bgav_sprintf("%s/%s", base, url);
+  free(base);
+  return ret;
+  }
+
+static int compare_variants(const void * p1, const void * p2)
+  {
+  const hls_variant_t * v1 = p1;
+  const hls_variant_t * v2 = p2;
+
+  if(v1->bandwidth < v2->bandwidth)
+    return -1;
+  if(v1->bandwidth > v2->bandwidth)
+    return 1;
+  return 0;
+  }
+
+static void parse_variants(bgav_hls_t * h, const char * m3u8)
+  {
+  int i;
+  char ** lines;
+  char * pos;
+  int bandwidth = -1;
+  int variants_alloc = 0;
+  
+  lines = bgav_stringbreak(m3u8, '\n');
+  i = 0;
+
+  while(lines[i])
+    {
+    if((pos = strchr(lines[i], '\r')))
+      *pos = '\0';
+    i++;
+    }
+
+  i = 0;
+  while(lines[i])
+    {
+    if(!strncasecmp(lines[i], "#EXT-X-STREAM-INF", 17))
+      {
+      bandwidth = 0;
+
+      /* Don't match AVERAGE-BANDWIDTH */
+      if((pos = strstr(lines[i], ":BANDWIDTH=")) ||
+         (pos = strstr(lines[i], ",BANDWIDTH=")))
+        bandwidth = atoi(pos + 11);
+      }
+    else if((*(lines[i]) != '#') && (*(lines[i]) != '\0') &&
+            (bandwidth >= 0))
+      {
+      if(variants_alloc < h->num_variants + 1)
+        {
+        variants_alloc += 8;
+        h->variants = realloc(h->variants,
+                              variants_alloc * sizeof(*h->variants));
+        }
+      h->variants[h->num_variants].url = make_url(h, lines[i]);
+      h->variants[h->num_variants].bandwidth = bandwidth;
+      h->num_variants++;
+      bandwidth = -1;
+      }
+    i++;
+    }
+  bgav_stringbreak_free(lines);
+
+  if(h->num_variants > 1)
+    qsort(h->variants, h->num_variants, sizeof(*h->variants),
+          compare_variants);
+
+  if(h->ctx->opt->dump_indices)
+    {
+    bgav_dprintf("HLS variants\n");
+    for(i = 0; i < h->num_variants; i++)
+      bgav_dprintf("  %d bits/s: %s\n",
+                   h->variants[i].bandwidth, h->variants[i].url);
+    }
+  }
+
+/*
+ *  Without a throughput measurement we start with the lowest
+ *  variant (or the highest one allowed by network_bandwidth)
+ */
+
+static int select_variant(bgav_hls_t * h)
+  {
+  int i;
+  int ret = 0;
+  int cap = h->ctx->opt->network_bandwidth;
+  
+  for(i = 1; i < h->num_variants; i++)
+    {
+    if((cap > 0) && (h->variants[i].bandwidth > cap))
+      break;
+
+    if(h->bandwidth <= 0.0)
+      {
+      if(cap <= 0)
+        break;
+      }
+    else if(h->variants[i].bandwidth > h->bandwidth * BANDWIDTH_SAFETY)
+      break;
+    
+    ret = i;
+    }
+  return ret;
+  }
+
 static void dump_urls(bgav_hls_t * h)
   {
   int i;
@@ -172,6 +363,14 @@ static void parse_urls(bgav_hls_t * h, const char * m3u8)
         seq = atoi(pos);
         }
       }
+    else if(!strncasecmp(lines[i], "#EXT-X-TARGETDURATION", 21))
+      {
+      if((pos = strchr(lines[i], ':')))
+        {
+        pos++;
+        h->target_duration = strtod(pos, NULL);
+        }
+      }
     else if(!strncasecmp(lines[i], "#EXTINF", 7))
       break;
     i++;
@@ -216,7 +415,7 @@ static void parse_urls(bgav_hls_t * h, const char * m3u8)
       }
     else if((*(lines[i]) != '#') && have_extinf)
       {
-      h->urls[h->num_urls].url = bgav_input_absolute_url(h->ctx, lines[i]);
+      h->urls[h->num_urls].url = make_url(h, lines[i]);
       h->urls[h->num_urls].seq = seq++;
       h->num_urls++;
       have_extinf = 0;
@@ -230,35 +429,39 @@ static void parse_urls(bgav_hls_t * h, const char * m3u8)
     }
 
   bgav_stringbreak_free(lines);
-  dump_urls(h);
+
+  if(h->ctx->opt->dump_indices)
+    dump_urls(h);
+  }
+
+static int find_seq(bgav_hls_t * h, int seq)
+  {
+  int i;
+  for(i = 0; i < h->num_urls; i++)
+    {
+    if(h->urls[i].seq == seq)
+      return i;
+    }
+  return -1;
   }
 
-static void handle_id3(bgav_hls_t * h, gavl_dictionary_t * m)
+static void handle_id3(bgav_hls_t * h, hls_segment_t * seg, gavl_dictionary_t * m)
   {
   int len;
-  uint8_t * buf;
   bgav_input_context_t * mem;
   bgav_id3v2_tag_t * id3;
   
-  //  char * 
+  if(seg->len < BGAV_ID3V2_DETECT_LEN)
+    return;
 
-  len = bgav_id3v2_detect(h->probe_buffer);
+  len = bgav_id3v2_detect(seg->data);
     
-  if(!len)
+  if(!len || (len > seg->len))
     return;
   
   // fprintf(stderr, "HLS: Detected ID3 tag\n");
   
-  buf = malloc(len);
-  memcpy(buf, h->probe_buffer, h->probe_len);
-
-  if(bgav_http_read(h->stream_socket, buf + h->probe_len, len - h->probe_len, 1) < len - h->probe_len)
-    {
-    free(buf);
-    return;
-    }
-
-  mem = bgav_input_open_memory(buf, len, h->ctx->opt);
+  mem = bgav_input_open_memory(seg->data, len, h->ctx->opt);
 
   if((id3 = bgav_id3v2_read(mem)))
     {
@@ -270,53 +473,369 @@ static void handle_id3(bgav_hls_t * h, gavl_dictionary_t * m)
   bgav_input_close(mem);
   bgav_input_destroy(mem);
     
-  h->probe_len = 0;
-  h->segment_pos += len;
-  free(buf);
+  h->read_pos = len;
   }
 
-static int load_stream_url(bgav_hls_t * h, int idx)
+/* Called by the reader when a new segment starts */
+
+static void start_segment(bgav_hls_t * h, hls_segment_t * seg)
   {
   gavl_dictionary_t m;
   gavl_dictionary_init(&m);
 
-  bgav_log(h->ctx->opt, BGAV_LOG_DEBUG, LOG_DOMAIN, "Loading %s", h->urls[idx].url);
+  /* Get metadata from the stream socket */
+  gavl_dictionary_copy(&m, &seg->m);
   
-  h->stream_socket = bgav_http_reopen(h->stream_socket, h->urls[idx].url, h->ctx->opt,
+  /* Get metadata from ID3V2 tags */
+  handle_id3(h, seg, &m);
+
+  if(h->ctx->tt &&
+     !gavl_metadata_equal(h->ctx->tt->cur->metadata, &m))
+    {
+    gavl_dictionary_reset(h->ctx->tt->cur->metadata);
+    memcpy(h->ctx->tt->cur->metadata, &m, sizeof(m));
+    gavl_dictionary_init(&m);
+
+    bgav_options_metadata_changed(h->ctx->opt, h->ctx->tt->cur->metadata);
+    }
+  gavl_dictionary_free(&m);
+  h->seg_started = 1;
+  }
+
+/* Download thread */
+
+static void cond_wait_timeout(bgav_hls_t * h, int milliseconds)
+  {
+  struct timeval now;
+  struct timespec abstime;
+
+  gettimeofday(&now, NULL);
+  abstime.tv_sec  = now.tv_sec + milliseconds / 1000;
+  abstime.tv_nsec = (now.tv_usec + (milliseconds % 1000) * 1000) * 1000;
+
+  if(abstime.tv_nsec >= 1000000000)
+    {
+    abstime.tv_sec++;
+    abstime.tv_nsec -= 1000000000;
+    }
+  pthread_cond_timedwait(&h->cond, &h->mutex, &abstime);
+  }
+
+static int download_segment(bgav_hls_t * h, hls_segment_t * seg,
+                            const char * url, int gen)
+  {
+  int64_t len;
+  int bytes_to_read;
+  int result;
+  gavl_time_t start_time;
+  gavl_time_t duration;
+  double rate;
+  
+  bgav_log(h->ctx->opt, BGAV_LOG_DEBUG, LOG_DOMAIN, "Loading %s", url);
+
+  start_time = gavl_timer_get(h->timer);
+
+  h->stream_socket = bgav_http_reopen(h->stream_socket, url, h->ctx->opt,
                                       NULL,
                                       h->stream_header);
-
   if(!h->stream_socket)
     return 0;
+
+  gavl_dictionary_reset(&seg->m);
+  bgav_http_set_metadata(h->stream_socket, &seg->m);
+
+  len = bgav_http_total_bytes(h->stream_socket);
+  seg->len = 0;
+
+  pthread_mutex_lock(&h->mutex);
+  h->fetch_bytes = 0;
+  h->fetch_total = len;
+  pthread_mutex_unlock(&h->mutex);
+
+  while(1)
+    {
+    if(len > 0)
+      {
+      bytes_to_read = len - seg->len;
+      if(bytes_to_read > DOWNLOAD_CHUNK)
+        bytes_to_read = DOWNLOAD_CHUNK;
+      if(!bytes_to_read)
+        break;
+      }
+    else
+      bytes_to_read = DOWNLOAD_CHUNK;
+
+    if(seg->alloc < seg->len + bytes_to_read)
+      {
+      seg->alloc = seg->len + bytes_to_read + (len > 0 ? 0 : DOWNLOAD_CHUNK);
+      seg->data = realloc(seg->data, seg->alloc);
+      }
+
+    result = bgav_http_read(h->stream_socket, seg->data + seg->len,
+                            bytes_to_read, 1);
+    if(result <= 0)
+      break;
+
+    seg->len += result;
+
+    pthread_mutex_lock(&h->mutex);
+    h->fetch_bytes = seg->len;
+    if(h->stop || (gen != h->seek_gen))
+      {
+      pthread_mutex_unlock(&h->mutex);
+      return 0;
+      }
+    pthread_mutex_unlock(&h->mutex);
+    }
+
+  if((len > 0) && (seg->len < len))
+    {
+    bgav_log(h->ctx->opt, BGAV_LOG_WARNING, LOG_DOMAIN,
+             "Segment truncated (%d of %"PRId64" bytes)", seg->len, len);
+    }
+
+  /* Update throughput */
+  duration = gavl_timer_get(h->timer) - start_time;
   
-  h->segment_len = bgav_http_total_bytes(h->stream_socket);
-  h->segment_pos = 0;
+  if(seg->len && (duration > 0))
+    {
+    rate = (double)seg->len * 8.0 * (double)GAVL_TIME_SCALE / (double)duration;
+
+    pthread_mutex_lock(&h->mutex);
+    if(h->bandwidth <= 0.0)
+      h->bandwidth = rate;
+    else
+      h->bandwidth = BANDWIDTH_WEIGHT * rate +
+        (1.0 - BANDWIDTH_WEIGHT) * h->bandwidth;
+    pthread_mutex_unlock(&h->mutex);
+    }
   
-  /* Get metadata from the stream socket */
-  bgav_http_set_metadata(h->stream_socket, &m);
+  return !!seg->len;
+  }
+
+static int reload_m3u8(bgav_hls_t * h)
+  {
+  int len;
+  char * buf;
+  int ret = 0;
+
+  bgav_log(h->ctx->opt, BGAV_LOG_DEBUG, LOG_DOMAIN, "Reloading m3u8");
+
+  if(!(h->m3u8_socket = bgav_http_reopen(h->m3u8_socket, h->url, h->ctx->opt,
+                                         NULL,
+                                         h->m3u8_header)))
+    return 0;
+
+  len = bgav_http_total_bytes(h->m3u8_socket);
+  if(len <= 0)
+    return 0;
 
-  /* Get metadata from m3u8 */
+  buf = malloc(len+1);
+  if(bgav_http_read(h->m3u8_socket, (uint8_t*)buf, len, 1) < len)
+    goto end;
+
+  buf[len] = '\0';
+
+  pthread_mutex_lock(&h->mutex);
+  parse_urls(h, buf);
+  pthread_mutex_unlock(&h->mutex);
+  ret = 1;
+
+  end:
+  free(buf);
+  return ret;
+  }
+
+/*
+ *  Switch variants at segment boundaries. Called with locked mutex.
+ *  Media sequence numbers and timestamps are aligned across variants,
+ *  so we continue with fetch_seq and the demuxer sees a continuous stream.
+ */
+
+static void check_variant(bgav_hls_t * h)
+  {
+  int v;
+  char * old_url;
+  int result;
+
+  if(h->num_variants < 2)
+    return;
+
+  v = select_variant(h);
+  if(v == h->cur_variant)
+    return;
+
+  bgav_log(h->ctx->opt, BGAV_LOG_INFO, LOG_DOMAIN,
+           "Switching to variant with %d bits/s (measured %.0f bits/s)",
+           h->variants[v].bandwidth, h->bandwidth);
   
+  old_url = h->url;
+  h->url = gavl_strdup(h->variants[v].url);
+
+  pthread_mutex_unlock(&h->mutex);
+  result = reload_m3u8(h);
+  pthread_mutex_lock(&h->mutex);
   
-  /* Get metadata from ID3V2 tags */
+  if(result)
+    {
+    h->cur_variant = v;
+    h->last_reload = gavl_timer_get(h->timer);
+    free(old_url);
+    }
+  else
+    {
+    bgav_log(h->ctx->opt, BGAV_LOG_WARNING, LOG_DOMAIN,
+             "Loading variant playlist failed, staying with the current one");
+    free(h->url);
+    h->url = old_url;
+    }
+  }
 
-  h->probe_len = bgav_http_read(h->stream_socket, h->probe_buffer, PROBE_LEN, 1);
-  h->probe_pos = 0;
+/* Milliseconds until the next reload of a live playlist is due */
 
-  handle_id3(h, &m);
+static int reload_delay(bgav_hls_t * h)
+  {
+  gavl_time_t elapsed;
+  gavl_time_t interval;
 
+  interval = gavl_seconds_to_time(h->target_duration > 0.0 ?
+                                  h->target_duration :
+                                  DEFAULT_TARGET_DURATION);
+  elapsed = gavl_timer_get(h->timer) - h->last_reload;
 
-  if(h->ctx->tt &&
-     !gavl_metadata_equal(h->ctx->tt->cur->metadata, &m))
+  if(elapsed >= interval)
+    return 0;
+  return (int)((interval - elapsed) / (GAVL_TIME_SCALE / 1000)) + 1;
+  }
+
+static void * prefetch_thread(void * data)
+  {
+  bgav_hls_t * h = data;
+  hls_segment_t * seg;
+  char * url;
+  int idx;
+  int seq;
+  int delay;
+  int result;
+  int gen;
+
+  pthread_mutex_lock(&h->mutex);
+
+  while(1)
     {
-    gavl_dictionary_reset(h->ctx->tt->cur->metadata);
-    memcpy(h->ctx->tt->cur->metadata, &m, sizeof(m));
-    gavl_dictionary_init(&m);
+    if(h->stop)
+      break;
 
-    bgav_options_metadata_changed(h->ctx->opt, h->ctx->tt->cur->metadata);
+    /* Refresh live playlists on the target duration timer */
+    if(!h->end_of_sequence && (h->reload_now || !reload_delay(h)))
+      {
+      h->reload_now = 0;
+      pthread_mutex_unlock(&h->mutex);
+      result = reload_m3u8(h);
+      pthread_mutex_lock(&h->mutex);
+
+      h->last_reload = gavl_timer_get(h->timer);
+
+      if(!result)
+        bgav_log(h->ctx->opt, BGAV_LOG_WARNING, LOG_DOMAIN,
+                 "Reloading playlist failed");
+      continue;
+      }
+
+    if((h->num_segments >= h->max_segments) || h->fetch_eof)
+      {
+      /* Wait until the reader needs more data */
+      if(h->end_of_sequence)
+        pthread_cond_wait(&h->cond, &h->mutex);
+      else
+        cond_wait_timeout(h, reload_delay(h));
+      continue;
+      }
+
+    idx = find_seq(h, h->fetch_seq);
+
+    if(idx < 0)
+      {
+      if(h->num_urls && (h->urls[0].seq > h->fetch_seq))
+        {
+        /* We fell behind the live window */
+        bgav_log(h->ctx->opt, BGAV_LOG_WARNING, LOG_DOMAIN,
+                 "Segments %d-%d expired", h->fetch_seq, h->urls[0].seq - 1);
+        h->fetch_seq = h->urls[0].seq;
+        }
+      else if(h->end_of_sequence)
+        {
+        h->fetch_eof = 1;
+        pthread_cond_broadcast(&h->cond);
+        }
+      else if((delay = reload_delay(h)))
+        cond_wait_timeout(h, delay);
+      continue;
+      }
+
+    url = gavl_strdup(h->urls[idx].url);
+    seq = h->fetch_seq;
+    gen = h->seek_gen;
+    seg = &h->segments[(h->seg_read + h->num_segments) % h->max_segments];
+
+    pthread_mutex_unlock(&h->mutex);
+    result = download_segment(h, seg, url, gen);
+    free(url);
+    pthread_mutex_lock(&h->mutex);
+
+    if(h->stop)
+      break;
+
+    /* Seeked during the download: Throw it away */
+    if(gen != h->seek_gen)
+      continue;
+
+    if(!result)
+      {
+      h->fetch_errors++;
+      
+      /* Live streams retry after reloading the playlist. If the segment
+         expired meanwhile, we continue with the first one available */
+      if(!h->end_of_sequence && (h->fetch_errors < MAX_FETCH_ERRORS))
+        {
+        bgav_log(h->ctx->opt, BGAV_LOG_WARNING, LOG_DOMAIN,
+                 "Loading segment %d failed, retrying", seq);
+        h->reload_now = 1;
+        continue;
+        }
+      
+      bgav_log(h->ctx->opt, BGAV_LOG_ERROR, LOG_DOMAIN,
+               "Loading segment %d failed", seq);
+      h->fetch_eof = 1;
+      pthread_cond_broadcast(&h->cond);
+      continue;
+      }
+
+    h->fetch_errors = 0;
+    seg->seq = seq;
+    h->num_segments++;
+    h->fetch_seq++;
+    h->fetch_bytes = 0;
+    h->fetch_total = 0;
+    pthread_cond_broadcast(&h->cond);
+
+    check_variant(h);
     }
-  gavl_dictionary_free(&m);
-  return 1;
+
+  pthread_mutex_unlock(&h->mutex);
+  return NULL;
+  }
+
+/* Must be called with locked mutex */
+
+static float get_buffer_fill(bgav_hls_t * h)
+  {
+  float fill;
+
+  fill = h->num_segments;
+  if(h->fetch_total > 0)
+    fill += (float)h->fetch_bytes / (float)h->fetch_total;
+  return fill / h->max_segments;
   }
 
 bgav_hls_t * bgav_hls_create(bgav_input_context_t * ctx)
@@ -326,6 +845,15 @@ bgav_hls_t * bgav_hls_create(bgav_input_context_t * ctx)
   bgav_hls_t * ret;
   ret = calloc(1, sizeof(*ret));
   ret->ctx = ctx;
+
+  ret->max_segments = ctx->opt->hls_prefetch_segments;
+  if(ret->max_segments < 1)
+    ret->max_segments = 1;
+  ret->segments = calloc(ret->max_segments, sizeof(*ret->segments));
+  
+  pthread_mutex_init(&ret->mutex, NULL);
+  pthread_cond_init(&ret->cond, NULL);
+  ret->timer = gavl_timer_create();
   
   // fprintf(stderr, "URL: %s\n", ctx->url);
 
@@ -336,13 +864,7 @@ bgav_hls_t * bgav_hls_create(bgav_input_context_t * ctx)
     goto fail;
 
   m3u8[ctx->total_bytes] = '\0';
-  parse_urls(ret, m3u8);
-  free(m3u8);
-  m3u8 = NULL;
-  
-  if(!ret->num_urls)
-    goto fail;
-  
+
   ret->stream_header = bgav_http_header_create();
   
   bgav_http_header_add_line(ret->stream_header, "User-Agent: "PACKAGE"/"VERSION);
@@ -354,11 +876,48 @@ bgav_hls_t * bgav_hls_create(bgav_input_context_t * ctx)
   bgav_http_header_add_line(ret->m3u8_header, "User-Agent: "PACKAGE"/"VERSION);
   bgav_http_header_add_line(ret->m3u8_header, "Accept: */*");
   bgav_http_header_add_line(ret->m3u8_header, "Connection: Keep-Alive");
+
+  ret->url = gavl_strdup(ctx->url);
+  
+  if(strstr(m3u8, "#EXT-X-STREAM-INF"))
+    {
+    /* Master playlist */
+    parse_variants(ret, m3u8);
+    free(m3u8);
+    m3u8 = NULL;
+
+    if(!ret->num_variants)
+      goto fail;
+    
+    ret->cur_variant = select_variant(ret);
+    free(ret->url);
+    ret->url = gavl_strdup(ret->variants[ret->cur_variant].url);
+
+    bgav_log(ctx->opt, BGAV_LOG_INFO, LOG_DOMAIN,
+             "Got %d variants, starting with %d bits/s", ret->num_variants,
+             ret->variants[ret->cur_variant].bandwidth);
+    
+    if(!reload_m3u8(ret))
+      goto fail;
+    }
+  else
+    {
+    parse_urls(ret, m3u8);
+    free(m3u8);
+    m3u8 = NULL;
+    }
+  
+  if(!ret->num_urls)
+    goto fail;
   
-  ret->seq = ret->urls[0].seq;
+  ret->fetch_seq = ret->urls[0].seq;
   
-  if(!load_stream_url(ret, 0))
+  gavl_timer_start(ret->timer);
+  ret->last_reload = gavl_timer_get(ret->timer);
+
+  if(pthread_create(&ret->thread, NULL, prefetch_thread, ret))
     goto fail;
+  ret->have_thread = 1;
   
   gavl_dictionary_reset(&ret->ctx->m);
   
@@ -375,120 +934,174 @@ bgav_hls_t * bgav_hls_create(bgav_input_context_t * ctx)
   return NULL;
   }
 
-static int reload_m3u8(bgav_hls_t * h)
-  {
-  int len;
-  char * buf;
-  fprintf(stderr, "Reloading m3u8\n");
-
-  if(!(h->m3u8_socket = bgav_http_reopen(h->m3u8_socket, h->ctx->url, h->ctx->opt,
-                                         NULL,
-                                         h->m3u8_header)))
-    return 0;
-
-  len = bgav_http_total_bytes(h->m3u8_socket);
-  if(len <= 0)
-    return 0;
-  
-  buf = malloc(len+1);
-  if(bgav_http_read(h->m3u8_socket, (uint8_t*)buf, len, 1) < len)
-    {
-    free(buf);
-    return 0;
-    }
-  
-  buf[len] = '\0';
-  parse_urls(h, buf);
-  free(buf);
-
-  fprintf(stderr, "Reloaded m3u8\n");
-  
-  return 1;
-  }
-
 int bgav_hls_read(bgav_hls_t * h, uint8_t * data, int len, int block)
   {
   int bytes_to_read;
-  int result;
   int bytes_read = 0;
-  int idx;
-  int i;
+  float fill;
+  hls_segment_t * seg;
 
   if(h->eof)
     return 0;
   
+  pthread_mutex_lock(&h->mutex);
+
   while(bytes_read < len)
     {
-    if(h->segment_pos >= h->segment_len)
+    if(!h->num_segments)
       {
-      fprintf(stderr, "End of segment\n");
-
-      /* Check if we should reload the m3u8 */
-      
-      if(!h->end_of_sequence && !reload_m3u8(h))
-        return 0;
-      
-      /* Open next segment */
-
-      h->seq++;
-
-      idx = -1;
-
-      for(i = 0; i < h->num_urls; i++)
+      if(h->fetch_eof)
         {
-        fprintf(stderr, "Find next segment %d %d\n", h->urls[i].seq, h->seq);
-
-        if(h->urls[i].seq == h->seq)
-          {
-          idx = i;
-          break;
-          }
+        h->eof = 1;
+        bgav_log(h->ctx->opt, BGAV_LOG_INFO, LOG_DOMAIN, "No more segments");
+        break;
         }
+      if(!block)
+        break;
 
-      if(idx < 0)
+      /* The callback is called without the lock */
+      if(h->ctx->opt->buffer_callback)
         {
-        h->eof = 1;
-        bgav_log(h->ctx->opt, BGAV_LOG_INFO, LOG_DOMAIN, "No more segments");
-        return bytes_read;
+        fill = get_buffer_fill(h);
+        pthread_mutex_unlock(&h->mutex);
+        h->ctx->opt->buffer_callback(h->ctx->opt->buffer_callback_data, fill);
+        pthread_mutex_lock(&h->mutex);
+
+        if(h->num_segments || h->fetch_eof)
+          continue;
         }
-      if(!load_stream_url(h, idx))
-        return bytes_read;
+      
+      /* Wait for the download thread */
+      pthread_cond_wait(&h->cond, &h->mutex);
+      continue;
       }
     
+    seg = &h->segments[h->seg_read];
+
+    /* The current segment is never touched by the download thread */
+    pthread_mutex_unlock(&h->mutex);
+
+    if(!h->seg_started)
+      start_segment(h, seg);
+
     bytes_to_read = len - bytes_read;
+    if(bytes_to_read > seg->len - h->read_pos)
+      bytes_to_read = seg->len - h->read_pos;
 
-    /* Try probe buffer */
-    if(h->probe_pos < h->probe_len)
-      {
-      if(bytes_to_read > h->probe_len - h->probe_pos)
-        bytes_to_read = h->probe_len - h->probe_pos;
+    memcpy(data + bytes_read, seg->data + h->read_pos, bytes_to_read);
+    bytes_read += bytes_to_read;
+    h->read_pos += bytes_to_read;
 
-      memcpy(data + bytes_read, &h->probe_buffer[h->probe_pos], bytes_to_read);
-      h->probe_pos += bytes_to_read;
-      result = bytes_to_read;
-      }
-    else
+    pthread_mutex_lock(&h->mutex);
+
+    if(h->read_pos >= seg->len)
       {
-      if(bytes_to_read > h->segment_len - h->segment_pos)
-        bytes_to_read =  h->segment_len - h->segment_pos;
-      result = bgav_http_read(h->stream_socket, data + bytes_read, bytes_to_read, block);
+      /* Segment done: Give the buffer back to the download thread */
+      h->seg_read = (h->seg_read + 1) % h->max_segments;
+      h->num_segments--;
+      h->read_pos = 0;
+      h->seg_started = 0;
+      pthread_cond_broadcast(&h->cond);
       }
-    if(result <= 0)
-      return bytes_read;
-
-    bytes_read += result;
-    h->segment_pos += result;
     }
 
+  pthread_mutex_unlock(&h->mutex);
   return bytes_read;
   }
 
+gavl_time_t bgav_hls_get_duration(bgav_hls_t * h)
+  {
+  int i;
+  double duration = 0.0;
+
+  if(!h->end_of_sequence)
+    return GAVL_TIME_UNDEFINED;
+
+  pthread_mutex_lock(&h->mutex);
+  for(i = 0; i < h->num_urls; i++)
+    duration += h->urls[i].duration;
+  pthread_mutex_unlock(&h->mutex);
+
+  return gavl_seconds_to_time(duration);
+  }
+
+/*
+ *  Seek to the segment containing time. The demuxer must resync
+ *  inside the segment.
+ */
+
+void bgav_hls_seek_time(bgav_hls_t * h, int64_t time, int scale)
+  {
+  int i;
+  double t;
+  double start = 0.0;
+
+  t = (double)time / (double)scale;
+  
+  pthread_mutex_lock(&h->mutex);
+
+  for(i = 0; i < h->num_urls - 1; i++)
+    {
+    if(start + h->urls[i].duration > t)
+      break;
+    start += h->urls[i].duration;
+    }
+
+  bgav_log(h->ctx->opt, BGAV_LOG_DEBUG, LOG_DOMAIN,
+           "Seeking to segment %d (%f seconds)", h->urls[i].seq, start);
+  
+  h->fetch_seq = h->urls[i].seq;
+  h->seek_gen++;
+  
+  h->seg_read = 0;
+  h->num_segments = 0;
+  h->read_pos = 0;
+  h->seg_started = 0;
+  h->fetch_eof = 0;
+  h->fetch_errors = 0;
+  h->fetch_bytes = 0;
+  h->fetch_total = 0;
+  h->eof = 0;
+  
+  pthread_cond_broadcast(&h->cond);
+  pthread_mutex_unlock(&h->mutex);
+  }
+
 void bgav_hls_close(bgav_hls_t * h)
   {
+  int i;
+
+  if(h->have_thread)
+    {
+    pthread_mutex_lock(&h->mutex);
+    h->stop = 1;
+    pthread_cond_broadcast(&h->cond);
+    pthread_mutex_unlock(&h->mutex);
+    pthread_join(h->thread, NULL);
+    }
+
   free_urls(h);
 
   if(h->urls)
     free(h->urls);
+
+  if(h->variants)
+    {
+    for(i = 0; i < h->num_variants; i++)
+      free(h->variants[i].url);
+    free(h->variants);
+    }
+
+  if(h->url)
+    free(h->url);
+
+  for(i = 0; i < h->max_segments; i++)
+    {
+    if(h->segments[i].data)
+      free(h->segments[i].data);
+    gavl_dictionary_free(&h->segments[i].m);
+    }
+  free(h->segments);
   
   if(h->stream_header)
     bgav_http_header_destroy(h->stream_header);
@@ -500,6 +1113,11 @@ void bgav_hls_close(bgav_hls_t * h)
   if(h->m3u8_socket)
     bgav_http_close(h->m3u8_socket);
   
+  if(h->timer)
+    gavl_timer_destroy(h->timer);
+
+  pthread_mutex_destroy(&h->mutex);
+  pthread_cond_destroy(&h->cond);
+
   free(h);
   }
-
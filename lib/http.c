@@ -44,9 +44,49 @@ struct bgav_http_s
   int chunk_eof;
   
   int64_t content_length;
+  int64_t content_pos; // Body bytes read so far
   int can_seek;
+  int reused; // Last request was sent over a kept alive connection
   };
 
+/* Maximum number of unread body bytes we discard to keep
+   a keepalive connection usable */
+#define MAX_DRAIN_BYTES (64*1024)
+
+/*
+ *  Make sure the body of the last response is completely read
+ *  so the connection can be reused for the next request
+ */
+
+static int finish_body(bgav_http_t * h)
+  {
+  uint8_t buf[1024];
+  int64_t bytes_left;
+  int bytes_to_read;
+  
+  if(h->chunked)
+    return h->chunk_eof;
+  
+  if(h->content_length <= 0)
+    return 0;
+
+  bytes_left = h->content_length - h->content_pos;
+
+  if(bytes_left > MAX_DRAIN_BYTES)
+    return 0;
+  
+  while(bytes_left > 0)
+    {
+    bytes_to_read = bytes_left > 1024 ? 1024 : bytes_left;
+    
+    if(bgav_read_data_fd(h->opt, h->fd, buf, bytes_to_read,
+                         h->opt->read_timeout) < bytes_to_read)
+      return 0;
+    bytes_left -= bytes_to_read;
+    }
+  return 1;
+  }
+
 static bgav_http_t *
 do_connect(bgav_http_t * ret, const char * host, int port, const bgav_options_t * opt,
            bgav_http_header_t * request_header,
@@ -77,26 +117,45 @@ do_connect(bgav_http_t * ret, const char * host, int port, const bgav_options_t
     ret->header = NULL;
     }
   
-  if(ret->keepalive_host && strcmp(ret->keepalive_host, host))
+  /* Reuse the connection only if the last response was keepalive
+     and its body was read completely */
+  if((ret->fd >= 0) &&
+     (!ret->keepalive_host || strcmp(ret->keepalive_host, host) ||
+      !finish_body(ret)))
     {
     close(ret->fd);
     ret->fd = -1;
+    }
+
+  if((ret->fd < 0) && ret->keepalive_host)
+    {
     free(ret->keepalive_host);
     ret->keepalive_host = NULL;
     }
   
+  ret->reused = (ret->fd >= 0);
+  
   if(ret->fd < 0)
     {
     ret->fd = bgav_tcp_connect(ret->opt, host, port);
     if(ret->fd == -1)
       goto fail;
     }
+
+  /* Reset per-response state */
+  ret->chunked = 0;
+  ret->chunk_size = 0;
+  ret->chunk_pos = 0;
+  ret->chunk_error = 0;
+  ret->chunk_eof = 0;
+  ret->content_pos = 0;
   
   if(!bgav_http_header_send(ret->opt, request_header, extra_header, ret->fd))
     {
     if(ret->keepalive_host) // Keepalive connection got closed by server
       {
       close(ret->fd);
+      ret->reused = 0;
       ret->fd = bgav_tcp_connect(ret->opt, host, port);
       if((ret->fd == -1) ||
          (!bgav_http_header_send(ret->opt, request_header, extra_header, ret->fd)))
@@ -126,8 +185,14 @@ do_connect(bgav_http_t * ret, const char * host, int port, const bgav_options_t
     ret->keepalive_host = NULL;
     }
   
+  /* HTTP/1.1 connections are persistent unless the server says otherwise */
   var = bgav_http_header_get_var(ret->header, "Connection");
-  if(var && !strcasecmp(var, "Keep-alive"))
+  if(var)
+    {
+    if(!strcasecmp(var, "Keep-alive"))
+      ret->keepalive_host = gavl_strdup(host);
+    }
+  else if(!strncasecmp(bgav_http_header_status_line(ret->header), "HTTP/1.1", 8))
     ret->keepalive_host = gavl_strdup(host);
 
   ret->content_length = 0;
@@ -574,12 +639,27 @@ static int read_chunked(bgav_http_t * h, uint8_t * data, int len, int block)
 static int read_normal(bgav_http_t * h, uint8_t * data, int len, int block)
   {
   int to;
-
+  int result;
+  
   if(block)
     to = h->opt->read_timeout;
   else
     to = 0;
-  return bgav_read_data_fd(h->opt, h->fd, data, len, to);
+
+  /* Never read past the body: On keepalive connections we would
+     block until the timeout */
+  if(h->content_length > 0)
+    {
+    if(h->content_pos >= h->content_length)
+      return 0;
+    if(len > h->content_length - h->content_pos)
+      len = h->content_length - h->content_pos;
+    }
+  
+  result = bgav_read_data_fd(h->opt, h->fd, data, len, to);
+  if(result > 0)
+    h->content_pos += result;
+  return result;
   }
 
 int bgav_http_read(bgav_http_t * h, uint8_t * data, int len, int block)
@@ -705,3 +785,13 @@ int bgav_http_can_seek(bgav_http_t * h)
   return h->can_seek;
   }
 
+int bgav_http_is_keep_alive(bgav_http_t * h)
+  {
+  return !!h->keepalive_host;
+  }
+
+int bgav_http_is_reused(bgav_http_t * h)
+  {
+  return h->reused;
+  }
+
@@ -33,6 +33,24 @@
 
 /* Generic http input module */
 
+/*
+ *  Block cache for seekable resources. Data are cached in aligned
+ *  blocks, which are loaded with bounded range requests over a
+ *  keepalive connection. The number of blocks is set with
+ *  bgav_options_set_http_cache_blocks().
+ */
+
+#define BLOCK_SIZE (256*1024)
+#define MIN_BLOCKS 4
+
+typedef struct
+  {
+  int64_t start; /* -1 if unused */
+  int len;       /* Valid bytes starting at start */
+  uint8_t * data;
+  int64_t last_used;
+  } http_block_t;
+
 typedef struct
   {
   int icy_metaint;
@@ -42,6 +60,14 @@ typedef struct
   bgav_charset_converter_t * charset_cnv;
 
   bgav_hls_t * hls;
+
+  /* Block cache */
+  http_block_t * blocks;
+  int num_blocks;
+  int64_t use_counter;
+
+  int block_mode; /* Set after the first seek */
+  int64_t pos;    /* Position of the next byte returned by read_data() */
   } http_priv;
 
 static bgav_http_header_t * create_header(const bgav_options_t * opt)
@@ -57,6 +83,7 @@ static bgav_http_header_t * create_header(const bgav_options_t * opt)
 
 static int open_http(bgav_input_context_t * ctx, const char * url, char ** r)
   {
+  int i;
   const char * var;
   http_priv * p;
   bgav_http_header_t * header = NULL;
@@ -103,15 +130,215 @@ static int open_http(bgav_input_context_t * ctx, const char * url, char ** r)
   
   ctx->flags |= BGAV_INPUT_DO_BUFFER;
 
+  /* Only HLS can seek by time (see finalize_http) */
+  ctx->flags &= ~BGAV_INPUT_CAN_SEEK_TIME;
+
+  if((ctx->flags & BGAV_INPUT_CAN_SEEK_BYTE) && !p->icy_metaint)
+    {
+    p->num_blocks = ctx->opt->http_cache_blocks;
+    if(p->num_blocks < MIN_BLOCKS)
+      p->num_blocks = MIN_BLOCKS;
+    p->blocks = calloc(p->num_blocks, sizeof(*p->blocks));
+    for(i = 0; i < p->num_blocks; i++)
+      p->blocks[i].start = -1;
+    }
+  
   ctx->url = gavl_strdup(url);
   return 1;
   }
 
+/* Block cache */
+
+static http_block_t * find_block(http_priv * p, int64_t start)
+  {
+  int i;
+  for(i = 0; i < p->num_blocks; i++)
+    {
+    if(p->blocks[i].start == start)
+      return &p->blocks[i];
+    }
+  return NULL;
+  }
+
+/* Get an unused or the least recently used block */
+
+static http_block_t * new_block(http_priv * p, int64_t start)
+  {
+  int i;
+  http_block_t * ret = &p->blocks[0];
+  
+  for(i = 0; i < p->num_blocks; i++)
+    {
+    if(p->blocks[i].start < 0)
+      {
+      ret = &p->blocks[i];
+      break;
+      }
+    if(p->blocks[i].last_used < ret->last_used)
+      ret = &p->blocks[i];
+    }
+
+  if(!ret->data)
+    ret->data = malloc(BLOCK_SIZE);
+  
+  ret->start = start;
+  ret->len = 0;
+  ret->last_used = ++p->use_counter;
+  return ret;
+  }
+
+/* Load the missing part of a block with a range request */
+
+static int fetch_block(bgav_input_context_t * ctx, http_block_t * b)
+  {
+  int64_t start, end;
+  int bytes_to_read;
+  int result;
+  bgav_http_header_t * header;
+  http_priv * p = ctx->priv;
+  
+  start = b->start + b->len;
+  end = b->start + BLOCK_SIZE;
+  
+  if((ctx->total_bytes > 0) && (end > ctx->total_bytes))
+    end = ctx->total_bytes;
+
+  if(start >= end)
+    return 0;
+  
+  header = create_header(ctx->opt);
+  bgav_http_header_add_line_nocpy(header,
+                                  bgav_sprintf("Range: bytes=%"PRId64"-%"PRId64,
+                                               start, end - 1));
+  
+  /* Reuses the connection if the server keeps it alive */
+  p->h = bgav_http_reopen(p->h, ctx->url, ctx->opt, NULL, header);
+  bgav_http_header_destroy(header);
+
+  if(!p->h)
+    return 0;
+
+  ctx->perf_requests++;
+  if(bgav_http_is_reused(p->h))
+    ctx->perf_requests_reused++;
+  
+  if(bgav_http_header_status_code(bgav_http_get_header(p->h)) != 206)
+    {
+    bgav_log(ctx->opt, BGAV_LOG_ERROR, LOG_DOMAIN,
+             "Server ignored range request");
+    bgav_http_close(p->h);
+    p->h = NULL;
+    return 0;
+    }
+  
+  bytes_to_read = end - start;
+  
+  result = bgav_http_read(p->h, b->data + b->len, bytes_to_read, 1);
+  if(result <= 0)
+    return 0;
+  
+  b->len += result;
+  return 1;
+  }
+
+/* Store data read from a streaming connection into the cache */
+
+static void store_data(http_priv * p, int64_t pos,
+                       const uint8_t * data, int len)
+  {
+  int64_t start;
+  int offset;
+  int bytes_to_copy;
+  http_block_t * b;
+  
+  while(len > 0)
+    {
+    offset = pos % BLOCK_SIZE;
+    start = pos - offset;
+
+    if(!(b = find_block(p, start)))
+      {
+      if(offset)
+        return;
+      b = new_block(p, start);
+      }
+    else if(b->len != offset)
+      return;
+    
+    bytes_to_copy = BLOCK_SIZE - offset;
+    if(bytes_to_copy > len)
+      bytes_to_copy = len;
+
+    memcpy(b->data + offset, data, bytes_to_copy);
+    b->len += bytes_to_copy;
+
+    pos += bytes_to_copy;
+    data += bytes_to_copy;
+    len -= bytes_to_copy;
+    }
+  }
+
+static int read_blocks(bgav_input_context_t* ctx,
+                       uint8_t * buffer, int len, int block)
+  {
+  int64_t start;
+  int offset;
+  int bytes_to_copy;
+  int bytes_read = 0;
+  http_block_t * b;
+  http_priv * p = ctx->priv;
+  
+  while(bytes_read < len)
+    {
+    if((ctx->total_bytes > 0) && (p->pos >= ctx->total_bytes))
+      break;
+    
+    offset = p->pos % BLOCK_SIZE;
+    start = p->pos - offset;
+    
+    b = find_block(p, start);
+    
+    if(!b || (b->len <= offset))
+      {
+      /* Nonblocking reads are served from the cache only */
+      if(!block)
+        break;
+      ctx->perf_cache_misses++;
+      if(!b)
+        b = new_block(p, start);
+      if(!fetch_block(ctx, b) || (b->len <= offset))
+        break;
+      }
+    else
+      ctx->perf_cache_hits++;
+
+    b->last_used = ++p->use_counter;
+    
+    bytes_to_copy = b->len - offset;
+    if(bytes_to_copy > len - bytes_read)
+      bytes_to_copy = len - bytes_read;
+
+    memcpy(buffer + bytes_read, b->data + offset, bytes_to_copy);
+    bytes_read += bytes_to_copy;
+    p->pos += bytes_to_copy;
+    }
+  return bytes_read;
+  }
+
 static int64_t seek_byte_http(bgav_input_context_t * ctx,
                            int64_t pos, int whence)
   {
   bgav_http_header_t * header = NULL;
   http_priv * p = ctx->priv;
+
+  if(p->blocks)
+    {
+    /* Data are loaded on demand */
+    p->block_mode = 1;
+    p->pos = ctx->position;
+    return ctx->position;
+    }
+  
   bgav_http_close(p->h);
 
   header = create_header(ctx->opt);
@@ -124,15 +351,36 @@ static int64_t seek_byte_http(bgav_input_context_t * ctx,
   return ctx->position;
   }
 
+static void seek_time_http(bgav_input_context_t * ctx,
+                           int64_t time, int scale)
+  {
+  http_priv * p = ctx->priv;
+
+  if(p->hls)
+    bgav_hls_seek_time(p->hls, time, scale);
+  }
+
 static int read_data(bgav_input_context_t* ctx,
                      uint8_t * buffer, int len, int block)
   {
+  int result;
   http_priv * p = ctx->priv;
   
   if(p->hls)
     return bgav_hls_read(p->hls, buffer, len, block);
-  else
-    return bgav_http_read(p->h, buffer, len, block);
+  else if(p->block_mode)
+    return read_blocks(ctx, buffer, len, block);
+  else if(!p->h)
+    return 0;
+
+  result = bgav_http_read(p->h, buffer, len, block);
+
+  if(p->blocks && (result > 0))
+    {
+    store_data(p, p->pos, buffer, result);
+    p->pos += result;
+    }
+  return result;
   }
 
 static void * memscan(void * mem_start, int size, void * key, int key_len)
@@ -268,6 +516,7 @@ static int read_nonblock_http(bgav_input_context_t * ctx,
 
 static void close_http(bgav_input_context_t * ctx)
   {
+  int i;
   http_priv * p = ctx->priv;
 
   if(p->h)
@@ -279,11 +528,22 @@ static void close_http(bgav_input_context_t * ctx)
   if(p->hls)
     bgav_hls_close(p->hls);
 
+  if(p->blocks)
+    {
+    for(i = 0; i < p->num_blocks; i++)
+      {
+      if(p->blocks[i].data)
+        free(p->blocks[i].data);
+      }
+    free(p->blocks);
+    }
+  
   free(p);
   }
 
 static int finalize_http(bgav_input_context_t * ctx)
   {
+  gavl_time_t duration;
   http_priv * p = ctx->priv;
   if(bgav_hls_detect(ctx))
     {
@@ -293,6 +553,16 @@ static int finalize_http(bgav_input_context_t * ctx)
     
     if(!p->hls)
       return 0;
+
+    /* Byte seeking applied to the playlist */
+    ctx->flags &= ~(BGAV_INPUT_CAN_SEEK_BYTE|BGAV_INPUT_SEEK_SLOW);
+
+    /* VOD playlists can seek by segment */
+    if((duration = bgav_hls_get_duration(p->hls)) != GAVL_TIME_UNDEFINED)
+      {
+      ctx->flags |= BGAV_INPUT_CAN_SEEK_TIME;
+      gavl_dictionary_set_long(&ctx->m, GAVL_META_APPROX_DURATION, duration);
+      }
     return 1;
     }
   else
@@ -307,6 +577,7 @@ const bgav_input_t bgav_input_http =
     .read =          read_http,
     .read_nonblock = read_nonblock_http,
     .seek_byte     = seek_byte_http,
+    .seek_time     = seek_time_http,
     .close =         close_http,
   };
 
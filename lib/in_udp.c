@@ -0,0 +1,426 @@
+/*****************************************************************
+ * gmerlin-avdecoder - a general purpose multimedia decoding library
+ *
+ * Copyright (c) 2001 - 2012 Members of the Gmerlin project
+ * gmerlin-general@lists.sourceforge.net
+ * http://gmerlin.sourceforge.net
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * *****************************************************************/
+
+
+/*
+ *  Raw MPEG-TS over UDP (unicast or multicast), optionally wrapped
+ *  into RTP. URLs are udp://[group]:port or rtp://[group]:port.
+ *
+ *  A receive thread reads the datagrams into a ring of fixed size
+ *  slots, the reader copies the payloads out. Timing comes from the
+ *  PCRs, which the MPEG-TS demuxer evaluates.
+ */
+
+#include <avdec_private.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <sys/socket.h>
+#include <poll.h>
+#endif
+
+#define LOG_DOMAIN "in_udp"
+
+#define NUM_SLOTS 4096
+
+/* Enough for 7 TS packets plus RTP header */
+#define SLOT_SIZE 2048
+
+/* Interval for checking stop requests (milliseconds) */
+#define POLL_INTERVAL 100
+
+#define TS_SYNC 0x47
+
+typedef struct
+  {
+  uint8_t * data;
+  int offset; // Start of the TS data (after the RTP header)
+  int len;
+  } slot_t;
+
+typedef struct
+  {
+  int fd;
+  int rtp; // -1: Unknown, 0: Raw TS, 1: RTP encapsulated
+
+  uint8_t * slab;
+  slot_t slots[NUM_SLOTS];
+
+  int slot_read; // Ring index of the slot being read
+  int num_slots; // Filled slots, protected by the mutex
+  int read_pos;  // Position inside the slot being read (reader only)
+
+  /* Statistics (receive thread only) */
+  int64_t datagrams;
+  int64_t syscalls;
+  uint32_t kernel_drops;
+  
+  pthread_t thread;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  int have_thread;
+  int stop;
+  int eof;
+  } udp_priv_t;
+
+/* Return the offset of the RTP payload or -1 if this is no RTP packet */
+
+static int rtp_payload(const uint8_t * data, int len, int * payload_len)
+  {
+  int offset;
+
+  if((len < 12) || ((data[0] & 0xc0) != 0x80))
+    return -1;
+
+  offset = 12 + (data[0] & 0x0f) * 4;
+
+  /* Extension header */
+  if(data[0] & 0x10)
+    {
+    if(len < offset + 4)
+      return -1;
+    offset += 4 + BGAV_PTR_2_16BE(data + offset + 2) * 4;
+    }
+
+  *payload_len = len - offset;
+
+  /* Padding */
+  if(data[0] & 0x20)
+    *payload_len -= data[len-1];
+
+  if(*payload_len < 0)
+    return -1;
+  
+  return offset;
+  }
+
+static void set_payload(bgav_input_context_t * ctx, slot_t * s, int len)
+  {
+  int offset;
+  int payload_len = 0;
+  udp_priv_t * p = ctx->priv;
+
+  offset = rtp_payload(s->data, len, &payload_len);
+  
+  if(p->rtp < 0)
+    {
+    if(len && (s->data[0] == TS_SYNC))
+      p->rtp = 0;
+    else if((offset >= 0) && (payload_len > 0) &&
+            (s->data[offset] == TS_SYNC))
+      {
+      bgav_log(ctx->opt, BGAV_LOG_INFO, LOG_DOMAIN,
+               "Detected RTP encapsulation");
+      p->rtp = 1;
+      }
+    else
+      {
+      bgav_log(ctx->opt, BGAV_LOG_WARNING, LOG_DOMAIN,
+               "Datagram starts with no sync byte, assuming raw TS");
+      p->rtp = 0;
+      }
+    }
+
+  if(p->rtp && (offset >= 0))
+    {
+    s->offset = offset;
+    s->len = payload_len;
+    }
+  else
+    {
+    s->offset = 0;
+    s->len = len;
+    }
+  }
+
+static void * receive_thread(void * data)
+  {
+  bgav_input_context_t * ctx = data;
+  udp_priv_t * p = ctx->priv;
+  struct pollfd pfd;
+  uint8_t * bufs[BGAV_UDP_MAX_BATCH];
+  int lens[BGAV_UDP_MAX_BATCH];
+  int write_idx;
+  int num;
+  int i;
+  int result;
+  int timeout = 0;
+  
+  pfd.fd = p->fd;
+  pfd.events = POLLIN;
+  
+  pthread_mutex_lock(&p->mutex);
+
+  while(!p->stop)
+    {
+    if(p->num_slots >= NUM_SLOTS)
+      {
+      /* Ring full: The kernel buffer must hold the data until the
+         reader catches up */
+      pthread_cond_wait(&p->cond, &p->mutex);
+      continue;
+      }
+    
+    write_idx = (p->slot_read + p->num_slots) % NUM_SLOTS;
+    num = NUM_SLOTS - p->num_slots;
+    pthread_mutex_unlock(&p->mutex);
+
+    /* Free slots are owned by us */
+    
+    if(num > NUM_SLOTS - write_idx)
+      num = NUM_SLOTS - write_idx;
+    if(num > ctx->opt->udp_batch_size)
+      num = ctx->opt->udp_batch_size;
+    if(num > BGAV_UDP_MAX_BATCH)
+      num = BGAV_UDP_MAX_BATCH;
+    if(num < 1)
+      num = 1;
+    
+    result = bgav_poll(&pfd, 1, POLL_INTERVAL);
+
+    if(result < 0)
+      {
+      pthread_mutex_lock(&p->mutex);
+      break;
+      }
+    else if(!result)
+      {
+      timeout += POLL_INTERVAL;
+      pthread_mutex_lock(&p->mutex);
+      
+      if(timeout >= ctx->opt->read_timeout)
+        {
+        bgav_log(ctx->opt, BGAV_LOG_ERROR, LOG_DOMAIN,
+                 "Got no data for %d milliseconds", timeout);
+        break;
+        }
+      continue;
+      }
+
+    timeout = 0;
+    
+    for(i = 0; i < num; i++)
+      bufs[i] = p->slots[write_idx + i].data;
+    
+    num = bgav_udp_read_batch(p->fd, bufs, lens, SLOT_SIZE, num,
+                              &p->kernel_drops);
+    if(num < 0)
+      num = 0;
+    else
+      {
+      p->syscalls++;
+      p->datagrams += num;
+      }
+    
+    for(i = 0; i < num; i++)
+      set_payload(ctx, &p->slots[write_idx + i], lens[i]);
+
+    pthread_mutex_lock(&p->mutex);
+    if(num)
+      {
+      p->num_slots += num;
+      pthread_cond_broadcast(&p->cond);
+      }
+    }
+
+  p->eof = 1;
+  pthread_cond_broadcast(&p->cond);
+  pthread_mutex_unlock(&p->mutex);
+  return NULL;
+  }
+
+static int open_udp(bgav_input_context_t * ctx, const char * url, char ** r)
+  {
+  int i;
+  int port = -1;
+  char * host = NULL;
+  udp_priv_t * p = NULL;
+  
+  if(!bgav_url_split(url, NULL, NULL, NULL, &host, &port, NULL))
+    {
+    bgav_log(ctx->opt, BGAV_LOG_ERROR, LOG_DOMAIN, "Invalid URL %s", url);
+    return 0;
+    }
+
+  if(port <= 0)
+    {
+    bgav_log(ctx->opt, BGAV_LOG_ERROR, LOG_DOMAIN, "No port given in %s", url);
+    goto fail;
+    }
+  
+  p = calloc(1, sizeof(*p));
+  ctx->priv = p;
+  p->rtp = -1;
+  p->fd = -1;
+  
+  pthread_mutex_init(&p->mutex, NULL);
+  pthread_cond_init(&p->cond, NULL);
+  
+  if((p->fd = bgav_udp_open(ctx->opt, port)) < 0)
+    goto fail;
+
+  if(host && (*host != '\0') &&
+     (bgav_udp_join(ctx->opt, p->fd, host) < 0))
+    goto fail;
+
+  p->slab = malloc(NUM_SLOTS * SLOT_SIZE);
+  for(i = 0; i < NUM_SLOTS; i++)
+    p->slots[i].data = p->slab + i * SLOT_SIZE;
+  
+  if(pthread_create(&p->thread, NULL, receive_thread, ctx))
+    goto fail;
+  p->have_thread = 1;
+
+  ctx->url = gavl_strdup(url);
+  
+  if(host)
+    free(host);
+  return 1;
+
+  fail:
+  if(host)
+    free(host);
+
+  if(p)
+    {
+    if(p->fd >= 0)
+      closesocket(p->fd);
+    if(p->slab)
+      free(p->slab);
+    pthread_mutex_destroy(&p->mutex);
+    pthread_cond_destroy(&p->cond);
+    free(p);
+    ctx->priv = NULL;
+    }
+  return 0;
+  }
+
+static int do_read(bgav_input_context_t * ctx,
+                   uint8_t * buffer, int len, int block)
+  {
+  int bytes_read = 0;
+  int bytes_to_copy;
+  slot_t * s;
+  udp_priv_t * p = ctx->priv;
+
+  pthread_mutex_lock(&p->mutex);
+
+  while(bytes_read < len)
+    {
+    if(!p->num_slots)
+      {
+      if(p->eof || !block)
+        break;
+      pthread_cond_wait(&p->cond, &p->mutex);
+      continue;
+      }
+
+    s = &p->slots[p->slot_read];
+
+    /* Filled slots are owned by us */
+    pthread_mutex_unlock(&p->mutex);
+
+    bytes_to_copy = len - bytes_read;
+    if(bytes_to_copy > s->len - p->read_pos)
+      bytes_to_copy = s->len - p->read_pos;
+
+    memcpy(buffer + bytes_read, s->data + s->offset + p->read_pos,
+           bytes_to_copy);
+    bytes_read += bytes_to_copy;
+    p->read_pos += bytes_to_copy;
+    
+    pthread_mutex_lock(&p->mutex);
+
+    if(p->read_pos >= s->len)
+      {
+      p->slot_read = (p->slot_read + 1) % NUM_SLOTS;
+      p->num_slots--;
+      p->read_pos = 0;
+
+      /* Wake up the receive thread if the ring was full */
+      if(p->num_slots == NUM_SLOTS - 1)
+        pthread_cond_broadcast(&p->cond);
+      }
+    }
+  
+  pthread_mutex_unlock(&p->mutex);
+  return bytes_read;
+  }
+
+static int read_udp(bgav_input_context_t* ctx,
+                    uint8_t * buffer, int len)
+  {
+  return do_read(ctx, buffer, len, 1);
+  }
+
+static int read_nonblock_udp(bgav_input_context_t * ctx,
+                             uint8_t * buffer, int len)
+  {
+  return do_read(ctx, buffer, len, 0);
+  }
+
+static void close_udp(bgav_input_context_t * ctx)
+  {
+  udp_priv_t * p = ctx->priv;
+
+  if(!p)
+    return;
+  
+  if(p->have_thread)
+    {
+    pthread_mutex_lock(&p->mutex);
+    p->stop = 1;
+    pthread_cond_broadcast(&p->cond);
+    pthread_mutex_unlock(&p->mutex);
+    pthread_join(p->thread, NULL);
+    }
+
+  if(p->syscalls)
+    bgav_log(ctx->opt, BGAV_LOG_INFO, LOG_DOMAIN,
+             "%"PRId64" datagrams, %.1f per syscall, %u dropped by the kernel",
+             p->datagrams, (double)p->datagrams / (double)p->syscalls,
+             p->kernel_drops);
+  
+  if(p->fd >= 0)
+    closesocket(p->fd);
+
+  if(p->slab)
+    free(p->slab);
+  
+  pthread_mutex_destroy(&p->mutex);
+  pthread_cond_destroy(&p->cond);
+  free(p);
+  }
+
+const bgav_input_t bgav_input_udp =
+  {
+    .name =          "udp",
+    .open =          open_udp,
+    .read =          read_udp,
+    .read_nonblock = read_nonblock_udp,
+    .close =         close_udp,
+  };
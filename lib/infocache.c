@@ -0,0 +1,650 @@
+/*****************************************************************
+ * gmerlin-avdecoder - a general purpose multimedia decoding library
+ *
+ * Copyright (c) 2001 - 2012 Members of the Gmerlin project
+ * gmerlin-general@lists.sourceforge.net
+ * http://gmerlin.sourceforge.net
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * *****************************************************************/
+
+#include <config.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <avdec_private.h>
+
+#include <gavl/gavf.h>
+#include <gavl/trackinfo.h>
+
+#define LOG_DOMAIN "infocache"
+
+#define INFO_SIGNATURE "BGAVINFO"
+
+/* Version must be increased each time the fileformat
+   changes */
+#define INFO_VERSION 2
+
+/*
+ * Media info cache
+ *
+ * The cache files live in the same directory structure as the
+ * file indices (see fileindex.c) and are named after the same
+ * md5 sum of the filename.
+ *
+ * Format (numbers are written with the gavf I/O routines):
+ *
+ * - Signature "BGAVINFO"
+ * - Version (32)
+ * - Filename
+ * - File size (64)
+ * - File time (st_mtime returned by stat(2)) (64)
+ * - Sample accurate option (32)
+ * - Flags (32)
+ * - Number of tracks (32)
+ * - Global metadata
+ * - EDL present (32)
+ *   - EDL
+ * - Tracks consisting of
+ *   - Track metadata
+ *   - Number of audio, video, text and overlay streams (4 x 32)
+ *   - Stream entries consisting of
+ *     - Stream ID (32)
+ *     - Fourcc (32)
+ *     - Subformat (32)
+ *     - Timescale (32)
+ *     - Container bitrate (32)
+ *     - Codec bitrate (32)
+ *     - Extradata size (32) + Extradata
+ *     - Compression info present (32)
+ *       - ID, flags, bitrate, max packet size, pre skip,
+ *         video buffer size, max ref frames (7 x 32)
+ *       - Global header size (32) + Global header
+ *     - Stream info
+ *
+ * The cache is written once per handle: After a full open or when
+ * new compression infos were obtained, before the decoders are started
+ * (see bgav_info_cache_flush()).
+ */
+
+static int get_key(bgav_t * b, int64_t * size, int64_t * mtime)
+  {
+  struct stat st;
+
+  /* Only local files have a key we can check without
+     reading the file */
+  if(!b->input->index_file || !b->input->filename ||
+     (b->input->filename[0] != '/'))
+    return 0;
+
+  if(stat(b->input->filename, &st))
+    return 0;
+
+  *size = st.st_size;
+  *mtime = st.st_mtime;
+  return 1;
+  }
+
+/* Read/write variable sized data */
+
+static int write_data(gavf_io_t * io, const uint8_t * data, int len)
+  {
+  if(!gavf_io_write_uint32v(io, len))
+    return 0;
+  if(len && (gavf_io_write_data(io, data, len) < len))
+    return 0;
+  return 1;
+  }
+
+static int read_data(gavf_io_t * io, uint8_t ** data, int * len)
+  {
+  uint32_t size;
+
+  if(!gavf_io_read_uint32v(io, &size))
+    return 0;
+
+  *len = size;
+  if(!size)
+    return 1;
+
+  *data = malloc(size + GAVL_PACKET_PADDING);
+  memset(*data + size, 0, GAVL_PACKET_PADDING);
+
+  if(gavf_io_read_data(io, *data, size) < size)
+    return 0;
+  return 1;
+  }
+
+static int write_stream(gavf_io_t * io, bgav_stream_t * s)
+  {
+  if(!gavf_io_write_uint32v(io, s->stream_id) ||
+     !gavf_io_write_uint32v(io, s->fourcc) ||
+     !gavf_io_write_uint32v(io, s->subformat) ||
+     !gavf_io_write_uint32v(io, s->timescale) ||
+     !gavf_io_write_uint32v(io, s->container_bitrate) ||
+     !gavf_io_write_uint32v(io, s->codec_bitrate) ||
+     !write_data(io, s->ext_data, s->ext_size))
+    return 0;
+
+  if(!gavf_io_write_uint32v(io, !!(s->flags & STREAM_GOT_CI)))
+    return 0;
+
+  if(s->flags & STREAM_GOT_CI)
+    {
+    if(!gavf_io_write_uint32v(io, s->ci.id) ||
+       !gavf_io_write_uint32v(io, s->ci.flags) ||
+       !gavf_io_write_uint32v(io, s->ci.bitrate) ||
+       !gavf_io_write_uint32v(io, s->ci.max_packet_size) ||
+       !gavf_io_write_uint32v(io, s->ci.pre_skip) ||
+       !gavf_io_write_uint32v(io, s->ci.video_buffer_size) ||
+       !gavf_io_write_uint32v(io, s->ci.max_ref_frames) ||
+       !write_data(io, s->ci.global_header, s->ci.global_header_len))
+      return 0;
+    }
+
+  return gavl_dictionary_write(io, s->info);
+  }
+
+static void update_stream_pointers(bgav_stream_t * s)
+  {
+  s->m = gavl_stream_get_metadata_nc(s->info);
+
+  switch(s->type)
+    {
+    case GAVF_STREAM_AUDIO:
+      s->data.audio.format = gavl_stream_get_audio_format_nc(s->info);
+      break;
+    case GAVF_STREAM_VIDEO:
+      s->data.video.format = gavl_stream_get_video_format_nc(s->info);
+      break;
+    case GAVF_STREAM_TEXT:
+    case GAVF_STREAM_OVERLAY:
+      s->data.subtitle.video.format =
+        gavl_stream_get_video_format_nc(s->info);
+      break;
+    default:
+      break;
+    }
+  }
+
+static int read_stream(gavf_io_t * io, bgav_stream_t * s)
+  {
+  uint32_t val;
+  int got_ci;
+
+  if(!gavf_io_read_uint32v(io, &val))
+    return 0;
+  s->stream_id = val;
+
+  if(!gavf_io_read_uint32v(io, &s->fourcc) ||
+     !gavf_io_read_uint32v(io, &s->subformat))
+    return 0;
+
+  if(!gavf_io_read_uint32v(io, &val))
+    return 0;
+  s->timescale = val;
+
+  if(!gavf_io_read_uint32v(io, &val))
+    return 0;
+  s->container_bitrate = val;
+
+  if(!gavf_io_read_uint32v(io, &val))
+    return 0;
+  s->codec_bitrate = val;
+
+  if(!read_data(io, &s->ext_data, &s->ext_size))
+    return 0;
+
+  if(!gavf_io_read_uint32v(io, &val))
+    return 0;
+  got_ci = val;
+
+  if(got_ci)
+    {
+    if(!gavf_io_read_uint32v(io, &val))
+      return 0;
+    s->ci.id = val;
+    if(!gavf_io_read_uint32v(io, &val))
+      return 0;
+    s->ci.flags = val;
+    if(!gavf_io_read_uint32v(io, &val))
+      return 0;
+    s->ci.bitrate = val;
+    if(!gavf_io_read_uint32v(io, &val))
+      return 0;
+    s->ci.max_packet_size = val;
+    if(!gavf_io_read_uint32v(io, &val))
+      return 0;
+    s->ci.pre_skip = val;
+    if(!gavf_io_read_uint32v(io, &val))
+      return 0;
+    s->ci.video_buffer_size = val;
+    if(!gavf_io_read_uint32v(io, &val))
+      return 0;
+    s->ci.max_ref_frames = val;
+    if(!read_data(io, &s->ci.global_header, &s->ci.global_header_len))
+      return 0;
+    s->flags |= STREAM_GOT_CI;
+    }
+
+  gavl_dictionary_reset(s->info);
+  if(!gavl_dictionary_read(io, s->info))
+    return 0;
+
+  update_stream_pointers(s);
+  return 1;
+  }
+
+static int read_track(gavf_io_t * io, bgav_track_t * t,
+                      const bgav_options_t * opt)
+  {
+  int i;
+  uint32_t num_audio, num_video, num_text, num_overlay;
+
+  gavl_dictionary_reset(t->metadata);
+  if(!gavl_dictionary_read(io, t->metadata))
+    return 0;
+
+  if(!gavf_io_read_uint32v(io, &num_audio) ||
+     !gavf_io_read_uint32v(io, &num_video) ||
+     !gavf_io_read_uint32v(io, &num_text) ||
+     !gavf_io_read_uint32v(io, &num_overlay))
+    return 0;
+
+  for(i = 0; i < num_audio; i++)
+    {
+    if(!read_stream(io, bgav_track_add_audio_stream(t, opt)))
+      return 0;
+    }
+  for(i = 0; i < num_video; i++)
+    {
+    if(!read_stream(io, bgav_track_add_video_stream(t, opt)))
+      return 0;
+    }
+  for(i = 0; i < num_text; i++)
+    {
+    if(!read_stream(io, bgav_track_add_text_stream(t, opt, NULL)))
+      return 0;
+    }
+  for(i = 0; i < num_overlay; i++)
+    {
+    if(!read_stream(io, bgav_track_add_overlay_stream(t, opt)))
+      return 0;
+    }
+  return 1;
+  }
+
+static int write_track(gavf_io_t * io, bgav_track_t * t)
+  {
+  int i;
+
+  if(!gavl_dictionary_write(io, t->metadata))
+    return 0;
+
+  if(!gavf_io_write_uint32v(io, t->num_audio_streams) ||
+     !gavf_io_write_uint32v(io, t->num_video_streams) ||
+     !gavf_io_write_uint32v(io, t->num_text_streams) ||
+     !gavf_io_write_uint32v(io, t->num_overlay_streams))
+    return 0;
+
+  for(i = 0; i < t->num_audio_streams; i++)
+    {
+    if(!write_stream(io, &t->audio_streams[i]))
+      return 0;
+    }
+  for(i = 0; i < t->num_video_streams; i++)
+    {
+    if(!write_stream(io, &t->video_streams[i]))
+      return 0;
+    }
+  for(i = 0; i < t->num_text_streams; i++)
+    {
+    if(!write_stream(io, &t->text_streams[i]))
+      return 0;
+    }
+  for(i = 0; i < t->num_overlay_streams; i++)
+    {
+    if(!write_stream(io, &t->overlay_streams[i]))
+      return 0;
+    }
+  return 1;
+  }
+
+int bgav_info_cache_read(bgav_t * b)
+  {
+  int i;
+  int ret = 0;
+  char * filename = NULL;
+  char * str = NULL;
+  FILE * in = NULL;
+  gavf_io_t * io = NULL;
+  bgav_track_table_t * tt = NULL;
+  uint8_t sig[8];
+  uint32_t val;
+  uint32_t num_tracks;
+  int64_t size, mtime;
+  int64_t file_size, file_time;
+
+  if(!get_key(b, &size, &mtime))
+    return 0;
+
+  filename = bgav_search_file_read(&b->opt, "infocache",
+                                   b->input->index_file);
+  if(!filename)
+    return 0;
+
+  if(!(in = fopen(filename, "rb")))
+    goto fail;
+
+  io = gavf_io_create_file(in, 0, 1, 1);
+  in = NULL;
+
+  /* Check key */
+
+  if((gavf_io_read_data(io, sig, 8) < 8) ||
+     memcmp(sig, INFO_SIGNATURE, 8) ||
+     !gavf_io_read_uint32v(io, &val) ||
+     (val != INFO_VERSION))
+    goto fail;
+
+  if(!gavf_io_read_string(io, &str) ||
+     strcmp(str, b->input->filename) ||
+     !gavf_io_read_int64v(io, &file_size) ||
+     !gavf_io_read_int64v(io, &file_time) ||
+     (file_size != size) ||
+     (file_time != mtime) ||
+     !gavf_io_read_uint32v(io, &val) ||
+     (val != b->opt.sample_accurate) ||
+     !gavf_io_read_uint32v(io, &val))
+    goto fail;
+
+  b->info_cache_flags = val;
+
+  /* Tracks */
+
+  if(!gavf_io_read_uint32v(io, &num_tracks) || !num_tracks)
+    goto fail;
+  
+  tt = bgav_track_table_create(num_tracks);
+
+  if(!gavl_dictionary_read(io, gavl_dictionary_get_dictionary_create(&tt->info,
+                                                                      GAVL_META_METADATA)) ||
+     !gavf_io_read_uint32v(io, &val))
+    goto fail;
+
+  if(val &&
+     !gavl_dictionary_read(io, gavl_dictionary_get_dictionary_create(&tt->info,
+                                                                      GAVL_META_EDL)))
+    goto fail;
+
+  for(i = 0; i < num_tracks; i++)
+    {
+    if(!read_track(io, &tt->tracks[i], &b->opt))
+      goto fail;
+    }
+
+  bgav_log(&b->opt, BGAV_LOG_DEBUG, LOG_DOMAIN,
+           "Got media info from %s", filename);
+
+  b->tt = tt;
+  tt = NULL;
+  ret = 1;
+
+  fail:
+
+  if(tt)
+    bgav_track_table_unref(tt);
+  if(io)
+    gavf_io_destroy(io);
+  if(in)
+    fclose(in);
+  if(str)
+    free(str);
+  free(filename);
+  return ret;
+  }
+
+void bgav_info_cache_write(bgav_t * b)
+  {
+  int i;
+  int flags = 0;
+  char * filename;
+  FILE * out;
+  gavf_io_t * io;
+  int64_t size, mtime;
+  const gavl_dictionary_t * edl;
+
+  /* Don't cache estimates from the info only mode */
+  if(!b->tt || !b->demuxer || bgav_is_redirector(b) ||
+     (b->demuxer->flags & BGAV_DEMUXER_INCOMPLETE) ||
+     !get_key(b, &size, &mtime))
+    return;
+
+  filename = bgav_search_file_write(&b->opt, "infocache",
+                                    b->input->index_file);
+  if(!filename)
+    return;
+
+  if(!(out = fopen(filename, "wb")))
+    {
+    bgav_log(&b->opt, BGAV_LOG_WARNING, LOG_DOMAIN,
+             "Cannot open %s for writing", filename);
+    free(filename);
+    return;
+    }
+
+  io = gavf_io_create_file(out, 1, 1, 1);
+
+  if(bgav_can_seek(b))
+    flags |= BGAV_INFO_CACHE_CAN_SEEK;
+
+  if((gavf_io_write_data(io, (const uint8_t*)INFO_SIGNATURE, 8) < 8) ||
+     !gavf_io_write_uint32v(io, INFO_VERSION) ||
+     !gavf_io_write_string(io, b->input->filename) ||
+     !gavf_io_write_int64v(io, size) ||
+     !gavf_io_write_int64v(io, mtime) ||
+     !gavf_io_write_uint32v(io, b->opt.sample_accurate) ||
+     !gavf_io_write_uint32v(io, flags) ||
+     !gavf_io_write_uint32v(io, b->tt->num_tracks) ||
+     !gavl_dictionary_write(io, gavl_dictionary_get_dictionary(&b->tt->info,
+                                                               GAVL_META_METADATA)))
+    goto fail;
+
+  edl = gavl_dictionary_get_dictionary(&b->tt->info, GAVL_META_EDL);
+
+  if(!gavf_io_write_uint32v(io, !!edl) ||
+     (edl && !gavl_dictionary_write(io, edl)))
+    goto fail;
+
+  for(i = 0; i < b->tt->num_tracks; i++)
+    {
+    if(!write_track(io, &b->tt->tracks[i]))
+      goto fail;
+    }
+  gavf_io_destroy(io);
+  free(filename);
+  return;
+
+  fail:
+
+  /* Don't leave a truncated file behind */
+  gavf_io_destroy(io);
+  remove(filename);
+  free(filename);
+  }
+
+void bgav_info_cache_flush(bgav_t * b)
+  {
+  if(!b->info_cache_dirty || b->info_cache_written)
+    return;
+  
+  bgav_info_cache_write(b);
+  b->info_cache_dirty = 0;
+  b->info_cache_written = 1;
+  }
+
+/*
+ *  Take over the streams of the demuxer's track table into the cached
+ *  one. The formats and metadata are updated in place, so pointers the
+ *  application got after bgav_open() stay valid.
+ */
+
+static int tables_match(const bgav_track_table_t * ctt,
+                        const bgav_track_table_t * dtt)
+  {
+  int i;
+
+  if(ctt->num_tracks != dtt->num_tracks)
+    return 0;
+
+  for(i = 0; i < ctt->num_tracks; i++)
+    {
+    if((ctt->tracks[i].num_audio_streams != dtt->tracks[i].num_audio_streams) ||
+       (ctt->tracks[i].num_video_streams != dtt->tracks[i].num_video_streams) ||
+       (ctt->tracks[i].num_text_streams != dtt->tracks[i].num_text_streams) ||
+       (ctt->tracks[i].num_overlay_streams != dtt->tracks[i].num_overlay_streams))
+      return 0;
+    }
+  return 1;
+  }
+
+static void merge_stream(bgav_stream_t * cs, bgav_stream_t * ds,
+                         bgav_track_t * ct)
+  {
+  switch(ds->type)
+    {
+    case GAVF_STREAM_AUDIO:
+      gavl_audio_format_copy(cs->data.audio.format, ds->data.audio.format);
+      ds->data.audio.format = cs->data.audio.format;
+      break;
+    case GAVF_STREAM_VIDEO:
+      gavl_video_format_copy(cs->data.video.format, ds->data.video.format);
+      ds->data.video.format = cs->data.video.format;
+      break;
+    case GAVF_STREAM_TEXT:
+    case GAVF_STREAM_OVERLAY:
+      gavl_video_format_copy(cs->data.subtitle.video.format,
+                             ds->data.subtitle.video.format);
+      ds->data.subtitle.video.format = cs->data.subtitle.video.format;
+      break;
+    default:
+      break;
+    }
+
+  gavl_dictionary_reset(cs->m);
+  gavl_dictionary_copy(cs->m, ds->m);
+
+  ds->info = cs->info;
+  ds->m = cs->m;
+  ds->track = ct;
+
+  /* Keep compression infos obtained in earlier sessions */
+  if(!(ds->flags & STREAM_GOT_CI) && (cs->flags & STREAM_GOT_CI))
+    {
+    gavl_compression_info_free(&ds->ci);
+    gavl_compression_info_copy(&ds->ci, &cs->ci);
+    ds->flags |= STREAM_GOT_CI;
+    }
+  }
+
+static void merge_track(bgav_track_t * ct, bgav_track_t * dt)
+  {
+  int i;
+
+  for(i = 0; i < dt->num_audio_streams; i++)
+    merge_stream(&ct->audio_streams[i], &dt->audio_streams[i], ct);
+  for(i = 0; i < dt->num_video_streams; i++)
+    merge_stream(&ct->video_streams[i], &dt->video_streams[i], ct);
+  for(i = 0; i < dt->num_text_streams; i++)
+    merge_stream(&ct->text_streams[i], &dt->text_streams[i], ct);
+  for(i = 0; i < dt->num_overlay_streams; i++)
+    merge_stream(&ct->overlay_streams[i], &dt->overlay_streams[i], ct);
+
+  gavl_dictionary_reset(ct->metadata);
+  gavl_dictionary_copy(ct->metadata, dt->metadata);
+  
+  /* The cached streams are replaced by the ones of the demuxer */
+  bgav_track_free(ct);
+
+  ct->num_audio_streams   = dt->num_audio_streams;
+  ct->num_video_streams   = dt->num_video_streams;
+  ct->num_text_streams    = dt->num_text_streams;
+  ct->num_overlay_streams = dt->num_overlay_streams;
+  ct->audio_streams       = dt->audio_streams;
+  ct->video_streams       = dt->video_streams;
+  ct->text_streams        = dt->text_streams;
+  ct->overlay_streams     = dt->overlay_streams;
+  ct->priv                = dt->priv;
+  ct->flags               = dt->flags;
+
+  dt->num_audio_streams   = 0;
+  dt->num_video_streams   = 0;
+  dt->num_text_streams    = 0;
+  dt->num_overlay_streams = 0;
+  dt->audio_streams       = NULL;
+  dt->video_streams       = NULL;
+  dt->text_streams        = NULL;
+  dt->overlay_streams     = NULL;
+  dt->priv                = NULL;
+  }
+
+static void replace_table(bgav_track_table_t ** tt,
+                          bgav_track_table_t * dtt,
+                          bgav_track_table_t * ctt)
+  {
+  if(*tt != dtt)
+    return;
+  bgav_track_table_unref(*tt);
+  *tt = ctt;
+  bgav_track_table_ref(ctt);
+  }
+
+int bgav_info_cache_merge(bgav_t * b, bgav_track_table_t * ctt)
+  {
+  int i;
+  const gavl_dictionary_t * edl;
+  bgav_track_table_t * dtt = b->tt;
+
+  if(!dtt || !tables_match(ctt, dtt))
+    return 0;
+
+  for(i = 0; i < ctt->num_tracks; i++)
+    merge_track(&ctt->tracks[i], &dtt->tracks[i]);
+
+  ctt->cur = ctt->tracks + (dtt->cur - dtt->tracks);
+
+  if(!gavl_dictionary_get_dictionary(&ctt->info, GAVL_META_EDL) &&
+     (edl = gavl_dictionary_get_dictionary(&dtt->info, GAVL_META_EDL)))
+    gavl_dictionary_copy(gavl_dictionary_get_dictionary_create(&ctt->info,
+                                                               GAVL_META_EDL),
+                         edl);
+
+  /* dtt is freed after the last reference is gone */
+  bgav_track_table_ref(dtt);
+
+  replace_table(&b->tt, dtt, ctt);
+  if(b->input)
+    replace_table(&b->input->tt, dtt, ctt);
+  if(b->demuxer)
+    replace_table(&b->demuxer->tt, dtt, ctt);
+
+  bgav_track_table_unref(dtt);
+
+  bgav_track_table_compute_info(ctt);
+  return 1;
+  }
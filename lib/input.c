@@ -36,13 +36,42 @@
 #define ALLOC_SIZE    128
 #define MAX_REDIRECTIONS 5
 
+/* Calls of the input module with performance counters */
+
+static int input_read(bgav_input_context_t * ctx, uint8_t * buffer, int len)
+  {
+  int ret;
+  bgav_perf_timer_t t;
+  
+  bgav_perf_start(&t, ctx->opt, NULL);
+  ret = ctx->input->read(ctx, buffer, len);
+  bgav_perf_stop(&t, &ctx->perf_read, &ctx->perf_total);
+  if(ret > 0)
+    ctx->perf_read.bytes += ret;
+  return ret;
+  }
+
+static int input_read_nonblock(bgav_input_context_t * ctx,
+                               uint8_t * buffer, int len)
+  {
+  int ret;
+  bgav_perf_timer_t t;
+  
+  bgav_perf_start(&t, ctx->opt, NULL);
+  ret = ctx->input->read_nonblock(ctx, buffer, len);
+  bgav_perf_stop(&t, &ctx->perf_read, &ctx->perf_total);
+  if(ret > 0)
+    ctx->perf_read.bytes += ret;
+  return ret;
+  }
+
 static void do_buffer(bgav_input_context_t * ctx)
   {
   if(ctx->flags & BGAV_INPUT_DO_BUFFER)
     {
     ctx->buffer_size +=
-      ctx->input->read_nonblock(ctx, ctx->buffer + ctx->buffer_size,
-                                ctx->buffer_alloc - ctx->buffer_size);
+      input_read_nonblock(ctx, ctx->buffer + ctx->buffer_size,
+                          ctx->buffer_alloc - ctx->buffer_size);
     }
   }
 
@@ -216,7 +245,7 @@ int bgav_input_read_data(bgav_input_context_t * ctx, uint8_t * buffer, int len)
   if(len > bytes_to_copy)
     {
     result =
-      ctx->input->read(ctx, &buffer[bytes_to_copy], len - bytes_to_copy);
+      input_read(ctx, &buffer[bytes_to_copy], len - bytes_to_copy);
     if(result < 0)
       result = 0;
     ret = bytes_to_copy + result;
@@ -241,8 +270,8 @@ void bgav_input_ensure_buffer_size(bgav_input_context_t * ctx, int len)
       ctx->buffer = realloc(ctx->buffer, ctx->buffer_alloc);
       }
     result =
-      ctx->input->read(ctx, &ctx->buffer[ctx->buffer_size],
-                      len - ctx->buffer_size);
+      input_read(ctx, &ctx->buffer[ctx->buffer_size],
+                 len - ctx->buffer_size);
     if(result < 0)
       result = 0;
     ctx->buffer_size += result;
@@ -630,6 +659,7 @@ extern const bgav_input_t bgav_input_mms;
 extern const bgav_input_t bgav_input_http;
 extern const bgav_input_t bgav_input_ftp;
 extern const bgav_input_t bgav_input_mmsh;
+extern const bgav_input_t bgav_input_udp;
 
 #ifdef HAVE_CDIO
 extern const bgav_input_t bgav_input_vcd;
@@ -661,6 +691,7 @@ void bgav_inputs_dump()
   bgav_dprintf( "<li>%s\n", bgav_input_mmsh.name);
   bgav_dprintf( "<li>%s\n", bgav_input_http.name);
   bgav_dprintf( "<li>%s\n", bgav_input_ftp.name);
+  bgav_dprintf( "<li>%s\n", bgav_input_udp.name);
 
 #ifdef HAVE_CDIO
 
@@ -783,6 +814,9 @@ static int input_open(bgav_input_context_t * ctx,
       ctx->input = &bgav_input_ftp;
     else if(!strcasecmp(protocol, "mmsh"))
       ctx->input = &bgav_input_mmsh;
+    else if(!strcasecmp(protocol, "udp") ||
+            !strcasecmp(protocol, "rtp"))
+      ctx->input = &bgav_input_udp;
     else if(!strcasecmp(protocol, "file"))
       ctx->input = &bgav_input_file;
     else if(!strcasecmp(protocol, "stdin") || !strcmp(url, "-"))
@@ -1057,6 +1091,7 @@ void bgav_input_seek(bgav_input_context_t * ctx,
                      int64_t position,
                      int whence)
   {
+  bgav_perf_timer_t t;
   /*
    *  ctx->position MUST be set before seeking takes place
    *  because some seek() methods might use the position value
@@ -1074,7 +1109,9 @@ void bgav_input_seek(bgav_input_context_t * ctx,
       ctx->position = ctx->total_bytes + position;
       break;
     }
+  bgav_perf_start(&t, ctx->opt, NULL);
   ctx->input->seek_byte(ctx, position, whence);
+  bgav_perf_stop(&t, &ctx->perf_seek, &ctx->perf_total);
   ctx->buffer_size = 0;
   }
 
@@ -1102,7 +1139,7 @@ void bgav_input_buffer(bgav_input_context_t * ctx)
     bytes_to_read = ctx->buffer_alloc / 20;
     if(bytes_to_read > ctx->buffer_alloc - ctx->buffer_size)
       bytes_to_read = ctx->buffer_alloc - ctx->buffer_size;
-    result = ctx->input->read(ctx, ctx->buffer + ctx->buffer_size, bytes_to_read);
+    result = input_read(ctx, ctx->buffer + ctx->buffer_size, bytes_to_read);
 
     if(result < bytes_to_read)
       return;
@@ -1119,16 +1156,45 @@ void bgav_input_buffer(bgav_input_context_t * ctx)
 
 int bgav_input_read_sector(bgav_input_context_t * ctx, uint8_t * buf)
   {
+  int ret;
+  bgav_perf_timer_t t;
+  
   if(!ctx->input->read_sector)
     return 0;
-  return ctx->input->read_sector(ctx, buf);
+  
+  bgav_perf_start(&t, ctx->opt, NULL);
+  ret = ctx->input->read_sector(ctx, buf);
+  bgav_perf_stop(&t, &ctx->perf_read, &ctx->perf_total);
+  if(ret)
+    ctx->perf_read.bytes += ctx->sector_size;
+  return ret;
   }
 
 void bgav_input_seek_sector(bgav_input_context_t * ctx,
                             int64_t sector)
   {
-  if(ctx->input->seek_sector)
-    ctx->input->seek_sector(ctx, sector);
+  bgav_perf_timer_t t;
+  
+  if(!ctx->input->seek_sector)
+    return;
+  
+  bgav_perf_start(&t, ctx->opt, NULL);
+  ctx->input->seek_sector(ctx, sector);
+  bgav_perf_stop(&t, &ctx->perf_seek, &ctx->perf_total);
+  }
+
+void bgav_input_seek_time(bgav_input_context_t * ctx,
+                          int64_t time, int scale)
+  {
+  bgav_perf_timer_t t;
+  
+  if(!ctx->input->seek_time)
+    return;
+  
+  bgav_perf_start(&t, ctx->opt, NULL);
+  ctx->input->seek_time(ctx, time, scale);
+  bgav_perf_stop(&t, &ctx->perf_seek, &ctx->perf_total);
+  ctx->buffer_size = 0;
   }
 
 bgav_input_context_t * bgav_input_create(const bgav_options_t * opt)
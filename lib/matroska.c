@@ -201,9 +201,21 @@ int bgav_mkv_read_id(bgav_input_context_t * ctx, int * ret)
   
 int bgav_mkv_element_read(bgav_input_context_t * ctx, bgav_mkv_element_t * ret)
   {
-  if(!bgav_mkv_read_id(ctx, &ret->id) ||
-     !bgav_mkv_read_size(ctx, &ret->size))
+  int64_t size_pos;
+  int size_len;
+  
+  if(!bgav_mkv_read_id(ctx, &ret->id))
     return 0;
+
+  size_pos = ctx->position;
+  
+  if(!bgav_mkv_read_size(ctx, &ret->size))
+    return 0;
+
+  /* All value bits set means unknown size */
+  size_len = ctx->position - size_pos;
+  ret->unknown_size = (ret->size == (1LL << (7 * size_len)) - 1);
+  
   ret->end = ctx->position + ret->size;
   return 1;
   }
@@ -2059,9 +2071,9 @@ void bgav_mkv_cluster_free(bgav_mkv_cluster_t * c)
 
 /* Block */
 
-int bgav_mkv_block_read(bgav_input_context_t * ctx,
-                         bgav_mkv_block_t * ret,
-                         bgav_mkv_element_t * parent)
+int bgav_mkv_block_read_header(bgav_input_context_t * ctx,
+                               bgav_mkv_block_t * ret,
+                               bgav_mkv_element_t * parent)
   {
   uint8_t tmp_8;
   int data_alloc_save;
@@ -2097,7 +2109,16 @@ int bgav_mkv_block_read(bgav_input_context_t * ctx,
     }
 
   ret->data_size = parent->size - (ctx->position - pos);
+  return 1;
+  }
 
+int bgav_mkv_block_read(bgav_input_context_t * ctx,
+                        bgav_mkv_block_t * ret,
+                        bgav_mkv_element_t * parent)
+  {
+  if(!bgav_mkv_block_read_header(ctx, ret, parent))
+    return 0;
+  
   if(ret->data_alloc < ret->data_size)
     {
     ret->data_alloc = ret->data_size + 1024;
@@ -2128,7 +2149,9 @@ void bgav_mkv_block_free(bgav_mkv_block_t * b)
 
 int bgav_mkv_block_group_read(bgav_input_context_t * ctx,
                               bgav_mkv_block_group_t * ret,
-                              bgav_mkv_element_t * parent)
+                              bgav_mkv_element_t * parent,
+                              bgav_mkv_block_func block_func,
+                              void * block_priv)
   {
   bgav_mkv_element_t e;
   ret->block.data_size = 0;
@@ -2168,7 +2191,13 @@ int bgav_mkv_block_group_read(bgav_input_context_t * ctx,
         break;
       case MKV_ID_Block:
       case MKV_ID_SimpleBlock:
-        if(!bgav_mkv_block_read(ctx, &ret->block, &e))
+        if(block_func)
+          {
+          if(!bgav_mkv_block_read_header(ctx, &ret->block, &e) ||
+             !block_func(block_priv, &ret->block))
+            return 0;
+          }
+        else if(!bgav_mkv_block_read(ctx, &ret->block, &e))
           return 0;
         break;
       default:
@@ -79,6 +79,11 @@ void bgav_options_set_rtp_try_tcp(bgav_options_t*b, int p)
   b->rtp_try_tcp = p;
   }
 
+void bgav_options_set_udp_batch_size(bgav_options_t*b, int num)
+  {
+  b->udp_batch_size = num;
+  }
+
 void bgav_options_set_sample_accurate(bgav_options_t*b, int p)
   {
   b->sample_accurate = p;
@@ -94,6 +99,21 @@ void bgav_options_set_cache_size(bgav_options_t*opt, int s)
   opt->cache_size = s;
   }
 
+void bgav_options_set_follow(bgav_options_t*opt, int interval)
+  {
+  opt->follow = interval;
+  }
+
+void bgav_options_set_info_cache(bgav_options_t*opt, int enable)
+  {
+  opt->info_cache = enable;
+  }
+
+void bgav_options_set_info_only(bgav_options_t*opt, int enable)
+  {
+  opt->info_only = enable;
+  }
+
 void bgav_options_set_http_proxy_auth(bgav_options_t*b, int i)
   {
   b->http_proxy_auth = i;
@@ -119,6 +139,16 @@ void bgav_options_set_http_shoutcast_metadata(bgav_options_t*b, int m)
   b->http_shoutcast_metadata = m;
   }
 
+void bgav_options_set_http_cache_blocks(bgav_options_t*b, int n)
+  {
+  b->http_cache_blocks = n;
+  }
+
+void bgav_options_set_hls_prefetch_segments(bgav_options_t*b, int n)
+  {
+  b->hls_prefetch_segments = n;
+  }
+
 void bgav_options_set_ftp_anonymous_password(bgav_options_t*b, const char * h)
   {
   if(b->ftp_anonymous_password)
@@ -194,6 +224,12 @@ void bgav_options_set_dv_datetime(bgav_options_t* opt,
   opt->dv_datetime = datetime;
   }
 
+void bgav_options_set_mpegts_multiplex(bgav_options_t* opt,
+                                       int multiplex)
+  {
+  opt->mpegts_multiplex = multiplex;
+  }
+
 void bgav_options_set_shrink(bgav_options_t* opt,
                              int shrink)
   {
@@ -217,6 +253,21 @@ void bgav_options_set_threads(bgav_options_t * opt, int threads)
   opt->threads = threads;
   }
 
+void bgav_options_set_pipeline(bgav_options_t * opt, int pipeline)
+  {
+  opt->pipeline = pipeline;
+  }
+
+void bgav_options_set_stream_copy(bgav_options_t * opt, int enable)
+  {
+  opt->stream_copy = enable;
+  }
+
+void bgav_options_set_seamless(bgav_options_t * opt, int seamless)
+  {
+  opt->seamless = seamless;
+  }
+
 void bgav_options_set_dump_headers(bgav_options_t* opt,
                                    int enable)
   {
@@ -235,6 +286,12 @@ void bgav_options_set_dump_packets(bgav_options_t* opt,
   opt->dump_packets = enable;
   }
 
+void bgav_options_set_perf_counters(bgav_options_t* opt,
+                                    int enable)
+  {
+  opt->perf_counters = enable;
+  }
+
 
 #define FREE(ptr) if(ptr) free(ptr)
 
@@ -260,6 +317,9 @@ void bgav_options_set_defaults(bgav_options_t * b)
   b->cache_size = 20;
   b->vdpau = 1;
   b->threads = 1;
+  b->udp_batch_size = 32;
+  b->http_cache_blocks = 64;
+  b->hls_prefetch_segments = 3;
 
   b->vaapi = 1;
 
@@ -297,6 +357,9 @@ void bgav_options_copy(bgav_options_t * dst, const bgav_options_t * src)
   CP_INT(sample_accurate);
   CP_INT(cache_time);
   CP_INT(cache_size);
+  CP_INT(follow);
+  CP_INT(info_cache);
+  CP_INT(info_only);
   /* Generic network options */
   CP_INT(connect_timeout);
   CP_INT(read_timeout);
@@ -306,6 +369,7 @@ void bgav_options_copy(bgav_options_t * dst, const bgav_options_t * src)
 
   CP_INT(rtp_try_tcp);
   CP_INT(rtp_port_base);
+  CP_INT(udp_batch_size);
   
   /* http options */
 
@@ -319,6 +383,8 @@ void bgav_options_copy(bgav_options_t * dst, const bgav_options_t * src)
   CP_STR(http_proxy_pass);
   
   CP_INT(http_shoutcast_metadata);
+  CP_INT(http_cache_blocks);
+  CP_INT(hls_prefetch_segments);
 
   /* ftp options */
     
@@ -343,17 +409,22 @@ void bgav_options_copy(bgav_options_t * dst, const bgav_options_t * src)
   /* Audio */
 
   CP_INT(audio_dynrange);
+  CP_INT(seamless);
   
   CP_INT(prefer_ffmpeg_demuxers);
   CP_INT(dv_datetime);
+  CP_INT(mpegts_multiplex);
   CP_INT(shrink);
 
   CP_INT(vdpau);
   CP_INT(vaapi);
   CP_INT(threads);
+  CP_INT(pipeline);
+  CP_INT(stream_copy);
   CP_INT(dump_headers);
   CP_INT(dump_indices);
   CP_INT(dump_packets);
+  CP_INT(perf_counters);
   
   /* Callbacks */
   
@@ -20,14 +20,20 @@
  * *****************************************************************/
 
 #include <stdlib.h>
+#include <pthread.h>
 
 #include <avdec_private.h>
 
+/* The buffer is locked because in pipeline mode the demuxer thread
+   appends packets while the decoder thread reads them */
+
 struct bgav_packet_buffer_s
   {
   bgav_packet_t * packets;
   bgav_packet_t * packets_end;
   bgav_packet_pool_t * pp;
+  int num_packets;
+  pthread_mutex_t mutex;
   };
 
 bgav_packet_buffer_t * bgav_packet_buffer_create(bgav_packet_pool_t * pp)
@@ -35,6 +41,7 @@ bgav_packet_buffer_t * bgav_packet_buffer_create(bgav_packet_pool_t * pp)
   bgav_packet_buffer_t * ret;
   ret = calloc(1, sizeof(*ret));
   ret->pp = pp;
+  pthread_mutex_init(&ret->mutex, NULL);
   return ret;
   }
 
@@ -47,34 +54,43 @@ void bgav_packet_buffer_destroy(bgav_packet_buffer_t * b)
     bgav_packet_destroy(b->packets);
     b->packets = tmp;
     }
+  pthread_mutex_destroy(&b->mutex);
   free(b);
   }
 
 bgav_packet_t *
 bgav_packet_buffer_get_packet_read(bgav_packet_buffer_t* b)
   {
-  bgav_packet_t * ret;
+  bgav_packet_t * ret = NULL;
+  pthread_mutex_lock(&b->mutex);
   if(b->packets)
     {
     ret = b->packets;
     b->packets = b->packets->next;
+    if(!b->packets)
+      b->packets_end = NULL;
     ret->next = NULL;
-    return ret;
+    b->num_packets--;
     }
-  else
-    return NULL;
+  pthread_mutex_unlock(&b->mutex);
+  return ret;
   }
 
 bgav_packet_t *
 bgav_packet_buffer_peek_packet_read(bgav_packet_buffer_t * b)
   {
-  return b->packets;
+  bgav_packet_t * ret;
+  pthread_mutex_lock(&b->mutex);
+  ret = b->packets;
+  pthread_mutex_unlock(&b->mutex);
+  return ret;
   }
 
 void bgav_packet_buffer_clear(bgav_packet_buffer_t * b)
   {
   bgav_packet_t * tmp;
   //  fprintf(stderr, "bgav_packet_buffer_clear()...\n");
+  pthread_mutex_lock(&b->mutex);
   while(b->packets)
     {
     tmp = b->packets->next;
@@ -84,18 +100,35 @@ void bgav_packet_buffer_clear(bgav_packet_buffer_t * b)
     b->packets = tmp;
     }
   b->packets_end = NULL;
+  b->num_packets = 0;
+  pthread_mutex_unlock(&b->mutex);
   //  fprintf(stderr, "bgav_packet_buffer_clear()...done\n");
   }
 
 int bgav_packet_buffer_is_empty(bgav_packet_buffer_t * b)
   {
-  return !b->packets ? 1 : 0;
+  int ret;
+  pthread_mutex_lock(&b->mutex);
+  ret = !b->packets ? 1 : 0;
+  pthread_mutex_unlock(&b->mutex);
+  return ret;
+  }
+
+int bgav_packet_buffer_get_num_packets(bgav_packet_buffer_t * b)
+  {
+  int ret;
+  pthread_mutex_lock(&b->mutex);
+  ret = b->num_packets;
+  pthread_mutex_unlock(&b->mutex);
+  return ret;
   }
 
 void bgav_packet_buffer_append(bgav_packet_buffer_t * b,
                                bgav_packet_t * p)
   {
   p->next = NULL;
+
+  pthread_mutex_lock(&b->mutex);
   
   if(!b->packets)
     {
@@ -107,5 +140,7 @@ void bgav_packet_buffer_append(bgav_packet_buffer_t * b,
     b->packets_end->next = p;
     b->packets_end = b->packets_end->next;
     }
+  b->num_packets++;
+  pthread_mutex_unlock(&b->mutex);
   }
 
@@ -20,6 +20,7 @@
  * *****************************************************************/
 
 #include <stdlib.h>
+#include <pthread.h>
 
 #include <avdec_private.h>
 
@@ -29,25 +30,36 @@
 struct bgav_packet_pool_s
   {
   bgav_packet_t * packets;
+  pthread_mutex_t mutex; /* Packets are returned by the decoder thread
+                            in pipeline mode */
+  int64_t misses;
   };
 
 bgav_packet_pool_t * bgav_packet_pool_create()
   {
   bgav_packet_pool_t * ret;
   ret = calloc(1, sizeof(*ret));
+  pthread_mutex_init(&ret->mutex, NULL);
   return ret;
   }
 
 bgav_packet_t * bgav_packet_pool_get(bgav_packet_pool_t * pp)
   {
   bgav_packet_t * ret;
+
+  pthread_mutex_lock(&pp->mutex);
   if(pp->packets)
     {
     ret = pp->packets;
     pp->packets = pp->packets->next;
+    pthread_mutex_unlock(&pp->mutex);
     }
   else
+    {
+    pp->misses++;
+    pthread_mutex_unlock(&pp->mutex);
     ret = bgav_packet_create();
+    }
 
   ret->next = NULL;
   bgav_packet_reset(ret);
@@ -58,7 +70,13 @@ void bgav_packet_pool_put(bgav_packet_pool_t * pp,
                           bgav_packet_t * p)
   {
 #ifdef DEBUG_PP
-  bgav_packet_t * tmp = pp->packets;
+  bgav_packet_t * tmp;
+#endif
+
+  pthread_mutex_lock(&pp->mutex);
+  
+#ifdef DEBUG_PP
+  tmp = pp->packets;
   while(tmp)
     {
     if(tmp == p)
@@ -71,6 +89,16 @@ void bgav_packet_pool_put(bgav_packet_pool_t * pp,
 
   p->next = pp->packets;
   pp->packets = p;
+  pthread_mutex_unlock(&pp->mutex);
+  }
+
+int64_t bgav_packet_pool_get_misses(bgav_packet_pool_t * pp)
+  {
+  int64_t ret;
+  pthread_mutex_lock(&pp->mutex);
+  ret = pp->misses;
+  pthread_mutex_unlock(&pp->mutex);
+  return ret;
   }
 
 void bgav_packet_pool_destroy(bgav_packet_pool_t * pp)
@@ -82,5 +110,6 @@ void bgav_packet_pool_destroy(bgav_packet_pool_t * pp)
     bgav_packet_destroy(pp->packets);
     pp->packets = tmp;
     }
+  pthread_mutex_destroy(&pp->mutex);
   free(pp);
   }
@@ -0,0 +1,104 @@
+/*****************************************************************
+ * gmerlin-avdecoder - a general purpose multimedia decoding library
+ *
+ * Copyright (c) 2001 - 2012 Members of the Gmerlin project
+ * gmerlin-general@lists.sourceforge.net
+ * http://gmerlin.sourceforge.net
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * *****************************************************************/
+
+#include <string.h>
+#include <time.h>
+
+#include <avdec_private.h>
+
+int64_t bgav_perf_time(void)
+  {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+  }
+
+void bgav_perf_start(bgav_perf_timer_t * t, const bgav_options_t * opt,
+                     const int64_t * below)
+  {
+  if(!opt->perf_counters)
+    {
+    t->start = 0;
+    return;
+    }
+  t->start = bgav_perf_time();
+  t->below = below;
+  if(below)
+    t->below_start = *below;
+  }
+
+void bgav_perf_stop(bgav_perf_timer_t * t, bgav_perf_counter_t * c,
+                    int64_t * total)
+  {
+  int64_t elapsed;
+  int64_t self;
+  
+  c->calls++;
+  
+  if(!t->start)
+    return;
+  
+  elapsed = bgav_perf_time() - t->start;
+  self = elapsed;
+  
+  if(t->below)
+    self -= *t->below - t->below_start;
+  if(self > 0)
+    c->time += self;
+  if(total)
+    *total += elapsed;
+  }
+
+/* Public API */
+
+void bgav_get_perf(bgav_t * b, bgav_perf_t * ret)
+  {
+  memset(ret, 0, sizeof(*ret));
+
+  if(b->input)
+    {
+    ret->read = b->input->perf_read;
+    ret->seek = b->input->perf_seek;
+    ret->requests        = b->input->perf_requests;
+    ret->requests_reused = b->input->perf_requests_reused;
+    ret->cache_hits      = b->input->perf_cache_hits;
+    ret->cache_misses    = b->input->perf_cache_misses;
+    }
+  if(b->demuxer)
+    ret->demux = b->demuxer->perf;
+  }
+
+static void get_stream_perf(bgav_stream_t * s, bgav_stream_perf_t * ret)
+  {
+  *ret = s->perf;
+  if(s->pp)
+    ret->pool_misses = bgav_packet_pool_get_misses(s->pp);
+  }
+
+void bgav_get_audio_perf(bgav_t * b, int stream, bgav_stream_perf_t * ret)
+  {
+  get_stream_perf(&b->tt->cur->audio_streams[stream], ret);
+  }
+
+void bgav_get_video_perf(bgav_t * b, int stream, bgav_stream_perf_t * ret)
+  {
+  get_stream_perf(&b->tt->cur->video_streams[stream], ret);
+  }
@@ -0,0 +1,675 @@
+/*****************************************************************
+ * gmerlin-avdecoder - a general purpose multimedia decoding library
+ *
+ * Copyright (c) 2001 - 2012 Members of the Gmerlin project
+ * gmerlin-general@lists.sourceforge.net
+ * http://gmerlin.sourceforge.net
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * *****************************************************************/
+
+#include <stdlib.h>
+#include <pthread.h>
+
+#include <avdec_private.h>
+
+#define LOG_DOMAIN "pipeline"
+
+/*
+ *  Pipeline mode
+ *
+ *  One thread calls the demuxer and fills the packet buffers of the
+ *  streams. Each decoded audio and video stream has a thread, which
+ *  reads frames from the decoder into a small queue. The sources
+ *  returned to the application read from these queues.
+ *
+ *  The demuxer stops if one of the packet buffers is full unless a
+ *  stream is waiting for a packet. The latter prevents deadlocks for
+ *  badly interleaved files. A stream, which isn't read by the application
+ *  while the demuxer runs for others, gets its packets dropped after
+ *  PIPELINE_MAX_PACKETS and resumes at the next keyframe.
+ *
+ *  Before seeking (or stopping) the decoder threads are parked first
+ *  (they might still need packets to finish the current frame), then
+ *  the demuxer thread. While parked, everything runs on the caller's
+ *  thread like without pipeline. The next read call restarts the threads.
+ *
+ *  All state is protected by one mutex, state changes are signalled
+ *  with one condition variable.
+ */
+
+#define PIPELINE_PACKETS 64 /* Max packets per stream */
+#define PIPELINE_MAX_PACKETS 1024 /* Hard limit, if other streams starve */
+#define PIPELINE_FRAMES   4 /* Queued frames per stream */
+
+struct bgav_pipeline_stream_s
+  {
+  bgav_stream_t * s;
+  bgav_pipeline_t * pl;
+
+  pthread_t thread;
+  int parked;
+
+  /* Frame queue */
+  gavl_video_frame_t * vframes[PIPELINE_FRAMES];
+  gavl_audio_frame_t * aframes[PIPELINE_FRAMES];
+
+  int read_pos;
+  int num_frames;
+  int have_frame; /* Frame at read_pos is owned by the application */
+
+  /* Returned after all queued frames */
+  gavl_source_status_t status;
+
+  gavl_video_source_t * vsrc;
+  gavl_audio_source_t * asrc;
+  };
+
+struct bgav_pipeline_s
+  {
+  bgav_demuxer_context_t * demuxer;
+
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+
+  pthread_t demux_thread;
+
+  /* Streams read from the demuxer */
+  bgav_stream_t ** streams;
+  int * dropping; /* Packets are dropped until the next keyframe */
+  int num_streams;
+
+  /* Decoder threads */
+  bgav_pipeline_stream_t * ps;
+  int num_ps;
+
+  int running;
+
+  int pause_decode;
+  int pause_demux;
+  int demux_parked;
+  int quit;
+
+  int eof;
+  int starving; /* Number of threads waiting for packets */
+  };
+
+static int packets_full(bgav_pipeline_t * pl)
+  {
+  int i;
+  for(i = 0; i < pl->num_streams; i++)
+    {
+    if(bgav_packet_buffer_get_num_packets(pl->streams[i]->packet_buffer) >=
+       PIPELINE_PACKETS)
+      return 1;
+    }
+  return 0;
+  }
+
+static void * demux_thread(void * data)
+  {
+  int result;
+  bgav_pipeline_t * pl = data;
+
+  pthread_mutex_lock(&pl->mutex);
+
+  while(1)
+    {
+    while(!pl->quit &&
+          (pl->pause_demux || pl->eof ||
+           (!pl->starving && packets_full(pl))))
+      {
+      if(pl->pause_demux && !pl->demux_parked)
+        {
+        pl->demux_parked = 1;
+        pthread_cond_broadcast(&pl->cond);
+        }
+      pthread_cond_wait(&pl->cond, &pl->mutex);
+      }
+    pl->demux_parked = 0;
+
+    if(pl->quit)
+      break;
+
+    pthread_mutex_unlock(&pl->mutex);
+    result = bgav_demuxer_next_packet_pipeline(pl->demuxer);
+    pthread_mutex_lock(&pl->mutex);
+
+    if(!result)
+      pl->eof = 1;
+    pthread_cond_broadcast(&pl->cond);
+    }
+
+  pthread_mutex_unlock(&pl->mutex);
+  return NULL;
+  }
+
+gavl_source_status_t
+bgav_pipeline_get_packet(bgav_pipeline_t * pl, bgav_stream_t * s,
+                         bgav_packet_t ** ret, int peek, int force)
+  {
+  bgav_packet_t * p;
+  gavl_source_status_t st = GAVL_SOURCE_OK;
+
+  pthread_mutex_lock(&pl->mutex);
+
+  while(!(p = bgav_packet_buffer_peek_packet_read(s->packet_buffer)))
+    {
+    /* The stream flags are only changed by the thread reading
+       the stream */
+    if(pl->eof)
+      s->flags |= STREAM_EOF_D;
+
+    if(s->flags & STREAM_EOF_D)
+      {
+      st = GAVL_SOURCE_EOF;
+      break;
+      }
+    if(!force)
+      {
+      st = GAVL_SOURCE_AGAIN;
+      break;
+      }
+    pl->starving++;
+    pthread_cond_broadcast(&pl->cond);
+    pthread_cond_wait(&pl->cond, &pl->mutex);
+    pl->starving--;
+    }
+
+  if(p)
+    {
+    if(!peek)
+      {
+      p = bgav_packet_buffer_get_packet_read(s->packet_buffer);
+      /* Wake up the demuxer */
+      pthread_cond_broadcast(&pl->cond);
+      }
+    if(ret)
+      *ret = p;
+    }
+
+  pthread_mutex_unlock(&pl->mutex);
+  return st;
+  }
+
+/* Called by the demuxer thread before a packet is appended. The
+   mutex is not held here, the demuxer runs unlocked */
+
+int bgav_pipeline_drop_packet(bgav_pipeline_t * pl, bgav_stream_t * s,
+                              bgav_packet_t * p)
+  {
+  int i;
+  int num;
+  int ret;
+  int start = 0;
+  
+  for(i = 0; i < pl->num_streams; i++)
+    {
+    if(pl->streams[i] == s)
+      break;
+    }
+  if(i == pl->num_streams)
+    return 0;
+  
+  num = bgav_packet_buffer_get_num_packets(s->packet_buffer);
+
+  pthread_mutex_lock(&pl->mutex);
+  
+  if(num >= PIPELINE_MAX_PACKETS)
+    {
+    start = !pl->dropping[i];
+    pl->dropping[i] = 1;
+    }
+  else if(pl->dropping[i] && (num < PIPELINE_PACKETS) &&
+          (PACKET_GET_KEYFRAME(p) ||
+           (s->flags & (STREAM_PARSE_FULL|STREAM_PARSE_FRAME))))
+    pl->dropping[i] = 0;
+  
+  if((ret = pl->dropping[i]))
+    pl->demuxer->perf.dropped++;
+  
+  pthread_mutex_unlock(&pl->mutex);
+
+  if(start)
+    bgav_log(s->opt, BGAV_LOG_WARNING, LOG_DOMAIN,
+             "Stream %d is not read, dropping packets", s->stream_id);
+  return ret;
+  }
+
+/* Decoder threads */
+
+static void * decode_thread(void * data)
+  {
+  int idx;
+  gavl_source_status_t st;
+  gavl_video_frame_t * vf;
+  gavl_audio_frame_t * af;
+  bgav_pipeline_stream_t * ps = data;
+  bgav_pipeline_t * pl = ps->pl;
+  bgav_stream_t * s = ps->s;
+
+  pthread_mutex_lock(&pl->mutex);
+
+  while(1)
+    {
+    while(!pl->quit &&
+          (pl->pause_decode || (ps->status != GAVL_SOURCE_OK) ||
+           (ps->num_frames == PIPELINE_FRAMES)))
+      {
+      if(pl->pause_decode && !ps->parked)
+        {
+        ps->parked = 1;
+        pthread_cond_broadcast(&pl->cond);
+        }
+      pthread_cond_wait(&pl->cond, &pl->mutex);
+      }
+    ps->parked = 0;
+
+    if(pl->quit)
+      break;
+
+    idx = (ps->read_pos + ps->num_frames) % PIPELINE_FRAMES;
+
+    pthread_mutex_unlock(&pl->mutex);
+
+    if(s->type == GAVF_STREAM_VIDEO)
+      {
+      vf = ps->vframes[idx];
+      st = gavl_video_source_read_frame(s->data.video.vsrc, &vf);
+      }
+    else
+      {
+      af = ps->aframes[idx];
+      st = gavl_audio_source_read_frame(s->data.audio.source, &af);
+      }
+
+    pthread_mutex_lock(&pl->mutex);
+
+    switch(st)
+      {
+      case GAVL_SOURCE_OK:
+        ps->num_frames++;
+        break;
+      case GAVL_SOURCE_AGAIN:
+        /* Decoder peeked without force: Wait for the next packet */
+        pl->starving++;
+        pthread_cond_broadcast(&pl->cond);
+        pthread_cond_wait(&pl->cond, &pl->mutex);
+        pl->starving--;
+        break;
+      default:
+        ps->status = st;
+        break;
+      }
+    pthread_cond_broadcast(&pl->cond);
+    }
+
+  pthread_mutex_unlock(&pl->mutex);
+  return NULL;
+  }
+
+/* Must be called with locked mutex */
+
+static void release_frame(bgav_pipeline_stream_t * ps)
+  {
+  if(!ps->have_frame)
+    return;
+
+  ps->read_pos = (ps->read_pos + 1) % PIPELINE_FRAMES;
+  ps->num_frames--;
+  ps->have_frame = 0;
+  pthread_cond_broadcast(&ps->pl->cond);
+  }
+
+static void start_pipeline(bgav_pipeline_t * pl)
+  {
+  pl->demuxer->pipeline = pl;
+
+  pthread_mutex_lock(&pl->mutex);
+  pl->pause_decode = 0;
+  pl->pause_demux = 0;
+  pl->eof = 0;
+  pthread_cond_broadcast(&pl->cond);
+  pthread_mutex_unlock(&pl->mutex);
+  pl->running = 1;
+  }
+
+/* Returns the next queued frame, must be called with locked mutex */
+
+static gavl_source_status_t next_frame(bgav_pipeline_stream_t * ps)
+  {
+  bgav_pipeline_t * pl = ps->pl;
+
+  release_frame(ps);
+
+  while(!ps->num_frames && (ps->status == GAVL_SOURCE_OK))
+    pthread_cond_wait(&pl->cond, &pl->mutex);
+
+  if(!ps->num_frames)
+    return ps->status;
+  return GAVL_SOURCE_OK;
+  }
+
+static gavl_source_status_t
+read_video(void * priv, gavl_video_frame_t ** frame)
+  {
+  gavl_source_status_t st;
+  bgav_pipeline_stream_t * ps = priv;
+  bgav_pipeline_t * pl = ps->pl;
+
+  if(!pl->running)
+    start_pipeline(pl);
+
+  pthread_mutex_lock(&pl->mutex);
+  if((st = next_frame(ps)) == GAVL_SOURCE_OK)
+    {
+    *frame = ps->vframes[ps->read_pos];
+    ps->have_frame = 1;
+    }
+  pthread_mutex_unlock(&pl->mutex);
+  return st;
+  }
+
+static gavl_source_status_t
+read_audio(void * priv, gavl_audio_frame_t ** frame)
+  {
+  gavl_source_status_t st;
+  bgav_pipeline_stream_t * ps = priv;
+  bgav_pipeline_t * pl = ps->pl;
+
+  if(!pl->running)
+    start_pipeline(pl);
+
+  pthread_mutex_lock(&pl->mutex);
+  if((st = next_frame(ps)) == GAVL_SOURCE_OK)
+    {
+    *frame = ps->aframes[ps->read_pos];
+    ps->have_frame = 1;
+    }
+  pthread_mutex_unlock(&pl->mutex);
+  return st;
+  }
+
+int bgav_pipeline_skip_video(bgav_stream_t * s, int64_t * time, int scale)
+  {
+  int64_t time_scaled;
+  gavl_video_frame_t * f;
+  bgav_pipeline_stream_t * ps = s->pipe;
+  bgav_pipeline_t * pl = ps->pl;
+
+  /* Stopped: The decoder is in sync with the application */
+  if(!pl->running)
+    return bgav_video_skipto(s, time, scale);
+
+  time_scaled =
+    gavl_time_rescale(scale, s->data.video.format->timescale, *time);
+
+  pthread_mutex_lock(&pl->mutex);
+
+  while(1)
+    {
+    if(next_frame(ps) != GAVL_SOURCE_OK)
+      {
+      pthread_mutex_unlock(&pl->mutex);
+      return 0;
+      }
+    f = ps->vframes[ps->read_pos];
+
+    if(f->timestamp + f->duration > time_scaled)
+      {
+      *time = gavl_time_rescale(s->data.video.format->timescale, scale,
+                                f->timestamp);
+      break;
+      }
+    /* Drop frame */
+    ps->have_frame = 1;
+    }
+
+  pthread_mutex_unlock(&pl->mutex);
+
+  /* The frame we stopped at is delivered by the next read call */
+  gavl_video_source_reset(ps->vsrc);
+  return 1;
+  }
+
+gavl_video_source_t * bgav_pipeline_get_video_source(bgav_stream_t * s)
+  {
+  if(s->pipe)
+    return s->pipe->vsrc;
+  return s->data.video.vsrc;
+  }
+
+gavl_audio_source_t * bgav_pipeline_get_audio_source(bgav_stream_t * s)
+  {
+  if(s->pipe)
+    return s->pipe->asrc;
+  return s->data.audio.source;
+  }
+
+static int use_stream(bgav_stream_t * s)
+  {
+  return (s->action != BGAV_STREAM_MUTE) &&
+    !(s->flags & STREAM_SUBREADER) && s->packet_buffer;
+  }
+
+static int decode_stream(bgav_stream_t * s)
+  {
+  return (s->action == BGAV_STREAM_DECODE) && !STREAM_IS_STILL(s) &&
+    (((s->type == GAVF_STREAM_VIDEO) && s->data.video.vsrc) ||
+     ((s->type == GAVF_STREAM_AUDIO) && s->data.audio.source));
+  }
+
+static void add_streams(bgav_pipeline_t * pl, bgav_stream_t * s, int num)
+  {
+  int i;
+  bgav_pipeline_stream_t * ps;
+
+  for(i = 0; i < num; i++)
+    {
+    if(!use_stream(&s[i]))
+      continue;
+
+    pl->streams[pl->num_streams++] = &s[i];
+
+    if(!decode_stream(&s[i]))
+      continue;
+
+    ps = &pl->ps[pl->num_ps++];
+    ps->s = &s[i];
+    ps->pl = pl;
+    }
+  }
+
+static void init_stream(bgav_pipeline_stream_t * ps)
+  {
+  int i;
+  bgav_stream_t * s = ps->s;
+
+  if(s->type == GAVF_STREAM_VIDEO)
+    {
+    for(i = 0; i < PIPELINE_FRAMES; i++)
+      ps->vframes[i] = gavl_video_frame_create(s->data.video.format);
+    ps->vsrc = gavl_video_source_create(read_video, ps,
+                                        GAVL_SOURCE_SRC_ALLOC | s->src_flags,
+                                        s->data.video.format);
+    }
+  else
+    {
+    for(i = 0; i < PIPELINE_FRAMES; i++)
+      ps->aframes[i] = gavl_audio_frame_create(s->data.audio.format);
+    ps->asrc = gavl_audio_source_create(read_audio, ps,
+                                        GAVL_SOURCE_SRC_ALLOC | s->src_flags,
+                                        s->data.audio.format);
+    }
+  s->pipe = ps;
+  }
+
+bgav_pipeline_t * bgav_pipeline_create(bgav_t * b)
+  {
+  int i;
+  int num;
+  bgav_pipeline_t * ret;
+  bgav_track_t * t = b->tt->cur;
+
+  /* The other modes let the requesting stream drive the demuxer */
+  if(!b->demuxer ||
+     ((b->demuxer->demux_mode != DEMUX_MODE_STREAM) &&
+      (b->demuxer->demux_mode != DEMUX_MODE_SI_I)))
+    {
+    bgav_log(&b->opt, BGAV_LOG_INFO, LOG_DOMAIN,
+             "Pipeline mode not supported for this demuxer mode");
+    return NULL;
+    }
+
+  num = t->num_audio_streams + t->num_video_streams +
+    t->num_text_streams + t->num_overlay_streams;
+
+  ret = calloc(1, sizeof(*ret));
+  ret->streams = calloc(num, sizeof(*ret->streams));
+  ret->dropping = calloc(num, sizeof(*ret->dropping));
+  ret->ps = calloc(num, sizeof(*ret->ps));
+  ret->demuxer = b->demuxer;
+
+  add_streams(ret, t->audio_streams, t->num_audio_streams);
+  add_streams(ret, t->video_streams, t->num_video_streams);
+  add_streams(ret, t->text_streams, t->num_text_streams);
+  add_streams(ret, t->overlay_streams, t->num_overlay_streams);
+
+  if(!ret->num_ps)
+    {
+    free(ret->streams);
+    free(ret->dropping);
+    free(ret->ps);
+    free(ret);
+    return NULL;
+    }
+
+  pthread_mutex_init(&ret->mutex, NULL);
+  pthread_cond_init(&ret->cond, NULL);
+
+  /* Threads start parked, the first read call starts them */
+  ret->pause_decode = 1;
+  ret->pause_demux = 1;
+
+  pthread_create(&ret->demux_thread, NULL, demux_thread, ret);
+
+  for(i = 0; i < ret->num_ps; i++)
+    {
+    init_stream(&ret->ps[i]);
+    pthread_create(&ret->ps[i].thread, NULL, decode_thread, &ret->ps[i]);
+    }
+
+  bgav_log(&b->opt, BGAV_LOG_DEBUG, LOG_DOMAIN,
+           "Started pipeline with %d decoder threads", ret->num_ps);
+  return ret;
+  }
+
+static int decode_parked(bgav_pipeline_t * pl)
+  {
+  int i;
+  for(i = 0; i < pl->num_ps; i++)
+    {
+    if(!pl->ps[i].parked)
+      return 0;
+    }
+  return 1;
+  }
+
+void bgav_pipeline_stop(bgav_pipeline_t * pl)
+  {
+  int i;
+  bgav_pipeline_stream_t * ps;
+
+  if(!pl->running)
+    return;
+
+  pthread_mutex_lock(&pl->mutex);
+
+  /* The demuxer keeps running until the decoders are parked */
+  pl->pause_decode = 1;
+  pthread_cond_broadcast(&pl->cond);
+  while(!decode_parked(pl))
+    pthread_cond_wait(&pl->cond, &pl->mutex);
+
+  pl->pause_demux = 1;
+  pthread_cond_broadcast(&pl->cond);
+  while(!pl->demux_parked)
+    pthread_cond_wait(&pl->cond, &pl->mutex);
+
+  for(i = 0; i < pl->num_streams; i++)
+    pl->dropping[i] = 0;
+  
+  /* Flush frame queues */
+  for(i = 0; i < pl->num_ps; i++)
+    {
+    ps = &pl->ps[i];
+    ps->read_pos = 0;
+    ps->num_frames = 0;
+    ps->have_frame = 0;
+    ps->status = GAVL_SOURCE_OK;
+
+    if(ps->vsrc)
+      gavl_video_source_reset(ps->vsrc);
+    if(ps->asrc)
+      gavl_audio_source_reset(ps->asrc);
+    }
+
+  pthread_mutex_unlock(&pl->mutex);
+
+  pl->demuxer->pipeline = NULL;
+  pl->running = 0;
+  }
+
+void bgav_pipeline_destroy(bgav_pipeline_t * pl)
+  {
+  int i, j;
+  bgav_pipeline_stream_t * ps;
+
+  bgav_pipeline_stop(pl);
+
+  pthread_mutex_lock(&pl->mutex);
+  pl->quit = 1;
+  pthread_cond_broadcast(&pl->cond);
+  pthread_mutex_unlock(&pl->mutex);
+
+  pthread_join(pl->demux_thread, NULL);
+
+  for(i = 0; i < pl->num_ps; i++)
+    {
+    ps = &pl->ps[i];
+    pthread_join(ps->thread, NULL);
+
+    if(ps->vsrc)
+      gavl_video_source_destroy(ps->vsrc);
+    if(ps->asrc)
+      gavl_audio_source_destroy(ps->asrc);
+
+    for(j = 0; j < PIPELINE_FRAMES; j++)
+      {
+      if(ps->vframes[j])
+        gavl_video_frame_destroy(ps->vframes[j]);
+      if(ps->aframes[j])
+        gavl_audio_frame_destroy(ps->aframes[j]);
+      }
+    ps->s->pipe = NULL;
+    }
+
+  pthread_mutex_destroy(&pl->mutex);
+  pthread_cond_destroy(&pl->cond);
+
+  free(pl->streams);
+  free(pl->dropping);
+  free(pl->ps);
+  free(pl);
+  }
@@ -432,13 +432,31 @@ init_stream(bgav_demuxer_context_t * ctx,
   return 1;
   }
 
+static int parse_rtp_packet(bgav_demuxer_context_t * ctx,
+                            rtp_packet_t * p, int bytes_read)
+  {
+  rtp_priv_t * priv;
+  priv = ctx->priv;
+  
+  bgav_input_reopen_memory(priv->input_mem, p->buffer, bytes_read);
+  
+  if(!rtp_header_read(priv->input_mem, &p->h))
+    {
+    return 0;
+    }
+  p->buf = p->buffer + priv->input_mem->position;
+  p->len = bytes_read - priv->input_mem->position;
+
+  /* Handle padding */
+  if(p->h.padding)
+    p->len -= p->buf[p->len-1];
+  return 1;
+  }
+
 static int read_rtp_packet(bgav_demuxer_context_t * ctx,
                            int fd, int len, bgav_rtp_packet_buffer_t * b)
   {
   rtp_packet_t * p;
-  int bytes_read;
-  rtp_priv_t * priv;
-  priv = ctx->priv;
 
   if(bgav_rtp_packet_buffer_get_eof(b))
     {
@@ -447,35 +465,56 @@ static int read_rtp_packet(bgav_demuxer_context_t * ctx,
   /* Read packet */
   p = bgav_rtp_packet_buffer_lock_write(b);
   
-  if(!len)
-    {
-    bytes_read = bgav_udp_read(fd,
-                               p->buffer, RTP_MAX_PACKET_LENGTH);
-    }
-  else
-    {
-    if(len > RTP_MAX_PACKET_LENGTH)
-      return 0;
-    if(bgav_input_read_data(ctx->input, p->buffer, len) < len)
-      return 0;
-    bytes_read = len;
-    }
+  if(len > RTP_MAX_PACKET_LENGTH)
+    return 0;
+  if(bgav_input_read_data(ctx->input, p->buffer, len) < len)
+    return 0;
   
-  bgav_input_reopen_memory(priv->input_mem, p->buffer, bytes_read);
+  if(!parse_rtp_packet(ctx, p, len))
+    return 0;
   
-  if(!rtp_header_read(priv->input_mem, &p->h))
+  bgav_rtp_packet_buffer_unlock_write(b);
+  
+  return 1;
+  }
+
+/* Receive as many datagrams as possible directly into the packet buffer */
+
+static int read_rtp_packets_udp(bgav_demuxer_context_t * ctx,
+                                int fd, bgav_rtp_packet_buffer_t * b)
+  {
+  int i;
+  int num;
+  rtp_packet_t ** packets;
+  uint8_t * data[BGAV_UDP_MAX_BATCH];
+  int len[BGAV_UDP_MAX_BATCH];
+  rtp_stats_t * stats;
+  
+  if(bgav_rtp_packet_buffer_get_eof(b))
     {
     return 0;
     }
-  p->buf = p->buffer + priv->input_mem->position;
-  p->len = bytes_read - priv->input_mem->position;
 
-  /* Handle padding */
-  if(p->h.padding)
-    p->len -= p->buf[p->len-1];
+  packets = bgav_rtp_packet_buffer_lock_write_batch(b, &num);
   
-  bgav_rtp_packet_buffer_unlock_write(b);
+  for(i = 0; i < num; i++)
+    data[i] = packets[i]->buffer;
+
+  stats = bgav_rtp_packet_buffer_get_stats(b);
   
+  num = bgav_udp_read_batch(fd, data, len, RTP_MAX_PACKET_LENGTH, num,
+                            &stats->kernel_drops);
+  if(num <= 0)
+    return 0;
+
+  stats->syscalls++;
+  stats->datagrams += num;
+  
+  for(i = 0; i < num; i++)
+    {
+    if(parse_rtp_packet(ctx, packets[i], len[i]))
+      bgav_rtp_packet_buffer_commit(b, i);
+    }
   return 1;
   }
 
@@ -594,7 +633,7 @@ static int handle_pollfds(bgav_demuxer_context_t * ctx)
     {
     if(priv->pollfds[index].revents & POLLIN)
       {
-      if(read_rtp_packet(ctx, priv->pollfds[index].fd, 0, priv->streams[i].buf))
+      if(read_rtp_packets_udp(ctx, priv->pollfds[index].fd, priv->streams[i].buf))
         ret++;
       }
     index++;
@@ -779,7 +818,17 @@ static void close_rtp(bgav_demuxer_context_t * ctx)
   for(i = 0; i < priv->num_streams; i++)
     {
     if(priv->streams[i].buf)
+      {
+      rtp_stats_t * stats = bgav_rtp_packet_buffer_get_stats(priv->streams[i].buf);
+
+      if(stats->syscalls)
+        bgav_log(ctx->opt, BGAV_LOG_INFO, LOG_DOMAIN,
+                 "Stream %d: %"PRId64" datagrams, %.1f per syscall, %u dropped by the kernel",
+                 i+1, stats->datagrams,
+                 (double)stats->datagrams / (double)stats->syscalls,
+                 stats->kernel_drops);
       bgav_rtp_packet_buffer_destroy(priv->streams[i].buf);
+      }
 
     if(priv->streams[i].rtp_fd >= 0)
       closesocket(priv->streams[i].rtp_fd);
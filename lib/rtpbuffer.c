@@ -25,33 +25,51 @@
 #include <stdlib.h>
 #define LOG_DOMAIN "rtpstack"
 
-// #define MAX_PACKETS 10
-
 #define MAX_DROPOUT 3000
 #define MAX_MISORDER 100
 #define MIN_SEQUENTIAL 2
 
-#if 0
-typedef struct packet_s
+/*
+ *  Packets are stored in a ring indexed by the extended sequence number.
+ *  There is exactly one writer (the network thread) and one reader
+ *  (the demuxer). A slot is owned by the writer while it's empty and
+ *  by the reader while it's full, so the handoff needs no locks.
+ *
+ *  RING_SIZE must be a power of 2
+ */
+
+#define RING_SIZE 1024
+#define RING_MASK (RING_SIZE-1)
+
+#define SLOT_EMPTY 0
+#define SLOT_FULL  1
+
+#define ATOMIC_LOAD(v)     __atomic_load_n(&(v), __ATOMIC_ACQUIRE)
+#define ATOMIC_STORE(v, x) __atomic_store_n(&(v), (x), __ATOMIC_RELEASE)
+
+typedef struct
   {
-  rtp_packet_t p;
-  struct packet_s * next;
-  } packet_t;
-#endif
+  rtp_packet_t * p;
+  int state;
+  } slot_t;
 
 struct bgav_rtp_packet_buffer_s
   {
-  rtp_packet_t * read_packets;
-  rtp_packet_t * read_packet;
+  slot_t slots[RING_SIZE];
+
+  /* RING_SIZE + num_spares packets */
+  rtp_packet_t * slab;
+
+  /* Owned by the writer */
+  rtp_packet_t ** spares;
+  int num_spares;
   
-  rtp_packet_t * write_packets;
-  rtp_packet_t * write_packet;
-  pthread_mutex_t read_mutex;
-  pthread_mutex_t write_mutex;
+  rtp_packet_t * read_packet;
+
+  int64_t read_seq;  // Next sequence number for the reader, -1 if unknown
+  int64_t max_seq;   // Highest sequence number in the ring
   
-  int64_t last_seq;
   const bgav_options_t * opt;
-  int num;
   rtp_stats_t stats;
   int timescale;
   
@@ -177,83 +195,73 @@ static int update_stats(rtp_stats_t * s, uint16_t seq,
 bgav_rtp_packet_buffer_t *
 bgav_rtp_packet_buffer_create(const bgav_options_t * opt, int timescale)
   {
+  int i;
   bgav_rtp_packet_buffer_t * ret;
   ret = calloc(1, sizeof(*ret));
-  ret->last_seq = -1;
+  ret->read_seq = -1;
+  ret->max_seq = -1;
   ret->opt = opt;
   ret->timescale = timescale;
   ret->last_timestamp = GAVL_TIME_UNDEFINED;
-  pthread_mutex_init(&ret->read_mutex, NULL);
-  pthread_mutex_init(&ret->write_mutex, NULL);
   pthread_mutex_init(&ret->eof_mutex, NULL);
   ret->stats.timer = gavl_timer_create();
+
+  ret->num_spares = opt->udp_batch_size;
+  if(ret->num_spares < 1)
+    ret->num_spares = 1;
+  if(ret->num_spares > BGAV_UDP_MAX_BATCH)
+    ret->num_spares = BGAV_UDP_MAX_BATCH;
   
-  return ret;
-  }
+  ret->slab = calloc(RING_SIZE + ret->num_spares, sizeof(*ret->slab));
+  for(i = 0; i < RING_SIZE; i++)
+    ret->slots[i].p = &ret->slab[i];
 
-static void free_packets(rtp_packet_t * p)
-  {
-  rtp_packet_t * tmp;
-  while(p)
-    {
-    tmp = p->next;
-    free(p);
-    //    fprintf(stderr, "Destroy packet\n");
-    p = tmp;
-    }
+  ret->spares = malloc(ret->num_spares * sizeof(*ret->spares));
+  for(i = 0; i < ret->num_spares; i++)
+    ret->spares[i] = &ret->slab[RING_SIZE + i];
+  
+  return ret;
   }
 
 void bgav_rtp_packet_buffer_destroy(bgav_rtp_packet_buffer_t * b)
   {
-  pthread_mutex_destroy(&b->read_mutex);
-  pthread_mutex_destroy(&b->write_mutex);
   pthread_mutex_destroy(&b->eof_mutex);
   if(b->stats.timer) gavl_timer_destroy(b->stats.timer);
-  free_packets(b->read_packets);
-  free_packets(b->write_packets);
-  free_packets(b->read_packet);
-  free_packets(b->write_packet);
+  free(b->slab);
+  free(b->spares);
   free(b);
   }
 
 rtp_packet_t *
 bgav_rtp_packet_buffer_lock_write(bgav_rtp_packet_buffer_t * b)
   {
-  //  fprintf(stderr, "Lock Write\n");
-  pthread_mutex_lock(&b->write_mutex);
-  if(!b->write_packets)
-    {
-    b->write_packet = calloc(1, sizeof(*b->write_packet));
-    //    fprintf(stderr, "Create packet\n");
-    }
-  else
-    {
-    b->write_packet = b->write_packets;
-    b->write_packets = b->write_packets->next;
-    b->write_packet->next = NULL;
-    }
-  pthread_mutex_unlock(&b->write_mutex);
-  return b->write_packet;
+  /* The spare packets are always owned by the writer */
+  return b->spares[0];
   }
 
 void bgav_rtp_packet_buffer_unlock_write(bgav_rtp_packet_buffer_t * b)
   {
-  int drop = 0;
-  rtp_packet_t * p = b->write_packet;
+  bgav_rtp_packet_buffer_commit(b, 0);
+  }
 
-  b->write_packet = NULL;
+rtp_packet_t **
+bgav_rtp_packet_buffer_lock_write_batch(bgav_rtp_packet_buffer_t * b,
+                                        int * num)
+  {
+  *num = b->num_spares;
+  return b->spares;
+  }
 
-  //  fprintf(stderr, "Unlock Write\n");
+void bgav_rtp_packet_buffer_commit(bgav_rtp_packet_buffer_t * b, int index)
+  {
+  int64_t read_seq;
+  int64_t seq;
+  slot_t * slot;
+  rtp_packet_t * p = b->spares[index];
 
-  /* Push back and return */
+  /* Not initialized: Packet is reused */
   if(!b->timescale)
-    {
-    p->next = b->write_packets;
-    b->write_packets = p;
     return;
-    }
-  //  if(b->next_seq == -1)
-  //    b->next_seq = p->h.sequence_number;
   
   /* Correct timestamp */
   if((b->last_timestamp != GAVL_TIME_UNDEFINED) &&
@@ -284,118 +292,118 @@ void bgav_rtp_packet_buffer_unlock_write(bgav_rtp_packet_buffer_t * b)
 
   /* Update sequence number */
   p->h.sequence_number += b->stats.cycles;
-  
-  /* Insert into read buffer */
-  pthread_mutex_lock(&b->read_mutex);
-  if(!b->read_packets)
+  seq = p->h.sequence_number;
+
+  read_seq = ATOMIC_LOAD(b->read_seq);
+
+  if(read_seq < 0)
     {
-    b->read_packets = p;
-    b->read_packets->next = NULL;
+    /* First packet */
+    read_seq = seq;
+    ATOMIC_STORE(b->read_seq, seq);
     }
-  else if((b->last_seq >= 0) &&
-          (b->last_seq > p->h.sequence_number))
+  else if(seq < read_seq)
     {
-    drop = 1;
     bgav_log(b->opt, BGAV_LOG_WARNING, LOG_DOMAIN, "Dropping obsolete packet");
+    return;
     }
-  else
+  else if(seq - read_seq >= RING_SIZE)
     {
-    rtp_packet_t * tmp;
-    rtp_packet_t * p_iter;
-    p_iter = b->read_packets;
-    
-    if(b->read_packets->h.sequence_number ==
-       p->h.sequence_number)
-      {
-      bgav_log(b->opt, BGAV_LOG_WARNING, LOG_DOMAIN, "Dropping duplicate packet");
-      drop = 1;
-      }
-    else if(b->read_packets->h.sequence_number >
-            p->h.sequence_number)
-      {
-      p->next = b->read_packets;
-      b->read_packets = p;
-      }
-    else
-      {
-      p_iter = b->read_packets;
-      while(p_iter->next)
-        {
-        if(p_iter->next->h.sequence_number > p->h.sequence_number)
-          break;
-        p_iter = p_iter->next;
-        }
-      tmp = p_iter->next;
-      p_iter->next = p;
-      p_iter->next->next = tmp;
-      }
+    bgav_log(b->opt, BGAV_LOG_WARNING, LOG_DOMAIN,
+             "Dropping packet, buffer full");
+    return;
     }
-  if(!drop)
-    b->num++;
   
-  pthread_mutex_unlock(&b->read_mutex);
+  slot = &b->slots[seq & RING_MASK];
 
-  if(drop)
+  if(ATOMIC_LOAD(slot->state) != SLOT_EMPTY)
     {
-    /* Push back */
-    pthread_mutex_lock(&b->write_mutex);
-    p->next = b->write_packets;
-    b->write_packets = p;
-    pthread_mutex_unlock(&b->write_mutex);
+    if(slot->p->h.sequence_number == seq)
+      bgav_log(b->opt, BGAV_LOG_WARNING, LOG_DOMAIN,
+               "Dropping duplicate packet");
+    else
+      bgav_log(b->opt, BGAV_LOG_WARNING, LOG_DOMAIN,
+               "Dropping packet, buffer full");
+    return;
     }
+
+  /* Swap the packet with the (unused) one from the slot */
+  b->spares[index] = slot->p;
+  slot->p = p;
+  
+  ATOMIC_STORE(slot->state, SLOT_FULL);
+
+  if(seq > b->max_seq)
+    ATOMIC_STORE(b->max_seq, seq);
   }
 
 rtp_packet_t *
 bgav_rtp_packet_buffer_try_lock_read(bgav_rtp_packet_buffer_t * b)
   {
-  pthread_mutex_lock(&b->read_mutex);
-  if(!b->read_packets)
-    {
-    pthread_mutex_unlock(&b->read_mutex);
-    return NULL;
-    }
-  /* Waiting for packet */
-  if((b->last_seq != -1) &&
-     (b->read_packets->h.sequence_number != b->last_seq+1) &&
-     (b->num < MAX_MISORDER))
-    {
-    pthread_mutex_unlock(&b->read_mutex);
+  int64_t seq;
+  int64_t max_seq;
+  int64_t i;
+  slot_t * slot;
+  int broken = 0;
+  
+  seq = ATOMIC_LOAD(b->read_seq);
+  
+  if(seq < 0)
     return NULL;
-    }
   
-  b->read_packet = b->read_packets;
-  b->read_packets = b->read_packets->next;
-  b->read_packet->next = NULL;
+  slot = &b->slots[seq & RING_MASK];
 
-  if((b->last_seq >= 0) && 
-     (b->read_packet->h.sequence_number != b->last_seq+1))
+  /* Release packets the writer inserted after we skipped them */
+  if((ATOMIC_LOAD(slot->state) == SLOT_FULL) &&
+     (slot->p->h.sequence_number != seq))
+    ATOMIC_STORE(slot->state, SLOT_EMPTY);
+  
+  if(ATOMIC_LOAD(slot->state) == SLOT_EMPTY)
     {
+    /* Waiting for packet */
+    max_seq = ATOMIC_LOAD(b->max_seq);
+    
+    if(max_seq - seq < MAX_MISORDER)
+      return NULL;
+
+    /* Give up and skip to the next packet we have */
+    for(i = seq + 1; i <= max_seq; i++)
+      {
+      slot = &b->slots[i & RING_MASK];
+      
+      if(ATOMIC_LOAD(slot->state) == SLOT_FULL)
+        {
+        if(slot->p->h.sequence_number == i)
+          break;
+        ATOMIC_STORE(slot->state, SLOT_EMPTY);
+        }
+      }
+
+    if(i > max_seq)
+      return NULL;
+    
     bgav_log(b->opt, BGAV_LOG_WARNING, LOG_DOMAIN,
-             "%"PRId64" packet(s) missing",
-             b->read_packet->h.sequence_number - b->last_seq+1);
-    b->read_packet->broken = 1;
+             "%"PRId64" packet(s) missing", i - seq);
+    seq = i;
+    broken = 1;
+    ATOMIC_STORE(b->read_seq, seq);
     }
-  else
-    b->read_packet->broken = 0;
-
-  b->last_seq = b->read_packet->h.sequence_number;
   
-  b->num--;
-  pthread_mutex_unlock(&b->read_mutex);
-  //  fprintf(stderr, "Lock read\n");
+  b->read_packet = slot->p;
+  b->read_packet->broken = broken;
   return b->read_packet;
   }
 
 void bgav_rtp_packet_buffer_unlock_read(bgav_rtp_packet_buffer_t * b)
   {
-  /* Push back */
-  pthread_mutex_lock(&b->write_mutex);
-  b->read_packet->next = b->write_packets;
-  b->write_packets = b->read_packet;
-  pthread_mutex_unlock(&b->write_mutex);
-  //  fprintf(stderr, "Unlock read\n");
+  int64_t seq = b->read_packet->h.sequence_number;
   
   b->read_packet = NULL;
+
+  /* Give the slot back to the writer. The slot must be empty before
+     read_seq allows the writer to reuse it for seq + RING_SIZE */
+  ATOMIC_STORE(b->slots[seq & RING_MASK].state, SLOT_EMPTY);
+  ATOMIC_STORE(b->read_seq, seq + 1);
   }
 
 void bgav_rtp_packet_buffer_set_eof(bgav_rtp_packet_buffer_t * b)
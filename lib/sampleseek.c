@@ -106,6 +106,10 @@ void bgav_seek_audio(bgav_t * bgav, int stream, int64_t sample)
   bgav_stream_t * s;
   s = &bgav->tt->cur->audio_streams[stream];
 
+  if(bgav->pipeline)
+    bgav_pipeline_stop(bgav->pipeline);
+  bgav_seamless_reset(bgav);
+  
   // fprintf(stderr, "Seek audio: %ld\n", sample);
   
   if(sample >= s->stats.pts_end) /* EOF */
@@ -171,6 +175,10 @@ void bgav_seek_video(bgav_t * bgav, int stream, int64_t time)
   bgav_stream_t * s;
   int64_t frame_time;
   s = &bgav->tt->cur->video_streams[stream];
+
+  if(bgav->pipeline)
+    bgav_pipeline_stop(bgav->pipeline);
+  bgav_seamless_reset(bgav);
   
   //  fprintf(stderr, "Seek video: %ld\n", time);
   
@@ -426,12 +434,17 @@ int bgav_set_sample_accurate(bgav_t * b)
         {
         if(bgav_build_file_index(b, &t))
           {
-          if(!b->opt.cache_time || ((t*1000)/GAVL_TIME_SCALE > b->opt.cache_time))
+          /* Followed files are indexed again later, so we always
+             keep the index */
+          if(!b->opt.cache_time || b->opt.follow ||
+             ((t*1000)/GAVL_TIME_SCALE > b->opt.cache_time))
             bgav_write_file_index(b);
           }
         else
           return 0;
         }
+      if(b->opt.follow)
+        b->demuxer->follow = b;
       return 1;
       break;
     case INDEX_MODE_SI_PARSE:
@@ -0,0 +1,681 @@
+/*****************************************************************
+ * gmerlin-avdecoder - a general purpose multimedia decoding library
+ *
+ * Copyright (c) 2001 - 2012 Members of the Gmerlin project
+ * gmerlin-general@lists.sourceforge.net
+ * http://gmerlin.sourceforge.net
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * *****************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include <avdec_private.h>
+
+#define LOG_DOMAIN "seamless"
+
+/*
+ *  Seamless playback
+ *
+ *  The application queues tracks. The first queued track is opened
+ *  in a background thread while the current one is playing. If the
+ *  formats of all active streams are the same, the streams of the
+ *  new track are started without decoders and become a segment:
+ *  Once a stream of the handle reaches the end of its segment, it
+ *  continues with the packets of the same stream in the next segment.
+ *  The decoders of the handle are kept and the timestamps are shifted
+ *  to continue the ones of the previous segment.
+ *
+ *  Each stream switches on its own, so a segment is closed after the
+ *  last stream left it. Segment 0 is the handle itself.
+ */
+
+typedef struct segment_s
+  {
+  bgav_t * b;     /* NULL for the handle itself */
+  int track;
+  char * location;
+  int refcount;   /* Number of streams still reading from here */
+  int entered;
+  struct segment_s * next;
+  } segment_t;
+
+typedef struct
+  {
+  bgav_seamless_t * sl;
+  bgav_stream_t * s;
+  int index;
+
+  /* Original packet source of the stream */
+  bgav_packet_source_t src;
+
+  segment_t * seg;
+  bgav_stream_t * in; /* Stream of the current segment, NULL for segment 0 */
+
+  int64_t offset;
+  int64_t end;
+  bgav_packet_t * shifted; /* Peeked packet with shifted timestamps */
+  } splice_t;
+
+typedef struct
+  {
+  char * location;
+  int track;
+  } queue_entry_t;
+
+struct bgav_seamless_s
+  {
+  bgav_t * b;
+
+  queue_entry_t * queue;
+  int queue_len;
+  int queue_alloc;
+
+  /* Next track, opened by the background thread */
+  pthread_t thread;
+  int have_thread;
+  const char * open_location;
+  int open_track;
+  bgav_t * next;
+  int next_compatible;
+
+  splice_t * splices;
+  int num_splices;
+
+  segment_t * segments;
+
+  /* Packets of the later segments are read from the decoder threads
+     in pipeline mode */
+  pthread_mutex_t mutex;
+  };
+
+static bgav_stream_t * get_stream(bgav_track_t * t, int index)
+  {
+  if(index < t->num_audio_streams)
+    return &t->audio_streams[index];
+  index -= t->num_audio_streams;
+  if(index < t->num_video_streams)
+    return &t->video_streams[index];
+  return NULL;
+  }
+
+/*
+ *  The new stream isn't started with a decoder, so sample- and
+ *  pixelformats are only compared if the demuxer set them (raw formats).
+ *  Any mismatch is a hard segment boundary.
+ */
+
+static int stream_compatible(const bgav_stream_t * s, const bgav_stream_t * n)
+  {
+  if((s->type != n->type) ||
+     (s->fourcc != n->fourcc) ||
+     (s->timescale != n->timescale) ||
+     (s->ext_size != n->ext_size) ||
+     (s->ext_size && memcmp(s->ext_data, n->ext_data, s->ext_size)))
+    return 0;
+
+  switch(s->type)
+    {
+    case GAVF_STREAM_AUDIO:
+      if((s->data.audio.format->samplerate != n->data.audio.format->samplerate) ||
+         (s->data.audio.format->num_channels != n->data.audio.format->num_channels) ||
+         (s->data.audio.bits_per_sample != n->data.audio.bits_per_sample) ||
+         (s->data.audio.block_align != n->data.audio.block_align) ||
+         (s->data.audio.endianess != n->data.audio.endianess))
+        return 0;
+      if((s->data.audio.format->sample_format != GAVL_SAMPLE_NONE) &&
+         (n->data.audio.format->sample_format != GAVL_SAMPLE_NONE) &&
+         (s->data.audio.format->sample_format != n->data.audio.format->sample_format))
+        return 0;
+      break;
+    case GAVF_STREAM_VIDEO:
+      if((s->data.video.format->image_width != n->data.video.format->image_width) ||
+         (s->data.video.format->image_height != n->data.video.format->image_height) ||
+         (s->data.video.format->pixel_width != n->data.video.format->pixel_width) ||
+         (s->data.video.format->pixel_height != n->data.video.format->pixel_height) ||
+         (s->data.video.depth != n->data.video.depth))
+        return 0;
+      if((s->data.video.format->pixelformat != GAVL_PIXELFORMAT_NONE) &&
+         (n->data.video.format->pixelformat != GAVL_PIXELFORMAT_NONE) &&
+         (s->data.video.format->pixelformat != n->data.video.format->pixelformat))
+        return 0;
+      break;
+    default:
+      break;
+    }
+  return 1;
+  }
+
+/* Background thread: Open the first queued track */
+
+static void * open_thread(void * data)
+  {
+  int i;
+  bgav_seamless_t * sl = data;
+  bgav_t * b = sl->b;
+  bgav_t * next;
+  bgav_track_t * t;
+  bgav_stream_t * s;
+  const char * location =
+    sl->open_location ? sl->open_location : b->location;
+  
+  next = bgav_create();
+  bgav_options_copy(&next->opt, &b->opt);
+  next->opt.pipeline = 0;
+  next->opt.seamless = 0;
+
+  if(!bgav_open(next, location) ||
+     !bgav_select_track(next, sl->open_track))
+    {
+    bgav_log(&b->opt, BGAV_LOG_WARNING, LOG_DOMAIN,
+             "Opening %s (track %d) failed",
+             location, sl->open_track + 1);
+    bgav_close(next);
+    return NULL;
+    }
+
+  sl->next = next;
+  t = next->tt->cur;
+
+  if(!sl->num_splices ||
+     (t->num_audio_streams != b->tt->cur->num_audio_streams) ||
+     (t->num_video_streams != b->tt->cur->num_video_streams))
+    return NULL;
+
+  for(i = 0; i < sl->num_splices; i++)
+    {
+    s = get_stream(t, sl->splices[i].index);
+    if(!stream_compatible(sl->splices[i].s, s))
+      {
+      bgav_log(&b->opt, BGAV_LOG_INFO, LOG_DOMAIN,
+               "Stream formats differ, cannot append track");
+      return NULL;
+      }
+    s->action = sl->splices[i].s->action;
+    s->flags |= STREAM_SPLICE_SOURCE;
+    }
+
+  if(!bgav_start(next))
+    return NULL;
+
+  sl->next_compatible = 1;
+  return NULL;
+  }
+
+static void start_open(bgav_seamless_t * sl)
+  {
+  if(sl->have_thread || sl->next || !sl->queue_len || !sl->num_splices)
+    return;
+
+  sl->next_compatible = 0;
+  sl->open_location = sl->queue[0].location;
+  sl->open_track = sl->queue[0].track;
+  
+  if(pthread_create(&sl->thread, NULL, open_thread, sl))
+    {
+    bgav_log(&sl->b->opt, BGAV_LOG_WARNING, LOG_DOMAIN,
+             "Creating thread failed");
+    return;
+    }
+  sl->have_thread = 1;
+  }
+
+static void join_open(bgav_seamless_t * sl)
+  {
+  if(!sl->have_thread)
+    return;
+  pthread_join(sl->thread, NULL);
+  sl->have_thread = 0;
+  }
+
+static void queue_pop(bgav_seamless_t * sl, queue_entry_t * ret)
+  {
+  *ret = sl->queue[0];
+  sl->queue_len--;
+  if(sl->queue_len)
+    memmove(sl->queue, sl->queue + 1, sl->queue_len * sizeof(*sl->queue));
+  }
+
+static void queue_push_front(bgav_seamless_t * sl, char * location, int track)
+  {
+  if(sl->queue_len + 1 > sl->queue_alloc)
+    {
+    sl->queue_alloc = sl->queue_len + 16;
+    sl->queue = realloc(sl->queue, sl->queue_alloc * sizeof(*sl->queue));
+    }
+  if(sl->queue_len)
+    memmove(sl->queue + 1, sl->queue, sl->queue_len * sizeof(*sl->queue));
+  sl->queue[0].location = location;
+  sl->queue[0].track = track;
+  sl->queue_len++;
+  }
+
+static void close_segment(segment_t * seg)
+  {
+  if(seg->b)
+    bgav_close(seg->b);
+  if(seg->location)
+    free(seg->location);
+  free(seg);
+  }
+
+/* Append the opened track as new segment. Called with the mutex locked */
+
+static segment_t * append_segment(bgav_seamless_t * sl, segment_t * last)
+  {
+  queue_entry_t e;
+
+  join_open(sl);
+
+  if(!sl->next)
+    {
+    /* Opening failed, drop the entry */
+    if(sl->queue_len)
+      {
+      queue_pop(sl, &e);
+      if(e.location)
+        free(e.location);
+      }
+    return NULL;
+    }
+  if(!sl->next_compatible)
+    return NULL;
+
+  queue_pop(sl, &e);
+  last->next = calloc(1, sizeof(*last->next));
+  last->next->b = sl->next;
+  last->next->location = e.location;
+  last->next->track = e.track;
+  sl->next = NULL;
+
+  /* Prepare the one after */
+  start_open(sl);
+  return last->next;
+  }
+
+/* Move a stream to the next segment. Called with the mutex locked */
+
+static int next_segment(splice_t * sp)
+  {
+  bgav_seamless_t * sl = sp->sl;
+  segment_t * seg = sp->seg;
+  segment_t * next;
+
+  if(!(next = seg->next) && !(next = append_segment(sl, seg)))
+    return 0;
+
+  sp->in = get_stream(next->b->tt->cur, sp->index);
+  sp->seg = next;
+  sp->shifted = NULL;
+
+  if(sp->in->stats.pts_start != GAVL_TIME_UNDEFINED)
+    sp->offset = sp->end - sp->in->stats.pts_start;
+  else
+    sp->offset = sp->end;
+
+  next->refcount++;
+  seg->refcount--;
+
+  if(!next->entered)
+    {
+    next->entered = 1;
+    bgav_log(&sl->b->opt, BGAV_LOG_INFO, LOG_DOMAIN,
+             "Continuing with %s (track %d)",
+             next->location ? next->location : sl->b->location,
+             next->track + 1);
+    bgav_options_metadata_changed(&sl->b->opt, next->b->tt->cur->metadata);
+    }
+
+  /* Close segments, which were left by all streams. Segment 0
+     is the handle itself and stays. */
+  if(!sl->segments->refcount)
+    {
+    while((seg = sl->segments->next) && !seg->refcount)
+      {
+      sl->segments->next = seg->next;
+      close_segment(seg);
+      }
+    }
+  return 1;
+  }
+
+static void shift_packet(splice_t * sp, bgav_packet_t * p)
+  {
+  if(!sp->in || (p == sp->shifted))
+    return;
+  if(p->pts != GAVL_TIME_UNDEFINED)
+    p->pts += sp->offset;
+  if(p->dts != GAVL_TIME_UNDEFINED)
+    p->dts += sp->offset;
+  sp->shifted = p;
+  }
+
+static gavl_source_status_t read_packet(splice_t * sp, bgav_packet_t ** ret,
+                                        int peek, int force)
+  {
+  gavl_source_status_t st;
+  bgav_packet_t * p = NULL;
+
+  while(1)
+    {
+    if(!sp->in)
+      {
+      if(peek)
+        st = sp->src.peek_func(sp->src.data, ret ? &p : NULL, force);
+      else
+        st = sp->src.get_func(sp->src.data, &p);
+      }
+    else
+      {
+      pthread_mutex_lock(&sp->sl->mutex);
+      if(peek)
+        st = bgav_stream_peek_packet_read(sp->in, ret ? &p : NULL, force);
+      else
+        st = bgav_stream_get_packet_read(sp->in, &p);
+      pthread_mutex_unlock(&sp->sl->mutex);
+      }
+
+    if(st != GAVL_SOURCE_EOF)
+      break;
+
+    pthread_mutex_lock(&sp->sl->mutex);
+    if(!next_segment(sp))
+      {
+      pthread_mutex_unlock(&sp->sl->mutex);
+      return GAVL_SOURCE_EOF;
+      }
+    pthread_mutex_unlock(&sp->sl->mutex);
+    }
+
+  if((st != GAVL_SOURCE_OK) || !p)
+    return st;
+
+  shift_packet(sp, p);
+
+  if(!peek)
+    {
+    sp->shifted = NULL;
+
+    /* Packets are in decode order: With B-frames, the last packet
+       isn't the one with the highest pts */
+    if(p->pts != GAVL_TIME_UNDEFINED)
+      {
+      int64_t end = p->pts + (p->duration > 0 ? p->duration : 0);
+      if((sp->end == GAVL_TIME_UNDEFINED) || (end > sp->end))
+        sp->end = end;
+      }
+    }
+  if(ret)
+    *ret = p;
+  return st;
+  }
+
+static gavl_source_status_t get_packet_splice(void * priv, bgav_packet_t ** ret)
+  {
+  return read_packet(priv, ret, 0, 1);
+  }
+
+static gavl_source_status_t peek_packet_splice(void * priv, bgav_packet_t ** ret,
+                                               int force)
+  {
+  return read_packet(priv, ret, 1, force);
+  }
+
+static bgav_seamless_t * get_seamless(bgav_t * b)
+  {
+  if(!b->seamless)
+    {
+    b->seamless = calloc(1, sizeof(*b->seamless));
+    b->seamless->b = b;
+    pthread_mutex_init(&b->seamless->mutex, NULL);
+    }
+  return b->seamless;
+  }
+
+int bgav_queue_track(bgav_t * b, const char * location, int track)
+  {
+  bgav_seamless_t * sl;
+
+  if(!b->opt.seamless)
+    return 0;
+
+  sl = get_seamless(b);
+
+  pthread_mutex_lock(&sl->mutex);
+  if(sl->queue_len + 1 > sl->queue_alloc)
+    {
+    sl->queue_alloc = sl->queue_len + 16;
+    sl->queue = realloc(sl->queue, sl->queue_alloc * sizeof(*sl->queue));
+    }
+  sl->queue[sl->queue_len].location = gavl_strdup(location);
+  sl->queue[sl->queue_len].track = track;
+  sl->queue_len++;
+  
+  start_open(sl);
+  pthread_mutex_unlock(&sl->mutex);
+  return 1;
+  }
+
+bgav_t * bgav_get_next(bgav_t * b)
+  {
+  int i;
+  bgav_t * ret;
+  queue_entry_t e;
+  bgav_seamless_t * sl = b->seamless;
+
+  if(!sl || !sl->queue_len)
+    return NULL;
+
+  pthread_mutex_lock(&sl->mutex);
+  join_open(sl);
+
+  /* Not opened in the background yet */
+  if(!sl->next)
+    {
+    sl->next_compatible = 0;
+    sl->open_location = sl->queue[0].location;
+    sl->open_track = sl->queue[0].track;
+    open_thread(sl);
+    }
+  
+  ret = sl->next;
+  sl->next = NULL;
+  queue_pop(sl, &e);
+  pthread_mutex_unlock(&sl->mutex);
+
+  if(e.location)
+    free(e.location);
+
+  if(!ret)
+    return NULL;
+
+  if(sl->next_compatible)
+    {
+    /* Was started for appending, start it again the normal way */
+    bgav_stop(ret);
+    for(i = 0; i < ret->tt->cur->num_audio_streams; i++)
+      ret->tt->cur->audio_streams[i].flags &= ~STREAM_SPLICE_SOURCE;
+    for(i = 0; i < ret->tt->cur->num_video_streams; i++)
+      ret->tt->cur->video_streams[i].flags &= ~STREAM_SPLICE_SOURCE;
+    bgav_select_track(ret, ret->tt->cur - ret->tt->tracks);
+    }
+
+  /* The rest of the queue goes to the new handle */
+  ret->opt.seamless = b->opt.seamless;
+  for(i = 0; i < sl->queue_len; i++)
+    {
+    bgav_queue_track(ret, sl->queue[i].location, sl->queue[i].track);
+    if(sl->queue[i].location)
+      free(sl->queue[i].location);
+    }
+  sl->queue_len = 0;
+  return ret;
+  }
+
+void bgav_seamless_start(bgav_t * b)
+  {
+  int i, num;
+  bgav_seamless_t * sl;
+  bgav_stream_t * s;
+  splice_t * sp;
+
+  if(!b->opt.seamless)
+    return;
+
+  sl = get_seamless(b);
+
+  num = b->tt->cur->num_audio_streams + b->tt->cur->num_video_streams;
+  sl->splices = calloc(num, sizeof(*sl->splices));
+
+  sl->segments = calloc(1, sizeof(*sl->segments));
+
+  for(i = 0; i < num; i++)
+    {
+    s = get_stream(b->tt->cur, i);
+
+    if((s->action != BGAV_STREAM_DECODE) &&
+       (s->action != BGAV_STREAM_READRAW))
+      continue;
+
+    sp = &sl->splices[sl->num_splices++];
+
+    sp->sl = sl;
+    sp->s = s;
+    sp->index = i;
+    sp->seg = sl->segments;
+    sp->end = s->stats.pts_start;
+    sl->segments->refcount++;
+
+    /* We are the last element in the chain */
+    bgav_packet_source_copy(&sp->src, &s->src);
+    s->src.get_func = get_packet_splice;
+    s->src.peek_func = peek_packet_splice;
+    s->src.data = sp;
+    }
+
+  pthread_mutex_lock(&sl->mutex);
+  start_open(sl);
+  pthread_mutex_unlock(&sl->mutex);
+  }
+
+/* Go back to the first segment. The later segments are queued again */
+
+static void reset_segments(bgav_seamless_t * sl)
+  {
+  int i, j, num;
+  segment_t * seg;
+
+  join_open(sl);
+  if(sl->next)
+    {
+    bgav_close(sl->next);
+    sl->next = NULL;
+    }
+
+  /* Queue the later segments again (in their order) */
+  num = 0;
+  for(seg = sl->segments->next; seg; seg = seg->next)
+    num++;
+
+  for(i = num - 1; i >= 0; i--)
+    {
+    seg = sl->segments->next;
+    for(j = 0; j < i; j++)
+      seg = seg->next;
+    queue_push_front(sl, seg->location, seg->track);
+    seg->location = NULL;
+    }
+
+  while((seg = sl->segments->next))
+    {
+    sl->segments->next = seg->next;
+    close_segment(seg);
+    }
+
+  sl->segments->refcount = sl->num_splices;
+
+  for(i = 0; i < sl->num_splices; i++)
+    {
+    sl->splices[i].seg = sl->segments;
+    sl->splices[i].in = NULL;
+    sl->splices[i].offset = 0;
+    /* end is a running maximum, restart it from the handle */
+    sl->splices[i].end = sl->splices[i].s->stats.pts_start;
+    sl->splices[i].shifted = NULL;
+    }
+  }
+
+void bgav_seamless_reset(bgav_t * b)
+  {
+  bgav_seamless_t * sl = b->seamless;
+
+  if(!sl || !sl->segments)
+    return;
+
+  reset_segments(sl);
+  start_open(sl);
+  }
+
+void bgav_seamless_stop(bgav_t * b)
+  {
+  int i;
+  splice_t * sp;
+  bgav_seamless_t * sl = b->seamless;
+
+  if(!sl || !sl->segments)
+    return;
+
+  reset_segments(sl);
+
+  for(i = 0; i < sl->num_splices; i++)
+    {
+    sp = &sl->splices[i];
+    bgav_packet_source_copy(&sp->s->src, &sp->src);
+    }
+  free(sl->splices);
+  sl->splices = NULL;
+  sl->num_splices = 0;
+
+  close_segment(sl->segments);
+  sl->segments = NULL;
+  }
+
+void bgav_seamless_destroy(bgav_t * b)
+  {
+  int i;
+  bgav_seamless_t * sl = b->seamless;
+
+  if(!sl)
+    return;
+
+  bgav_seamless_stop(b);
+
+  join_open(sl);
+  if(sl->next)
+    bgav_close(sl->next);
+
+  for(i = 0; i < sl->queue_len; i++)
+    {
+    if(sl->queue[i].location)
+      free(sl->queue[i].location);
+    }
+  if(sl->queue)
+    free(sl->queue);
+
+  pthread_mutex_destroy(&sl->mutex);
+  free(sl);
+  b->seamless = NULL;
+  }
@@ -431,6 +431,12 @@ bgav_seek_scaled(bgav_t * b, int64_t * time, int scale)
   //  fprintf(stderr, "bgav_seek_scaled: %f\n",
   //          gavl_time_to_seconds(gavl_time_unscale(scale, *time)));
   
+  /* Park the threads, they are restarted by the next read call */
+  if(b->pipeline)
+    bgav_pipeline_stop(b->pipeline);
+
+  bgav_seamless_reset(b);
+  
   /* Clear EOF */
 
   bgav_track_clear_eof_d(track);
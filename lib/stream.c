@@ -258,6 +258,8 @@ void bgav_stream_clear(bgav_stream_t * s)
     bgav_packet_pool_put(s->pp, s->out_packet_b);
     s->out_packet_b = NULL;
     }
+  if((s->type == GAVF_STREAM_VIDEO) && s->data.video.fth)
+    bgav_frame_threads_reset(s->data.video.fth);
   
   s->in_position  = 0;
   s->out_time = GAVL_TIME_UNDEFINED;
@@ -332,6 +334,13 @@ void bgav_stream_done_packet_write(bgav_stream_t * s, bgav_packet_t * p)
     p->position = s->index_position;
     s->index_position++;
     }
+
+  if(s->demuxer && s->demuxer->pipeline &&
+     bgav_pipeline_drop_packet(s->demuxer->pipeline, s, p))
+    {
+    bgav_stream_done_packet_read(s, p);
+    return;
+    }
   
   bgav_packet_buffer_append(s->packet_buffer, p);
   }
@@ -364,9 +373,18 @@ bgav_stream_get_packet_read(bgav_stream_t * s, bgav_packet_t ** ret)
   {
   bgav_packet_t * p = NULL;
   gavl_source_status_t st;
+  bgav_perf_timer_t t;
 
+  /* In pipeline mode, the demuxer runs in another thread */
+  bgav_perf_start(&t, s->opt,
+                  (s->demuxer && !s->demuxer->pipeline) ?
+                  &s->demuxer->perf_total : NULL);
+  
   if((st = s->src.get_func(s->src.data, &p)) != GAVL_SOURCE_OK)
     return st;
+
+  bgav_perf_stop(&t, &s->perf.parse, &s->perf_parse_total);
+  s->perf.parse.bytes += p->data_size;
   
   if(s->timecode_table)
     p->tc =
@@ -442,6 +460,23 @@ bgav_stream_read_packet_func(void * sp, gavl_packet_t ** p)
   return GAVL_SOURCE_OK;
   }
 
+/*
+ *  Packets from a superindex are complete frames with timestamps,
+ *  durations and keyframe flags. In stream copy mode they need no
+ *  parsing. Formats, whose superindex has no valid timestamps
+ *  (INDEX_MODE_SI_PARSE) are excluded.
+ */
+
+int bgav_stream_copy_packets(const bgav_stream_t * s)
+  {
+  return s->opt->stream_copy &&
+    (s->action == BGAV_STREAM_READRAW) &&
+    s->demuxer && s->demuxer->si &&
+    (s->demuxer->index_mode != INDEX_MODE_SI_PARSE) &&
+    !(s->flags & (STREAM_PARSE_FULL|STREAM_DTS_ONLY|
+                  STREAM_NO_DURATIONS|STREAM_STANDALONE));
+  }
+
 void bgav_stream_set_extradata(bgav_stream_t * s,
                                const uint8_t * data, int len)
   {
@@ -19,6 +19,8 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  * *****************************************************************/
                                                                                
+#define _GNU_SOURCE /* recvmmsg */
+
 #include <fcntl.h>
 #include <sys/types.h>
 
@@ -45,7 +47,7 @@
 int bgav_udp_open(const bgav_options_t * opt, int port)
   {
   int ret;
-  size_t tmp = 0;
+  int tmp = 0;
   struct addrinfo * addr;
   addr = bgav_hostbyname(opt, NULL, port, SOCK_DGRAM, AI_PASSIVE);
 
@@ -66,8 +68,19 @@ int bgav_udp_open(const bgav_options_t * opt, int port)
     }
 
   //  getsockopt(ret, SOL_SOCKET, SO_RCVBUF, &tmp, &optlen);
+
+  /* High bitrate streams overflow small kernel buffers
+     while our thread is busy */
   tmp = 65536;
+  if(opt->network_buffer_size > tmp)
+    tmp = opt->network_buffer_size;
   setsockopt(ret, SOL_SOCKET, SO_RCVBUF, &tmp, sizeof(tmp));
+
+#ifdef SO_RXQ_OVFL
+  /* Get the number of datagrams dropped by the kernel */
+  tmp = 1;
+  setsockopt(ret, SOL_SOCKET, SO_RXQ_OVFL, &tmp, sizeof(tmp));
+#endif
   
   bgav_log(opt, BGAV_LOG_INFO, LOG_DOMAIN,
            "UDP Socket bound on port %d\n", port);
@@ -76,6 +89,45 @@ int bgav_udp_open(const bgav_options_t * opt, int port)
   return ret;
   }
 
+/*
+ *  Join a multicast group. Returns 1 if the group was joined,
+ *  0 if the address is no multicast address and -1 on error
+ */
+
+int bgav_udp_join(const bgav_options_t * opt, int fd, const char * group)
+  {
+  struct addrinfo * addr;
+  struct ip_mreq mreq;
+  struct sockaddr_in * sa;
+  
+  if(!(addr = bgav_hostbyname(opt, group, 0, SOCK_DGRAM, 0)))
+    return -1;
+
+  sa = (struct sockaddr_in *)addr->ai_addr;
+
+  if(!IN_MULTICAST(ntohl(sa->sin_addr.s_addr)))
+    {
+    freeaddrinfo(addr);
+    return 0;
+    }
+
+  memset(&mreq, 0, sizeof(mreq));
+  mreq.imr_multiaddr = sa->sin_addr;
+  mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+  freeaddrinfo(addr);
+  
+  if(setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0)
+    {
+    bgav_log(opt, BGAV_LOG_ERROR, LOG_DOMAIN,
+             "Cannot join multicast group %s: %s", group, strerror(errno));
+    return -1;
+    }
+  
+  bgav_log(opt, BGAV_LOG_INFO, LOG_DOMAIN,
+           "Joined multicast group %s", group);
+  return 1;
+  }
+
 int bgav_udp_read(int fd, uint8_t * data, int len)
   {
   int bytes_read;
@@ -94,6 +146,90 @@ int bgav_udp_read(int fd, uint8_t * data, int len)
   return bytes_read;
   }
 
+/*
+ *  Read up to num datagrams with one system call. The socket must be
+ *  readable (i.e. polled before). If supported, drops is set to the
+ *  number of datagrams the kernel dropped on this socket so far.
+ *  Returns the number of datagrams.
+ */
+
+#ifdef HAVE_RECVMMSG
+
+int bgav_udp_read_batch(int fd, uint8_t ** data, int * len,
+                        int max_len, int num, uint32_t * drops)
+  {
+  int i;
+  int result;
+  struct mmsghdr msgs[BGAV_UDP_MAX_BATCH];
+  struct iovec iov[BGAV_UDP_MAX_BATCH];
+#ifdef SO_RXQ_OVFL
+  struct cmsghdr * cmsg;
+  /* Aligned control buffers */
+  union
+    {
+    char buf[CMSG_SPACE(sizeof(uint32_t))];
+    struct cmsghdr align;
+    } ctrl[BGAV_UDP_MAX_BATCH];
+#endif
+  
+  if(num > BGAV_UDP_MAX_BATCH)
+    num = BGAV_UDP_MAX_BATCH;
+
+  memset(msgs, 0, num * sizeof(msgs[0]));
+  
+  for(i = 0; i < num; i++)
+    {
+    iov[i].iov_base = data[i];
+    iov[i].iov_len = max_len;
+    msgs[i].msg_hdr.msg_iov = &iov[i];
+    msgs[i].msg_hdr.msg_iovlen = 1;
+#ifdef SO_RXQ_OVFL
+    msgs[i].msg_hdr.msg_control = ctrl[i].buf;
+    msgs[i].msg_hdr.msg_controllen = sizeof(ctrl[i].buf);
+#endif
+    }
+
+  for(;;)
+    {
+    /* Block for the first datagram only */
+    result = recvmmsg(fd, msgs, num, MSG_WAITFORONE, NULL);
+    if(result < 0)
+      {
+      if(errno == EINTR)
+        continue;
+      return -1;
+      }
+    break;
+    }
+  
+  for(i = 0; i < result; i++)
+    {
+    len[i] = msgs[i].msg_len;
+#ifdef SO_RXQ_OVFL
+    for(cmsg = CMSG_FIRSTHDR(&msgs[i].msg_hdr); cmsg;
+        cmsg = CMSG_NXTHDR(&msgs[i].msg_hdr, cmsg))
+      {
+      if((cmsg->cmsg_level == SOL_SOCKET) &&
+         (cmsg->cmsg_type == SO_RXQ_OVFL))
+        memcpy(drops, CMSG_DATA(cmsg), sizeof(*drops));
+      }
+#endif
+    }
+  return result;
+  }
+
+#else
+
+int bgav_udp_read_batch(int fd, uint8_t ** data, int * len,
+                        int max_len, int num, uint32_t * drops)
+  {
+  if((len[0] = bgav_udp_read(fd, data[0], max_len)) < 0)
+    return -1;
+  return 1;
+  }
+
+#endif
+
 int bgav_udp_write(const bgav_options_t * opt,
                    int fd, uint8_t * data, int len,
                    struct addrinfo * addr)
@@ -68,6 +68,82 @@ int bgav_set_video_stream(bgav_t * b, int stream, bgav_stream_action_t action)
   return 1;
   }
 
+int bgav_set_video_keyframes_only(bgav_t * b, int stream, int keyframes_only)
+  {
+  bgav_stream_t * s;
+  
+  if((stream >= b->tt->cur->num_video_streams) ||
+     (stream < 0))
+    return 0;
+
+  s = &b->demuxer->tt->cur->video_streams[stream];
+
+  if(keyframes_only)
+    s->flags |= STREAM_KEYFRAMES_ONLY;
+  else
+    s->flags &= ~STREAM_KEYFRAMES_ONLY;
+  return 1;
+  }
+
+/* Keyframes only: Superindex and file index entries have reliable
+   keyframe flags unless the stream needs a parser */
+
+int bgav_video_skip_nonkey(bgav_stream_t * s)
+  {
+  return (s->flags & STREAM_KEYFRAMES_ONLY) &&
+    (s->ci.flags & GAVL_COMPRESSION_HAS_P_FRAMES) &&
+    !(s->flags & (STREAM_PARSE_FULL|STREAM_PARSE_FRAME));
+  }
+
+/* Keyframe filter: Drops all other packets before they reach the decoder */
+
+static gavl_source_status_t
+peek_keyframe(void * sp, bgav_packet_t ** ret, int force)
+  {
+  gavl_source_status_t st;
+  bgav_packet_t * p;
+  bgav_stream_t * s = sp;
+  
+  while(1)
+    {
+    p = NULL;
+    if((st = s->data.video.kf_src.peek_func(s->data.video.kf_src.data,
+                                            &p, force)) != GAVL_SOURCE_OK)
+      return st;
+
+    if(PACKET_GET_KEYFRAME(p))
+      break;
+    
+    s->data.video.kf_src.get_func(s->data.video.kf_src.data, &p);
+    bgav_stream_done_packet_read(s, p);
+    s->perf.parse.dropped++;
+    }
+  if(ret)
+    *ret = p;
+  return GAVL_SOURCE_OK;
+  }
+
+static gavl_source_status_t
+get_keyframe(void * sp, bgav_packet_t ** ret)
+  {
+  gavl_source_status_t st;
+  bgav_stream_t * s = sp;
+
+  while(1)
+    {
+    if((st = s->data.video.kf_src.get_func(s->data.video.kf_src.data,
+                                           ret)) != GAVL_SOURCE_OK)
+      return st;
+    
+    if(PACKET_GET_KEYFRAME(*ret))
+      break;
+    bgav_stream_done_packet_read(s, *ret);
+    s->perf.parse.dropped++;
+    }
+  return GAVL_SOURCE_OK;
+  }
+
+
 static int check_still(bgav_stream_t * s)
   {
   if(!STREAM_IS_STILL(s))
@@ -96,16 +172,25 @@ read_video_nocopy(void * sp,
   {
   gavl_source_status_t st;
   bgav_stream_t * s = sp;
+  bgav_perf_timer_t t;
   //  fprintf(stderr, "Read video nocopy\n");
   if(!check_still(s))
     return GAVL_SOURCE_AGAIN;
-  if((st = s->data.video.decoder->decode(sp, NULL)) != GAVL_SOURCE_OK)
+
+  bgav_perf_start(&t, s->opt, &s->perf_parse_total);
+  st = s->data.video.decoder->decode(sp, NULL);
+  bgav_perf_stop(&t, &s->perf.decode, NULL);
+
+  if(st != GAVL_SOURCE_OK)
     {
     fprintf(stderr, "EOF :)\n");
     return st;
     }
+  
   if(frame)
     *frame = s->vframe;
+  else
+    s->perf.decode.dropped++;
 #ifdef DUMP_TIMESTAMPS
   bgav_dprintf("Video timestamp: %"PRId64"\n", s->data.video.frame->timestamp);
 #endif    
@@ -119,20 +204,21 @@ static gavl_source_status_t read_video_copy(void * sp,
   {
   gavl_source_status_t st;
   bgav_stream_t * s = sp;
+  bgav_perf_timer_t t;
   if(!check_still(s))
     return GAVL_SOURCE_AGAIN;
+
+  bgav_perf_start(&t, s->opt, &s->perf_parse_total);
+  st = s->data.video.decoder->decode(sp, frame ? *frame : NULL);
+  bgav_perf_stop(&t, &s->perf.decode, NULL);
+
+  if(st != GAVL_SOURCE_OK)
+    return st;
   
   if(frame)
-    {
-    if((st = s->data.video.decoder->decode(sp, *frame)) != GAVL_SOURCE_OK)
-      return st;
     s->out_time = (*frame)->timestamp + (*frame)->duration;
-    }
   else
-    {
-    if((st = s->data.video.decoder->decode(sp, NULL)) != GAVL_SOURCE_OK)
-      return st;
-    }
+    s->perf.decode.dropped++;
 #ifdef DUMP_TIMESTAMPS
   bgav_dprintf("Video timestamp: %"PRId64"\n", s->data.video.frame->timestamp);
 #endif    
@@ -140,19 +226,47 @@ static gavl_source_status_t read_video_copy(void * sp,
   return GAVL_SOURCE_OK;
   }
 
+static gavl_source_status_t read_video_threads(void * sp,
+                                               gavl_video_frame_t ** frame)
+  {
+  gavl_source_status_t st;
+  bgav_stream_t * s = sp;
+  gavl_video_frame_t * f = NULL;
+  
+  if(!check_still(s))
+    return GAVL_SOURCE_AGAIN;
+
+  /* The decode counter is updated by the frame threads */
+  if((st = bgav_frame_threads_read(s->data.video.fth, &f)) != GAVL_SOURCE_OK)
+    return st;
+  
+  if(frame)
+    *frame = f;
+  else
+    s->perf.decode.dropped++;
+  s->out_time = f->timestamp + f->duration;
+  s->flags &= ~STREAM_HAVE_FRAME;
+  return GAVL_SOURCE_OK;
+  }
+
 int bgav_video_start(bgav_stream_t * s)
   {
   int result;
   int src_flags;
+  int copy;
   bgav_video_decoder_t * dec;
 
   if(!s->timescale && s->data.video.format->timescale)
     s->timescale = s->data.video.format->timescale;
 
+  /* In stream copy mode, the demuxer packets go to the
+     packet source directly */
+  copy = bgav_stream_copy_packets(s);
+  
   /* Some streams need to be parsed generically for extracting
      format values and/or timecodes */
 
-  if(!(s->flags & STREAM_STANDALONE))
+  if(!(s->flags & STREAM_STANDALONE) && !copy)
     {
     if(bgav_check_fourcc(s->fourcc, bgav_dv_fourccs) ||
        bgav_check_fourcc(s->fourcc, bgav_png_fourccs) ||
@@ -163,7 +277,7 @@ int bgav_video_start(bgav_stream_t * s)
     }
   
   if((s->flags & (STREAM_PARSE_FULL|STREAM_PARSE_FRAME)) &&
-     !s->data.video.parser)
+     !s->data.video.parser && !copy)
     {
     s->data.video.parser = bgav_video_parser_create(s);
     if(!s->data.video.parser)
@@ -188,7 +302,7 @@ int bgav_video_start(bgav_stream_t * s)
     s->index_mode = INDEX_MODE_SIMPLE;
     }
   /* Frametype detector */
-  if((s->flags & STREAM_NEED_FRAMETYPES) && !s->fd)
+  if((s->flags & STREAM_NEED_FRAMETYPES) && !s->fd && !copy)
     {
     s->fd = bgav_frametype_detector_create(s);
     if(bgav_stream_peek_packet_read(s, NULL, 1) != GAVL_SOURCE_OK)
@@ -265,8 +379,22 @@ int bgav_video_start(bgav_stream_t * s)
       s->ci.max_ref_frames = 1;
     }
   
+  /* Packets go to the decoder of another handle */
+  if(s->flags & STREAM_SPLICE_SOURCE)
+    return 1;
+  
   if(s->action == BGAV_STREAM_DECODE)
     {
+    if((s->flags & STREAM_KEYFRAMES_ONLY) &&
+       (s->ci.flags & GAVL_COMPRESSION_HAS_P_FRAMES) &&
+       (s->src.get_func != get_keyframe))
+      {
+      bgav_packet_source_copy(&s->data.video.kf_src, &s->src);
+      s->src.get_func = get_keyframe;
+      s->src.peek_func = peek_keyframe;
+      s->src.data = s;
+      }
+    
     dec = bgav_find_video_decoder(s->fourcc);
     if(!dec)
       {
@@ -280,22 +408,37 @@ int bgav_video_start(bgav_stream_t * s)
       return 0;
       }
     s->data.video.decoder = dec;
+
+    /* Intra-only streams can be decoded with one decoder per thread */
+    s->data.video.fth = bgav_frame_threads_create(s, dec);
     
-    result = dec->init(s);
-    if(!result)
-      return 0;
+    if(!s->data.video.fth)
+      {
+      result = dec->init(s);
+      if(!result)
+        return 0;
+      }
 
     if(s->data.video.format->interlace_mode == GAVL_INTERLACE_UNKNOWN)
       s->data.video.format->interlace_mode = GAVL_INTERLACE_NONE;
     if(s->data.video.format->framerate_mode == GAVL_FRAMERATE_UNKNOWN)
       s->data.video.format->framerate_mode = GAVL_FRAMERATE_CONSTANT;
 
+    if((s->flags & STREAM_KEYFRAMES_ONLY) &&
+       (s->data.video.format->framerate_mode == GAVL_FRAMERATE_CONSTANT))
+      s->data.video.format->framerate_mode = GAVL_FRAMERATE_VARIABLE;
+    
     src_flags = s->src_flags;
     
     if(s->vframe)
       src_flags |= GAVL_SOURCE_SRC_ALLOC;
-    
-    if(src_flags & GAVL_SOURCE_SRC_ALLOC)
+
+    if(s->data.video.fth)
+      s->data.video.vsrc =
+        gavl_video_source_create(read_video_threads,
+                                 s, src_flags | GAVL_SOURCE_SRC_ALLOC,
+                                 s->data.video.format);
+    else if(src_flags & GAVL_SOURCE_SRC_ALLOC)
       s->data.video.vsrc =
         gavl_video_source_create(read_video_nocopy,
                                  s, src_flags,
@@ -348,9 +491,22 @@ static int bgav_video_decode(bgav_stream_t * s,
 
 int bgav_read_video(bgav_t * b, gavl_video_frame_t * frame, int s)
   {
+  bgav_stream_t * vs;
+  gavl_video_frame_t * tmp;
+  
   if(b->eof)
     return 0;
-  return bgav_video_decode(&b->tt->cur->video_streams[s], frame);
+
+  vs = &b->tt->cur->video_streams[s];
+  if(vs->pipe)
+    {
+    /* If frame is NULL, the source returns its own frame, which is
+       skipped then */
+    tmp = frame;
+    return (gavl_video_source_read_frame(bgav_pipeline_get_video_source(vs),
+                                         &tmp) == GAVL_SOURCE_OK) ? 1 : 0;
+    }
+  return bgav_video_decode(vs, frame);
   }
 
 void bgav_video_dump(bgav_stream_t * s)
@@ -394,11 +550,14 @@ void bgav_video_stop(bgav_stream_t * s)
     gavl_video_source_destroy(s->data.video.vsrc);
     s->data.video.vsrc = NULL;
     }
-  if(s->data.video.decoder)
+  if(s->data.video.fth)
     {
-    s->data.video.decoder->close(s);
-    s->data.video.decoder = NULL;
+    bgav_frame_threads_destroy(s->data.video.fth);
+    s->data.video.fth = NULL;
     }
+  else if(s->data.video.decoder)
+    s->data.video.decoder->close(s);
+  s->data.video.decoder = NULL;
   /* Clear still mode flag (it will be set during reinit) */
   s->flags &= ~(STREAM_STILL_SHOWN  | STREAM_HAVE_FRAME);
   
@@ -420,6 +579,9 @@ void bgav_video_resync(bgav_stream_t * s)
     }
 
   s->flags &= ~STREAM_HAVE_FRAME;
+
+  if(s->data.video.fth)
+    bgav_frame_threads_reset(s->data.video.fth);
   
   if(s->data.video.parser)
     {
@@ -458,10 +620,11 @@ void bgav_video_resync(bgav_stream_t * s)
       p = NULL;
       bgav_stream_get_packet_read(s, &p);
       bgav_stream_done_packet_read(s, p);
+      s->perf.parse.dropped++;
       }
     }
   
-  if(s->data.video.decoder->resync)
+  if(!s->data.video.fth && s->data.video.decoder->resync)
     s->data.video.decoder->resync(s);
   }
 
@@ -512,6 +675,14 @@ int bgav_video_skipto(bgav_stream_t * s, int64_t * time, int scale)
   /* Easy case: Intra only streams */
   else if(!(s->ci.flags & GAVL_COMPRESSION_HAS_P_FRAMES))
     {
+    /* Frames decoded in advance come first */
+    if(s->data.video.fth &&
+       bgav_frame_threads_skipto(s->data.video.fth, time_scaled, &s->out_time))
+      {
+      *time = gavl_time_rescale(s->data.video.format->timescale, scale, s->out_time);
+      return 1;
+      }
+    
     while(1)
       {
       p = NULL;
@@ -526,6 +697,7 @@ int bgav_video_skipto(bgav_stream_t * s, int64_t * time, int scale)
       p = NULL;
       bgav_stream_get_packet_read(s, &p);
       bgav_stream_done_packet_read(s, p);
+      s->perf.parse.dropped++;
       }
     *time = gavl_time_rescale(s->data.video.format->timescale, scale, s->out_time);
     return 1;
@@ -575,14 +747,17 @@ void bgav_skip_video(bgav_t * bgav, int stream,
   {
   bgav_stream_t * s;
   s = &bgav->tt->cur->video_streams[stream];
-  bgav_video_skipto(s, time, scale);
+  if(s->pipe)
+    bgav_pipeline_skip_video(s, time, scale);
+  else
+    bgav_video_skipto(s, time, scale);
   }
 
 gavl_video_source_t * bgav_get_video_source(bgav_t * bgav, int stream)
   {
   bgav_stream_t * s;
   s = &bgav->tt->cur->video_streams[stream];
-  return s->data.video.vsrc;
+  return bgav_pipeline_get_video_source(s);
   }
 
 static void frame_table_append_frame(gavl_frame_table_t * t,
@@ -772,6 +947,19 @@ static uint32_t avc1_fourccs[] =
     0x00
   };
 
+static uint32_t h265_fourccs[] =
+  {
+    BGAV_MK_FOURCC('H','E','V','C'),
+    0x00
+  };
+
+static uint32_t hvc1_fourccs[] =
+  {
+    BGAV_MK_FOURCC('h','v','c','1'),
+    BGAV_MK_FOURCC('h','e','v','1'),
+    0x00
+  };
+
 static uint32_t mpeg4_fourccs[] =
   {
     BGAV_MK_FOURCC('m','p','4','v'),
@@ -854,6 +1042,11 @@ int bgav_get_video_compression_info(bgav_t * bgav, int stream,
   else if(s->flags & STREAM_GOT_NO_CI)
     return 0;
 
+  /* Not in the info cache or demuxer opened in info only mode */
+  if(!bgav_ensure_demuxer(bgav))
+    return 0;
+  s = &bgav->tt->cur->video_streams[stream];
+  
   bgav_track_get_compression(bgav->tt->cur);
   
   if(bgav_check_fourcc(s->fourcc, bgav_png_fourccs))
@@ -887,6 +1080,13 @@ int bgav_get_video_compression_info(bgav_t * bgav, int stream,
     id = GAVL_CODEC_ID_H264;
     s->flags |= STREAM_FILTER_PACKETS;
     }
+  else if(bgav_check_fourcc(s->fourcc, h265_fourccs))
+    id = GAVL_CODEC_ID_H265;
+  else if(bgav_check_fourcc(s->fourcc, hvc1_fourccs))
+    {
+    id = GAVL_CODEC_ID_H265;
+    s->flags |= STREAM_FILTER_PACKETS;
+    }
   else if(bgav_check_fourcc(s->fourcc, d10_fourccs))
     {
     id = GAVL_CODEC_ID_MPEG2;
@@ -945,6 +1145,9 @@ int bgav_get_video_compression_info(bgav_t * bgav, int stream,
   if(ret)
     gavl_compression_info_copy(ret, &s->ci);
   s->flags |= STREAM_GOT_CI;
+
+  if(bgav->opt.info_cache)
+    bgav->info_cache_dirty = 1;
   
   return 1;
   }
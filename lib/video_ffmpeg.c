@@ -475,7 +475,10 @@ static gavl_source_status_t get_packet(bgav_stream_t * s)
     break;
     }
 
-  if((priv->ctx->skip_frame == AVDISCARD_DEFAULT) &&
+  /* In keyframes only mode, we get only (reference) frames, which
+     are never discarded */
+  if(((priv->ctx->skip_frame == AVDISCARD_DEFAULT) ||
+      (s->flags & STREAM_KEYFRAMES_ONLY)) &&
      !(p->flags & GAVL_PACKET_NOOUTPUT))
     bgav_pts_cache_push(&priv->pts_cache, p, NULL, &e);
     
@@ -503,23 +506,62 @@ static gavl_source_status_t get_packet(bgav_stream_t * s)
   return GAVL_SOURCE_OK;
   }
 
+/*
+ *  Let the gavl frame point to the planes of the AVFrame. Flipping
+ *  is done with negative strides after the format is known.
+ */
+
+static void set_frame_planes(bgav_stream_t * s)
+  {
+  int i, num_planes, sub_h, sub_v, height;
+  ffmpeg_video_priv * priv;
+  priv = s->decoder_priv;
+
+  if((priv->flags & (FLIP_Y|NEED_FORMAT)) != FLIP_Y)
+    {
+    for(i = 0; i < 3; i++)
+      {
+      priv->gavl_frame->planes[i]  = priv->frame->data[i];
+      priv->gavl_frame->strides[i] = priv->frame->linesize[i];
+      }
+    return;
+    }
+
+  num_planes = gavl_pixelformat_num_planes(s->data.video.format->pixelformat);
+  gavl_pixelformat_chroma_sub(s->data.video.format->pixelformat,
+                              &sub_h, &sub_v);
+  
+  for(i = 0; i < num_planes; i++)
+    {
+    height = s->data.video.format->image_height;
+    if(i)
+      height = (height + sub_v - 1) / sub_v;
+    
+    priv->gavl_frame->planes[i]  =
+      priv->frame->data[i] + (height - 1) * priv->frame->linesize[i];
+    priv->gavl_frame->strides[i] = -priv->frame->linesize[i];
+    }
+  }
+
 static gavl_source_status_t decode_picture(bgav_stream_t * s)
   {
   ffmpeg_video_priv * priv;
   //  bgav_pts_cache_entry_t * e;
   gavl_source_status_t st;
   int result;
-
+  
   priv = s->decoder_priv;
   
   if(priv->flags & GOT_EOS)
     {
     avcodec_flush_buffers(priv->ctx);
+    av_frame_unref(priv->frame);
     priv->flags &= ~GOT_EOS;
     }
   
   while(1)
     {
+    /* Unreferences the previous frame */
     result = avcodec_receive_frame(priv->ctx, priv->frame);
 
     if(!result)
@@ -602,15 +644,11 @@ static gavl_source_status_t decode_picture(bgav_stream_t * s)
     
   if(!result)
     {
-    int i;
     s->flags |= STREAM_HAVE_FRAME; 
       
     /* Set our internal frame */
-    for(i = 0; i < 3; i++)
-      {
-      priv->gavl_frame->planes[i]  = priv->frame->data[i];
-      priv->gavl_frame->strides[i] = priv->frame->linesize[i];
-      }
+    set_frame_planes(s);
+    
     bgav_pts_cache_get_first(&priv->pts_cache, priv->gavl_frame);
 
     if(gavl_interlace_mode_is_mixed(s->data.video.format->interlace_mode))
@@ -716,7 +754,7 @@ static int init_ffmpeg(bgav_stream_t * s)
   /* Set up coded specific details */
   
   if(s->fourcc == BGAV_MK_FOURCC('W','V','1','F'))
-    s->flags |= FLIP_Y;
+    priv->flags |= FLIP_Y;
   
   priv->info = lookup_codec(s);
 
@@ -864,6 +902,9 @@ static int init_ffmpeg(bgav_stream_t * s)
   //  priv->ctx->skip_frame = AVDISCARD_NONREF;
   //  priv->ctx->skip_loop_filter = AVDISCARD_ALL;
   //  priv->ctx->skip_idct = AVDISCARD_ALL;
+
+  if(s->flags & STREAM_KEYFRAMES_ONLY)
+    priv->ctx->skip_frame = AVDISCARD_NONREF;
   
   /* Set missing format values */
   
@@ -923,7 +964,11 @@ static int init_ffmpeg(bgav_stream_t * s)
   init_put_frame(s);
 
   if(!priv->put_frame)
+    {
+    /* The initial frame might need flipping */
+    set_frame_planes(s);
     s->vframe = priv->gavl_frame;
+    }
   
   return 1;
   }
@@ -936,6 +981,9 @@ static void resync_ffmpeg(bgav_stream_t * s)
   priv = s->decoder_priv;
   
   avcodec_flush_buffers(priv->ctx);
+
+  /* Release the buffer of the last decoded frame */
+  av_frame_unref(priv->frame);
   
   bgav_pts_cache_clear(&priv->pts_cache);
   
@@ -962,11 +1010,9 @@ static void close_ffmpeg(bgav_stream_t * s)
     gavl_video_frame_destroy(priv->gavl_frame);
     }
 
+  /* Also unreferences the buffers */
   if(priv->frame)
-    {
-    //    av_frame_unref(priv->frame); // Not necessary? At least valgrind doesn't complain
     av_frame_free(&priv->frame);
-    }
   
   if(priv->src_field)
     {
@@ -997,7 +1043,6 @@ static void close_ffmpeg(bgav_stream_t * s)
 #ifdef HAVE_LIBVA
 
 #endif 
-  av_frame_free(&priv->frame);
   free(priv);
   }
 
@@ -2127,31 +2172,12 @@ static void put_frame_yuva420(bgav_stream_t * s, gavl_video_frame_t * f)
   }
 
 
-static void put_frame_flip(bgav_stream_t * s, gavl_video_frame_t * f)
-  {
-  ffmpeg_video_priv * priv = s->decoder_priv;
-  priv->gavl_frame->planes[0]  = priv->frame->data[0];
-  priv->gavl_frame->planes[1]  = priv->frame->data[1];
-  priv->gavl_frame->planes[2]  = priv->frame->data[2];
-          
-  priv->gavl_frame->strides[0] = priv->frame->linesize[0];
-  priv->gavl_frame->strides[1] = priv->frame->linesize[1];
-  priv->gavl_frame->strides[2] = priv->frame->linesize[2];
-  gavl_video_frame_copy_flip_y(s->data.video.format,
-                               f, priv->gavl_frame);
-  
-  }
-
 static void put_frame_swapfields(bgav_stream_t * s, gavl_video_frame_t * f)
   {
   ffmpeg_video_priv * priv = s->decoder_priv;
-  priv->gavl_frame->planes[0]  = priv->frame->data[0];
-  priv->gavl_frame->planes[1]  = priv->frame->data[1];
-  priv->gavl_frame->planes[2]  = priv->frame->data[2];
-          
-  priv->gavl_frame->strides[0] = priv->frame->linesize[0];
-  priv->gavl_frame->strides[1] = priv->frame->linesize[1];
-  priv->gavl_frame->strides[2] = priv->frame->linesize[2];
+
+  /* Takes care of FLIP_Y */
+  set_frame_planes(s);
 
   /* src field (top) -> dst field (bottom) */
   gavl_video_frame_get_field(s->data.video.format->pixelformat,
@@ -2181,11 +2207,53 @@ static void put_frame_swapfields(bgav_stream_t * s, gavl_video_frame_t * f)
   }
 
 #ifdef HAVE_LIBSWSCALE
+/*
+ *  Source planes for swscale. The gavl format doesn't describe the
+ *  ffmpeg pixelformat here, so the chroma subsampling for flipping is
+ *  taken from the pixelformat descriptor.
+ */
+
+static void get_src_planes(bgav_stream_t * s,
+                           const uint8_t ** planes, int * strides)
+  {
+  int i, num_planes, height;
+  const AVPixFmtDescriptor * desc;
+  ffmpeg_video_priv * priv = s->decoder_priv;
+
+  for(i = 0; i < AV_NUM_DATA_POINTERS; i++)
+    {
+    planes[i]  = priv->frame->data[i];
+    strides[i] = priv->frame->linesize[i];
+    }
+  
+  if(!(priv->flags & FLIP_Y))
+    return;
+
+  desc = av_pix_fmt_desc_get(priv->frame->format);
+  num_planes = av_pix_fmt_count_planes(priv->frame->format);
+  
+  for(i = 0; i < num_planes; i++)
+    {
+    height = s->data.video.format->image_height;
+    
+    if((i == 1) || (i == 2))
+      height = -((-height) >> desc->log2_chroma_h);
+    
+    planes[i]  += (height - 1) * strides[i];
+    strides[i] = -strides[i];
+    }
+  }
+
 static void put_frame_swscale(bgav_stream_t * s, gavl_video_frame_t * f)
   {
+  const uint8_t * planes[AV_NUM_DATA_POINTERS];
+  int strides[AV_NUM_DATA_POINTERS];
   ffmpeg_video_priv * priv = s->decoder_priv;
+
+  get_src_planes(s, planes, strides);
+  
   sws_scale(priv->swsContext,
-            (const uint8_t * const *)priv->frame->data, priv->frame->linesize,
+            planes, strides,
             0, s->data.video.format->image_height,
             f->planes, f->strides);
   }
@@ -2215,11 +2283,12 @@ static void init_put_frame(bgav_stream_t * s)
     priv->put_frame = put_frame_rgba32;
   else if(priv->ctx->pix_fmt == AV_PIX_FMT_YUVA420P)
     priv->put_frame = put_frame_yuva420;
+  /* The converters above flip while writing the destination
+     (flip_y argument), all other paths flip the source with negative
+     strides */
   else if(!priv->do_convert)
     {
-    if(priv->flags & FLIP_Y)
-      priv->put_frame = put_frame_flip;
-    else if(priv->flags & SWAP_FIELDS_OUT)
+    if(priv->flags & SWAP_FIELDS_OUT)
       priv->put_frame = put_frame_swapfields;
     else
       priv->put_frame = NULL;
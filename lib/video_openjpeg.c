@@ -180,6 +180,7 @@ static gavl_source_status_t decode_openjpeg(bgav_stream_t * s, gavl_video_frame_
         
         }
       opj_image_destroy(priv->img);
+      priv->img = NULL;
       }
     
     }
@@ -251,24 +252,29 @@ static void close_openjpeg(bgav_stream_t * s)
   free(priv);
   }
 
-#if 0
 static void resync_openjpeg(bgav_stream_t * s)
   {
   openjpeg_priv_t * priv;
   priv = s->decoder_priv;
+
+  /* Drop the image decoded in advance */
+  if(priv->img)
+    {
+    opj_image_destroy(priv->img);
+    priv->img = NULL;
+    }
   }
-#endif
 
 static bgav_video_decoder_t decoder =
   {
     .name =   "OPENJPEG video decoder",
     .fourccs =  (uint32_t[]){ BGAV_MK_FOURCC('R', '3', 'D', '1'),
                               0x00  },
+    .flags =  VIDEO_DECODER_FRAME_THREADS,
     .init =   init_openjpeg,
     .decode = decode_openjpeg,
-    //    .resync = resync_openjpeg,
+    .resync = resync_openjpeg,
     .close =  close_openjpeg,
-    .resync = NULL,
   };
 
 void bgav_init_video_decoders_openjpeg()
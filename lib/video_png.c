@@ -116,6 +116,7 @@ static bgav_video_decoder_t decoder =
   {
     .name =   "PNG video decoder",
     .fourccs = bgav_png_fourccs,
+    .flags =  VIDEO_DECODER_FRAME_THREADS,
     .init =   init_png,
     .decode = decode_png,
     .resync = resync_png,
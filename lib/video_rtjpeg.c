@@ -103,6 +103,7 @@ static bgav_video_decoder_t rtjpeg_decoder =
   {
     .name =   "rtjpeg video decoder",
     .fourccs =  (uint32_t[]){ BGAV_MK_FOURCC('R', 'T', 'J', '0'), 0x00  },
+    .flags =  VIDEO_DECODER_FRAME_THREADS,
     .init =   init_rtjpeg,
     .decode = decode_rtjpeg,
     .close =  close_rtjpeg,
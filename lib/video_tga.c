@@ -241,8 +241,10 @@ static gavl_source_status_t decode_tga(bgav_stream_t * s, gavl_video_frame_t * f
       }
 
     bgav_set_video_frame_from_packet(priv->p, frame);
-    bgav_stream_done_packet_read(s, priv->p);
     }
+  bgav_stream_done_packet_read(s, priv->p);
+  priv->p = NULL;
+  
   /* Free anything */
 
   tga_free_buffers(&priv->tga);
@@ -282,15 +284,31 @@ static void close_tga(bgav_stream_t * s)
   free(priv);
   }
 
+static void resync_tga(bgav_stream_t * s)
+  {
+  tga_priv_t * priv;
+  priv = s->decoder_priv;
+
+  /* Drop the frame decoded in advance */
+  if(priv->p)
+    {
+    bgav_stream_done_packet_read(s, priv->p);
+    priv->p = NULL;
+    }
+  tga_free_buffers(&priv->tga);
+  memset(&priv->tga, 0, sizeof(priv->tga));
+  }
+
 static bgav_video_decoder_t decoder =
   {
     .name =   "TGA video decoder",
     .fourccs =  (uint32_t[]){ BGAV_MK_FOURCC('t', 'g', 'a', ' '),
                             0x00  },
+    .flags =  VIDEO_DECODER_FRAME_THREADS,
     .init =   init_tga,
     .decode = decode_tga,
     .close =  close_tga,
-    .resync = NULL,
+    .resync = resync_tga,
   };
 
 void bgav_init_video_decoders_tga()
@@ -315,6 +315,7 @@ static bgav_video_decoder_t decoder =
     .name =   "TIFF video decoder",
     .fourccs =  (uint32_t[]){ BGAV_MK_FOURCC('t', 'i', 'f', 'f'),
                             0x00  },
+    .flags =  VIDEO_DECODER_FRAME_THREADS,
     .init =   init_tiff,
     .decode = decode_tiff,
     .close =  close_tiff,
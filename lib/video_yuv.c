@@ -23,19 +23,61 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
 
 #include <config.h>
 #include <avdec_private.h>
 #include <codecs.h>
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && \
+  defined(HAVE_IMMINTRIN_H)
+#define HAVE_X86_SIMD
+#include <immintrin.h>
+#endif
+
 #define PAD(size, bytes) ((((size)+bytes-1)/bytes)*bytes)
 
+/* Don't start threads for slices smaller than this */
+#define MIN_SLICE_ROWS 16
+
+#define LOG_DOMAIN "video_yuv"
+
+typedef struct yuv_priv_s yuv_priv_t;
+
 typedef struct
+  {
+  pthread_t thread;
+  yuv_priv_t * priv;
+  int index;
+  } slice_thread_t;
+
+typedef void (*unpack_line_func)(const uint8_t * src,
+                                 uint8_t * dst_y, uint8_t * dst_u, uint8_t * dst_v,
+                                 int width);
+
+struct yuv_priv_s
   {
   gavl_video_frame_t * frame;
   bgav_packet_t * p;
   void (*decode_func)(bgav_stream_t * s, bgav_packet_t * p, gavl_video_frame_t * f);
-  } yuv_priv_t;
+
+  /* Packed formats: Unpack rows [start, end) into dst */
+  void (*unpack_rows)(yuv_priv_t * priv, gavl_video_frame_t * dst, int start, int end);
+  unpack_line_func unpack_line;
+  int width;
+  int num_rows;
+  
+  /* Slice threads. Slice 0 is done by the calling thread */
+  int num_slices;
+  slice_thread_t * threads;
+  pthread_mutex_t mutex;
+  pthread_cond_t start_cond;
+  pthread_cond_t done_cond;
+  int job;
+  int pending;
+  int quit;
+  gavl_video_frame_t * dst;
+  };
 
 /* Common initialization */
 
@@ -45,57 +87,9 @@ static void init_common(bgav_stream_t * s)
   priv = calloc(1, sizeof(*priv));
   s->decoder_priv = priv;
   priv->frame = gavl_video_frame_create(NULL);
-  }
-
-/* Decoding functions */
-
-/* yuv2: It's yuyv with signedness swapped and JPEG scaled */
-
-static void decode_yuv2(bgav_stream_t * s, bgav_packet_t * p, gavl_video_frame_t * f)
-  {
-  int i, j;
-  uint8_t * src, *dst_y, *dst_u, *dst_v;
-  yuv_priv_t * priv;
-  priv = s->decoder_priv;
-
-  priv->frame->planes[0] = p->data;
-  
-  for(i = 0; i < s->data.video.format->image_height; i++)
-    {
-    src = priv->frame->planes[0] + i * priv->frame->strides[0];
-    dst_y = f->planes[0]         + i * f->strides[0];
-    dst_u = f->planes[1]         + i * f->strides[1];
-    dst_v = f->planes[2]         + i * f->strides[2];
-    
-    for(j = 0; j < s->data.video.format->image_width/2; j++)
-      {
-      dst_y[0] = src[0];        /* Y */
-      dst_u[0] = src[1] ^ 0x80; /* U */
-      dst_y[1] = src[2];        /* Y */
-      dst_v[0] = src[3] ^ 0x80; /* V */
-      src+=4;
-      dst_y+=2;
-      dst_u++;
-      dst_v++;
-      }
-    }
-  }
-
-static int init_yuv2(bgav_stream_t * s)
-  {
-  yuv_priv_t * priv;
-  
-  init_common(s);
-
-  gavl_dictionary_set_string(s->m, GAVL_META_FORMAT,
-                    "Full scale YUV 4:2:2 packed (yuv2)");
-
-  priv = s->decoder_priv;
-
-  priv->frame->strides[0] = PAD(s->data.video.format->image_width * 2, 4);
-  priv->decode_func = decode_yuv2;
-  s->data.video.format->pixelformat = GAVL_YUVJ_422_P;
-  return 1;
+#ifdef HAVE_X86_SIMD
+  __builtin_cpu_init();
+#endif
   }
 
 /* v408:  */
@@ -136,33 +130,579 @@ static const uint8_t decode_alpha_v408[256] =
   0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
 };
 
+/* Line unpackers. The SIMD versions handle the bulk of the line and
+   leave the rest to the C versions */
 
-static void decode_v408(bgav_stream_t * s, bgav_packet_t * p, gavl_video_frame_t * f)
+static void unpack_line_yuv2_c(const uint8_t * src,
+                               uint8_t * dst_y, uint8_t * dst_u, uint8_t * dst_v,
+                               int width)
   {
-  int i, j;
-  uint8_t * src, *dst;
+  int j;
+  for(j = 0; j < width/2; j++)
+    {
+    dst_y[0] = src[0];        /* Y */
+    dst_u[0] = src[1] ^ 0x80; /* U */
+    dst_y[1] = src[2];        /* Y */
+    dst_v[0] = src[3] ^ 0x80; /* V */
+    src+=4;
+    dst_y+=2;
+    dst_u++;
+    dst_v++;
+    }
+  }
+
+static void unpack_line_v408_c(const uint8_t * src,
+                               uint8_t * dst, uint8_t * dst_u, uint8_t * dst_v,
+                               int width)
+  {
+  int j;
+  for(j = 0; j < width; j++)
+    {
+    dst[0] = src[1];                    /* Y */
+    dst[1] = src[0];                    /* U */
+    dst[2] = src[2];                    /* V */
+    dst[3] = decode_alpha_v408[src[3]]; /* A */
+    src+=4;
+    dst+=4;
+    }
+  }
+
+static void unpack_line_v308_c(const uint8_t * src,
+                               uint8_t * dst_y, uint8_t * dst_u, uint8_t * dst_v,
+                               int width)
+  {
+  int j;
+  for(j = 0; j < width; j++)
+    {
+    *dst_y = src[1];
+    *dst_u = src[2];
+    *dst_v = src[0];
+      
+    src+=3;
+    dst_y++;
+    dst_u++;
+    dst_v++;
+    }
+  }
+
+static void unpack_line_v410_c(const uint8_t * src,
+                               uint8_t * dst_y8, uint8_t * dst_u8, uint8_t * dst_v8,
+                               int width)
+  {
+  int j;
+  uint32_t src_i;
+  uint16_t * dst_y = (uint16_t*)dst_y8;
+  uint16_t * dst_u = (uint16_t*)dst_u8;
+  uint16_t * dst_v = (uint16_t*)dst_v8;
+
+  for(j = 0; j < width; j++)
+    {
+    src_i = GAVL_PTR_2_32LE(src);
+
+    *(dst_v++) = (src_i & 0xffc00000) >> 16; /* V */
+    *(dst_y++) = (src_i & 0x3ff000) >> 6;    /* Y */
+    *(dst_u++) = (src_i & 0xffc) << 4;       /* U */
+      
+    src+=4;
+    }
+  }
+
+static void unpack_line_v210_c(const uint8_t * src,
+                               uint8_t * dst_y8, uint8_t * dst_u8, uint8_t * dst_v8,
+                               int width)
+  {
+  int j;
+  uint32_t i1, i2, i3, i4;
+  uint16_t * dst_y = (uint16_t*)dst_y8;
+  uint16_t * dst_u = (uint16_t*)dst_u8;
+  uint16_t * dst_v = (uint16_t*)dst_v8;
+
+  for(j = 0; j < width/6; j++)
+    {
+    i1 = GAVL_PTR_2_32LE(src);src+=4;
+    i2 = GAVL_PTR_2_32LE(src);src+=4;
+    i3 = GAVL_PTR_2_32LE(src);src+=4;
+    i4 = GAVL_PTR_2_32LE(src);src+=4;
+
+    /* These are grouped to show the "pixel pairs" of  4:2:2 */
+      
+    *(dst_u++) = (i1 & 0x3ff) << 6;       /* Cb0 */
+    *(dst_y++) = (i1 & 0xffc00) >> 4;     /* Y0 */
+    *(dst_v++) = (i1 & 0x3ff00000) >> 14; /* Cr0 */
+    *(dst_y++) = (i2 & 0x3ff) << 6;       /* Y1 */
+      
+    *(dst_u++) = (i2 & 0xffc00) >> 4;     /* Cb1 */
+    *(dst_y++) = (i2 & 0x3ff00000) >> 14; /* Y2 */
+    *(dst_v++) = (i3 & 0x3ff) << 6;       /* Cr1 */
+    *(dst_y++) = (i3 & 0xffc00) >> 4;     /* Y3 */
+      
+    *(dst_u++) = (i3 & 0x3ff00000) >> 14; /* Cb2 */
+    *(dst_y++) = (i4 & 0x3ff) << 6;       /* Y4 */
+    *(dst_v++) = (i4 & 0xffc00) >> 4;     /* Cr2 */
+    *(dst_y++) = (i4 & 0x3ff00000) >> 14; /* Y5 */
+    }
+
+  /* Handle the 2 or 4 pixels possibly remaining */
+  j = width - (width / 6) * 6;
+  if (j != 0)
+    {
+    i1 = GAVL_PTR_2_32LE(src);src+=4;
+    i2 = GAVL_PTR_2_32LE(src);src+=4;
+    i3 = GAVL_PTR_2_32LE(src);src+=4;
+    i4 = GAVL_PTR_2_32LE(src);src+=4;
+
+    *(dst_u++) = (i1 & 0x3ff) << 6;       /* Cb0 */
+    *(dst_y++) = (i1 & 0xffc00) >> 4;     /* Y0 */
+    *(dst_v++) = (i1 & 0x3ff00000) >> 14; /* Cr0 */
+    *(dst_y++) = (i2 & 0x3ff) << 6;       /* Y1 */
+    if (j == 4)
+      {
+      *(dst_u++) = (i2 & 0xffc00) >> 4;     /* Cb1 */
+      *(dst_y++) = (i2 & 0x3ff00000) >> 14; /* Y2 */
+      *(dst_v++) = (i3 & 0x3ff) << 6;       /* Cr1 */
+      *(dst_y++) = (i3 & 0xffc00) >> 4;     /* Y3 */
+      }
+    }
+  }
+
+#ifdef HAVE_X86_SIMD
+
+#define TARGET(t) __attribute__((target(t)))
+
+/* 16 pixels per iteration */
+
+static void TARGET("sse2")
+unpack_line_yuv2_sse2(const uint8_t * src,
+                      uint8_t * dst_y, uint8_t * dst_u, uint8_t * dst_v,
+                      int width)
+  {
+  int j;
+  __m128i s0, s1, c;
+  const __m128i mask = _mm_set1_epi16(0x00ff);
+  const __m128i sign = _mm_set1_epi8((char)0x80);
+  
+  for(j = 0; j + 16 <= width; j += 16)
+    {
+    s0 = _mm_loadu_si128((const __m128i*)src);
+    s1 = _mm_loadu_si128((const __m128i*)(src + 16));
+
+    _mm_storeu_si128((__m128i*)dst_y,
+                     _mm_packus_epi16(_mm_and_si128(s0, mask),
+                                      _mm_and_si128(s1, mask)));
+
+    /* U0 V0 U1 V1 ... */
+    c = _mm_packus_epi16(_mm_srli_epi16(s0, 8), _mm_srli_epi16(s1, 8));
+    c = _mm_xor_si128(c, sign);
+
+    _mm_storel_epi64((__m128i*)dst_u,
+                     _mm_packus_epi16(_mm_and_si128(c, mask), c));
+    _mm_storel_epi64((__m128i*)dst_v,
+                     _mm_packus_epi16(_mm_srli_epi16(c, 8), c));
+    
+    src   += 32;
+    dst_y += 16;
+    dst_u += 8;
+    dst_v += 8;
+    }
+  
+  if(j < width)
+    unpack_line_yuv2_c(src, dst_y, dst_u, dst_v, width - j);
+  }
+
+/* v308: Shuffle masks for 16 pixels (48 bytes) from 3 registers */
+
+static uint8_t v308_shuffle[3][3][16];
+static pthread_once_t v308_shuffle_once = PTHREAD_ONCE_INIT;
+
+static void init_v308_shuffle(void)
+  {
+  int c, r, k, idx;
+  /* Byte offsets of Y, U and V within a pixel */
+  static const int offsets[3] = { 1, 2, 0 };
+  
+  for(c = 0; c < 3; c++)
+    {
+    for(r = 0; r < 3; r++)
+      {
+      for(k = 0; k < 16; k++)
+        {
+        idx = 3 * k + offsets[c] - 16 * r;
+        v308_shuffle[c][r][k] = ((idx >= 0) && (idx < 16)) ? idx : 0x80;
+        }
+      }
+    }
+  }
+
+static void TARGET("ssse3")
+unpack_line_v308_ssse3(const uint8_t * src,
+                       uint8_t * dst_y, uint8_t * dst_u, uint8_t * dst_v,
+                       int width)
+  {
+  int j, c;
+  __m128i s[3];
+  __m128i m[3][3];
+  uint8_t * dst[3];
+  
+  for(c = 0; c < 3; c++)
+    {
+    m[c][0] = _mm_loadu_si128((const __m128i*)v308_shuffle[c][0]);
+    m[c][1] = _mm_loadu_si128((const __m128i*)v308_shuffle[c][1]);
+    m[c][2] = _mm_loadu_si128((const __m128i*)v308_shuffle[c][2]);
+    }
+
+  dst[0] = dst_y;
+  dst[1] = dst_u;
+  dst[2] = dst_v;
+  
+  for(j = 0; j + 16 <= width; j += 16)
+    {
+    s[0] = _mm_loadu_si128((const __m128i*)src);
+    s[1] = _mm_loadu_si128((const __m128i*)(src + 16));
+    s[2] = _mm_loadu_si128((const __m128i*)(src + 32));
+
+    for(c = 0; c < 3; c++)
+      {
+      _mm_storeu_si128((__m128i*)dst[c],
+                       _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(s[0], m[c][0]),
+                                                 _mm_shuffle_epi8(s[1], m[c][1])),
+                                    _mm_shuffle_epi8(s[2], m[c][2])));
+      dst[c] += 16;
+      }
+    src += 48;
+    }
+  
+  if(j < width)
+    unpack_line_v308_c(src, dst[0], dst[1], dst[2], width - j);
+  }
+
+/* v410: 8 pixels per iteration */
+
+static void TARGET("sse4.1")
+unpack_line_v410_sse4(const uint8_t * src,
+                      uint8_t * dst_y, uint8_t * dst_u, uint8_t * dst_v,
+                      int width)
+  {
+  int j;
+  __m128i s0, s1;
+  const __m128i mask = _mm_set1_epi32(0xffc0);
+  
+  for(j = 0; j + 8 <= width; j += 8)
+    {
+    s0 = _mm_loadu_si128((const __m128i*)src);
+    s1 = _mm_loadu_si128((const __m128i*)(src + 16));
+
+    _mm_storeu_si128((__m128i*)dst_y,
+                     _mm_packus_epi32(_mm_and_si128(_mm_srli_epi32(s0, 6), mask),
+                                      _mm_and_si128(_mm_srli_epi32(s1, 6), mask)));
+    _mm_storeu_si128((__m128i*)dst_u,
+                     _mm_packus_epi32(_mm_and_si128(_mm_slli_epi32(s0, 4), mask),
+                                      _mm_and_si128(_mm_slli_epi32(s1, 4), mask)));
+    _mm_storeu_si128((__m128i*)dst_v,
+                     _mm_packus_epi32(_mm_and_si128(_mm_srli_epi32(s0, 16), mask),
+                                      _mm_and_si128(_mm_srli_epi32(s1, 16), mask)));
+    src   += 32;
+    dst_y += 16;
+    dst_u += 16;
+    dst_v += 16;
+    }
+  
+  if(j < width)
+    unpack_line_v410_c(src, dst_y, dst_u, dst_v, width - j);
+  }
+
+/* v410: 16 pixels per iteration. _mm256_packus_epi32 works on 128 bit lanes,
+   so the result is permuted afterwards */
+
+static inline __m256i TARGET("avx2")
+pack_v410_avx2(__m256i s0, __m256i s1)
+  {
+  return _mm256_permute4x64_epi64(_mm256_packus_epi32(s0, s1), 0xd8);
+  }
+
+static void TARGET("avx2")
+unpack_line_v410_avx2(const uint8_t * src,
+                      uint8_t * dst_y, uint8_t * dst_u, uint8_t * dst_v,
+                      int width)
+  {
+  int j;
+  __m256i s0, s1;
+  const __m256i mask = _mm256_set1_epi32(0xffc0);
+  
+  for(j = 0; j + 16 <= width; j += 16)
+    {
+    s0 = _mm256_loadu_si256((const __m256i*)src);
+    s1 = _mm256_loadu_si256((const __m256i*)(src + 32));
+
+    _mm256_storeu_si256((__m256i*)dst_y,
+                        pack_v410_avx2(_mm256_and_si256(_mm256_srli_epi32(s0, 6), mask),
+                                       _mm256_and_si256(_mm256_srli_epi32(s1, 6), mask)));
+    _mm256_storeu_si256((__m256i*)dst_u,
+                        pack_v410_avx2(_mm256_and_si256(_mm256_slli_epi32(s0, 4), mask),
+                                       _mm256_and_si256(_mm256_slli_epi32(s1, 4), mask)));
+    _mm256_storeu_si256((__m256i*)dst_v,
+                        pack_v410_avx2(_mm256_and_si256(_mm256_srli_epi32(s0, 16), mask),
+                                       _mm256_and_si256(_mm256_srli_epi32(s1, 16), mask)));
+    src   += 64;
+    dst_y += 32;
+    dst_u += 32;
+    dst_v += 32;
+    }
+  
+  if(j < width)
+    unpack_line_v410_sse4(src, dst_y, dst_u, dst_v, width - j);
+  }
+
+/*
+ *  v210: One 16 byte block (6 pixels) per iteration. The 3 10 bit fields
+ *  of the 4 words are extracted into a = Cb0 Y1 Cr1 Y4, b = Y0 Cb1 Y3 Cr2 and
+ *  c = Cr0 Y2 Cb2 Y5 and shuffled into place. The stores write 2 Y and 1 Cb/Cr
+ *  sample more than they should, so the last block is done by the C version.
+ */
+
+#define W(n) (2*(n)), (2*(n)+1)
+#define X    -128, -128
+
+static void TARGET("sse4.1")
+unpack_line_v210_sse4(const uint8_t * src,
+                      uint8_t * dst_y, uint8_t * dst_u, uint8_t * dst_v,
+                      int width)
+  {
+  int j, blocks;
+  __m128i s, ab, cc, y, uv;
+  const __m128i mask = _mm_set1_epi32(0xffc0);
+
+  /* ab = a0 a1 a2 a3 b0 b1 b2 b3, cc = c0 c1 c2 c3 c0 c1 c2 c3 */
+  const __m128i y_ab  = _mm_setr_epi8(W(4), W(1), X,    W(6), W(3), X,    X, X);
+  const __m128i y_cc  = _mm_setr_epi8(X,    X,    W(1), X,    X,    W(3), X, X);
+  const __m128i uv_ab = _mm_setr_epi8(W(0), W(5), X,    X,    X,    W(2), W(7), X);
+  const __m128i uv_cc = _mm_setr_epi8(X,    X,    W(2), X,    W(0), X,    X,    X);
+  
+  blocks = width / 6;
+  
+  for(j = 0; j < blocks - 1; j++)
+    {
+    s = _mm_loadu_si128((const __m128i*)src);
+
+    ab = _mm_packus_epi32(_mm_and_si128(_mm_slli_epi32(s, 6), mask),
+                          _mm_and_si128(_mm_srli_epi32(s, 4), mask));
+    cc = _mm_and_si128(_mm_srli_epi32(s, 14), mask);
+    cc = _mm_packus_epi32(cc, cc);
+
+    y  = _mm_or_si128(_mm_shuffle_epi8(ab, y_ab),  _mm_shuffle_epi8(cc, y_cc));
+    uv = _mm_or_si128(_mm_shuffle_epi8(ab, uv_ab), _mm_shuffle_epi8(cc, uv_cc));
+
+    _mm_storeu_si128((__m128i*)dst_y, y);
+    _mm_storel_epi64((__m128i*)dst_u, uv);
+    _mm_storel_epi64((__m128i*)dst_v, _mm_srli_si128(uv, 8));
+    
+    src   += 16;
+    dst_y += 12;
+    dst_u += 6;
+    dst_v += 6;
+    }
+
+  unpack_line_v210_c(src, dst_y, dst_u, dst_v, width - j * 6);
+  }
+
+#undef W
+#undef X
+
+#endif
+
+/*
+ *  Packed formats, which are converted to a different layout.
+ *  Rows are independent, so larger frames are split into horizontal
+ *  slices, which are unpacked by worker threads.
+ */
+
+static void unpack_rows_planar(yuv_priv_t * priv, gavl_video_frame_t * f,
+                               int start, int end)
+  {
+  int i;
+  
+  for(i = start; i < end; i++)
+    {
+    priv->unpack_line(priv->frame->planes[0] + i * priv->frame->strides[0],
+                      f->planes[0] + i * f->strides[0],
+                      f->planes[1] ? f->planes[1] + i * f->strides[1] : NULL,
+                      f->planes[2] ? f->planes[2] + i * f->strides[2] : NULL,
+                      priv->width);
+    }
+  }
+
+static void get_slice(yuv_priv_t * priv, int index, int * start, int * end)
+  {
+  *start = (priv->num_rows * index) / priv->num_slices;
+  *end   = (priv->num_rows * (index + 1)) / priv->num_slices;
+  }
+
+static void * slice_thread(void * data)
+  {
+  int start, end;
+  int job = 0;
+  slice_thread_t * t = data;
+  yuv_priv_t * priv = t->priv;
+  
+  while(1)
+    {
+    pthread_mutex_lock(&priv->mutex);
+    while(!priv->quit && (priv->job == job))
+      pthread_cond_wait(&priv->start_cond, &priv->mutex);
+
+    if(priv->quit)
+      {
+      pthread_mutex_unlock(&priv->mutex);
+      break;
+      }
+    job = priv->job;
+    pthread_mutex_unlock(&priv->mutex);
+
+    get_slice(priv, t->index, &start, &end);
+    priv->unpack_rows(priv, priv->dst, start, end);
+    
+    pthread_mutex_lock(&priv->mutex);
+    priv->pending--;
+    if(!priv->pending)
+      pthread_cond_signal(&priv->done_cond);
+    pthread_mutex_unlock(&priv->mutex);
+    }
+  return NULL;
+  }
+
+static void decode_packed(bgav_stream_t * s, bgav_packet_t * p, gavl_video_frame_t * f)
+  {
+  int start, end;
   yuv_priv_t * priv;
   priv = s->decoder_priv;
 
   priv->frame->planes[0] = p->data;
+
+  if(!f)
+    return;
   
-  for(i = 0; i < s->data.video.format->image_height; i++)
+  if(priv->num_slices < 2)
     {
-    src = priv->frame->planes[0] + i * priv->frame->strides[0];
-    dst = f->planes[0]         + i * f->strides[0];
-    
-    for(j = 0; j < s->data.video.format->image_width; j++)
+    priv->unpack_rows(priv, f, 0, priv->num_rows);
+    return;
+    }
+
+  pthread_mutex_lock(&priv->mutex);
+  priv->dst = f;
+  priv->pending = priv->num_slices - 1;
+  priv->job++;
+  pthread_cond_broadcast(&priv->start_cond);
+  pthread_mutex_unlock(&priv->mutex);
+
+  get_slice(priv, 0, &start, &end);
+  priv->unpack_rows(priv, f, start, end);
+
+  pthread_mutex_lock(&priv->mutex);
+  while(priv->pending)
+    pthread_cond_wait(&priv->done_cond, &priv->mutex);
+  pthread_mutex_unlock(&priv->mutex);
+  }
+
+static void init_packed(bgav_stream_t * s,
+                        void (*unpack_rows)(yuv_priv_t * priv,
+                                            gavl_video_frame_t * dst,
+                                            int start, int end),
+                        unpack_line_func unpack_line,
+                        int num_rows)
+  {
+  int i, num_slices;
+  yuv_priv_t * priv;
+  priv = s->decoder_priv;
+
+  priv->decode_func = decode_packed;
+  priv->unpack_rows = unpack_rows;
+  priv->unpack_line = unpack_line;
+  priv->width = s->data.video.format->image_width;
+  priv->num_rows = num_rows;
+  priv->num_slices = 1;
+  
+  num_slices = s->opt->threads;
+  if(num_slices > num_rows / MIN_SLICE_ROWS)
+    num_slices = num_rows / MIN_SLICE_ROWS;
+
+  if(num_slices < 2)
+    return;
+
+  pthread_mutex_init(&priv->mutex, NULL);
+  pthread_cond_init(&priv->start_cond, NULL);
+  pthread_cond_init(&priv->done_cond, NULL);
+  
+  priv->threads = calloc(num_slices - 1, sizeof(*priv->threads));
+  
+  for(i = 0; i < num_slices - 1; i++)
+    {
+    priv->threads[i].priv = priv;
+    priv->threads[i].index = i + 1;
+    if(pthread_create(&priv->threads[i].thread, NULL,
+                      slice_thread, &priv->threads[i]))
       {
-      dst[0] = src[1];                    /* Y */
-      dst[1] = src[0];                    /* U */
-      dst[2] = src[2];                    /* V */
-      dst[3] = decode_alpha_v408[src[3]]; /* A */
-      src+=4;
-      dst+=4;
+      bgav_log(s->opt, BGAV_LOG_WARNING, LOG_DOMAIN,
+               "Creating slice thread failed");
+      break;
       }
     }
+  priv->num_slices = i + 1;
   }
 
+static void close_packed(yuv_priv_t * priv)
+  {
+  int i;
+  
+  if(!priv->threads)
+    return;
+  
+  pthread_mutex_lock(&priv->mutex);
+  priv->quit = 1;
+  pthread_cond_broadcast(&priv->start_cond);
+  pthread_mutex_unlock(&priv->mutex);
+  
+  for(i = 0; i < priv->num_slices - 1; i++)
+    pthread_join(priv->threads[i].thread, NULL);
+  
+  free(priv->threads);
+  pthread_mutex_destroy(&priv->mutex);
+  pthread_cond_destroy(&priv->start_cond);
+  pthread_cond_destroy(&priv->done_cond);
+  }
+
+#ifdef HAVE_X86_SIMD
+#define CPU_SUPPORTS(ext) __builtin_cpu_supports(ext)
+#else
+#define CPU_SUPPORTS(ext) 0
+#endif
+
+/* Decoding functions */
+
+/* yuv2: It's yuyv with signedness swapped and JPEG scaled */
+
+static int init_yuv2(bgav_stream_t * s)
+  {
+  yuv_priv_t * priv;
+  
+  init_common(s);
+
+  gavl_dictionary_set_string(s->m, GAVL_META_FORMAT,
+                    "Full scale YUV 4:2:2 packed (yuv2)");
+
+  priv = s->decoder_priv;
+
+  priv->frame->strides[0] = PAD(s->data.video.format->image_width * 2, 4);
+  init_packed(s, unpack_rows_planar, unpack_line_yuv2_c,
+              s->data.video.format->image_height);
+#ifdef HAVE_X86_SIMD
+  if(CPU_SUPPORTS("sse2"))
+    priv->unpack_line = unpack_line_yuv2_sse2;
+#endif
+  s->data.video.format->pixelformat = GAVL_YUVJ_422_P;
+  return 1;
+  }
+
+
+
 static int init_v408(bgav_stream_t * s)
   {
   yuv_priv_t * priv;
@@ -175,7 +715,8 @@ static int init_v408(bgav_stream_t * s)
   priv = s->decoder_priv;
 
   priv->frame->strides[0] = s->data.video.format->image_width * 4;
-  priv->decode_func = decode_v408;
+  init_packed(s, unpack_rows_planar, unpack_line_v408_c,
+              s->data.video.format->image_height);
   s->data.video.format->pixelformat = GAVL_YUVA_32;
   return 1;
   }
@@ -345,38 +886,6 @@ static int init_YVU9(bgav_stream_t * s)
 
 /* v308: Packed YUV 4:4:4, we make this planar */
 
-static void decode_v308(bgav_stream_t * s, bgav_packet_t * p, gavl_video_frame_t * f)
-  {
-  int i, j;
-  uint8_t * src, *dst_y, *dst_u, *dst_v;
-  yuv_priv_t * priv;
-  priv = s->decoder_priv;
-
-  priv->frame->planes[0] = p->data;
-  
-  for(i = 0; i < s->data.video.format->image_height; i++)
-    {
-    src = priv->frame->planes[0] + i * priv->frame->strides[0];
-
-    dst_y = f->planes[0] + i * f->strides[0];
-    dst_u = f->planes[1] + i * f->strides[1];
-    dst_v = f->planes[2] + i * f->strides[2];
-    
-    for(j = 0; j < s->data.video.format->image_width; j++)
-      {
-      *dst_y = src[1];
-      *dst_u = src[2];
-      *dst_v = src[0];
-      
-      src+=3;
-      dst_y++;
-      dst_u++;
-      dst_v++;
-      
-      }
-    }
-  }
-
 static int init_v308(bgav_stream_t * s)
   {
   yuv_priv_t * priv;
@@ -389,7 +898,15 @@ static int init_v308(bgav_stream_t * s)
   priv = s->decoder_priv;
 
   priv->frame->strides[0] = s->data.video.format->image_width * 3;
-  priv->decode_func = decode_v308;
+  init_packed(s, unpack_rows_planar, unpack_line_v308_c,
+              s->data.video.format->image_height);
+#ifdef HAVE_X86_SIMD
+  if(CPU_SUPPORTS("ssse3"))
+    {
+    pthread_once(&v308_shuffle_once, init_v308_shuffle);
+    priv->unpack_line = unpack_line_v308_ssse3;
+    }
+#endif
   s->data.video.format->pixelformat = GAVL_YUV_444_P;
   return 1;
   }
@@ -399,38 +916,6 @@ static int init_v308(bgav_stream_t * s)
  *  we make this planar
  */
 
-static void decode_v410(bgav_stream_t * s, bgav_packet_t * p, gavl_video_frame_t * f)
-  {
-  int i, j;
-  uint8_t * src;
-  uint16_t *dst_y, *dst_u, *dst_v;
-  uint32_t src_i;
-  yuv_priv_t * priv;
-  priv = s->decoder_priv;
-
-  priv->frame->planes[0] = p->data;
-  
-  for(i = 0; i < s->data.video.format->image_height; i++)
-    {
-    src = priv->frame->planes[0] + i * priv->frame->strides[0];
-
-    dst_y = (uint16_t*)(f->planes[0] + i * f->strides[0]);
-    dst_u = (uint16_t*)(f->planes[1] + i * f->strides[1]);
-    dst_v = (uint16_t*)(f->planes[2] + i * f->strides[2]);
-    
-    for(j = 0; j < s->data.video.format->image_width; j++)
-      {
-      src_i = GAVL_PTR_2_32LE(src);
-
-      *(dst_v++) = (src_i & 0xffc00000) >> 16; /* V */
-      *(dst_y++) = (src_i & 0x3ff000) >> 6;    /* Y */
-      *(dst_u++) = (src_i & 0xffc) << 4;       /* U */
-      
-      src+=4;
-      }
-    }
-  }
-
 static int init_v410(bgav_stream_t * s)
   {
   yuv_priv_t * priv;
@@ -443,7 +928,14 @@ static int init_v410(bgav_stream_t * s)
   priv = s->decoder_priv;
 
   priv->frame->strides[0] = s->data.video.format->image_width * 4;
-  priv->decode_func = decode_v410;
+  init_packed(s, unpack_rows_planar, unpack_line_v410_c,
+              s->data.video.format->image_height);
+#ifdef HAVE_X86_SIMD
+  if(CPU_SUPPORTS("avx2"))
+    priv->unpack_line = unpack_line_v410_avx2;
+  else if(CPU_SUPPORTS("sse4.1"))
+    priv->unpack_line = unpack_line_v410_sse4;
+#endif
   s->data.video.format->pixelformat = GAVL_YUV_444_P_16;
   return 1;
   }
@@ -453,74 +945,6 @@ static int init_v410(bgav_stream_t * s)
  *  we make this planar
  */
 
-static void decode_v210(bgav_stream_t * s, bgav_packet_t * p, gavl_video_frame_t * f)
-  {
-  int i, j;
-  uint8_t * src;
-  uint16_t *dst_y, *dst_u, *dst_v;
-  uint32_t i1, i2, i3, i4;
-  yuv_priv_t * priv;
-  priv = s->decoder_priv;
-
-  priv->frame->planes[0] = p->data;
-  
-  for(i = 0; i < s->data.video.format->image_height; i++)
-    {
-    src = priv->frame->planes[0] + i * priv->frame->strides[0];
-
-    dst_y = (uint16_t*)(f->planes[0] + i * f->strides[0]);
-    dst_u = (uint16_t*)(f->planes[1] + i * f->strides[1]);
-    dst_v = (uint16_t*)(f->planes[2] + i * f->strides[2]);
-    
-    for(j = 0; j < s->data.video.format->image_width/6; j++)
-      {
-      i1 = GAVL_PTR_2_32LE(src);src+=4;
-      i2 = GAVL_PTR_2_32LE(src);src+=4;
-      i3 = GAVL_PTR_2_32LE(src);src+=4;
-      i4 = GAVL_PTR_2_32LE(src);src+=4;
-
-      /* These are grouped to show the "pixel pairs" of  4:2:2 */
-      
-      *(dst_u++) = (i1 & 0x3ff) << 6;       /* Cb0 */
-      *(dst_y++) = (i1 & 0xffc00) >> 4;     /* Y0 */
-      *(dst_v++) = (i1 & 0x3ff00000) >> 14; /* Cr0 */
-      *(dst_y++) = (i2 & 0x3ff) << 6;       /* Y1 */
-      
-      *(dst_u++) = (i2 & 0xffc00) >> 4;     /* Cb1 */
-      *(dst_y++) = (i2 & 0x3ff00000) >> 14; /* Y2 */
-      *(dst_v++) = (i3 & 0x3ff) << 6;       /* Cr1 */
-      *(dst_y++) = (i3 & 0xffc00) >> 4;     /* Y3 */
-      
-      *(dst_u++) = (i3 & 0x3ff00000) >> 14; /* Cb2 */
-      *(dst_y++) = (i4 & 0x3ff) << 6;       /* Y4 */
-      *(dst_v++) = (i4 & 0xffc00) >> 4;     /* Cr2 */
-      *(dst_y++) = (i4 & 0x3ff00000) >> 14; /* Y5 */
-      }
-
-    /* Handle the 2 or 4 pixels possibly remaining */
-    j = (s->data.video.format->image_width - ((s->data.video.format->image_width / 6) * 6));
-    if (j != 0)
-      {
-      i1 = GAVL_PTR_2_32LE(src);src+=4;
-      i2 = GAVL_PTR_2_32LE(src);src+=4;
-      i3 = GAVL_PTR_2_32LE(src);src+=4;
-      i4 = GAVL_PTR_2_32LE(src);src+=4;
-
-      *(dst_u++) = (i1 & 0x3ff) << 6;       /* Cb0 */
-      *(dst_y++) = (i1 & 0xffc00) >> 4;     /* Y0 */
-      *(dst_v++) = (i1 & 0x3ff00000) >> 14; /* Cr0 */
-      *(dst_y++) = (i2 & 0x3ff) << 6;       /* Y1 */
-      if (j == 4)
-        {
-        *(dst_u++) = (i2 & 0xffc00) >> 4;     /* Cb1 */
-        *(dst_y++) = (i2 & 0x3ff00000) >> 14; /* Y2 */
-        *(dst_v++) = (i3 & 0x3ff) << 6;       /* Cr1 */
-        *(dst_y++) = (i3 & 0xffc00) >> 4;     /* Y3 */
-        }
-      }
-    }
-  }
-
 static int init_v210(bgav_stream_t * s)
   {
   yuv_priv_t * priv;
@@ -533,7 +957,12 @@ static int init_v210(bgav_stream_t * s)
   priv = s->decoder_priv;
 
   priv->frame->strides[0] = (PAD(s->data.video.format->image_width, 48) * 8) / 3;
-  priv->decode_func = decode_v210;
+  init_packed(s, unpack_rows_planar, unpack_line_v210_c,
+              s->data.video.format->image_height);
+#ifdef HAVE_X86_SIMD
+  if(CPU_SUPPORTS("sse4.1"))
+    priv->unpack_line = unpack_line_v210_sse4;
+#endif
   s->data.video.format->pixelformat = GAVL_YUV_422_P_16;
   return 1;
   }
@@ -545,25 +974,22 @@ static int init_v210(bgav_stream_t * s)
  *  qt4l/lqt universe :-)
  */
 
-static void decode_yuv4(bgav_stream_t * s, bgav_packet_t * p, gavl_video_frame_t * f)
+static void unpack_rows_yuv4(yuv_priv_t * priv, gavl_video_frame_t * f,
+                             int start, int end)
   {
   int i, j;
   uint8_t * src, *dst_y, *dst_u, *dst_v;
-  yuv_priv_t * priv;
-  priv = s->decoder_priv;
-
-  priv->frame->planes[0] = p->data;
 
   /* Packing order for one macropixel is U0V0Y0Y1Y2Y3 */
 
-  for(i = 0; i < s->data.video.format->image_height/2; i++)
+  for(i = start; i < end; i++)
     {
     src = priv->frame->planes[0] + i * priv->frame->strides[0];
     dst_y = f->planes[0] + 2 * i * f->strides[0];
     dst_u = f->planes[1] + i * f->strides[1];
     dst_v = f->planes[2] + i * f->strides[2];
     
-    for(j = 0; j < s->data.video.format->image_width/2; j++)
+    for(j = 0; j < priv->width/2; j++)
       {
       dst_u[0]               = src[0] ^ 0x80;
       dst_v[0]               = src[1] ^ 0x80;
@@ -595,7 +1021,8 @@ static int init_yuv4(bgav_stream_t * s)
   priv = s->decoder_priv;
 
   priv->frame->strides[0] = PAD(s->data.video.format->image_width, 2) * 3;
-  priv->decode_func = decode_yuv4;
+  init_packed(s, unpack_rows_yuv4, NULL,
+              s->data.video.format->image_height/2);
   s->data.video.format->pixelformat = GAVL_YUV_420_P;
   return 1;
   }
@@ -650,6 +1077,8 @@ static void close(bgav_stream_t * s)
   yuv_priv_t * priv;
   priv = s->decoder_priv;
 
+  close_packed(priv);
+  
   gavl_video_frame_null(priv->frame);
   gavl_video_frame_destroy(priv->frame);
   
@@ -0,0 +1,588 @@
+/*****************************************************************
+ * gmerlin-avdecoder - a general purpose multimedia decoding library
+ *
+ * Copyright (c) 2001 - 2012 Members of the Gmerlin project
+ * gmerlin-general@lists.sourceforge.net
+ * http://gmerlin.sourceforge.net
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * *****************************************************************/
+
+/*
+ *  Benchmark for files or directories. For each file we measure
+ *
+ *  - Open latency (bgav_open() and selecting the first track)
+ *  - Demux throughput (compressed packets of all A/V streams)
+ *  - Decode throughput (frames of all A/V streams)
+ *  - Latency of random seeks (until the first frame is decoded)
+ *
+ *  The peak RSS is reported once for the whole run since it is
+ *  a per process value.
+ *
+ *  The results are written as JSON. Test files can be generated
+ *  with bgavgen.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+
+#include <avdec.h>
+
+static int num_seeks = 20;
+static unsigned int seed = 1;
+static bgav_options_t * opt = NULL;
+
+static int64_t get_time()
+  {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+  }
+
+static long get_peak_rss()
+  {
+  struct rusage ru;
+  getrusage(RUSAGE_SELF, &ru);
+  return ru.ru_maxrss; /* kB on Linux */
+  }
+
+static void put_string(FILE * out, const char * str)
+  {
+  fputc('"', out);
+  while(*str)
+    {
+    if((*str == '"') || (*str == '\\'))
+      fprintf(out, "\\%c", *str);
+    else if((unsigned char)*str < 0x20)
+      fprintf(out, "\\u%04x", *str);
+    else
+      fputc(*str, out);
+    str++;
+    }
+  fputc('"', out);
+  }
+
+/* File list */
+
+static char ** files = NULL;
+static int num_files = 0;
+static int files_alloc = 0;
+
+static void add_file(const char * name)
+  {
+  if(num_files + 1 > files_alloc)
+    {
+    files_alloc += 64;
+    files = realloc(files, files_alloc * sizeof(*files));
+    }
+  files[num_files++] = strdup(name);
+  }
+
+static void add_location(const char * location)
+  {
+  struct stat st;
+  DIR * dir;
+  struct dirent * e;
+  char * path;
+
+  if(stat(location, &st) || !S_ISDIR(st.st_mode))
+    {
+    add_file(location);
+    return;
+    }
+
+  if(!(dir = opendir(location)))
+    return;
+
+  while((e = readdir(dir)))
+    {
+    if(e->d_name[0] == '.')
+      continue;
+    path = malloc(strlen(location) + strlen(e->d_name) + 2);
+    sprintf(path, "%s/%s", location, e->d_name);
+    add_location(path);
+    free(path);
+    }
+  closedir(dir);
+  }
+
+static int compare_files(const void * p1, const void * p2)
+  {
+  return strcmp(*(char * const *)p1, *(char * const *)p2);
+  }
+
+static int compare_int64(const void * p1, const void * p2)
+  {
+  int64_t t1 = *(const int64_t*)p1;
+  int64_t t2 = *(const int64_t*)p2;
+  return (t1 > t2) - (t1 < t2);
+  }
+
+static bgav_t * open_file(const char * location)
+  {
+  bgav_t * b = bgav_create();
+  bgav_options_copy(bgav_get_options(b), opt);
+
+  if(!bgav_open(b, location) || !bgav_num_tracks(b))
+    {
+    bgav_close(b);
+    return NULL;
+    }
+  bgav_select_track(b, 0);
+  return b;
+  }
+
+/* Open latency */
+
+static int bench_open(FILE * out, const char * location)
+  {
+  int64_t t;
+  bgav_t * b;
+
+  t = get_time();
+  b = open_file(location);
+  t = get_time() - t;
+
+  if(!b)
+    return 0;
+
+  fprintf(out, "      \"open_us\": %"PRId64",\n", t);
+  fprintf(out, "      \"duration\": %f,\n",
+          gavl_time_to_seconds(bgav_get_duration(b, 0)));
+  fprintf(out, "      \"audio_streams\": %d,\n", bgav_num_audio_streams(b, 0));
+  fprintf(out, "      \"video_streams\": %d,\n", bgav_num_video_streams(b, 0));
+  bgav_close(b);
+  return 1;
+  }
+
+/* Demux throughput */
+
+static void bench_demux(FILE * out, const char * location)
+  {
+  int i;
+  int num_audio, num_video;
+  int active;
+  int64_t t;
+  int64_t packets = 0;
+  int64_t bytes = 0;
+  gavl_packet_t p;
+  bgav_t * b;
+  int * audio_active;
+  int * video_active;
+  double seconds;
+
+  if(!(b = open_file(location)))
+    return;
+
+  num_audio = bgav_num_audio_streams(b, 0);
+  num_video = bgav_num_video_streams(b, 0);
+
+  audio_active = calloc(num_audio + 1, sizeof(*audio_active));
+  video_active = calloc(num_video + 1, sizeof(*video_active));
+
+  active = 0;
+  for(i = 0; i < num_audio; i++)
+    {
+    if(bgav_get_audio_compression_info(b, i, NULL))
+      {
+      bgav_set_audio_stream(b, i, BGAV_STREAM_READRAW);
+      audio_active[i] = 1;
+      active++;
+      }
+    }
+  for(i = 0; i < num_video; i++)
+    {
+    if(bgav_get_video_compression_info(b, i, NULL))
+      {
+      bgav_set_video_stream(b, i, BGAV_STREAM_READRAW);
+      video_active[i] = 1;
+      active++;
+      }
+    }
+
+  if(!active || !bgav_start(b))
+    goto end;
+
+  memset(&p, 0, sizeof(p));
+
+  t = get_time();
+
+  while(active)
+    {
+    for(i = 0; i < num_audio; i++)
+      {
+      if(!audio_active[i])
+        continue;
+      if(!bgav_read_audio_packet(b, i, &p))
+        {
+        audio_active[i] = 0;
+        active--;
+        continue;
+        }
+      packets++;
+      bytes += p.data_len;
+      }
+    for(i = 0; i < num_video; i++)
+      {
+      if(!video_active[i])
+        continue;
+      if(!bgav_read_video_packet(b, i, &p))
+        {
+        video_active[i] = 0;
+        active--;
+        continue;
+        }
+      packets++;
+      bytes += p.data_len;
+      }
+    }
+
+  t = get_time() - t;
+  gavl_packet_free(&p);
+
+  seconds = (double)t / 1000000.0;
+
+  fprintf(out, "      \"demux\": {\n");
+  fprintf(out, "        \"seconds\": %f,\n", seconds);
+  fprintf(out, "        \"packets\": %"PRId64",\n", packets);
+  fprintf(out, "        \"bytes\": %"PRId64",\n", bytes);
+  fprintf(out, "        \"packets_per_second\": %f,\n",
+          seconds > 0.0 ? packets / seconds : 0.0);
+  fprintf(out, "        \"mbytes_per_second\": %f\n",
+          seconds > 0.0 ? bytes / (seconds * 1048576.0) : 0.0);
+  fprintf(out, "      },\n");
+
+  end:
+  free(audio_active);
+  free(video_active);
+  bgav_close(b);
+  }
+
+static void put_perf_counter(FILE * out, const char * name,
+                             const bgav_perf_counter_t * c, int last)
+  {
+  fprintf(out, "\"%s\": { \"time_us\": %"PRId64", \"calls\": %"PRId64
+          ", \"bytes\": %"PRId64", \"dropped\": %"PRId64" }%s",
+          name, c->time, c->calls, c->bytes, c->dropped, last ? "" : ", ");
+  }
+
+static void put_perf(FILE * out, bgav_t * b, int num_audio, int num_video)
+  {
+  int i;
+  bgav_perf_t perf;
+  bgav_stream_perf_t stream_perf;
+
+  bgav_get_perf(b, &perf);
+
+  fprintf(out, "      \"perf\": {\n        ");
+  put_perf_counter(out, "read",  &perf.read, 0);
+  fprintf(out, "\n        ");
+  put_perf_counter(out, "seek",  &perf.seek, 0);
+  fprintf(out, "\n        ");
+  put_perf_counter(out, "demux", &perf.demux, 0);
+  fprintf(out, "\n        \"audio\": [");
+
+  for(i = 0; i < num_audio; i++)
+    {
+    bgav_get_audio_perf(b, i, &stream_perf);
+    fprintf(out, "%s\n          { ", i ? "," : "");
+    put_perf_counter(out, "parse",  &stream_perf.parse, 0);
+    put_perf_counter(out, "decode", &stream_perf.decode, 0);
+    fprintf(out, "\"pool_misses\": %"PRId64" }", stream_perf.pool_misses);
+    }
+  fprintf(out, " ],\n        \"video\": [");
+  for(i = 0; i < num_video; i++)
+    {
+    bgav_get_video_perf(b, i, &stream_perf);
+    fprintf(out, "%s\n          { ", i ? "," : "");
+    put_perf_counter(out, "parse",  &stream_perf.parse, 0);
+    put_perf_counter(out, "decode", &stream_perf.decode, 0);
+    fprintf(out, "\"pool_misses\": %"PRId64" }", stream_perf.pool_misses);
+    }
+  fprintf(out, " ]\n      },\n");
+  }
+
+/* Read one frame from the first stream after a seek */
+
+static int read_first_frame(bgav_t * b, int num_audio, int num_video)
+  {
+  gavl_video_frame_t * vf = NULL;
+  gavl_audio_frame_t * af = NULL;
+
+  if(num_video)
+    return gavl_video_source_read_frame(bgav_get_video_source(b, 0), &vf) ==
+      GAVL_SOURCE_OK;
+  else if(num_audio)
+    return gavl_audio_source_read_frame(bgav_get_audio_source(b, 0), &af) ==
+      GAVL_SOURCE_OK;
+  return 0;
+  }
+
+/* Decode throughput and seek latency. Both use the same instance */
+
+static void bench_decode(FILE * out, const char * location)
+  {
+  int i;
+  int num_audio, num_video;
+  int active;
+  int64_t t;
+  int64_t video_frames = 0;
+  int64_t audio_samples = 0;
+  int64_t * seek_times = NULL;
+  int num_seek_times = 0;
+  int64_t sum;
+  gavl_time_t duration;
+  gavl_time_t seek_time;
+  double seconds;
+  bgav_t * b;
+  gavl_audio_source_t ** asrc;
+  gavl_video_source_t ** vsrc;
+  gavl_audio_frame_t * af;
+  gavl_video_frame_t * vf;
+
+  if(!(b = open_file(location)))
+    return;
+
+  num_audio = bgav_num_audio_streams(b, 0);
+  num_video = bgav_num_video_streams(b, 0);
+
+  for(i = 0; i < num_audio; i++)
+    bgav_set_audio_stream(b, i, BGAV_STREAM_DECODE);
+  for(i = 0; i < num_video; i++)
+    bgav_set_video_stream(b, i, BGAV_STREAM_DECODE);
+
+  /* Fails if one of the decoders cannot be opened */
+  if(!bgav_start(b))
+    {
+    fprintf(out, "      \"error\": \"Starting the decoders failed\",\n");
+    bgav_close(b);
+    return;
+    }
+
+  asrc = calloc(num_audio + 1, sizeof(*asrc));
+  vsrc = calloc(num_video + 1, sizeof(*vsrc));
+
+  for(i = 0; i < num_audio; i++)
+    asrc[i] = bgav_get_audio_source(b, i);
+  for(i = 0; i < num_video; i++)
+    vsrc[i] = bgav_get_video_source(b, i);
+
+  active = num_audio + num_video;
+
+  t = get_time();
+
+  while(active)
+    {
+    for(i = 0; i < num_audio; i++)
+      {
+      if(!asrc[i])
+        continue;
+      af = NULL;
+      if(gavl_audio_source_read_frame(asrc[i], &af) != GAVL_SOURCE_OK)
+        {
+        asrc[i] = NULL;
+        active--;
+        continue;
+        }
+      audio_samples += af->valid_samples;
+      }
+    for(i = 0; i < num_video; i++)
+      {
+      if(!vsrc[i])
+        continue;
+      vf = NULL;
+      if(gavl_video_source_read_frame(vsrc[i], &vf) != GAVL_SOURCE_OK)
+        {
+        vsrc[i] = NULL;
+        active--;
+        continue;
+        }
+      video_frames++;
+      }
+    }
+
+  t = get_time() - t;
+  seconds = (double)t / 1000000.0;
+  duration = bgav_get_duration(b, 0);
+
+  fprintf(out, "      \"decode\": {\n");
+  fprintf(out, "        \"seconds\": %f,\n", seconds);
+  fprintf(out, "        \"video_frames\": %"PRId64",\n", video_frames);
+  fprintf(out, "        \"audio_samples\": %"PRId64",\n", audio_samples);
+  fprintf(out, "        \"video_fps\": %f,\n",
+          seconds > 0.0 ? video_frames / seconds : 0.0);
+  fprintf(out, "        \"realtime_factor\": %f\n",
+          ((seconds > 0.0) && (duration > 0)) ?
+          gavl_time_to_seconds(duration) / seconds : 0.0);
+  fprintf(out, "      },\n");
+
+  put_perf(out, b, num_audio, num_video);
+
+  /* Random seeks */
+
+  if(num_seeks && bgav_can_seek(b) && (duration > 0))
+    {
+    seek_times = malloc(num_seeks * sizeof(*seek_times));
+
+    for(i = 0; i < num_seeks; i++)
+      {
+      seek_time = (gavl_time_t)((double)rand_r(&seed) / RAND_MAX *
+                                (double)duration * 0.95);
+
+      t = get_time();
+      bgav_seek(b, &seek_time);
+      if(!read_first_frame(b, num_audio, num_video))
+        continue;
+      seek_times[num_seek_times++] = get_time() - t;
+      }
+    }
+
+  if(num_seek_times)
+    {
+    qsort(seek_times, num_seek_times, sizeof(*seek_times), compare_int64);
+    sum = 0;
+    for(i = 0; i < num_seek_times; i++)
+      sum += seek_times[i];
+
+    fprintf(out, "      \"seek\": {\n");
+    fprintf(out, "        \"count\": %d,\n", num_seek_times);
+    fprintf(out, "        \"min_us\": %"PRId64",\n", seek_times[0]);
+    fprintf(out, "        \"median_us\": %"PRId64",\n",
+            seek_times[num_seek_times / 2]);
+    fprintf(out, "        \"p90_us\": %"PRId64",\n",
+            seek_times[(num_seek_times * 9) / 10]);
+    fprintf(out, "        \"max_us\": %"PRId64",\n",
+            seek_times[num_seek_times - 1]);
+    fprintf(out, "        \"mean_us\": %"PRId64"\n", sum / num_seek_times);
+    fprintf(out, "      },\n");
+    }
+
+  if(seek_times)
+    free(seek_times);
+  free(asrc);
+  free(vsrc);
+  bgav_close(b);
+  }
+
+static void print_usage()
+  {
+  fprintf(stderr, "Usage: bgavbench [options] <file|directory>\n\n");
+  fprintf(stderr, "-t <threads>     Number of decoding threads\n");
+  fprintf(stderr, "-pipeline        Demux and decode in separate threads\n");
+  fprintf(stderr, "-seeks <num>     Number of random seeks (default: 20)\n");
+  fprintf(stderr, "-seed <num>      Seed for the seek positions (default: 1)\n");
+  fprintf(stderr, "-perf            Measure the time spent in each stage\n");
+  fprintf(stderr, "-o <file>        Write JSON output to file (default: stdout)\n");
+  fprintf(stderr, "\nTest files can be generated with bgavgen\n");
+  }
+
+int main(int argc, char ** argv)
+  {
+  int i;
+  int arg_index;
+  FILE * out = stdout;
+  bgav_t * dummy;
+
+  if(argc < 2)
+    {
+    print_usage();
+    return 0;
+    }
+
+  /* Options container, which is copied into every instance */
+  dummy = bgav_create();
+  opt = bgav_get_options(dummy);
+  bgav_options_set_log_level(opt, BGAV_LOG_ERROR);
+
+  arg_index = 1;
+  while(arg_index < argc - 1)
+    {
+    if(!strcmp(argv[arg_index], "-t"))
+      {
+      bgav_options_set_threads(opt, atoi(argv[arg_index+1]));
+      arg_index += 2;
+      }
+    else if(!strcmp(argv[arg_index], "-pipeline"))
+      {
+      bgav_options_set_pipeline(opt, 1);
+      arg_index++;
+      }
+    else if(!strcmp(argv[arg_index], "-seeks"))
+      {
+      num_seeks = atoi(argv[arg_index+1]);
+      arg_index += 2;
+      }
+    else if(!strcmp(argv[arg_index], "-seed"))
+      {
+      seed = strtoul(argv[arg_index+1], NULL, 10);
+      arg_index += 2;
+      }
+    else if(!strcmp(argv[arg_index], "-perf"))
+      {
+      bgav_options_set_perf_counters(opt, 1);
+      arg_index++;
+      }
+    else if(!strcmp(argv[arg_index], "-o"))
+      {
+      if(!(out = fopen(argv[arg_index+1], "w")))
+        {
+        fprintf(stderr, "Cannot open %s\n", argv[arg_index+1]);
+        return -1;
+        }
+      arg_index += 2;
+      }
+    else
+      arg_index++;
+    }
+
+  add_location(argv[argc-1]);
+  qsort(files, num_files, sizeof(*files), compare_files);
+
+  fprintf(out, "{\n  \"files\": [");
+
+  for(i = 0; i < num_files; i++)
+    {
+    fprintf(stderr, "Benchmarking %s\n", files[i]);
+
+    fprintf(out, "%s\n    {\n", i ? "," : "");
+
+    if(bench_open(out, files[i]))
+      {
+      bench_demux(out, files[i]);
+      bench_decode(out, files[i]);
+      }
+    else
+      fprintf(out, "      \"error\": \"Open failed\",\n");
+
+    /* Last member, all others are followed by a comma */
+    fprintf(out, "      \"location\": ");
+    put_string(out, files[i]);
+    fprintf(out, "\n    }");
+    free(files[i]);
+    }
+
+  fprintf(out, "\n  ],\n  \"peak_rss_kb\": %ld\n}\n", get_peak_rss());
+
+  if(out != stdout)
+    fclose(out);
+  if(files)
+    free(files);
+  bgav_close(dummy);
+  return 0;
+  }
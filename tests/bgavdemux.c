@@ -225,7 +225,7 @@ int main(int argc, char ** argv)
   
   if(argc == 1)
     {
-    fprintf(stderr, "Usage: bgavdemux [-dp] [-t track] [-as <num>] [-vs <num>] <location>\n");
+    fprintf(stderr, "Usage: bgavdemux [-dp] [-copy] [-t track] [-as <num>] [-vs <num>] <location>\n");
     
     return 0;
     }
@@ -256,6 +256,11 @@ int main(int argc, char ** argv)
       dump_packets = 1;
       arg_index++;
       }
+    else if(!strcmp(argv[arg_index], "-copy"))
+      {
+      bgav_options_set_stream_copy(bgav_get_options(file), 1);
+      arg_index++;
+      }
     }
   
   if(!strncmp(argv[argc-1], "vcd://", 6))
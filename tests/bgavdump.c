@@ -167,9 +167,53 @@ static void print_usage()
   fprintf(stderr, "-dh              Dump headers of the file\n");
   fprintf(stderr, "-di              Dump indices of the file\n");
   fprintf(stderr, "-dp              Dump packets\n");
+  fprintf(stderr, "-perf            Measure the time spent in each stage\n");
   fprintf(stderr, "-L               List all demultiplexers and codecs\n");
   }
 
+static void dump_perf_counter(const char * name, const bgav_perf_counter_t * c)
+  {
+  fprintf(stderr, "  %-8s time: %10.3f ms calls: %8"PRId64" bytes: %12"PRId64
+          " dropped: %"PRId64"\n", name, (double)c->time / 1000.0,
+          c->calls, c->bytes, c->dropped);
+  }
+
+static void dump_perf(bgav_t * file, int num_audio_streams, int num_video_streams)
+  {
+  int i;
+  bgav_perf_t perf;
+  bgav_stream_perf_t stream_perf;
+
+  fprintf(stderr, "Performance counters\n");
+  bgav_get_perf(file, &perf);
+  dump_perf_counter("Read",  &perf.read);
+  dump_perf_counter("Seek",  &perf.seek);
+  dump_perf_counter("Demux", &perf.demux);
+
+  if(perf.requests || perf.cache_hits || perf.cache_misses)
+    fprintf(stderr, "  Requests: %"PRId64" (reused connections: %"PRId64
+            "), cache hits: %"PRId64", cache misses: %"PRId64"\n",
+            perf.requests, perf.requests_reused,
+            perf.cache_hits, perf.cache_misses);
+
+  for(i = 0; i < num_audio_streams; i++)
+    {
+    bgav_get_audio_perf(file, i, &stream_perf);
+    fprintf(stderr, " Audio stream %d (pool misses: %"PRId64")\n", i+1,
+            stream_perf.pool_misses);
+    dump_perf_counter("Parse",  &stream_perf.parse);
+    dump_perf_counter("Decode", &stream_perf.decode);
+    }
+  for(i = 0; i < num_video_streams; i++)
+    {
+    bgav_get_video_perf(file, i, &stream_perf);
+    fprintf(stderr, " Video stream %d (pool misses: %"PRId64")\n", i+1,
+            stream_perf.pool_misses);
+    dump_perf_counter("Parse",  &stream_perf.parse);
+    dump_perf_counter("Decode", &stream_perf.decode);
+    }
+  }
+
 static void list_all()
   {
   bgav_inputs_dump();
@@ -301,6 +345,11 @@ int main(int argc, char ** argv)
       bgav_options_set_dump_indices(opt, 1);
       arg_index++;
       }
+    else if(!strcmp(argv[arg_index], "-perf"))
+      {
+      bgav_options_set_perf_counters(opt, 1);
+      arg_index++;
+      }
     else if(!strcmp(argv[arg_index], "-v"))
       {
       log_level = strtol(argv[arg_index+1], NULL, 10);
@@ -676,6 +725,10 @@ int main(int argc, char ** argv)
         fprintf(stderr, "Failed\n");
       gavl_video_frame_destroy(ovl);
       }
+
+    dump_perf(file,
+              do_audio ? num_audio_streams : 0,
+              do_video ? num_video_streams : 0);
 #ifndef TRACK
     }
 #endif
@@ -0,0 +1,679 @@
+/*****************************************************************
+ * gmerlin-avdecoder - a general purpose multimedia decoding library
+ *
+ * Copyright (c) 2001 - 2012 Members of the Gmerlin project
+ * gmerlin-general@lists.sourceforge.net
+ * http://gmerlin.sourceforge.net
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * *****************************************************************/
+
+/*
+ *  Generate synthetic test files for bgavbench. All files are written
+ *  without external libraries:
+ *
+ *  wav: 16 bit stereo PCM (sine)
+ *  y4m: YUV 4:2:0 (moving gradient)
+ *  avi: Uncompressed packed YUV (yuv2, 2vuy, v308, v408, v410, v210)
+ *  ps:  MPEG-2 program stream with DVD LPCM audio (sine)
+ *  ts:  MPEG-2 transport stream with (silent) MPEG-1 layer II audio
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <math.h>
+
+#define SAMPLERATE  48000
+#define NUM_CHANNELS 2
+#define FRAMERATE   25
+
+static int width  = 320;
+static int height = 240;
+static double duration = 10.0;
+
+/* Byte writers */
+
+static void put_8(FILE * out, int val)
+  {
+  fputc(val & 0xff, out);
+  }
+
+static void put_16_le(FILE * out, int val)
+  {
+  put_8(out, val);
+  put_8(out, val >> 8);
+  }
+
+static void put_32_le(FILE * out, uint32_t val)
+  {
+  put_16_le(out, val & 0xffff);
+  put_16_le(out, val >> 16);
+  }
+
+static void put_fourcc(FILE * out, const char * fourcc)
+  {
+  fwrite(fourcc, 1, 4, out);
+  }
+
+static int16_t sine_sample(int64_t sample, int channel)
+  {
+  double freq = channel ? 660.0 : 440.0;
+  return (int16_t)(16000.0 * sin(2.0 * M_PI * freq * sample / SAMPLERATE));
+  }
+
+/* WAV */
+
+static int write_wav(FILE * out)
+  {
+  int64_t i;
+  int j;
+  int64_t num_samples = (int64_t)(duration * SAMPLERATE);
+  uint32_t data_size = num_samples * NUM_CHANNELS * 2;
+
+  put_fourcc(out, "RIFF");
+  put_32_le(out, 36 + data_size);
+  put_fourcc(out, "WAVE");
+
+  put_fourcc(out, "fmt ");
+  put_32_le(out, 16);
+  put_16_le(out, 1); /* PCM */
+  put_16_le(out, NUM_CHANNELS);
+  put_32_le(out, SAMPLERATE);
+  put_32_le(out, SAMPLERATE * NUM_CHANNELS * 2);
+  put_16_le(out, NUM_CHANNELS * 2);
+  put_16_le(out, 16);
+
+  put_fourcc(out, "data");
+  put_32_le(out, data_size);
+
+  for(i = 0; i < num_samples; i++)
+    {
+    for(j = 0; j < NUM_CHANNELS; j++)
+      put_16_le(out, sine_sample(i, j));
+    }
+  return 1;
+  }
+
+/* Y4M */
+
+static int write_y4m(FILE * out)
+  {
+  int i, x, y;
+  int num_frames = (int)(duration * FRAMERATE);
+  uint8_t * line = malloc(width);
+
+  fprintf(out, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n",
+          width, height, FRAMERATE);
+
+  for(i = 0; i < num_frames; i++)
+    {
+    fprintf(out, "FRAME\n");
+
+    for(y = 0; y < height; y++)
+      {
+      for(x = 0; x < width; x++)
+        line[x] = (x + y + 4 * i) & 0xff;
+      fwrite(line, 1, width, out);
+      }
+    for(y = 0; y < height; y++) /* U and V */
+      {
+      for(x = 0; x < width / 2; x++)
+        line[x] = (y < height / 2) ? (x + i) & 0xff : (y - i) & 0xff;
+      fwrite(line, 1, width / 2, out);
+      }
+    }
+  free(line);
+  return 1;
+  }
+
+/* AVI with packed YUV */
+
+static const struct
+  {
+  const char * fourcc;
+  int bits_per_pixel;
+  }
+avi_formats[] =
+  {
+    { "yuv2", 16 },
+    { "2vuy", 16 },
+    { "v308", 24 },
+    { "v408", 32 },
+    { "v410", 32 },
+    { "v210", 20 },
+  };
+
+#define PAD(sz, num) (((sz+num-1)/num)*num)
+
+/* Line sizes as expected by the yuv decoder */
+
+static int get_avi_stride(const char * fourcc)
+  {
+  if(!strcmp(fourcc, "yuv2") || !strcmp(fourcc, "2vuy"))
+    return PAD(width * 2, 4);
+  else if(!strcmp(fourcc, "v308"))
+    return width * 3;
+  else if(!strcmp(fourcc, "v210"))
+    return (PAD(width, 48) * 8) / 3;
+  else
+    return width * 4;
+  }
+
+static int write_avi(FILE * out, const char * fourcc)
+  {
+  int i, j;
+  int bits_per_pixel = 0;
+  int num_frames = (int)(duration * FRAMERATE);
+  uint32_t frame_size;
+  uint32_t movi_size;
+  uint32_t hdrl_size;
+  uint32_t idx1_size;
+  uint8_t * frame;
+
+  for(i = 0; i < (int)(sizeof(avi_formats)/sizeof(avi_formats[0])); i++)
+    {
+    if(!strcmp(avi_formats[i].fourcc, fourcc))
+      {
+      bits_per_pixel = avi_formats[i].bits_per_pixel;
+      break;
+      }
+    }
+  if(!bits_per_pixel)
+    {
+    fprintf(stderr, "Unsupported fourcc %s\n", fourcc);
+    return 0;
+    }
+
+  frame_size = get_avi_stride(fourcc) * height;
+  movi_size  = 4 + num_frames * (8 + PAD(frame_size, 2));
+  idx1_size  = num_frames * 16;
+  hdrl_size  = 4 + (8 + 56) + (8 + 4 + (8 + 56) + (8 + 40));
+
+  put_fourcc(out, "RIFF");
+  put_32_le(out, 4 + (8 + hdrl_size) + (8 + movi_size) + (8 + idx1_size));
+  put_fourcc(out, "AVI ");
+
+  put_fourcc(out, "LIST");
+  put_32_le(out, hdrl_size);
+  put_fourcc(out, "hdrl");
+
+  /* avih */
+  put_fourcc(out, "avih");
+  put_32_le(out, 56);
+  put_32_le(out, 1000000 / FRAMERATE);    /* dwMicroSecPerFrame */
+  put_32_le(out, frame_size * FRAMERATE); /* dwMaxBytesPerSec */
+  put_32_le(out, 0);                      /* dwPaddingGranularity */
+  put_32_le(out, 0x10);                   /* dwFlags (AVIF_HASINDEX) */
+  put_32_le(out, num_frames);             /* dwTotalFrames */
+  put_32_le(out, 0);                      /* dwInitialFrames */
+  put_32_le(out, 1);                      /* dwStreams */
+  put_32_le(out, frame_size + 8);         /* dwSuggestedBufferSize */
+  put_32_le(out, width);
+  put_32_le(out, height);
+  for(i = 0; i < 4; i++)
+    put_32_le(out, 0);
+
+  put_fourcc(out, "LIST");
+  put_32_le(out, 4 + (8 + 56) + (8 + 40));
+  put_fourcc(out, "strl");
+
+  /* strh */
+  put_fourcc(out, "strh");
+  put_32_le(out, 56);
+  put_fourcc(out, "vids");
+  put_fourcc(out, fourcc);
+  put_32_le(out, 0);          /* dwFlags */
+  put_16_le(out, 0);          /* wPriority */
+  put_16_le(out, 0);          /* wLanguage */
+  put_32_le(out, 0);          /* dwInitialFrames */
+  put_32_le(out, 1);          /* dwScale */
+  put_32_le(out, FRAMERATE);  /* dwRate */
+  put_32_le(out, 0);          /* dwStart */
+  put_32_le(out, num_frames); /* dwLength */
+  put_32_le(out, frame_size); /* dwSuggestedBufferSize */
+  put_32_le(out, 0xffffffff); /* dwQuality */
+  put_32_le(out, 0);          /* dwSampleSize */
+  put_16_le(out, 0);          /* rcFrame */
+  put_16_le(out, 0);
+  put_16_le(out, width);
+  put_16_le(out, height);
+
+  /* strf */
+  put_fourcc(out, "strf");
+  put_32_le(out, 40);
+  put_32_le(out, 40);         /* biSize */
+  put_32_le(out, width);
+  put_32_le(out, height);
+  put_16_le(out, 1);          /* biPlanes */
+  put_16_le(out, bits_per_pixel);
+  put_fourcc(out, fourcc);    /* biCompression */
+  put_32_le(out, frame_size); /* biSizeImage */
+  for(i = 0; i < 4; i++)
+    put_32_le(out, 0);
+
+  /* movi */
+  put_fourcc(out, "LIST");
+  put_32_le(out, movi_size);
+  put_fourcc(out, "movi");
+
+  frame = malloc(PAD(frame_size, 2));
+  memset(frame, 0, PAD(frame_size, 2));
+
+  for(i = 0; i < num_frames; i++)
+    {
+    for(j = 0; j < (int)frame_size; j++)
+      frame[j] = (j * 7 + i * 3) & 0xff;
+    put_fourcc(out, "00dc");
+    put_32_le(out, frame_size);
+    fwrite(frame, 1, PAD(frame_size, 2), out);
+    }
+  free(frame);
+
+  /* idx1: Offsets are relative to the "movi" fourcc */
+  put_fourcc(out, "idx1");
+  put_32_le(out, idx1_size);
+  for(i = 0; i < num_frames; i++)
+    {
+    put_fourcc(out, "00dc");
+    put_32_le(out, 0x10); /* AVIIF_KEYFRAME */
+    put_32_le(out, 4 + i * (8 + PAD(frame_size, 2)));
+    put_32_le(out, frame_size);
+    }
+  return 1;
+  }
+
+/* MPEG helpers */
+
+static void put_pts(uint8_t * ptr, int prefix, int64_t pts)
+  {
+  ptr[0] = (prefix << 4) | ((pts >> 29) & 0x0e) | 0x01;
+  ptr[1] = (pts >> 22) & 0xff;
+  ptr[2] = ((pts >> 14) & 0xfe) | 0x01;
+  ptr[3] = (pts >> 7) & 0xff;
+  ptr[4] = ((pts << 1) & 0xfe) | 0x01;
+  }
+
+/* PS with DVD LPCM */
+
+#define LPCM_SAMPLES 480 /* 10 ms */
+
+static void put_pack_header(FILE * out, int64_t scr, int mux_rate)
+  {
+  uint8_t buf[14];
+
+  buf[0] = 0x00;
+  buf[1] = 0x00;
+  buf[2] = 0x01;
+  buf[3] = 0xba;
+  buf[4] = 0x44 | ((scr >> 27) & 0x38) | ((scr >> 28) & 0x03);
+  buf[5] = (scr >> 20) & 0xff;
+  buf[6] = ((scr >> 12) & 0xf8) | 0x04 | ((scr >> 13) & 0x03);
+  buf[7] = (scr >> 5) & 0xff;
+  buf[8] = ((scr << 3) & 0xf8) | 0x04;
+  buf[9] = 0x01;
+  buf[10] = (mux_rate >> 14) & 0xff;
+  buf[11] = (mux_rate >> 6) & 0xff;
+  buf[12] = ((mux_rate << 2) & 0xfc) | 0x03;
+  buf[13] = 0xf8; /* No stuffing */
+  fwrite(buf, 1, 14, out);
+  }
+
+static int write_ps(FILE * out)
+  {
+  int i, j;
+  int64_t sample = 0;
+  int64_t pts;
+  int64_t num_samples = (int64_t)(duration * SAMPLERATE);
+  int payload_size = LPCM_SAMPLES * NUM_CHANNELS * 2;
+  uint8_t header[14];
+  uint8_t * payload = malloc(payload_size);
+  uint8_t * ptr;
+  int frame_number = 0;
+
+  /* Bytes per second in units of 50 bytes */
+  int mux_rate = ((payload_size + 64) * (SAMPLERATE / LPCM_SAMPLES)) / 50;
+
+  while(sample < num_samples)
+    {
+    pts = (sample * 90000) / SAMPLERATE;
+
+    /* The PTS is 100 ms after the SCR */
+    put_pack_header(out, pts, mux_rate);
+
+    /* PES header */
+    header[0] = 0x00;
+    header[1] = 0x00;
+    header[2] = 0x01;
+    header[3] = 0xbd; /* Private stream 1 */
+    header[4] = ((3 + 5 + 7 + payload_size) >> 8) & 0xff;
+    header[5] = (3 + 5 + 7 + payload_size) & 0xff;
+    header[6] = 0x81;
+    header[7] = 0x80; /* PTS */
+    header[8] = 5;
+    put_pts(header + 9, 0x02, pts + 9000);
+    fwrite(header, 1, 14, out);
+
+    /* Substream ID, number of frames, first access unit */
+    put_8(out, 0xa0);
+    put_8(out, 0x01);
+    put_8(out, 0x00);
+    put_8(out, 0x04);
+
+    /* emphasis, mute, reserved, frame number */
+    put_8(out, frame_number & 0x1f);
+    /* 16 bit, 48 kHz, channels */
+    put_8(out, NUM_CHANNELS - 1);
+    /* Dynamic range control */
+    put_8(out, 0x80);
+
+    /* Samples are big endian */
+    ptr = payload;
+    for(i = 0; i < LPCM_SAMPLES; i++)
+      {
+      for(j = 0; j < NUM_CHANNELS; j++)
+        {
+        int16_t s = sine_sample(sample + i, j);
+        ptr[0] = (s >> 8) & 0xff;
+        ptr[1] = s & 0xff;
+        ptr += 2;
+        }
+      }
+    fwrite(payload, 1, payload_size, out);
+
+    sample += LPCM_SAMPLES;
+    frame_number++;
+    }
+
+  /* Program end code */
+  put_8(out, 0x00);
+  put_8(out, 0x00);
+  put_8(out, 0x01);
+  put_8(out, 0xb9);
+
+  free(payload);
+  return 1;
+  }
+
+/* TS with MPEG-1 layer II */
+
+#define TS_PACKET_SIZE 188
+
+#define PID_PMT   0x1000
+#define PID_AUDIO 0x0100
+
+/* 128 kbps, 48 kHz, stereo, no CRC */
+#define MP2_FRAME_SIZE    384
+#define MP2_FRAME_SAMPLES 1152
+
+static uint32_t crc32_mpeg(const uint8_t * data, int len)
+  {
+  int i, j;
+  uint32_t crc = 0xffffffff;
+
+  for(i = 0; i < len; i++)
+    {
+    crc ^= (uint32_t)data[i] << 24;
+    for(j = 0; j < 8; j++)
+      crc = (crc & 0x80000000) ? (crc << 1) ^ 0x04c11db7 : (crc << 1);
+    }
+  return crc;
+  }
+
+/* Write a PSI section into a single TS packet */
+
+static void put_section(FILE * out, int pid, uint8_t * section, int len,
+                        int * cc)
+  {
+  uint8_t pkt[TS_PACKET_SIZE];
+  uint32_t crc;
+
+  crc = crc32_mpeg(section, len);
+  section[len]   = crc >> 24;
+  section[len+1] = (crc >> 16) & 0xff;
+  section[len+2] = (crc >> 8) & 0xff;
+  section[len+3] = crc & 0xff;
+  len += 4;
+
+  memset(pkt, 0xff, TS_PACKET_SIZE);
+  pkt[0] = 0x47;
+  pkt[1] = 0x40 | (pid >> 8);
+  pkt[2] = pid & 0xff;
+  pkt[3] = 0x10 | (*cc & 0x0f);
+  pkt[4] = 0x00; /* Pointer field */
+  memcpy(pkt + 5, section, len);
+
+  (*cc)++;
+  fwrite(pkt, 1, TS_PACKET_SIZE, out);
+  }
+
+static void put_pat_pmt(FILE * out, int * pat_cc, int * pmt_cc)
+  {
+  uint8_t section[32];
+
+  /* PAT */
+  section[0] = 0x00;        /* table_id */
+  section[1] = 0xb0;        /* syntax indicator, section_length */
+  section[2] = 13;
+  section[3] = 0x00;        /* transport_stream_id */
+  section[4] = 0x01;
+  section[5] = 0xc1;        /* version 0, current */
+  section[6] = 0x00;        /* section_number */
+  section[7] = 0x00;        /* last_section_number */
+  section[8] = 0x00;        /* program_number */
+  section[9] = 0x01;
+  section[10] = 0xe0 | (PID_PMT >> 8);
+  section[11] = PID_PMT & 0xff;
+  put_section(out, 0x0000, section, 12, pat_cc);
+
+  /* PMT */
+  section[0] = 0x02;
+  section[1] = 0xb0;
+  section[2] = 18;
+  section[3] = 0x00;        /* program_number */
+  section[4] = 0x01;
+  section[5] = 0xc1;
+  section[6] = 0x00;
+  section[7] = 0x00;
+  section[8] = 0xe0 | (PID_AUDIO >> 8); /* PCR PID */
+  section[9] = PID_AUDIO & 0xff;
+  section[10] = 0xf0;       /* program_info_length */
+  section[11] = 0x00;
+  section[12] = 0x03;       /* MPEG-1 audio */
+  section[13] = 0xe0 | (PID_AUDIO >> 8);
+  section[14] = PID_AUDIO & 0xff;
+  section[15] = 0xf0;       /* ES_info_length */
+  section[16] = 0x00;
+  put_section(out, PID_PMT, section, 17, pmt_cc);
+  }
+
+/* Packetize one PES packet. The first TS packet carries the PCR */
+
+static void put_pes_ts(FILE * out, int pid, const uint8_t * data, int len,
+                       int64_t pcr, int * cc)
+  {
+  uint8_t pkt[TS_PACKET_SIZE];
+  int af_len;
+  int payload_len;
+  int first = 1;
+  int pos;
+
+  while(len)
+    {
+    af_len = 0;
+    if(first)
+      af_len = 8; /* length, flags, PCR */
+
+    payload_len = TS_PACKET_SIZE - 4 - af_len;
+
+    if(len < payload_len)
+      {
+      af_len += payload_len - len;
+      payload_len = len;
+      }
+
+    pkt[0] = 0x47;
+    pkt[1] = (first ? 0x40 : 0x00) | (pid >> 8);
+    pkt[2] = pid & 0xff;
+    pkt[3] = (af_len ? 0x30 : 0x10) | (*cc & 0x0f);
+    pos = 4;
+
+    if(af_len)
+      {
+      pkt[pos] = af_len - 1;
+      if(af_len > 1)
+        {
+        memset(pkt + pos + 1, 0xff, af_len - 1);
+        pkt[pos + 1] = 0x00;
+        if(first)
+          {
+          pkt[pos + 1] = 0x10; /* PCR flag */
+          pkt[pos + 2] = (pcr >> 25) & 0xff;
+          pkt[pos + 3] = (pcr >> 17) & 0xff;
+          pkt[pos + 4] = (pcr >> 9) & 0xff;
+          pkt[pos + 5] = (pcr >> 1) & 0xff;
+          pkt[pos + 6] = ((pcr & 1) << 7) | 0x7e;
+          pkt[pos + 7] = 0x00;
+          }
+        }
+      pos += af_len;
+      }
+    memcpy(pkt + pos, data, payload_len);
+    fwrite(pkt, 1, TS_PACKET_SIZE, out);
+
+    data += payload_len;
+    len -= payload_len;
+    (*cc)++;
+    first = 0;
+    }
+  }
+
+static int write_ts(FILE * out)
+  {
+  int64_t frame = 0;
+  int64_t num_frames =
+    (int64_t)(duration * SAMPLERATE) / MP2_FRAME_SAMPLES;
+  int64_t pts;
+  int pat_cc = 0, pmt_cc = 0, audio_cc = 0;
+  uint8_t pes[6 + 3 + 5 + MP2_FRAME_SIZE];
+
+  /* PES header */
+  pes[0] = 0x00;
+  pes[1] = 0x00;
+  pes[2] = 0x01;
+  pes[3] = 0xc0;
+  pes[4] = ((3 + 5 + MP2_FRAME_SIZE) >> 8) & 0xff;
+  pes[5] = (3 + 5 + MP2_FRAME_SIZE) & 0xff;
+  pes[6] = 0x80;
+  pes[7] = 0x80; /* PTS */
+  pes[8] = 5;
+
+  /* Layer II frame with all bit allocations zero (silence) */
+  memset(pes + 14, 0, MP2_FRAME_SIZE);
+  pes[14] = 0xff;
+  pes[15] = 0xfd; /* MPEG-1, layer II, no CRC */
+  pes[16] = 0x84; /* 128 kbps, 48 kHz */
+  pes[17] = 0x04; /* Stereo, original */
+
+  while(frame < num_frames)
+    {
+    pts = (frame * MP2_FRAME_SAMPLES * 90000) / SAMPLERATE;
+
+    /* Tables every 100 ms */
+    if(!(frame % 4))
+      put_pat_pmt(out, &pat_cc, &pmt_cc);
+
+    put_pts(pes + 9, 0x02, pts + 9000);
+    put_pes_ts(out, PID_AUDIO, pes, sizeof(pes), pts, &audio_cc);
+    frame++;
+    }
+  return 1;
+  }
+
+static void print_usage()
+  {
+  fprintf(stderr, "Usage: bgavgen [options] <type> <file>\n\n");
+  fprintf(stderr, "Types: wav, y4m, avi, ps, ts\n\n");
+  fprintf(stderr, "-d <seconds>     Duration (default: 10)\n");
+  fprintf(stderr, "-s <w>x<h>       Image size (default: 320x240)\n");
+  fprintf(stderr, "-fourcc <fourcc> Fourcc for avi: yuv2 (default), 2vuy,\n");
+  fprintf(stderr, "                 v308, v408, v410, v210\n");
+  }
+
+int main(int argc, char ** argv)
+  {
+  int arg_index;
+  int result = 0;
+  const char * type;
+  const char * fourcc = "yuv2";
+  FILE * out;
+
+  if(argc < 3)
+    {
+    print_usage();
+    return 0;
+    }
+
+  arg_index = 1;
+  while(arg_index < argc - 2)
+    {
+    if(!strcmp(argv[arg_index], "-d"))
+      {
+      duration = strtod(argv[arg_index+1], NULL);
+      arg_index += 2;
+      }
+    else if(!strcmp(argv[arg_index], "-s"))
+      {
+      if(sscanf(argv[arg_index+1], "%dx%d", &width, &height) < 2)
+        {
+        fprintf(stderr, "Invalid image size %s\n", argv[arg_index+1]);
+        return -1;
+        }
+      arg_index += 2;
+      }
+    else if(!strcmp(argv[arg_index], "-fourcc"))
+      {
+      fourcc = argv[arg_index+1];
+      arg_index += 2;
+      }
+    else
+      arg_index++;
+    }
+
+  type = argv[argc-2];
+
+  out = fopen(argv[argc-1], "wb");
+  if(!out)
+    {
+    fprintf(stderr, "Cannot open %s\n", argv[argc-1]);
+    return -1;
+    }
+
+  if(!strcmp(type, "wav"))
+    result = write_wav(out);
+  else if(!strcmp(type, "y4m"))
+    result = write_y4m(out);
+  else if(!strcmp(type, "avi"))
+    result = write_avi(out, fourcc);
+  else if(!strcmp(type, "ps"))
+    result = write_ps(out);
+  else if(!strcmp(type, "ts"))
+    result = write_ts(out);
+  else
+    fprintf(stderr, "Unknown type %s\n", type);
+
+  fclose(out);
+  return result ? 0 : -1;
+  }